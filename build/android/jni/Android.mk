@@ -133,6 +133,7 @@ LOCAL_SRC_FILES :=                                \
 		jni/src/convert_json.cpp                  \
 		jni/src/craftdef.cpp                      \
 		jni/src/database-dummy.cpp                \
+		jni/src/database-files.cpp                \
 		jni/src/database-sqlite3.cpp              \
 		jni/src/database.cpp                      \
 		jni/src/debug.cpp                         \
@@ -188,6 +189,7 @@ LOCAL_SRC_FILES :=                                \
 		jni/src/mg_schematic.cpp                  \
 		jni/src/minimap.cpp                       \
 		jni/src/mods.cpp                          \
+		jni/src/mod_storage.cpp                   \
 		jni/src/nameidmapping.cpp                 \
 		jni/src/nodedef.cpp                       \
 		jni/src/nodemetadata.cpp                  \
@@ -236,6 +238,7 @@ LOCAL_SRC_FILES :=                                \
 		jni/src/unittest/test_compression.cpp     \
 		jni/src/unittest/test_connection.cpp      \
 		jni/src/unittest/test_filepath.cpp        \
+		jni/src/unittest/test_imagefilters.cpp    \
 		jni/src/unittest/test_inventory.cpp       \
 		jni/src/unittest/test_mapnode.cpp         \
 		jni/src/unittest/test_nodedef.cpp         \
@@ -263,10 +266,12 @@ LOCAL_SRC_FILES :=                                \
 # Network
 LOCAL_SRC_FILES +=                                \
 		jni/src/network/connection.cpp            \
+		jni/src/network/mediaserver.cpp           \
 		jni/src/network/networkpacket.cpp         \
 		jni/src/network/clientopcodes.cpp         \
 		jni/src/network/clientpackethandler.cpp   \
 		jni/src/network/serveropcodes.cpp         \
+		jni/src/network/serverreceivequeue.cpp    \
 		jni/src/network/serverpackethandler.cpp   \
 
 # lua api
@@ -274,6 +279,8 @@ LOCAL_SRC_FILES +=                                \
 		jni/src/script/common/c_content.cpp       \
 		jni/src/script/common/c_converter.cpp     \
 		jni/src/script/common/c_internal.cpp      \
+		jni/src/script/common/c_packer.cpp        \
+		jni/src/script/common/c_profiler.cpp      \
 		jni/src/script/common/c_types.cpp         \
 		jni/src/script/cpp_api/s_async.cpp        \
 		jni/src/script/cpp_api/s_base.cpp         \
@@ -288,6 +295,7 @@ LOCAL_SRC_FILES +=                                \
 		jni/src/script/cpp_api/s_security.cpp     \
 		jni/src/script/cpp_api/s_server.cpp       \
 		jni/src/script/lua_api/l_areastore.cpp    \
+		jni/src/script/lua_api/l_auth.cpp         \
 		jni/src/script/lua_api/l_base.cpp         \
 		jni/src/script/lua_api/l_craft.cpp        \
 		jni/src/script/lua_api/l_env.cpp          \
@@ -303,6 +311,8 @@ LOCAL_SRC_FILES +=                                \
 		jni/src/script/lua_api/l_rollback.cpp     \
 		jni/src/script/lua_api/l_server.cpp       \
 		jni/src/script/lua_api/l_settings.cpp     \
+		jni/src/script/lua_api/l_sharedbuffer.cpp \
+		jni/src/script/lua_api/l_storage.cpp      \
 		jni/src/script/lua_api/l_http.cpp         \
 		jni/src/script/lua_api/l_util.cpp         \
 		jni/src/script/lua_api/l_vmanip.cpp       \
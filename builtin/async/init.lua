@@ -1,17 +1,24 @@
 
 core.log("info", "Initializing Asynchronous environment")
 
-function core.job_processor(serialized_func, serialized_param)
-	local func = loadstring(serialized_func)
-	local param = core.deserialize(serialized_param)
-	local retval = nil
+core.registered_async_functions = {}
 
-	if type(func) == "function" then
-		retval = core.serialize(func(param))
-	else
-		core.log("error", "ASYNC WORKER: Unable to deserialize function")
+function core.register_async_function(name, func)
+	assert(type(name) == "string", "Async function name must be a string")
+	assert(type(func) == "function", "Async function must be a function")
+	-- Jobs starting with this byte are taken as bytecode
+	assert(name:byte(1) ~= 27, "Async function name must not start with \\027")
+	core.registered_async_functions[name] = func
+end
+
+function core.job_processor(func, param)
+	if type(func) == "string" then
+		local name = func
+		func = core.registered_async_functions[name]
+		if not func then
+			error("Async function '" .. name .. "' is not registered")
+		end
 	end
 
-	return retval or core.serialize(nil)
+	return func(param)
 end
-
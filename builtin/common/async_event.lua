@@ -1,8 +1,7 @@
 
 core.async_jobs = {}
 
-local function handle_job(jobid, serialized_retval)
-	local retval = core.deserialize(serialized_retval)
+local function handle_job(jobid, retval)
 	assert(type(core.async_jobs[jobid]) == "function")
 	core.async_jobs[jobid](retval)
 	core.async_jobs[jobid] = nil
@@ -18,23 +17,17 @@ else
 	core.async_event_handler = handle_job
 end
 
+-- func is either a function, which is dumped to bytecode for every job,
+-- or the name of a function registered with core.register_async_function.
 function core.handle_async(func, parameter, callback)
-	-- Serialize function
-	local serialized_func = string.dump(func)
-
-	assert(serialized_func ~= nil)
-
-	-- Serialize parameters
-	local serialized_param = core.serialize(parameter)
-
-	if serialized_param == nil then
-		return false
+	if type(func) == "function" then
+		func = string.dump(func)
+		assert(func ~= nil)
 	end
 
-	local jobid = core.do_async_callback(serialized_func, serialized_param)
+	local jobid = core.do_async_callback(func, parameter)
 
 	core.async_jobs[jobid] = callback
 
 	return true
 end
-
@@ -29,75 +29,22 @@ end
 assert(core.string_to_privs("a,b").b == true)
 assert(core.privs_to_string({a=true,b=true}) == "a,b")
 
-core.auth_file_path = core.get_worldpath().."/auth.txt"
-core.auth_table = {}
-
-local function read_auth_file()
-	local newtable = {}
-	local file, errmsg = io.open(core.auth_file_path, 'rb')
-	if not file then
-		core.log("info", core.auth_file_path.." could not be opened for reading ("..errmsg.."); assuming new world")
-		return
-	end
-	for line in file:lines() do
-		if line ~= "" then
-			local fields = line:split(":", true)
-			local name, password, privilege_string, last_login = unpack(fields)
-			last_login = tonumber(last_login)
-			if not (name and password and privilege_string) then
-				error("Invalid line in auth.txt: "..dump(line))
-			end
-			local privileges = core.string_to_privs(privilege_string)
-			newtable[name] = {password=password, privileges=privileges, last_login=last_login}
-		end
-	end
-	io.close(file)
-	core.auth_table = newtable
-	core.notify_authentication_modified()
-end
-
-local function save_auth_file()
-	local newtable = {}
-	-- Check table for validness before attempting to save
-	for name, stuff in pairs(core.auth_table) do
-		assert(type(name) == "string")
-		assert(name ~= "")
-		assert(type(stuff) == "table")
-		assert(type(stuff.password) == "string")
-		assert(type(stuff.privileges) == "table")
-		assert(stuff.last_login == nil or type(stuff.last_login) == "number")
-	end
-	local file, errmsg = io.open(core.auth_file_path, 'w+b')
-	if not file then
-		error(core.auth_file_path.." could not be opened for writing: "..errmsg)
-	end
-	for name, stuff in pairs(core.auth_table) do
-		local priv_string = core.privs_to_string(stuff.privileges)
-		local parts = {name, stuff.password, priv_string, stuff.last_login or ""}
-		file:write(table.concat(parts, ":").."\n")
-	end
-	io.close(file)
-end
-
-read_auth_file()
+-- Entries live in the auth database of the world (see auth_backend in
+-- world.mt), core.auth reads and writes single entries of it.
+local core_auth = core.auth
+core.auth = nil
 
 core.builtin_auth_handler = {
 	get_auth = function(name)
 		assert(type(name) == "string")
-		-- Figure out what password to use for a new player (singleplayer
-		-- always has an empty password, otherwise use default, which is
-		-- usually empty too)
-		local new_password_hash = ""
-		-- If not in authentication table, return nil
-		if not core.auth_table[name] then
+		-- If not in authentication database, return nil
+		local auth_entry = core_auth.read(name)
+		if not auth_entry then
 			return nil
 		end
 		-- Figure out what privileges the player should have.
-		-- Take a copy of the privilege table
-		local privileges = {}
-		for priv, _ in pairs(core.auth_table[name].privileges) do
-			privileges[priv] = true
-		end
+		-- The entry is a fresh table, so its privileges can be extended
+		local privileges = auth_entry.privileges
 		-- If singleplayer, give all privileges except those marked as give_to_singleplayer = false
 		if core.is_singleplayer() then
 			for priv, def in pairs(core.registered_privileges) do
@@ -113,55 +60,73 @@ core.builtin_auth_handler = {
 		end
 		-- All done
 		return {
-			password = core.auth_table[name].password,
+			password = auth_entry.password,
 			privileges = privileges,
 			-- Is set to nil if unknown
-			last_login = core.auth_table[name].last_login,
+			last_login = auth_entry.last_login,
 		}
 	end,
 	create_auth = function(name, password)
 		assert(type(name) == "string")
 		assert(type(password) == "string")
 		core.log('info', "Built-in authentication handler adding player '"..name.."'")
-		core.auth_table[name] = {
+		core_auth.save({
+			name = name,
 			password = password,
 			privileges = core.string_to_privs(core.setting_get("default_privs")),
 			last_login = os.time(),
-		}
-		save_auth_file()
+		})
+	end,
+	delete_auth = function(name)
+		assert(type(name) == "string")
+		core.log('info', "Built-in authentication handler deleting player '"..name.."'")
+		return core_auth.delete(name)
 	end,
 	set_password = function(name, password)
 		assert(type(name) == "string")
 		assert(type(password) == "string")
-		if not core.auth_table[name] then
+		local auth_entry = core_auth.read(name)
+		if not auth_entry then
 			core.builtin_auth_handler.create_auth(name, password)
 		else
 			core.log('info', "Built-in authentication handler setting password of player '"..name.."'")
-			core.auth_table[name].password = password
-			save_auth_file()
+			auth_entry.password = password
+			core_auth.save(auth_entry)
 		end
 		return true
 	end,
 	set_privileges = function(name, privileges)
 		assert(type(name) == "string")
 		assert(type(privileges) == "table")
-		if not core.auth_table[name] then
+		local auth_entry = core_auth.read(name)
+		if not auth_entry then
 			core.builtin_auth_handler.create_auth(name,
 				core.get_password_hash(name,
 					core.setting_get("default_password")))
+			auth_entry = core_auth.read(name)
 		end
-		core.auth_table[name].privileges = privileges
+		auth_entry.privileges = privileges
+		core_auth.save(auth_entry)
 		core.notify_authentication_modified(name)
-		save_auth_file()
 	end,
 	reload = function()
-		read_auth_file()
+		core_auth.reload()
+		core.notify_authentication_modified()
 		return true
 	end,
 	record_login = function(name)
 		assert(type(name) == "string")
-		assert(core.auth_table[name]).last_login = os.time()
-		save_auth_file()
+		local auth_entry = assert(core_auth.read(name))
+		auth_entry.last_login = os.time()
+		core_auth.save(auth_entry)
+	end,
+	iterate = function()
+		local names = core_auth.list_names()
+		local i = 0
+		return function()
+			i = i + 1
+			return names[i]
+		end
 	end,
 }
 
@@ -172,7 +172,7 @@ core.register_chatcommand("grant", {
 		local grantname, grantprivstr = string.match(param, "([^ ]+) (.+)")
 		if not grantname or not grantprivstr then
 			return false, "Invalid parameters (see /help grant)"
-		elseif not core.auth_table[grantname] then
+		elseif not core.get_auth_handler().get_auth(grantname) then
 			return false, "Player " .. grantname .. " does not exist."
 		end
 		local grantprivs = core.string_to_privs(grantprivstr)
@@ -218,7 +218,7 @@ core.register_chatcommand("revoke", {
 		local revoke_name, revoke_priv_str = string.match(param, "([^ ]+) (.+)")
 		if not revoke_name or not revoke_priv_str then
 			return false, "Invalid parameters (see /help revoke)"
-		elseif not core.auth_table[revoke_name] then
+		elseif not core.get_auth_handler().get_auth(revoke_name) then
 			return false, "Player " .. revoke_name .. " does not exist."
 		end
 		local revoke_privs = core.string_to_privs(revoke_priv_str)
@@ -916,3 +916,98 @@ core.register_chatcommand("last-login", {
 		return false, "Last login time is unknown"
 	end,
 })
+
+local function sorted_script_profile()
+	local profile = core.get_script_profile()
+	table.sort(profile, function(a, b) return a.wall > b.wall end)
+	return profile
+end
+
+local function format_script_profile(max_entries)
+	local profile = sorted_script_profile()
+	local mods = {}
+	local mod_names = {}
+	for _, e in ipairs(profile) do
+		if not mods[e.mod] then
+			mods[e.mod] = 0
+			table.insert(mod_names, e.mod)
+		end
+		mods[e.mod] = mods[e.mod] + e.wall
+	end
+	table.sort(mod_names, function(a, b) return mods[a] > mods[b] end)
+
+	local lines = {"Time per mod:"}
+	for _, mod in ipairs(mod_names) do
+		table.insert(lines, string.format("  %s: %.1f ms", mod,
+				mods[mod] / 1000))
+	end
+	table.insert(lines, "Slowest callbacks:")
+	for i = 1, math.min(max_entries, #profile) do
+		local e = profile[i]
+		table.insert(lines, string.format(
+				"  %s %s %s: %d calls, %.1f ms (max %.1f ms), CPU %.1f ms",
+				e.mod, e.type, e.func, e.count, e.wall / 1000,
+				e.max_wall / 1000, e.cpu / 1000))
+	end
+	return table.concat(lines, "\n")
+end
+
+local function save_script_profile()
+	local path = core.get_worldpath() .. DIR_DELIM .. "script_profile_" ..
+			os.date("%Y%m%d_%H%M%S")
+
+	local file, err = io.open(path .. ".txt", "w")
+	if not file then
+		return false, err
+	end
+	file:write("mod\ttype\tfunction\tcount\twall_us\tcpu_us\tmax_wall_us\n")
+	for _, e in ipairs(sorted_script_profile()) do
+		file:write(table.concat({e.mod, e.type, e.func, e.count, e.wall,
+				e.cpu, e.max_wall}, "\t"), "\n")
+	end
+	file:close()
+
+	local folded, samples = core.get_script_profile_folded()
+	if samples == 0 then
+		return true, path .. ".txt"
+	end
+	file, err = io.open(path .. ".folded", "w")
+	if not file then
+		return false, err
+	end
+	file:write(folded)
+	file:close()
+	return true, path .. ".txt, " .. path .. ".folded"
+end
+
+core.register_chatcommand("profiler", {
+	params = "start [sample interval] | stop | print [count] | save | reset",
+	description = "Profile the time spent in Lua callbacks. The sample "
+			.. "interval (in ms) enables stack sampling for flamegraphs",
+	privs = {server=true},
+	func = function(name, param)
+		local cmd, arg = param:match("^(%S+)%s*(.*)$")
+		if cmd == "start" then
+			local interval = tonumber(arg) or 0
+			core.set_script_profiling(true, interval)
+			core.log("action", name .. " starts the script profiler")
+			return true, "Script profiler started" .. (interval > 0 and
+					" with a sample interval of " .. interval .. " ms" or "")
+		elseif cmd == "stop" then
+			core.set_script_profiling(false)
+			return true, "Script profiler stopped"
+		elseif cmd == "print" then
+			return true, format_script_profile(tonumber(arg) or 10)
+		elseif cmd == "save" then
+			local ok, files = save_script_profile()
+			if not ok then
+				return false, "Failed to save the script profile: " .. files
+			end
+			return true, "Saved the script profile to " .. files
+		elseif cmd == "reset" then
+			core.clear_script_profile()
+			return true, "Script profile cleared"
+		end
+		return false, "Invalid usage, see /help profiler."
+	end,
+})
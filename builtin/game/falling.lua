@@ -133,7 +133,8 @@ function check_attached_node(p, n)
 		d.y = -1
 	end
 	local p2 = vector.add(p, d)
-	local nn = core.get_node(p2).name
+	local nn = core.get_name_from_content_id(
+			core.get_node_raw(p2.x, p2.y, p2.z))
 	local def2 = core.registered_nodes[nn]
 	if def2 and not def2.walkable then
 		return false
@@ -146,7 +147,17 @@ end
 --
 
 function nodeupdate_single(p, delay)
-	local n = core.get_node(p)
+	-- Most nodes neither fall nor are attached, so check that before
+	-- building a node table
+	local content_id, param1, param2 = core.get_node_raw(p.x, p.y, p.z)
+	local name = core.get_name_from_content_id(content_id)
+	local groups = core.registered_nodes[name] and
+			core.registered_nodes[name].groups
+	if not groups or (not groups.falling_node and not groups.attached_node) then
+		return
+	end
+
+	local n = {name = name, param1 = param1, param2 = param2}
 	if core.get_item_group(n.name, "falling_node") ~= 0 then
 		local p_bottom = {x = p.x, y = p.y - 1, z = p.z}
 		local n_bottom = core.get_node(p_bottom)
@@ -164,9 +164,8 @@ core.register_entity(":__builtin:item", {
 		end
 		local p = self.object:getpos()
 		p.y = p.y - 0.5
-		local node = core.get_node_or_nil(p)
-		local in_unloaded = (node == nil)
-		if in_unloaded then
+		local content_id, _, _, pos_ok = core.get_node_raw(p.x, p.y, p.z)
+		if not pos_ok then
 			-- Don't infinetly fall into unloaded map
 			self.object:setvelocity({x = 0, y = 0, z = 0})
 			self.object:setacceleration({x = 0, y = 0, z = 0})
@@ -174,7 +173,7 @@ core.register_entity(":__builtin:item", {
 			self.object:set_properties({physical = false})
 			return
 		end
-		local nn = node.name
+		local nn = core.get_name_from_content_id(content_id)
 		-- If node is not registered or node is walkably solid and resting on nodebox
 		local v = self.object:getvelocity()
 		if not core.registered_nodes[nn] or core.registered_nodes[nn].walkable and v.y == 0 then
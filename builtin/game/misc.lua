@@ -197,3 +197,45 @@ function core.http_add_fetch(httpenv)
 
 	return httpenv
 end
+
+--
+-- Content ID cache
+--
+
+-- Content IDs and aliases don't change once all mods are loaded, so lookups
+-- made at runtime are memoized instead of crossing into C every time.
+do
+	local get_content_id = core.get_content_id
+	local get_name_from_content_id = core.get_name_from_content_id
+	local ids_final = false
+	local id_cache = {}
+	local name_cache = {}
+
+	core.after(0, function()
+		ids_final = true
+	end)
+
+	function core.get_content_id(name)
+		local id = id_cache[name]
+		if id then
+			return id
+		end
+		id = get_content_id(name)
+		if ids_final then
+			id_cache[name] = id
+		end
+		return id
+	end
+
+	function core.get_name_from_content_id(id)
+		local name = name_cache[id]
+		if name then
+			return name
+		end
+		name = get_name_from_content_id(id)
+		if ids_final then
+			name_cache[id] = name
+		end
+		return name
+	end
+end
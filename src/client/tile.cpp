@@ -1708,6 +1708,62 @@ bool TextureSource::generateImagePart(std::string part_of_name,
 	return true;
 }
 
+/*
+	Clip a blit of the given size to the area where both the source and the
+	destination image have pixels. Returns false if nothing is left.
+*/
+static bool clip_blit_area(video::IImage *src, video::IImage *dst,
+		v2s32 &src_pos, v2s32 &dst_pos, v2u32 &size)
+{
+	core::dimension2d<u32> src_dim = src->getDimension();
+	core::dimension2d<u32> dst_dim = dst->getDimension();
+
+	s32 skip_x = MYMAX(MYMAX(-src_pos.X, -dst_pos.X), 0);
+	s32 skip_y = MYMAX(MYMAX(-src_pos.Y, -dst_pos.Y), 0);
+	src_pos += v2s32(skip_x, skip_y);
+	dst_pos += v2s32(skip_x, skip_y);
+
+	s32 w = (s32)size.X - skip_x;
+	w = MYMIN(w, (s32)src_dim.Width - src_pos.X);
+	w = MYMIN(w, (s32)dst_dim.Width - dst_pos.X);
+	s32 h = (s32)size.Y - skip_y;
+	h = MYMIN(h, (s32)src_dim.Height - src_pos.Y);
+	h = MYMIN(h, (s32)dst_dim.Height - dst_pos.Y);
+	if (w <= 0 || h <= 0)
+		return false;
+
+	size = v2u32(w, h);
+	return true;
+}
+
+/*
+	Blit directly on the pixel buffers if both images are A8R8G8B8.
+	Pixels outside of either image are skipped, just like getPixel() and
+	setPixel() would do. Returns false if the images can't be handled here.
+*/
+static bool blit_raw(video::IImage *src, video::IImage *dst,
+		v2s32 src_pos, v2s32 dst_pos, v2u32 size, bool overlay)
+{
+	if (src->getColorFormat() != video::ECF_A8R8G8B8 ||
+			dst->getColorFormat() != video::ECF_A8R8G8B8)
+		return false;
+
+	if (!clip_blit_area(src, dst, src_pos, dst_pos, size))
+		return true;
+
+	u32 src_pitch = src->getPitch() / 4;
+	u32 dst_pitch = dst->getPitch() / 4;
+	const u32 *src_data = (const u32 *)src->lock() +
+			src_pos.Y * src_pitch + src_pos.X;
+	u32 *dst_data = (u32 *)dst->lock() +
+			dst_pos.Y * dst_pitch + dst_pos.X;
+	imageBlitWithAlphaRaw(src_data, src_pitch, dst_data, dst_pitch,
+			size, overlay);
+	dst->unlock();
+	src->unlock();
+	return true;
+}
+
 /*
 	Draw an image on top of an another one, using the alpha channel of the
 	source image
@@ -1718,6 +1774,9 @@ bool TextureSource::generateImagePart(std::string part_of_name,
 static void blit_with_alpha(video::IImage *src, video::IImage *dst,
 		v2s32 src_pos, v2s32 dst_pos, v2u32 size)
 {
+	if (blit_raw(src, dst, src_pos, dst_pos, size, false))
+		return;
+
 	for (u32 y0=0; y0<size.Y; y0++)
 	for (u32 x0=0; x0<size.X; x0++)
 	{
@@ -1739,6 +1798,9 @@ static void blit_with_alpha(video::IImage *src, video::IImage *dst,
 static void blit_with_alpha_overlay(video::IImage *src, video::IImage *dst,
 		v2s32 src_pos, v2s32 dst_pos, v2u32 size)
 {
+	if (blit_raw(src, dst, src_pos, dst_pos, size, true))
+		return;
+
 	for (u32 y0=0; y0<size.Y; y0++)
 	for (u32 x0=0; x0<size.X; x0++)
 	{
@@ -1880,6 +1942,12 @@ void brighten(video::IImage *image)
 
 	core::dimension2d<u32> dim = image->getDimension();
 
+	if (image->getColorFormat() == video::ECF_A8R8G8B8) {
+		imageBrightenRaw((u32 *)image->lock(), image->getPitch() / 4, dim);
+		image->unlock();
+		return;
+	}
+
 	for (u32 y=0; y<dim.Height; y++)
 	for (u32 x=0; x<dim.Width; x++)
 	{
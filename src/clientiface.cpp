@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include <sstream>
+#include <cstring>
 
 #include "clientiface.h"
 #include "util/numeric.h"
@@ -53,6 +54,84 @@ std::string ClientInterface::state2Name(ClientState state)
 	return statenames[state];
 }
 
+v3s16 BlockPosSet::getRegionPos(v3s16 p)
+{
+	return getContainerPos(p, 16);
+}
+
+u16 BlockPosSet::getRegionIndex(v3s16 p)
+{
+	return (p.X & 15) | ((p.Y & 15) << 4) | ((p.Z & 15) << 8);
+}
+
+bool BlockPosSet::contains(v3s16 p) const
+{
+	std::map<v3s16, Region>::const_iterator it =
+			m_regions.find(getRegionPos(p));
+	if (it == m_regions.end())
+		return false;
+	u16 i = getRegionIndex(p);
+	return it->second.bits[i >> 5] & (1U << (i & 31));
+}
+
+bool BlockPosSet::insert(v3s16 p)
+{
+	v3s16 rp = getRegionPos(p);
+	std::map<v3s16, Region>::iterator it = m_regions.find(rp);
+	if (it == m_regions.end()) {
+		Region r;
+		r.count = 0;
+		memset(r.bits, 0, sizeof(r.bits));
+		it = m_regions.insert(std::make_pair(rp, r)).first;
+	}
+	u16 i = getRegionIndex(p);
+	u32 &word = it->second.bits[i >> 5];
+	if (word & (1U << (i & 31)))
+		return false;
+	word |= 1U << (i & 31);
+	it->second.count++;
+	m_count++;
+	return true;
+}
+
+bool BlockPosSet::erase(v3s16 p)
+{
+	std::map<v3s16, Region>::iterator it = m_regions.find(getRegionPos(p));
+	if (it == m_regions.end())
+		return false;
+	u16 i = getRegionIndex(p);
+	u32 &word = it->second.bits[i >> 5];
+	if (!(word & (1U << (i & 31))))
+		return false;
+	word &= ~(1U << (i & 31));
+	m_count--;
+	if (--it->second.count == 0)
+		m_regions.erase(it);
+	return true;
+}
+
+void BlockPosSet::clear()
+{
+	m_regions.clear();
+	m_count = 0;
+}
+
+void BlockPosSet::getPositions(std::vector<v3s16> &dst) const
+{
+	for (std::map<v3s16, Region>::const_iterator it = m_regions.begin();
+			it != m_regions.end(); ++it) {
+		v3s16 base = it->first * 16;
+		for (u16 w = 0; w < 128; w++) {
+			u32 word = it->second.bits[w];
+			for (u16 i = w << 5; word != 0; i++, word >>= 1) {
+				if (word & 1)
+					dst.push_back(base +
+						v3s16(i & 15, (i >> 4) & 15, i >> 8));
+			}
+		}
+	}
+}
+
 void RemoteClient::ResendBlockIfOnWire(v3s16 p)
 {
 	// if this block is on wire, mark it for sending again as soon as possible
@@ -61,6 +140,108 @@ void RemoteClient::ResendBlockIfOnWire(v3s16 p)
 	}
 }
 
+void RemoteClient::recheckSkippedBlocks()
+{
+	if (m_blocks_skipped.size() == 0)
+		return;
+
+	// Blocks can be skipped again before their recheck comes, merge the
+	// two so that each block is checked once
+	for (std::vector<v3s16>::const_iterator it = m_blocks_recheck.begin();
+			it != m_blocks_recheck.end(); ++it)
+		m_blocks_skipped.insert(*it);
+	m_blocks_recheck.clear();
+	m_blocks_skipped.getPositions(m_blocks_recheck);
+	m_blocks_skipped.clear();
+
+	// Blocks of the current shell that were passed already are in there
+	m_nearest_unsent_index = 0;
+}
+
+RemoteClient::BlockSendCheck RemoteClient::checkBlockToSend(
+		ServerEnvironment *env, EmergeManager *emerge,
+		const BlockSendView &view, v3s16 p)
+{
+	v3s16 rel = p - view.center;
+	s16 d = MYMAX(abs(rel.X), MYMAX(abs(rel.Y), abs(rel.Z)));
+
+	if (d > view.d_max || blockpos_over_limit(p))
+		return BSC_NONE;
+
+	// Don't send blocks that are currently being transferred
+	if (m_blocks_sending.find(p) != m_blocks_sending.end())
+		return BSC_NONE;
+
+	// Don't send already sent blocks
+	if (m_blocks_sent.contains(p))
+		return BSC_NONE;
+
+	// Limit the send area vertically to 1/2
+	if (abs(rel.Y) > view.d_max / 2)
+		return BSC_SKIPPED;
+
+	/*
+		Don't generate or send if not in sight
+		FIXME This only works if the client uses a small enough
+		FOV setting. The default of 72 degrees is fine.
+	*/
+	if (!isBlockInSight(p, view.camera_pos, view.camera_dir,
+			view.camera_fov, 10000*BS))
+		return BSC_SKIPPED;
+
+	// If this is true, inexistent block will be made from scratch
+	bool generate = d <= view.d_max_gen;
+
+	/*
+		Check if map has this block
+	*/
+	MapBlock *block = env->getMap().getBlockNoCreateNoEx(p);
+
+	bool surely_not_found_on_disk = false;
+	bool block_is_invalid = false;
+	if (block != NULL) {
+		// Reset usage timer, this block will be of use in the future.
+		block->resetUsageTimer();
+
+		// Block is dummy if data doesn't exist.
+		// It means it has been not found from disk and not generated
+		if (block->isDummy())
+			surely_not_found_on_disk = true;
+
+		// Block is valid if lighting is up-to-date and data exists
+		if (!block->isValid() || !block->isGenerated())
+			block_is_invalid = true;
+
+		/*
+			If block is not close, don't send it unless it is near
+			ground level.
+
+			Block is near ground level if night-time mesh
+			differs from day-time mesh.
+		*/
+		if (d > BLOCK_SEND_ALWAYS_MAX_D && !block->getDayNightDiff())
+			return BSC_SKIPPED;
+	}
+
+	/*
+		If block has been marked to not exist on disk (dummy)
+		and generating new ones is not wanted, skip block.
+	*/
+	if (!generate && surely_not_found_on_disk)
+		return BSC_SKIPPED;
+
+	/*
+		Add inexistent block to emerge queue.
+	*/
+	if (block == NULL || surely_not_found_on_disk || block_is_invalid) {
+		if (!emerge->enqueueBlockEmerge(peer_id, p, generate))
+			return BSC_EMERGE_FULL;
+		return BSC_EMERGING;
+	}
+
+	return BSC_READY;
+}
+
 void RemoteClient::GetNextBlocks (
 		ServerEnvironment *env,
 		EmergeManager * emerge,
@@ -111,14 +292,44 @@ void RemoteClient::GetNextBlocks (
 	/*infostream<<"camera_dir=("<<camera_dir.X<<","<<camera_dir.Y<<","
 			<<camera_dir.Z<<")"<<std::endl;*/
 
+	const s16 full_d_max = g_settings->getS16("max_block_send_distance");
+
+	BlockSendView view;
+	view.center = center;
+	view.camera_pos = camera_pos;
+	view.camera_dir = camera_dir;
+	view.camera_fov = (72.0*M_PI/180) * 4./3.;
+	view.d_max = full_d_max;
+	view.d_max_gen = g_settings->getS16("max_block_generate_distance");
+
 	/*
 		Get the starting value of the block finder radius.
 	*/
 
 	if(m_last_center != center)
 	{
-		m_nearest_unsent_d = 0;
+		/*
+			Everything closer than the frontier was handled around the
+			old center, so everything closer than the frontier minus the
+			distance moved is handled around the new one. Only the blocks
+			skipped because of the old position have to be checked again.
+		*/
+		v3s16 moved = center - m_last_center;
+		s16 moved_d = MYMAX(abs(moved.X), MYMAX(abs(moved.Y), abs(moved.Z)));
+		m_nearest_unsent_d = MYMAX(0, m_nearest_unsent_d - moved_d);
+		m_nearest_unsent_index = 0;
 		m_last_center = center;
+		recheckSkippedBlocks();
+	}
+
+	/*
+		Blocks outside the view were skipped; check them again once the
+		view has turned far enough to show them.
+	*/
+	if (camera_dir.dotProduct(m_last_camera_dir) < 0.9)
+	{
+		m_last_camera_dir = camera_dir;
+		recheckSkippedBlocks();
 	}
 
 	/*infostream<<"m_nearest_unsent_reset_timer="
@@ -129,15 +340,13 @@ void RemoteClient::GetNextBlocks (
 	{
 		m_nearest_unsent_reset_timer = 0;
 		m_nearest_unsent_d = 0;
+		m_nearest_unsent_index = 0;
+		m_blocks_skipped.clear();
+		m_blocks_recheck.clear();
 		//infostream<<"Resetting m_nearest_unsent_d for "
 		//		<<server->getPlayerName(peer_id)<<std::endl;
 	}
 
-	//s16 last_nearest_unsent_d = m_nearest_unsent_d;
-	s16 d_start = m_nearest_unsent_d;
-
-	//infostream<<"d_start="<<d_start<<std::endl;
-
 	u16 max_simul_sends_setting = g_settings->getU16
 			("max_simultaneous_block_sends_per_client");
 	u16 max_simul_sends_usually = max_simul_sends_setting;
@@ -160,6 +369,89 @@ void RemoteClient::GetNextBlocks (
 	*/
 	u32 num_blocks_selected = m_blocks_sending.size();
 
+	/*
+		Check the blocks that have to be sent again.
+
+		They stay queued until they are on the wire, because not all of
+		the blocks selected here are actually sent.
+	*/
+	for (std::set<v3s16>::iterator it = m_blocks_resend.begin();
+			it != m_blocks_resend.end();) {
+		v3s16 p = *it;
+		v3s16 rel = p - center;
+		s16 d = MYMAX(abs(rel.X), MYMAX(abs(rel.Y), abs(rel.Z)));
+
+		u16 max_simul_dynamic = max_simul_sends_usually;
+		if (d <= BLOCK_SEND_DISABLE_LIMITS_MAX_D)
+			max_simul_dynamic = max_simul_sends_setting;
+		if (num_blocks_selected >= max_simul_dynamic) {
+			++it;
+			continue;
+		}
+
+		BlockSendCheck check = checkBlockToSend(env, emerge, view, p);
+		if (check == BSC_READY) {
+			dest.push_back(PrioritySortedBlockTransfer((float)d, p, peer_id));
+			num_blocks_selected += 1;
+			++it;
+		} else if (check == BSC_EMERGE_FULL) {
+			++it;
+		} else {
+			// Emerging without generating may not produce the block,
+			// check it again after moving as well
+			if (check == BSC_SKIPPED || check == BSC_EMERGING)
+				m_blocks_skipped.insert(p);
+			m_blocks_resend.erase(it++);
+		}
+	}
+
+	u32 checks_left = BLOCK_SEND_MAX_CHECKS_PER_STEP;
+
+	/*
+		Check the blocks skipped before the player moved or turned.
+		Those at or beyond the frontier are left to the search below.
+		Blocks selected here go to the resend queue until they are on
+		the wire.
+	*/
+	while (!m_blocks_recheck.empty() && checks_left > 0) {
+		v3s16 p = m_blocks_recheck.back();
+		v3s16 rel = p - center;
+		s16 d = MYMAX(abs(rel.X), MYMAX(abs(rel.Y), abs(rel.Z)));
+		if (d >= m_nearest_unsent_d) {
+			m_blocks_recheck.pop_back();
+			continue;
+		}
+
+		u16 max_simul_dynamic = max_simul_sends_usually;
+		if (d <= BLOCK_SEND_DISABLE_LIMITS_MAX_D)
+			max_simul_dynamic = max_simul_sends_setting;
+		if (num_blocks_selected >= max_simul_dynamic)
+			break;
+
+		checks_left--;
+		if (m_blocks_resend.find(p) != m_blocks_resend.end()) {
+			m_blocks_recheck.pop_back();
+			continue;
+		}
+
+		BlockSendCheck check = checkBlockToSend(env, emerge, view, p);
+		if (check == BSC_EMERGE_FULL)
+			break;
+		m_blocks_recheck.pop_back();
+		if (check == BSC_SKIPPED || check == BSC_EMERGING) {
+			m_blocks_skipped.insert(p);
+		} else if (check == BSC_READY) {
+			dest.push_back(PrioritySortedBlockTransfer((float)d, p, peer_id));
+			num_blocks_selected += 1;
+			m_blocks_resend.insert(p);
+		}
+	}
+
+	//s16 last_nearest_unsent_d = m_nearest_unsent_d;
+	s16 d_start = m_nearest_unsent_d;
+
+	//infostream<<"d_start="<<d_start<<std::endl;
+
 	/*
 		next time d will be continued from the d from which the nearest
 		unsent block was found this time.
@@ -168,10 +460,9 @@ void RemoteClient::GetNextBlocks (
 		time are actually sent.
 	*/
 	s32 new_nearest_unsent_d = -1;
+	u32 new_nearest_unsent_index = 0;
 
-	const s16 full_d_max = g_settings->getS16("max_block_send_distance");
 	s16 d_max = full_d_max;
-	s16 d_max_gen = g_settings->getS16("max_block_generate_distance");
 
 	// Don't loop very much at a time
 	s16 max_d_increment_at_time = 2;
@@ -182,8 +473,10 @@ void RemoteClient::GetNextBlocks (
 	s32 nearest_emergefull_d = -1;
 	s32 nearest_sent_d = -1;
 	//bool queue_is_full = false;
+	bool out_of_checks = false;
 
 	s16 d;
+	u32 i = 0;
 	for(d = d_start; d <= d_max; d++) {
 		/*
 			Get the border/face dot coordinates of a "d-radiused"
@@ -191,9 +484,10 @@ void RemoteClient::GetNextBlocks (
 		*/
 		std::vector<v3s16> list = FacePositionCache::getFacePositions(d);
 
-		std::vector<v3s16>::iterator li;
-		for(li = list.begin(); li != list.end(); ++li) {
-			v3s16 p = *li + center;
+		// Continue where the previous search ran out of checks
+		i = (d == d_start) ? m_nearest_unsent_index : 0;
+		for(; i < list.size(); i++) {
+			v3s16 p = list[i] + center;
 
 			/*
 				Send throttling
@@ -216,132 +510,50 @@ void RemoteClient::GetNextBlocks (
 				goto queue_full_break;
 			}
 
-			// Don't send blocks that are currently being transferred
-			if (m_blocks_sending.find(p) != m_blocks_sending.end())
+			// Limit the send area vertically to 1/2, without using a check
+			if (abs(p.Y - center.Y) > full_d_max / 2) {
+				m_blocks_skipped.insert(p);
 				continue;
-
-			/*
-				Do not go over-limit
-			*/
-			if (blockpos_over_limit(p))
-				continue;
-
-			// If this is true, inexistent block will be made from scratch
-			bool generate = d <= d_max_gen;
-
-			{
-				/*// Limit the generating area vertically to 2/3
-				if(abs(p.Y - center.Y) > d_max_gen - d_max_gen / 3)
-					generate = false;*/
-
-				// Limit the send area vertically to 1/2
-				if (abs(p.Y - center.Y) > full_d_max / 2)
-					continue;
 			}
 
-			/*
-				Don't generate or send if not in sight
-				FIXME This only works if the client uses a small enough
-				FOV setting. The default of 72 degrees is fine.
-			*/
-
-			float camera_fov = (72.0*M_PI/180) * 4./3.;
-			if(isBlockInSight(p, camera_pos, camera_dir, camera_fov, 10000*BS) == false)
-			{
-				continue;
-			}
-
-			/*
-				Don't send already sent blocks
-			*/
-			{
-				if(m_blocks_sent.find(p) != m_blocks_sent.end())
-				{
-					continue;
-				}
+			// Bound the work done per step
+			if (checks_left == 0) {
+				out_of_checks = true;
+				goto queue_full_break;
 			}
+			checks_left--;
 
-			/*
-				Check if map has this block
-			*/
-			MapBlock *block = env->getMap().getBlockNoCreateNoEx(p);
-
-			bool surely_not_found_on_disk = false;
-			bool block_is_invalid = false;
-			if(block != NULL)
-			{
-				// Reset usage timer, this block will be of use in the future.
-				block->resetUsageTimer();
-
-				// Block is dummy if data doesn't exist.
-				// It means it has been not found from disk and not generated
-				if(block->isDummy())
-				{
-					surely_not_found_on_disk = true;
-				}
-
-				// Block is valid if lighting is up-to-date and data exists
-				if(block->isValid() == false)
-				{
-					block_is_invalid = true;
-				}
+			// Already selected from the resend queue above
+			if (!m_blocks_resend.empty() &&
+					m_blocks_resend.find(p) != m_blocks_resend.end())
+				continue;
 
-				if(block->isGenerated() == false)
-					block_is_invalid = true;
+			switch (checkBlockToSend(env, emerge, view, p)) {
+			case BSC_NONE:
+				break;
+			case BSC_SKIPPED:
+				m_blocks_skipped.insert(p);
+				break;
+			case BSC_EMERGING:
+				if (nearest_emerged_d == -1)
+					nearest_emerged_d = d;
+				break;
+			case BSC_EMERGE_FULL:
+				if (nearest_emergefull_d == -1)
+					nearest_emergefull_d = d;
+				goto queue_full_break;
+			case BSC_READY:
+				if (nearest_sent_d == -1)
+					nearest_sent_d = d;
 
 				/*
-					If block is not close, don't send it unless it is near
-					ground level.
-
-					Block is near ground level if night-time mesh
-					differs from day-time mesh.
+					Add block to send queue
 				*/
-				if(d >= 4)
-				{
-					if(block->getDayNightDiff() == false)
-						continue;
-				}
-			}
-
-			/*
-				If block has been marked to not exist on disk (dummy)
-				and generating new ones is not wanted, skip block.
-			*/
-			if(generate == false && surely_not_found_on_disk == true)
-			{
-				// get next one.
-				continue;
-			}
-
-			/*
-				Add inexistent block to emerge queue.
-			*/
-			if(block == NULL || surely_not_found_on_disk || block_is_invalid)
-			{
-				if (emerge->enqueueBlockEmerge(peer_id, p, generate)) {
-					if (nearest_emerged_d == -1)
-						nearest_emerged_d = d;
-				} else {
-					if (nearest_emergefull_d == -1)
-						nearest_emergefull_d = d;
-					goto queue_full_break;
-				}
-
-				// get next one.
-				continue;
+				dest.push_back(PrioritySortedBlockTransfer((float)d, p,
+						peer_id));
+				num_blocks_selected += 1;
+				break;
 			}
-
-			if(nearest_sent_d == -1)
-				nearest_sent_d = d;
-
-			/*
-				Add block to send queue
-			*/
-			PrioritySortedBlockTransfer q((float)d, p, peer_id);
-
-			dest.push_back(q);
-
-			num_blocks_selected += 1;
 		}
 	}
 queue_full_break:
@@ -353,19 +565,29 @@ void RemoteClient::GetNextBlocks (
 	} else if(nearest_emergefull_d != -1){
 		new_nearest_unsent_d = nearest_emergefull_d;
 	} else {
-		if(d > g_settings->getS16("max_block_send_distance")){
-			new_nearest_unsent_d = 0;
-			m_nothing_to_send_pause_timer = 2.0;
+		if(d > full_d_max){
+			/*
+				Everything in range has been handled. Stay here until
+				the player moves or turns, or something is modified.
+			*/
+			new_nearest_unsent_d = full_d_max + 1;
+			if (m_blocks_recheck.empty())
+				m_nothing_to_send_pause_timer = 2.0;
 		} else {
-			if(nearest_sent_d != -1)
+			if(nearest_sent_d != -1) {
 				new_nearest_unsent_d = nearest_sent_d;
-			else
+			} else {
 				new_nearest_unsent_d = d;
+				if (out_of_checks)
+					new_nearest_unsent_index = i;
+			}
 		}
 	}
 
-	if(new_nearest_unsent_d != -1)
+	if(new_nearest_unsent_d != -1) {
 		m_nearest_unsent_d = new_nearest_unsent_d;
+		m_nearest_unsent_index = new_nearest_unsent_index;
+	}
 }
 
 void RemoteClient::GotBlock(v3s16 p)
@@ -394,19 +616,42 @@ void RemoteClient::SentBlock(v3s16 p)
 
 void RemoteClient::SetBlockNotSent(v3s16 p)
 {
-	m_nearest_unsent_d = 0;
 	m_nothing_to_send_pause_timer = 0;
 
 	if(m_blocks_sending.find(p) != m_blocks_sending.end())
 		m_blocks_sending.erase(p);
-	if(m_blocks_sent.find(p) != m_blocks_sent.end())
-		m_blocks_sent.erase(p);
+	m_blocks_sent.erase(p);
 	m_blocks_modified.insert(p);
+	m_blocks_resend.insert(p);
+}
+
+void RemoteClient::SetBlockDeleted(v3s16 p)
+{
+	m_block_versions.erase(p);
+	SetBlockNotSent(p);
+}
+
+void RemoteClient::SetBlockVersion(v3s16 p, u32 incarnation, u32 version)
+{
+	SentBlockVersion &v = m_block_versions[p];
+	v.incarnation = incarnation;
+	v.version = version;
+}
+
+bool RemoteClient::GetBlockVersion(v3s16 p, u32 &incarnation,
+		u32 &version) const
+{
+	std::map<v3s16, SentBlockVersion>::const_iterator it =
+			m_block_versions.find(p);
+	if (it == m_block_versions.end())
+		return false;
+	incarnation = it->second.incarnation;
+	version = it->second.version;
+	return true;
 }
 
 void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 {
-	m_nearest_unsent_d = 0;
 	m_nothing_to_send_pause_timer = 0;
 
 	for(std::map<v3s16, MapBlock*>::iterator
@@ -415,11 +660,57 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 	{
 		v3s16 p = i->first;
 		m_blocks_modified.insert(p);
+		m_blocks_resend.insert(p);
 
 		if(m_blocks_sending.find(p) != m_blocks_sending.end())
 			m_blocks_sending.erase(p);
-		if(m_blocks_sent.find(p) != m_blocks_sent.end())
-			m_blocks_sent.erase(p);
+		m_blocks_sent.erase(p);
+	}
+}
+
+bool RemoteClient::filterObjectUpdate(u16 id, f32 distance, double now,
+		const std::string &msg, const ObjectUpdateTiers &tiers)
+{
+	float interval = 0;
+	if (tiers.near_range > 0) {
+		if (distance > tiers.far_range)
+			interval = tiers.far_interval;
+		else if (distance > tiers.near_range)
+			interval = tiers.medium_interval;
+	}
+
+	if (interval <= 0) {
+		// Full rate; anything kept is outdated now
+		m_object_updates.erase(id);
+		return true;
+	}
+
+	std::pair<std::map<u16, ObjectUpdateState>::iterator, bool> inserted =
+		m_object_updates.insert(std::make_pair(id, ObjectUpdateState()));
+	ObjectUpdateState &state = inserted.first->second;
+	state.interval = interval;
+	// The first message after coming into a lower rate tier goes out
+	if (!inserted.second && now < state.last_sent + interval) {
+		state.deferred = msg;
+		return false;
+	}
+	state.last_sent = now;
+	state.deferred.clear();
+	return true;
+}
+
+void RemoteClient::releaseObjectUpdates(double now,
+		std::vector<std::string> &dst)
+{
+	for (std::map<u16, ObjectUpdateState>::iterator
+			it = m_object_updates.begin();
+			it != m_object_updates.end(); ++it) {
+		ObjectUpdateState &state = it->second;
+		if (state.deferred.empty() || now < state.last_sent + state.interval)
+			continue;
+		state.last_sent = now;
+		dst.push_back(std::string());
+		dst.back().swap(state.deferred);
 	}
 }
 
@@ -690,6 +981,9 @@ void ClientInterface::send(u16 peer_id, u8 channelnum,
 void ClientInterface::sendToAll(u16 channelnum,
 		NetworkPacket* pkt, bool reliable)
 {
+	// All clients share one copy of the packet data
+	SharedBuffer<u8> data = pkt->oldForgePacket();
+
 	MutexAutoLock clientslock(m_clients_mutex);
 	for(std::map<u16, RemoteClient*>::iterator
 		i = m_clients.begin();
@@ -697,7 +991,7 @@ void ClientInterface::sendToAll(u16 channelnum,
 		RemoteClient *client = i->second;
 
 		if (client->net_proto_version != 0) {
-			m_con->Send(client->peer_id, channelnum, pkt, reliable);
+			m_con->Send(client->peer_id, channelnum, data, reliable);
 		}
 	}
 }
@@ -198,6 +198,49 @@ enum ClientStateEvent
 	CSE_Disconnect
 };
 
+/*
+	Compact set of block positions.
+
+	Positions are grouped into regions of 16x16x16 blocks and each region is
+	stored as a 4096 bit bitmap. A client that has received a few thousand
+	blocks costs a handful of map nodes instead of one node per block, and
+	lookups of neighbouring positions mostly hit the same region.
+*/
+class BlockPosSet
+{
+public:
+	BlockPosSet():
+		m_count(0)
+	{}
+
+	bool contains(v3s16 p) const;
+	// Returns true if p was not in the set yet
+	bool insert(v3s16 p);
+	// Returns true if p was in the set
+	bool erase(v3s16 p);
+	void clear();
+	// Appends all positions in the set to dst
+	void getPositions(std::vector<v3s16> &dst) const;
+
+	u32 size() const
+		{ return m_count; }
+	u32 getRegionCount() const
+		{ return m_regions.size(); }
+
+private:
+	struct Region
+	{
+		u32 count;
+		u32 bits[128];
+	};
+
+	static v3s16 getRegionPos(v3s16 p);
+	static u16 getRegionIndex(v3s16 p);
+
+	std::map<v3s16, Region> m_regions;
+	u32 m_count;
+};
+
 /*
 	Used for queueing and sorting block transfers in containers
 
@@ -257,6 +300,8 @@ class RemoteClient
 		m_pending_serialization_version(SER_FMT_VER_INVALID),
 		m_state(CS_Created),
 		m_nearest_unsent_d(0),
+		m_nearest_unsent_index(0),
+		m_last_camera_dir(0,0,0),
 		m_nearest_unsent_reset_timer(0.0),
 		m_excess_gotblocks(0),
 		m_nothing_to_send_pause_timer(0.0),
@@ -288,6 +333,14 @@ class RemoteClient
 	void SetBlockNotSent(v3s16 p);
 	void SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks);
 
+	// Called when the client reports it has dropped the block
+	void SetBlockDeleted(v3s16 p);
+
+	// Remembers which version of the block was last sent to the client
+	void SetBlockVersion(v3s16 p, u32 incarnation, u32 version);
+	// Returns false if the client is not known to hold the block
+	bool GetBlockVersion(v3s16 p, u32 &incarnation, u32 &version) const;
+
 	/**
 	 * tell client about this block being modified right now.
 	 * this information is required to requeue the block in case it's "on wire"
@@ -296,6 +349,10 @@ class RemoteClient
 	 */
 	void ResendBlockIfOnWire(v3s16 p);
 
+	// Whether the client has confirmed receiving the block
+	bool isBlockSent(v3s16 p) const
+		{ return m_blocks_sent.contains(p); }
+
 	s32 SendingCount()
 	{
 		return m_blocks_sending.size();
@@ -325,6 +382,45 @@ class RemoteClient
 	*/
 	std::set<u16> m_known_objects;
 
+	/*
+		Unreliable messages (object movement) of known objects farther
+		away than near_range are sent at most every medium_interval,
+		beyond far_range at most every far_interval. A near_range of 0
+		sends everything at full rate. Distances are in world units.
+	*/
+	struct ObjectUpdateTiers
+	{
+		ObjectUpdateTiers():
+			near_range(0),
+			far_range(0),
+			medium_interval(0),
+			far_interval(0)
+		{}
+
+		float near_range;
+		float far_range;
+		float medium_interval;
+		float far_interval;
+	};
+
+	/*
+		Returns true if the unreliable message msg of the known object id
+		is to be sent now. Otherwise the newest message of the object is
+		kept until the interval of its tier has passed, so the last state
+		still arrives; see releaseObjectUpdates.
+		now is in seconds, distance is from the player to the object.
+	*/
+	bool filterObjectUpdate(u16 id, f32 distance, double now,
+			const std::string &msg, const ObjectUpdateTiers &tiers);
+	// Appends the kept messages whose interval has passed to dst
+	void releaseObjectUpdates(double now, std::vector<std::string> &dst);
+	// To be called when the object is removed from m_known_objects
+	void forgetObjectUpdates(u16 id)
+		{ m_object_updates.erase(id); }
+	// Whether releaseObjectUpdates may have something to release
+	bool hasObjectUpdates() const
+		{ return !m_object_updates.empty(); }
+
 	ClientState getState()
 		{ return m_state; }
 
@@ -370,6 +466,38 @@ class RemoteClient
 	/* current state of client */
 	ClientState m_state;
 
+	// Result of checkBlockToSend
+	enum BlockSendCheck
+	{
+		// Nothing to do, e.g. the block was sent already or is out of range
+		BSC_NONE,
+		// Skipped for a reason that depends on the position or view of
+		// the player, so it has to be checked again when those change
+		BSC_SKIPPED,
+		// Queued for emerging, it is sent again once emerged
+		BSC_EMERGING,
+		// The emerge queue is full
+		BSC_EMERGE_FULL,
+		// The block can be sent
+		BSC_READY
+	};
+
+	struct BlockSendView
+	{
+		v3s16 center;
+		v3f camera_pos;
+		v3f camera_dir;
+		float camera_fov;
+		s16 d_max;
+		s16 d_max_gen;
+	};
+
+	// Decides what to do with the block at p. May queue it for emerging.
+	BlockSendCheck checkBlockToSend(ServerEnvironment *env,
+			EmergeManager *emerge, const BlockSendView &view, v3s16 p);
+	// Queues the skipped blocks for checking them again
+	void recheckSkippedBlocks();
+
 	/*
 		Blocks that have been sent to client.
 		- These don't have to be sent again.
@@ -379,11 +507,37 @@ class RemoteClient
 		List of block positions.
 		No MapBlock* is stored here because the blocks can get deleted.
 	*/
-	std::set<v3s16> m_blocks_sent;
+	BlockPosSet m_blocks_sent;
+	/*
+		Send frontier: every block closer than m_nearest_unsent_d to
+		m_last_center has been handled. m_nearest_unsent_index is where
+		the search of that distance stopped when it ran out of budget.
+	*/
 	s16 m_nearest_unsent_d;
+	u32 m_nearest_unsent_index;
 	v3s16 m_last_center;
+	v3f m_last_camera_dir;
 	float m_nearest_unsent_reset_timer;
 
+	/*
+		Blocks inside the frontier that were skipped for being out of
+		sight, too far up or down, too far to generate or too far to be
+		sent without day/night difference. All of these depend on the
+		position and view of the player, so they are queued in
+		m_blocks_recheck when the player moves or turns instead of
+		searching everything again.
+	*/
+	BlockPosSet m_blocks_skipped;
+	std::vector<v3s16> m_blocks_recheck;
+
+	/*
+		Blocks that have to be sent again because they were modified or
+		emerged, or that were found sendable when checked again. These
+		are checked directly, so the frontier above does not have to be
+		reset for them.
+	*/
+	std::set<v3s16> m_blocks_resend;
+
 	/*
 		Blocks that are currently on the line.
 		This is used for throttling the sending of blocks.
@@ -404,6 +558,32 @@ class RemoteClient
 	*/
 	std::set<v3s16> m_blocks_modified;
 
+	/*
+		Incarnation and version (see MapBlock::getChangesSince) of the
+		block last sent to the client, for sending only the changes the
+		next time. Removed when the client deletes the block.
+	*/
+	struct SentBlockVersion
+	{
+		u32 incarnation;
+		u32 version;
+	};
+	std::map<v3s16, SentBlockVersion> m_block_versions;
+
+	// Objects whose messages are sent at a lower rate, by object id
+	struct ObjectUpdateState
+	{
+		ObjectUpdateState():
+			last_sent(0),
+			interval(0)
+		{}
+
+		double last_sent;
+		float interval;
+		std::string deferred;
+	};
+	std::map<u16, ObjectUpdateState> m_object_updates;
+
 	/*
 		Count of excess GotBlocks().
 		There is an excess amount because the client sometimes
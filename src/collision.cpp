@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <set>
 #include "util/timetaker.h"
 #include "profiler.h"
+#include "util/directiontables.h"
 
 // float error is 10 - 9.96875 = 0.03125
 //#define COLL_ZERO 0.032 // broken unit tests
@@ -193,6 +194,74 @@ static inline void getNeighborConnectingFace(v3s16 p, INodeDefManager *nodedef,
 		*neighbors |= v;
 }
 
+const CollisionNodeBoxes &CollisionBoxCache::get(Map *map,
+		INodeDefManager *nodedef, v3s16 p)
+{
+	std::map<v3s16, CollisionNodeBoxes>::iterator it = m_cache.find(p);
+	if (it != m_cache.end())
+		return it->second;
+
+	CollisionNodeBoxes &result = m_cache[p];
+	result.bouncy = 0;
+
+	MapNode n = map->getNodeNoEx(p, &result.is_valid_position);
+	if (!result.is_valid_position)
+		return result;
+
+	const ContentFeatures &f = nodedef->get(n);
+	if (f.walkable == false)
+		return result;
+
+	result.bouncy = itemgroup_get(f.groups, "bouncy");
+
+	int neighbors = 0;
+	if (f.drawtype == NDT_NODEBOX && f.node_box.type == NODEBOX_CONNECTED) {
+		v3s16 p2 = p;
+
+		p2.Y++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
+
+		p2 = p;
+		p2.Y--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
+
+		p2 = p;
+		p2.Z--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
+
+		p2 = p;
+		p2.X--;
+		getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
+
+		p2 = p;
+		p2.Z++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
+
+		p2 = p;
+		p2.X++;
+		getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
+	}
+	n.getCollisionBoxes(nodedef, &result.boxes, neighbors);
+	for (std::vector<aabb3f>::iterator
+			i = result.boxes.begin();
+			i != result.boxes.end(); ++i) {
+		i->MinEdge += v3f(p.X, p.Y, p.Z) * BS;
+		i->MaxEdge += v3f(p.X, p.Y, p.Z) * BS;
+	}
+
+	return result;
+}
+
+void CollisionBoxCache::invalidate(v3s16 p)
+{
+	if (m_cache.empty())
+		return;
+
+	m_cache.erase(p);
+	for (u16 i = 0; i < 6; i++)
+		m_cache.erase(p + g_6dirs[i]);
+}
+
 collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		f32 pos_max_d, const aabb3f &box_0,
 		f32 stepheight, f32 dtime,
@@ -255,65 +324,29 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 
 	bool any_position_valid = false;
 
+	INodeDefManager *nodedef = gamedef->getNodeDefManager();
+	CollisionBoxCache &box_cache = map->getCollisionBoxCache();
+
 	for(s16 x = min_x; x <= max_x; x++)
 	for(s16 y = min_y; y <= max_y; y++)
 	for(s16 z = min_z; z <= max_z; z++)
 	{
 		v3s16 p(x,y,z);
 
-		bool is_position_valid;
-		MapNode n = map->getNodeNoEx(p, &is_position_valid);
+		const CollisionNodeBoxes &nodeboxes = box_cache.get(map, nodedef, p);
 
-		if (is_position_valid) {
+		if (nodeboxes.is_valid_position) {
 			// Object collides into walkable nodes
 
 			any_position_valid = true;
-			INodeDefManager *nodedef = gamedef->getNodeDefManager();
-			const ContentFeatures &f = nodedef->get(n);
-			if(f.walkable == false)
-				continue;
-			int n_bouncy_value = itemgroup_get(f.groups, "bouncy");
-
-			int neighbors = 0;
-			if (f.drawtype == NDT_NODEBOX && f.node_box.type == NODEBOX_CONNECTED) {
-				v3s16 p2 = p;
-
-				p2.Y++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
-
-				p2 = p;
-				p2.Y--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
-
-				p2 = p;
-				p2.Z--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
-
-				p2 = p;
-				p2.X--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
-
-				p2 = p;
-				p2.Z++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
-
-				p2 = p;
-				p2.X++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
-			}
-			std::vector<aabb3f> nodeboxes;
-			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
-			for(std::vector<aabb3f>::iterator
-					i = nodeboxes.begin();
-					i != nodeboxes.end(); ++i)
+			for(std::vector<aabb3f>::const_iterator
+					i = nodeboxes.boxes.begin();
+					i != nodeboxes.boxes.end(); ++i)
 			{
-				aabb3f box = *i;
-				box.MinEdge += v3f(x, y, z)*BS;
-				box.MaxEdge += v3f(x, y, z)*BS;
-				cboxes.push_back(box);
+				cboxes.push_back(*i);
 				is_unloaded.push_back(false);
 				is_step_up.push_back(false);
-				bouncy_values.push_back(n_bouncy_value);
+				bouncy_values.push_back(nodeboxes.bouncy);
 				node_positions.push_back(p);
 				is_object.push_back(false);
 			}
@@ -364,7 +397,7 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 			if (s_env != 0) {
 				f32 distance = speed_f->getLength();
 				std::vector<u16> s_objects;
-				s_env->getObjectsInsideRadius(s_objects, *pos_f, distance * 1.5);
+				s_env->getCollisionObjectsInsideRadius(s_objects, *pos_f, distance * 1.5);
 				for (std::vector<u16>::iterator iter = s_objects.begin(); iter != s_objects.end(); ++iter) {
 					ServerActiveObject *current = s_env->getActiveObject(*iter);
 					if ((self == 0) || (self != current)) {
@@ -22,9 +22,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes_bloated.h"
 #include <vector>
+#include <map>
 
 class Map;
 class IGameDef;
+class INodeDefManager;
 class Environment;
 class ActiveObject;
 
@@ -69,6 +71,38 @@ struct collisionMoveResult
 	{}
 };
 
+// Collision boxes of a single node, in world coordinates
+struct CollisionNodeBoxes
+{
+	// false if the node is not loaded; it then collides like a full node
+	bool is_valid_position;
+	int bouncy;
+	// Empty if the node is not walkable
+	std::vector<aabb3f> boxes;
+};
+
+/*
+	Caches the collision boxes of nodes by position. Objects moving through
+	the same area during an environment step then share the map lookups and
+	node box calculations instead of repeating them.
+
+	The environment clears the cache at the start of each step, and the map
+	invalidates it whenever nodes change.
+*/
+class CollisionBoxCache
+{
+public:
+	const CollisionNodeBoxes &get(Map *map, INodeDefManager *nodedef, v3s16 p);
+
+	// Forget the node at p; its neighbours too, since connected node boxes
+	// depend on them
+	void invalidate(v3s16 p);
+	void clear() { m_cache.clear(); }
+
+private:
+	std::map<v3s16, CollisionNodeBoxes> m_cache;
+};
+
 // Moves using a single iteration; speed should not exceed pos_max_d/dtime
 collisionMoveResult collisionMoveSimple(Environment *env,IGameDef *gamedef,
 		f32 pos_max_d, const aabb3f &box_0,
@@ -45,8 +45,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define RESEND_TIMEOUT_MIN 0.1
 #define RESEND_TIMEOUT_MAX 3.0
-// resend_timeout = avg_rtt * this
-#define RESEND_TIMEOUT_FACTOR 4
+// resend_timeout = smoothed rtt + rtt variance * this
+#define RESEND_TIMEOUT_VARIANCE_FACTOR 4
 
 /*
     Server
@@ -56,6 +56,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define LIMITED_MAX_SIMULTANEOUS_BLOCK_SENDS 0
 // Override for the previous one when distance of block is very low
 #define BLOCK_SEND_DISABLE_LIMITS_MAX_D 1
+// Blocks closer than this are sent even if they have no day/night difference
+#define BLOCK_SEND_ALWAYS_MAX_D 3
+// Maximum number of block positions checked per client per server step
+#define BLOCK_SEND_MAX_CHECKS_PER_STEP 2048
 
 /*
     Map-related things
@@ -225,6 +225,17 @@ bool LuaEntitySAO::isAttached()
 }
 
 void LuaEntitySAO::step(float dtime, bool send_recommended)
+{
+	stepMovement(dtime);
+
+	if(m_registered){
+		m_env->getScriptIface()->luaentity_Step(m_id, dtime);
+	}
+
+	stepSend(send_recommended);
+}
+
+void LuaEntitySAO::stepMovement(float dtime)
 {
 	if(!m_properties_sent)
 	{
@@ -299,11 +310,10 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 			}
 		}
 	}
+}
 
-	if(m_registered){
-		m_env->getScriptIface()->luaentity_Step(m_id, dtime);
-	}
-
+void LuaEntitySAO::stepSend(bool send_recommended)
+{
 	if(send_recommended == false)
 		return;
 
@@ -679,7 +689,7 @@ void LuaEntitySAO::setSprite(v2s16 p, int num_frames, float framelength,
 	m_messages_out.push(aom);
 }
 
-std::string LuaEntitySAO::getName()
+const std::string &LuaEntitySAO::getName() const
 {
 	return m_init_name;
 }
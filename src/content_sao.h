@@ -44,6 +44,10 @@ class LuaEntitySAO : public ServerActiveObject
 			const std::string &data);
 	bool isAttached();
 	void step(float dtime, bool send_recommended);
+	// The parts of step() before and after on_step, used by the
+	// environment to call on_step of many entities at once
+	void stepMovement(float dtime);
+	void stepSend(bool send_recommended);
 	std::string getClientInitializationData(u16 protocol_version);
 	std::string getStaticData();
 	int punch(v3f dir,
@@ -80,7 +84,9 @@ class LuaEntitySAO : public ServerActiveObject
 	void setTextureMod(const std::string &mod);
 	void setSprite(v2s16 p, int num_frames, float framelength,
 			bool select_horiz_by_yawpitch);
-	std::string getName();
+	const std::string &getName() const;
+	bool isRegistered() const
+		{ return m_registered; }
 	bool getCollisionBox(aabb3f *toset);
 	bool collideWithObjects();
 private:
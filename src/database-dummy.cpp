@@ -54,3 +54,97 @@ void Database_Dummy::listAllLoadableBlocks(std::vector<v3s16> &dst)
 	}
 }
 
+bool PlayerDatabaseDummy::savePlayer(const std::string &name,
+		const std::string &data)
+{
+	m_database[name] = data;
+	return true;
+}
+
+std::string PlayerDatabaseDummy::loadPlayer(const std::string &name)
+{
+	std::map<std::string, std::string>::iterator it = m_database.find(name);
+	if (it == m_database.end())
+		return "";
+	return it->second;
+}
+
+bool PlayerDatabaseDummy::deletePlayer(const std::string &name)
+{
+	return m_database.erase(name) > 0;
+}
+
+void PlayerDatabaseDummy::listPlayers(std::vector<std::string> &dst)
+{
+	dst.reserve(dst.size() + m_database.size());
+	for (std::map<std::string, std::string>::const_iterator x = m_database.begin();
+			x != m_database.end(); ++x) {
+		dst.push_back(x->first);
+	}
+}
+
+bool AuthDatabaseDummy::getAuth(const std::string &name, AuthEntry &res)
+{
+	std::map<std::string, AuthEntry>::iterator it = m_database.find(name);
+	if (it == m_database.end())
+		return false;
+	res = it->second;
+	return true;
+}
+
+bool AuthDatabaseDummy::saveAuth(const AuthEntry &entry)
+{
+	m_database[entry.name] = entry;
+	return true;
+}
+
+bool AuthDatabaseDummy::deleteAuth(const std::string &name)
+{
+	return m_database.erase(name) > 0;
+}
+
+void AuthDatabaseDummy::listNames(std::vector<std::string> &res)
+{
+	res.reserve(res.size() + m_database.size());
+	for (std::map<std::string, AuthEntry>::const_iterator x = m_database.begin();
+			x != m_database.end(); ++x) {
+		res.push_back(x->first);
+	}
+}
+
+void ModStorageDatabaseDummy::getModEntries(const std::string &modname,
+		std::map<std::string, std::string> &storage)
+{
+	std::map<std::string, std::map<std::string, std::string> >::const_iterator
+		it = m_database.find(modname);
+	if (it == m_database.end())
+		return;
+	storage.insert(it->second.begin(), it->second.end());
+}
+
+bool ModStorageDatabaseDummy::setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value)
+{
+	m_database[modname][key] = value;
+	return true;
+}
+
+bool ModStorageDatabaseDummy::removeModEntry(const std::string &modname,
+		const std::string &key)
+{
+	std::map<std::string, std::map<std::string, std::string> >::iterator
+		it = m_database.find(modname);
+	if (it == m_database.end() || it->second.erase(key) == 0)
+		return false;
+	if (it->second.empty())
+		m_database.erase(it);
+	return true;
+}
+
+void ModStorageDatabaseDummy::listMods(std::vector<std::string> &res)
+{
+	for (std::map<std::string, std::map<std::string, std::string> >::const_iterator
+			x = m_database.begin(); x != m_database.end(); ++x) {
+		res.push_back(x->first);
+	}
+}
@@ -37,5 +37,44 @@ class Database_Dummy : public Database
 	std::map<s64, std::string> m_database;
 };
 
+class PlayerDatabaseDummy : public PlayerDatabase
+{
+public:
+	virtual bool savePlayer(const std::string &name, const std::string &data);
+	virtual std::string loadPlayer(const std::string &name);
+	virtual bool deletePlayer(const std::string &name);
+	virtual void listPlayers(std::vector<std::string> &dst);
+
+private:
+	std::map<std::string, std::string> m_database;
+};
+
+class AuthDatabaseDummy : public AuthDatabase
+{
+public:
+	virtual bool getAuth(const std::string &name, AuthEntry &res);
+	virtual bool saveAuth(const AuthEntry &entry);
+	virtual bool deleteAuth(const std::string &name);
+	virtual void listNames(std::vector<std::string> &res);
+
+private:
+	std::map<std::string, AuthEntry> m_database;
+};
+
+class ModStorageDatabaseDummy : public ModStorageDatabase
+{
+public:
+	virtual void getModEntries(const std::string &modname,
+			std::map<std::string, std::string> &storage);
+	virtual bool setModEntry(const std::string &modname,
+			const std::string &key, const std::string &value);
+	virtual bool removeModEntry(const std::string &modname,
+			const std::string &key);
+	virtual void listMods(std::vector<std::string> &res);
+
+private:
+	std::map<std::string, std::map<std::string, std::string> > m_database;
+};
+
 #endif
 
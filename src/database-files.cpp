@@ -0,0 +1,235 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/*
+Player and auth files database classes
+*/
+
+#include "database-files.h"
+
+#include "constants.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "player.h"
+#include "settings.h"
+#include "util/string.h"
+
+#include <fstream>
+#include <sstream>
+
+// Reads the file at path into text and the player name in it into name
+static bool read_player_file(const std::string &path, std::string &text,
+		std::string &name)
+{
+	std::ifstream is(path.c_str(), std::ios_base::binary);
+	if (!is.good())
+		return false;
+	std::ostringstream os(std::ios_base::binary);
+	os << is.rdbuf();
+	text = os.str();
+
+	std::istringstream tis(text, std::ios_base::binary);
+	Settings args;
+	if (!args.parseConfigLines(tis, "PlayerArgsEnd") || !args.exists("name")) {
+		warningstream << "Invalid player file " << path << std::endl;
+		return false;
+	}
+	name = args.get("name");
+	return true;
+}
+
+PlayerDatabaseFiles::PlayerDatabaseFiles(const std::string &savedir) :
+	m_players_path(savedir + DIR_DELIM "players")
+{
+}
+
+bool PlayerDatabaseFiles::findPlayerFile(const std::string &name,
+		std::string &path, std::string &text)
+{
+	/*
+	 * Some file systems are not case-sensitive but player names are,
+	 * so the file named after the player may belong to another player.
+	 * Alternative files are then tried, up to the first free one.
+	 */
+	std::string file_name;
+	path = m_players_path + DIR_DELIM + name;
+	for (u32 i = 0; i < PLAYER_FILE_ALTERNATE_TRIES; i++) {
+		if (!fs::PathExists(path))
+			return false;
+		if (read_player_file(path, text, file_name) && file_name == name)
+			return true;
+		path = m_players_path + DIR_DELIM + name + itos(i);
+	}
+
+	path = "";
+	return false;
+}
+
+bool PlayerDatabaseFiles::savePlayer(const std::string &name,
+		const std::string &data)
+{
+	fs::CreateDir(m_players_path);
+
+	std::string path, text;
+	findPlayerFile(name, path, text);
+	if (path.empty()) {
+		infostream << "Didn't find free file for player " << name << std::endl;
+		return false;
+	}
+
+	if (!fs::safeWriteToFile(path, Player::binaryToText(data))) {
+		infostream << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::string PlayerDatabaseFiles::loadPlayer(const std::string &name)
+{
+	std::string path, text;
+	if (!findPlayerFile(name, path, text))
+		return "";
+	return Player::textToBinary(text);
+}
+
+bool PlayerDatabaseFiles::deletePlayer(const std::string &name)
+{
+	std::string path, text;
+	if (!findPlayerFile(name, path, text))
+		return false;
+	return fs::DeleteSingleFileOrEmptyDirectory(path);
+}
+
+void PlayerDatabaseFiles::listPlayers(std::vector<std::string> &dst)
+{
+	std::vector<fs::DirListNode> files = fs::GetDirListing(m_players_path);
+	for (std::vector<fs::DirListNode>::const_iterator it = files.begin();
+			it != files.end(); ++it) {
+		if (it->dir)
+			continue;
+		std::string text, name;
+		if (read_player_file(m_players_path + DIR_DELIM + it->name,
+				text, name))
+			dst.push_back(name);
+	}
+}
+
+
+/*
+	AuthDatabaseFiles
+*/
+
+AuthDatabaseFiles::AuthDatabaseFiles(const std::string &savedir) :
+	m_auth_path(savedir + DIR_DELIM "auth.txt"),
+	m_saving(false),
+	m_modified(false)
+{
+	reload();
+}
+
+void AuthDatabaseFiles::reload()
+{
+	m_entries.clear();
+
+	std::ifstream is(m_auth_path.c_str(), std::ios_base::binary);
+	if (!is.good()) {
+		infostream << m_auth_path << " could not be opened for reading; "
+			"assuming new world" << std::endl;
+		return;
+	}
+
+	std::string line;
+	while (std::getline(is, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+		if (line.empty())
+			continue;
+		AuthEntry entry;
+		if (!entry.fromLine(line))
+			throw SerializationError("Invalid line in auth.txt: " + line);
+		m_entries[entry.name] = entry;
+	}
+}
+
+bool AuthDatabaseFiles::writeAuthFile()
+{
+	std::ostringstream os(std::ios_base::binary);
+	for (std::map<std::string, AuthEntry>::const_iterator
+			it = m_entries.begin(); it != m_entries.end(); ++it)
+		os << it->second.toLine() << "\n";
+
+	if (!fs::safeWriteToFile(m_auth_path, os.str())) {
+		errorstream << m_auth_path << " could not be written" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void AuthDatabaseFiles::beginSave()
+{
+	m_saving = true;
+}
+
+bool AuthDatabaseFiles::endSave()
+{
+	m_saving = false;
+	if (!m_modified)
+		return true;
+	m_modified = false;
+	return writeAuthFile();
+}
+
+bool AuthDatabaseFiles::getAuth(const std::string &name, AuthEntry &res)
+{
+	std::map<std::string, AuthEntry>::const_iterator it = m_entries.find(name);
+	if (it == m_entries.end())
+		return false;
+	res = it->second;
+	return true;
+}
+
+bool AuthDatabaseFiles::saveAuth(const AuthEntry &entry)
+{
+	m_entries[entry.name] = entry;
+	if (m_saving) {
+		m_modified = true;
+		return true;
+	}
+	return writeAuthFile();
+}
+
+bool AuthDatabaseFiles::deleteAuth(const std::string &name)
+{
+	if (m_entries.erase(name) == 0)
+		return false;
+	if (m_saving) {
+		m_modified = true;
+		return true;
+	}
+	return writeAuthFile();
+}
+
+void AuthDatabaseFiles::listNames(std::vector<std::string> &res)
+{
+	for (std::map<std::string, AuthEntry>::const_iterator
+			it = m_entries.begin(); it != m_entries.end(); ++it)
+		res.push_back(it->first);
+}
@@ -0,0 +1,79 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#ifndef DATABASE_FILES_HEADER
+#define DATABASE_FILES_HEADER
+
+#include "database.h"
+#include <map>
+#include <string>
+
+/*
+	The old player storage: one text file per player in world/players.
+*/
+class PlayerDatabaseFiles : public PlayerDatabase
+{
+public:
+	PlayerDatabaseFiles(const std::string &savedir);
+
+	virtual bool savePlayer(const std::string &name, const std::string &data);
+	virtual std::string loadPlayer(const std::string &name);
+	virtual bool deletePlayer(const std::string &name);
+	virtual void listPlayers(std::vector<std::string> &dst);
+
+private:
+	// Sets path to the file of the player and text to its contents.
+	// If the player has no file, returns false and sets path to a free file.
+	bool findPlayerFile(const std::string &name, std::string &path,
+			std::string &text);
+
+	std::string m_players_path;
+};
+
+/*
+	The old authentication storage: world/auth.txt, one player per line.
+	Kept in memory and rewritten as a whole on every change, so this only
+	suits small servers and the import of old worlds.
+*/
+class AuthDatabaseFiles : public AuthDatabase
+{
+public:
+	AuthDatabaseFiles(const std::string &savedir);
+
+	virtual void beginSave();
+	virtual bool endSave();
+
+	virtual bool getAuth(const std::string &name, AuthEntry &res);
+	virtual bool saveAuth(const AuthEntry &entry);
+	virtual bool deleteAuth(const std::string &name);
+	virtual void listNames(std::vector<std::string> &res);
+	virtual void reload();
+
+private:
+	bool writeAuthFile();
+
+	std::string m_auth_path;
+	std::map<std::string, AuthEntry> m_entries;
+	// Between beginSave and endSave the file is only written by endSave
+	bool m_saving;
+	bool m_modified;
+};
+
+#endif
@@ -100,5 +100,134 @@ void Database_LevelDB::listAllLoadableBlocks(std::vector<v3s16> &dst)
 	delete it;
 }
 
+PlayerDatabaseLevelDB::PlayerDatabaseLevelDB(const std::string &savedir)
+{
+	leveldb::Options options;
+	options.create_if_missing = true;
+	leveldb::Status status = leveldb::DB::Open(options,
+		savedir + DIR_DELIM + "players.db", &m_database);
+	ENSURE_STATUS_OK(status);
+}
+
+PlayerDatabaseLevelDB::~PlayerDatabaseLevelDB()
+{
+	delete m_database;
+}
+
+bool PlayerDatabaseLevelDB::savePlayer(const std::string &name,
+		const std::string &data)
+{
+	leveldb::Status status = m_database->Put(leveldb::WriteOptions(),
+			name, data);
+	if (!status.ok()) {
+		warningstream << "savePlayer: LevelDB error saving player "
+			<< name << ": " << status.ToString() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string PlayerDatabaseLevelDB::loadPlayer(const std::string &name)
+{
+	std::string datastr;
+	leveldb::Status status = m_database->Get(leveldb::ReadOptions(),
+		name, &datastr);
+
+	if(status.ok())
+		return datastr;
+	else
+		return "";
+}
+
+bool PlayerDatabaseLevelDB::deletePlayer(const std::string &name)
+{
+	leveldb::Status status = m_database->Delete(leveldb::WriteOptions(),
+			name);
+	if (!status.ok()) {
+		warningstream << "deletePlayer: LevelDB error deleting player "
+			<< name << ": " << status.ToString() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void PlayerDatabaseLevelDB::listPlayers(std::vector<std::string> &dst)
+{
+	leveldb::Iterator* it = m_database->NewIterator(leveldb::ReadOptions());
+	for (it->SeekToFirst(); it->Valid(); it->Next()) {
+		dst.push_back(it->key().ToString());
+	}
+	ENSURE_STATUS_OK(it->status());  // Check for any errors found during the scan
+	delete it;
+}
+
+AuthDatabaseLevelDB::AuthDatabaseLevelDB(const std::string &savedir)
+{
+	leveldb::Options options;
+	options.create_if_missing = true;
+	leveldb::Status status = leveldb::DB::Open(options,
+		savedir + DIR_DELIM + "auth.db", &m_database);
+	ENSURE_STATUS_OK(status);
+}
+
+AuthDatabaseLevelDB::~AuthDatabaseLevelDB()
+{
+	delete m_database;
+}
+
+bool AuthDatabaseLevelDB::getAuth(const std::string &name, AuthEntry &res)
+{
+	std::string datastr;
+	leveldb::Status status = m_database->Get(leveldb::ReadOptions(),
+		name, &datastr);
+	if (!status.ok())
+		return false;
+
+	if (!res.fromLine(datastr)) {
+		warningstream << "getAuth: Invalid auth entry of player "
+			<< name << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool AuthDatabaseLevelDB::saveAuth(const AuthEntry &entry)
+{
+	leveldb::Status status = m_database->Put(leveldb::WriteOptions(),
+			entry.name, entry.toLine());
+	if (!status.ok()) {
+		warningstream << "saveAuth: LevelDB error saving auth of "
+			<< entry.name << ": " << status.ToString() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool AuthDatabaseLevelDB::deleteAuth(const std::string &name)
+{
+	leveldb::Status status = m_database->Delete(leveldb::WriteOptions(),
+			name);
+	if (!status.ok()) {
+		warningstream << "deleteAuth: LevelDB error deleting auth of "
+			<< name << ": " << status.ToString() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void AuthDatabaseLevelDB::listNames(std::vector<std::string> &res)
+{
+	leveldb::Iterator* it = m_database->NewIterator(leveldb::ReadOptions());
+	for (it->SeekToFirst(); it->Valid(); it->Next()) {
+		res.push_back(it->key().ToString());
+	}
+	ENSURE_STATUS_OK(it->status());  // Check for any errors found during the scan
+	delete it;
+}
+
 #endif // USE_LEVELDB
 
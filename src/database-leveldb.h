@@ -43,6 +43,37 @@ class Database_LevelDB : public Database
 	leveldb::DB *m_database;
 };
 
+class PlayerDatabaseLevelDB : public PlayerDatabase
+{
+public:
+	PlayerDatabaseLevelDB(const std::string &savedir);
+	~PlayerDatabaseLevelDB();
+
+	virtual bool savePlayer(const std::string &name, const std::string &data);
+	virtual std::string loadPlayer(const std::string &name);
+	virtual bool deletePlayer(const std::string &name);
+	virtual void listPlayers(std::vector<std::string> &dst);
+
+private:
+	leveldb::DB *m_database;
+};
+
+// Values are auth.txt lines
+class AuthDatabaseLevelDB : public AuthDatabase
+{
+public:
+	AuthDatabaseLevelDB(const std::string &savedir);
+	~AuthDatabaseLevelDB();
+
+	virtual bool getAuth(const std::string &name, AuthEntry &res);
+	virtual bool saveAuth(const AuthEntry &entry);
+	virtual bool deleteAuth(const std::string &name);
+	virtual void listNames(std::vector<std::string> &res);
+
+private:
+	leveldb::DB *m_database;
+};
+
 #endif // USE_LEVELDB
 
 #endif
@@ -183,5 +183,146 @@ void Database_Redis::listAllLoadableBlocks(std::vector<v3s16> &dst)
 	freeReplyObject(reply);
 }
 
+
+PlayerDatabaseRedis::PlayerDatabaseRedis(Settings &conf)
+{
+	std::string tmp;
+	try {
+		tmp = conf.get("redis_address");
+		hash = conf.get("redis_hash") + "_players";
+	} catch (SettingNotFoundException) {
+		throw SettingNotFoundException("Set redis_address and "
+			"redis_hash in world.mt to use the redis backend");
+	}
+	const char *addr = tmp.c_str();
+	int port = conf.exists("redis_port") ? conf.getU16("redis_port") : 6379;
+	ctx = redisConnect(addr, port);
+	if (!ctx) {
+		throw FileNotGoodException("Cannot allocate redis context");
+	} else if (ctx->err) {
+		std::string err = std::string("Connection error: ") + ctx->errstr;
+		redisFree(ctx);
+		throw FileNotGoodException(err);
+	}
+}
+
+PlayerDatabaseRedis::~PlayerDatabaseRedis()
+{
+	redisFree(ctx);
+}
+
+void PlayerDatabaseRedis::beginSave() {
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "MULTI"));
+	if (!reply) {
+		throw FileNotGoodException(std::string(
+			"Redis command 'MULTI' failed: ") + ctx->errstr);
+	}
+	freeReplyObject(reply);
+}
+
+void PlayerDatabaseRedis::endSave() {
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "EXEC"));
+	if (!reply) {
+		throw FileNotGoodException(std::string(
+			"Redis command 'EXEC' failed: ") + ctx->errstr);
+	}
+	freeReplyObject(reply);
+}
+
+bool PlayerDatabaseRedis::savePlayer(const std::string &name,
+		const std::string &data)
+{
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "HSET %s %b %b",
+			hash.c_str(), name.c_str(), name.size(), data.c_str(), data.size()));
+	if (!reply) {
+		warningstream << "savePlayer: redis command 'HSET' failed on "
+			"player " << name << ": " << ctx->errstr << std::endl;
+		return false;
+	}
+
+	if (reply->type == REDIS_REPLY_ERROR) {
+		warningstream << "savePlayer: saving player " << name
+			<< " failed: " << std::string(reply->str, reply->len) << std::endl;
+		freeReplyObject(reply);
+		return false;
+	}
+
+	freeReplyObject(reply);
+	return true;
+}
+
+std::string PlayerDatabaseRedis::loadPlayer(const std::string &name)
+{
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx,
+			"HGET %s %b", hash.c_str(), name.c_str(), name.size()));
+
+	if (!reply) {
+		throw FileNotGoodException(std::string(
+			"Redis command 'HGET %s %s' failed: ") + ctx->errstr);
+	}
+	switch (reply->type) {
+	case REDIS_REPLY_STRING: {
+		std::string str(reply->str, reply->len);
+		freeReplyObject(reply);
+		return str;
+	}
+	case REDIS_REPLY_NIL:
+		// player not found in database
+		freeReplyObject(reply);
+		return "";
+	case REDIS_REPLY_ERROR: {
+		std::string errstr(reply->str, reply->len);
+		freeReplyObject(reply);
+		throw FileNotGoodException(std::string(
+			"Redis command 'HGET %s %s' errored: ") + errstr);
+	}
+	}
+	freeReplyObject(reply);
+	throw FileNotGoodException(std::string(
+		"Redis command 'HGET %s %s' gave invalid reply."));
+}
+
+bool PlayerDatabaseRedis::deletePlayer(const std::string &name)
+{
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx,
+		"HDEL %s %b", hash.c_str(), name.c_str(), name.size()));
+	if (!reply) {
+		throw FileNotGoodException(std::string(
+			"Redis command 'HDEL %s %s' failed: ") + ctx->errstr);
+	} else if (reply->type == REDIS_REPLY_ERROR) {
+		warningstream << "deletePlayer: deleting player " << name
+			<< " failed: " << std::string(reply->str, reply->len) << std::endl;
+		freeReplyObject(reply);
+		return false;
+	}
+
+	freeReplyObject(reply);
+	return true;
+}
+
+void PlayerDatabaseRedis::listPlayers(std::vector<std::string> &dst)
+{
+	redisReply *reply = static_cast<redisReply *>(redisCommand(ctx, "HKEYS %s", hash.c_str()));
+	if (!reply) {
+		throw FileNotGoodException(std::string(
+			"Redis command 'HKEYS %s' failed: ") + ctx->errstr);
+	}
+	switch (reply->type) {
+	case REDIS_REPLY_ARRAY:
+		dst.reserve(dst.size() + reply->elements);
+		for (size_t i = 0; i < reply->elements; i++) {
+			assert(reply->element[i]->type == REDIS_REPLY_STRING);
+			dst.push_back(std::string(reply->element[i]->str,
+				reply->element[i]->len));
+		}
+		break;
+	case REDIS_REPLY_ERROR:
+		throw FileNotGoodException(std::string(
+			"Failed to get keys from database: ") +
+			std::string(reply->str, reply->len));
+	}
+	freeReplyObject(reply);
+}
+
 #endif // USE_REDIS
 
@@ -49,6 +49,26 @@ class Database_Redis : public Database
 	std::string hash;
 };
 
+class PlayerDatabaseRedis : public PlayerDatabase
+{
+public:
+	// Uses the hash redis_hash with "_players" appended
+	PlayerDatabaseRedis(Settings &conf);
+	~PlayerDatabaseRedis();
+
+	virtual void beginSave();
+	virtual void endSave();
+
+	virtual bool savePlayer(const std::string &name, const std::string &data);
+	virtual std::string loadPlayer(const std::string &name);
+	virtual bool deletePlayer(const std::string &name);
+	virtual void listPlayers(std::vector<std::string> &dst);
+
+private:
+	redisContext *ctx;
+	std::string hash;
+};
+
 #endif // USE_REDIS
 
 #endif
@@ -22,6 +22,18 @@ SQLite format specification:
 	blocks:
 		(PK) INT id
 		BLOB data
+	player (in players.sqlite):
+		(PK) TEXT name
+		BLOB data
+	auth (in auth.sqlite):
+		(PK) TEXT name
+		TEXT password
+		TEXT privileges (comma separated)
+		INT last_login (-1 if unknown)
+	entries (in mod_storage.sqlite):
+		(PK) BLOB modname
+		(PK) BLOB key
+		BLOB value
 */
 
 
@@ -295,3 +307,517 @@ Database_SQLite3::~Database_SQLite3()
 	SQLOK(sqlite3_close(m_database), "Failed to close database");
 }
 
+
+
+/*
+	PlayerDatabaseSQLite3
+*/
+
+PlayerDatabaseSQLite3::PlayerDatabaseSQLite3(const std::string &savedir) :
+	m_initialized(false),
+	m_savedir(savedir),
+	m_database(NULL),
+	m_stmt_read(NULL),
+	m_stmt_write(NULL),
+	m_stmt_list(NULL),
+	m_stmt_delete(NULL),
+	m_stmt_begin(NULL),
+	m_stmt_end(NULL)
+{
+}
+
+void PlayerDatabaseSQLite3::verifyDatabase()
+{
+	if (m_initialized) return;
+
+	std::string dbp = m_savedir + DIR_DELIM + "players.sqlite";
+
+	if (!fs::CreateAllDirs(m_savedir)) {
+		infostream << "PlayerDatabaseSQLite3: Failed to create directory \""
+			<< m_savedir << "\"" << std::endl;
+		throw FileNotGoodException("Failed to create database "
+				"save directory");
+	}
+
+	SQLOK(sqlite3_open_v2(dbp.c_str(), &m_database,
+			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL),
+		std::string("Failed to open SQLite3 database file ") + dbp);
+
+	SQLOK(sqlite3_busy_handler(m_database, Database_SQLite3::busyHandler,
+		m_busy_handler_data), "Failed to set SQLite3 busy handler");
+
+	SQLOK(sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `player` (\n"
+		"	`name` TEXT PRIMARY KEY,\n"
+		"	`data` BLOB\n"
+		");\n",
+		NULL, NULL, NULL),
+		"Failed to create database table");
+
+	std::string query_str = std::string("PRAGMA synchronous = ")
+			 + itos(g_settings->getU16("sqlite_synchronous"));
+	SQLOK(sqlite3_exec(m_database, query_str.c_str(), NULL, NULL, NULL),
+		"Failed to modify sqlite3 synchronous mode");
+
+	PREPARE_STATEMENT(begin, "BEGIN");
+	PREPARE_STATEMENT(end, "COMMIT");
+	PREPARE_STATEMENT(read, "SELECT `data` FROM `player` WHERE `name` = ? LIMIT 1");
+	PREPARE_STATEMENT(write, "REPLACE INTO `player` (`name`, `data`) VALUES (?, ?)");
+	PREPARE_STATEMENT(delete, "DELETE FROM `player` WHERE `name` = ?");
+	PREPARE_STATEMENT(list, "SELECT `name` FROM `player`");
+
+	m_initialized = true;
+
+	verbosestream << "ServerEnvironment: SQLite3 player database opened." << std::endl;
+}
+
+void PlayerDatabaseSQLite3::beginSave()
+{
+	verifyDatabase();
+	SQLRES(sqlite3_step(m_stmt_begin), SQLITE_DONE,
+		"Failed to start SQLite3 transaction");
+	sqlite3_reset(m_stmt_begin);
+}
+
+void PlayerDatabaseSQLite3::endSave()
+{
+	verifyDatabase();
+	SQLRES(sqlite3_step(m_stmt_end), SQLITE_DONE,
+		"Failed to commit SQLite3 transaction");
+	sqlite3_reset(m_stmt_end);
+}
+
+bool PlayerDatabaseSQLite3::savePlayer(const std::string &name,
+		const std::string &data)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_text(m_stmt_write, 1, name.c_str(), name.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_blob(m_stmt_write, 2, data.data(), data.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	SQLRES(sqlite3_step(m_stmt_write), SQLITE_DONE, "Failed to save player")
+	sqlite3_reset(m_stmt_write);
+
+	return true;
+}
+
+std::string PlayerDatabaseSQLite3::loadPlayer(const std::string &name)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_text(m_stmt_read, 1, name.c_str(), name.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	if (sqlite3_step(m_stmt_read) != SQLITE_ROW) {
+		sqlite3_reset(m_stmt_read);
+		return "";
+	}
+	const char *data = (const char *) sqlite3_column_blob(m_stmt_read, 0);
+	size_t len = sqlite3_column_bytes(m_stmt_read, 0);
+
+	std::string s;
+	if (data)
+		s = std::string(data, len);
+
+	sqlite3_reset(m_stmt_read);
+
+	return s;
+}
+
+bool PlayerDatabaseSQLite3::deletePlayer(const std::string &name)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_text(m_stmt_delete, 1, name.c_str(), name.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	bool good = sqlite3_step(m_stmt_delete) == SQLITE_DONE;
+	sqlite3_reset(m_stmt_delete);
+
+	if (!good) {
+		warningstream << "deletePlayer: Player failed to delete "
+			<< name << ": " << sqlite3_errmsg(m_database) << std::endl;
+	}
+	return good && sqlite3_changes(m_database) > 0;
+}
+
+void PlayerDatabaseSQLite3::listPlayers(std::vector<std::string> &dst)
+{
+	verifyDatabase();
+
+	while (sqlite3_step(m_stmt_list) == SQLITE_ROW) {
+		const char *name = (const char *) sqlite3_column_text(m_stmt_list, 0);
+		size_t len = sqlite3_column_bytes(m_stmt_list, 0);
+		dst.push_back(std::string(name, len));
+	}
+	sqlite3_reset(m_stmt_list);
+}
+
+PlayerDatabaseSQLite3::~PlayerDatabaseSQLite3()
+{
+	FINALIZE_STATEMENT(m_stmt_read)
+	FINALIZE_STATEMENT(m_stmt_write)
+	FINALIZE_STATEMENT(m_stmt_list)
+	FINALIZE_STATEMENT(m_stmt_begin)
+	FINALIZE_STATEMENT(m_stmt_end)
+	FINALIZE_STATEMENT(m_stmt_delete)
+
+	SQLOK(sqlite3_close(m_database), "Failed to close database");
+}
+
+
+/*
+	AuthDatabaseSQLite3
+*/
+
+AuthDatabaseSQLite3::AuthDatabaseSQLite3(const std::string &savedir) :
+	m_initialized(false),
+	m_savedir(savedir),
+	m_database(NULL),
+	m_stmt_read(NULL),
+	m_stmt_write(NULL),
+	m_stmt_list(NULL),
+	m_stmt_delete(NULL),
+	m_stmt_begin(NULL),
+	m_stmt_end(NULL)
+{
+}
+
+void AuthDatabaseSQLite3::verifyDatabase()
+{
+	if (m_initialized) return;
+
+	std::string dbp = m_savedir + DIR_DELIM + "auth.sqlite";
+
+	if (!fs::CreateAllDirs(m_savedir)) {
+		infostream << "AuthDatabaseSQLite3: Failed to create directory \""
+			<< m_savedir << "\"" << std::endl;
+		throw FileNotGoodException("Failed to create database "
+				"save directory");
+	}
+
+	SQLOK(sqlite3_open_v2(dbp.c_str(), &m_database,
+			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL),
+		std::string("Failed to open SQLite3 database file ") + dbp);
+
+	SQLOK(sqlite3_busy_handler(m_database, Database_SQLite3::busyHandler,
+		m_busy_handler_data), "Failed to set SQLite3 busy handler");
+
+	SQLOK(sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `auth` (\n"
+		"	`name` TEXT PRIMARY KEY,\n"
+		"	`password` TEXT,\n"
+		"	`privileges` TEXT,\n"
+		"	`last_login` INTEGER\n"
+		");\n",
+		NULL, NULL, NULL),
+		"Failed to create database table");
+
+	std::string query_str = std::string("PRAGMA synchronous = ")
+			 + itos(g_settings->getU16("sqlite_synchronous"));
+	SQLOK(sqlite3_exec(m_database, query_str.c_str(), NULL, NULL, NULL),
+		"Failed to modify sqlite3 synchronous mode");
+
+	PREPARE_STATEMENT(begin, "BEGIN");
+	PREPARE_STATEMENT(end, "COMMIT");
+	PREPARE_STATEMENT(read, "SELECT `password`, `privileges`, `last_login` "
+		"FROM `auth` WHERE `name` = ? LIMIT 1");
+	PREPARE_STATEMENT(write, "REPLACE INTO `auth` (`name`, `password`, "
+		"`privileges`, `last_login`) VALUES (?, ?, ?, ?)");
+	PREPARE_STATEMENT(delete, "DELETE FROM `auth` WHERE `name` = ?");
+	PREPARE_STATEMENT(list, "SELECT `name` FROM `auth`");
+
+	m_initialized = true;
+
+	verbosestream << "Server: SQLite3 auth database opened." << std::endl;
+}
+
+void AuthDatabaseSQLite3::beginSave()
+{
+	verifyDatabase();
+	SQLRES(sqlite3_step(m_stmt_begin), SQLITE_DONE,
+		"Failed to start SQLite3 transaction");
+	sqlite3_reset(m_stmt_begin);
+}
+
+bool AuthDatabaseSQLite3::endSave()
+{
+	verifyDatabase();
+	SQLRES(sqlite3_step(m_stmt_end), SQLITE_DONE,
+		"Failed to commit SQLite3 transaction");
+	sqlite3_reset(m_stmt_end);
+	return true;
+}
+
+bool AuthDatabaseSQLite3::getAuth(const std::string &name, AuthEntry &res)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_text(m_stmt_read, 1, name.c_str(), name.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	if (sqlite3_step(m_stmt_read) != SQLITE_ROW) {
+		sqlite3_reset(m_stmt_read);
+		return false;
+	}
+
+	res.name = name;
+	const char *password = (const char *) sqlite3_column_text(m_stmt_read, 0);
+	res.password = password ? password : "";
+	const char *privs = (const char *) sqlite3_column_text(m_stmt_read, 1);
+	res.privileges.clear();
+	if (privs && *privs)
+		res.privileges = str_split(std::string(privs), ',');
+	res.last_login = sqlite3_column_int64(m_stmt_read, 2);
+
+	sqlite3_reset(m_stmt_read);
+	return true;
+}
+
+bool AuthDatabaseSQLite3::saveAuth(const AuthEntry &entry)
+{
+	verifyDatabase();
+
+	std::string privs;
+	for (std::vector<std::string>::const_iterator it = entry.privileges.begin();
+			it != entry.privileges.end(); ++it) {
+		if (it != entry.privileges.begin())
+			privs += ",";
+		privs += *it;
+	}
+
+	SQLOK(sqlite3_bind_text(m_stmt_write, 1, entry.name.c_str(),
+			entry.name.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_text(m_stmt_write, 2, entry.password.c_str(),
+			entry.password.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_text(m_stmt_write, 3, privs.c_str(), privs.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_int64(m_stmt_write, 4, entry.last_login),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	SQLRES(sqlite3_step(m_stmt_write), SQLITE_DONE, "Failed to save auth")
+	sqlite3_reset(m_stmt_write);
+
+	return true;
+}
+
+bool AuthDatabaseSQLite3::deleteAuth(const std::string &name)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_text(m_stmt_delete, 1, name.c_str(), name.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	bool good = sqlite3_step(m_stmt_delete) == SQLITE_DONE;
+	sqlite3_reset(m_stmt_delete);
+
+	if (!good) {
+		warningstream << "deleteAuth: Auth failed to delete "
+			<< name << ": " << sqlite3_errmsg(m_database) << std::endl;
+	}
+	return good && sqlite3_changes(m_database) > 0;
+}
+
+void AuthDatabaseSQLite3::listNames(std::vector<std::string> &res)
+{
+	verifyDatabase();
+
+	while (sqlite3_step(m_stmt_list) == SQLITE_ROW) {
+		const char *name = (const char *) sqlite3_column_text(m_stmt_list, 0);
+		size_t len = sqlite3_column_bytes(m_stmt_list, 0);
+		res.push_back(std::string(name, len));
+	}
+	sqlite3_reset(m_stmt_list);
+}
+
+AuthDatabaseSQLite3::~AuthDatabaseSQLite3()
+{
+	FINALIZE_STATEMENT(m_stmt_read)
+	FINALIZE_STATEMENT(m_stmt_write)
+	FINALIZE_STATEMENT(m_stmt_list)
+	FINALIZE_STATEMENT(m_stmt_begin)
+	FINALIZE_STATEMENT(m_stmt_end)
+	FINALIZE_STATEMENT(m_stmt_delete)
+
+	SQLOK(sqlite3_close(m_database), "Failed to close database");
+}
+
+
+/*
+	ModStorageDatabaseSQLite3
+*/
+
+ModStorageDatabaseSQLite3::ModStorageDatabaseSQLite3(const std::string &savedir) :
+	m_initialized(false),
+	m_savedir(savedir),
+	m_database(NULL),
+	m_stmt_get(NULL),
+	m_stmt_set(NULL),
+	m_stmt_remove(NULL),
+	m_stmt_list(NULL),
+	m_stmt_begin(NULL),
+	m_stmt_end(NULL)
+{
+}
+
+void ModStorageDatabaseSQLite3::verifyDatabase()
+{
+	if (m_initialized) return;
+
+	std::string dbp = m_savedir + DIR_DELIM + "mod_storage.sqlite";
+
+	if (!fs::CreateAllDirs(m_savedir)) {
+		infostream << "ModStorageDatabaseSQLite3: Failed to create directory \""
+			<< m_savedir << "\"" << std::endl;
+		throw FileNotGoodException("Failed to create database "
+				"save directory");
+	}
+
+	SQLOK(sqlite3_open_v2(dbp.c_str(), &m_database,
+			SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL),
+		std::string("Failed to open SQLite3 database file ") + dbp);
+
+	SQLOK(sqlite3_busy_handler(m_database, Database_SQLite3::busyHandler,
+		m_busy_handler_data), "Failed to set SQLite3 busy handler");
+
+	SQLOK(sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `entries` (\n"
+		"	`modname` BLOB NOT NULL,\n"
+		"	`key` BLOB NOT NULL,\n"
+		"	`value` BLOB NOT NULL,\n"
+		"	PRIMARY KEY (`modname`, `key`)\n"
+		");\n",
+		NULL, NULL, NULL),
+		"Failed to create database table");
+
+	std::string query_str = std::string("PRAGMA synchronous = ")
+			 + itos(g_settings->getU16("sqlite_synchronous"));
+	SQLOK(sqlite3_exec(m_database, query_str.c_str(), NULL, NULL, NULL),
+		"Failed to modify sqlite3 synchronous mode");
+
+	PREPARE_STATEMENT(begin, "BEGIN");
+	PREPARE_STATEMENT(end, "COMMIT");
+	PREPARE_STATEMENT(get, "SELECT `key`, `value` FROM `entries` WHERE `modname` = ?");
+	PREPARE_STATEMENT(set, "REPLACE INTO `entries` (`modname`, `key`, `value`) "
+		"VALUES (?, ?, ?)");
+	PREPARE_STATEMENT(remove, "DELETE FROM `entries` WHERE `modname` = ? AND `key` = ?");
+	PREPARE_STATEMENT(list, "SELECT DISTINCT `modname` FROM `entries`");
+
+	m_initialized = true;
+
+	verbosestream << "Server: SQLite3 mod storage database opened." << std::endl;
+}
+
+void ModStorageDatabaseSQLite3::beginSave()
+{
+	verifyDatabase();
+	SQLRES(sqlite3_step(m_stmt_begin), SQLITE_DONE,
+		"Failed to start SQLite3 transaction");
+	sqlite3_reset(m_stmt_begin);
+}
+
+void ModStorageDatabaseSQLite3::endSave()
+{
+	verifyDatabase();
+	SQLRES(sqlite3_step(m_stmt_end), SQLITE_DONE,
+		"Failed to commit SQLite3 transaction");
+	sqlite3_reset(m_stmt_end);
+}
+
+void ModStorageDatabaseSQLite3::abortSave()
+{
+	verifyDatabase();
+
+	// SQLRES throws before the failed statement is reset
+	sqlite3_reset(m_stmt_set);
+	sqlite3_reset(m_stmt_remove);
+	sqlite3_reset(m_stmt_begin);
+	sqlite3_reset(m_stmt_end);
+
+	// A failed COMMIT may have ended the transaction already
+	if (!sqlite3_get_autocommit(m_database))
+		SQLOK(sqlite3_exec(m_database, "ROLLBACK", NULL, NULL, NULL),
+			"Failed to roll back SQLite3 transaction");
+}
+
+void ModStorageDatabaseSQLite3::getModEntries(const std::string &modname,
+		std::map<std::string, std::string> &storage)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_blob(m_stmt_get, 1, modname.data(), modname.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	while (sqlite3_step(m_stmt_get) == SQLITE_ROW) {
+		const char *key = (const char *) sqlite3_column_blob(m_stmt_get, 0);
+		size_t key_len = sqlite3_column_bytes(m_stmt_get, 0);
+		const char *value = (const char *) sqlite3_column_blob(m_stmt_get, 1);
+		size_t value_len = sqlite3_column_bytes(m_stmt_get, 1);
+		// Empty blobs are returned as NULL
+		storage[key ? std::string(key, key_len) : ""] =
+			value ? std::string(value, value_len) : "";
+	}
+	sqlite3_reset(m_stmt_get);
+}
+
+bool ModStorageDatabaseSQLite3::setModEntry(const std::string &modname,
+		const std::string &key, const std::string &value)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_blob(m_stmt_set, 1, modname.data(), modname.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_blob(m_stmt_set, 2, key.data(), key.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_blob(m_stmt_set, 3, value.data(), value.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	SQLRES(sqlite3_step(m_stmt_set), SQLITE_DONE, "Failed to set mod entry")
+	sqlite3_reset(m_stmt_set);
+
+	return true;
+}
+
+bool ModStorageDatabaseSQLite3::removeModEntry(const std::string &modname,
+		const std::string &key)
+{
+	verifyDatabase();
+
+	SQLOK(sqlite3_bind_blob(m_stmt_remove, 1, modname.data(), modname.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLOK(sqlite3_bind_blob(m_stmt_remove, 2, key.data(), key.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+
+	SQLRES(sqlite3_step(m_stmt_remove), SQLITE_DONE, "Failed to remove mod entry")
+	sqlite3_reset(m_stmt_remove);
+
+	return sqlite3_changes(m_database) > 0;
+}
+
+void ModStorageDatabaseSQLite3::listMods(std::vector<std::string> &res)
+{
+	verifyDatabase();
+
+	while (sqlite3_step(m_stmt_list) == SQLITE_ROW) {
+		const char *modname = (const char *) sqlite3_column_blob(m_stmt_list, 0);
+		size_t len = sqlite3_column_bytes(m_stmt_list, 0);
+		res.push_back(std::string(modname, len));
+	}
+	sqlite3_reset(m_stmt_list);
+}
+
+ModStorageDatabaseSQLite3::~ModStorageDatabaseSQLite3()
+{
+	FINALIZE_STATEMENT(m_stmt_get)
+	FINALIZE_STATEMENT(m_stmt_set)
+	FINALIZE_STATEMENT(m_stmt_remove)
+	FINALIZE_STATEMENT(m_stmt_list)
+	FINALIZE_STATEMENT(m_stmt_begin)
+	FINALIZE_STATEMENT(m_stmt_end)
+
+	SQLOK(sqlite3_close(m_database), "Failed to close database");
+}
@@ -42,6 +42,9 @@ class Database_SQLite3 : public Database
 	virtual bool initialized() const { return m_initialized; }
 	~Database_SQLite3();
 
+	// Reports long waits for a database locked by another process
+	static int busyHandler(void *data, int count);
+
 private:
 	// Open the database
 	void openDatabase();
@@ -65,8 +68,109 @@ class Database_SQLite3 : public Database
 	sqlite3_stmt *m_stmt_end;
 
 	s64 m_busy_handler_data[2];
+};
 
-	static int busyHandler(void *data, int count);
+class PlayerDatabaseSQLite3 : public PlayerDatabase
+{
+public:
+	PlayerDatabaseSQLite3(const std::string &savedir);
+	~PlayerDatabaseSQLite3();
+
+	virtual void beginSave();
+	virtual void endSave();
+
+	virtual bool savePlayer(const std::string &name, const std::string &data);
+	virtual std::string loadPlayer(const std::string &name);
+	virtual bool deletePlayer(const std::string &name);
+	virtual void listPlayers(std::vector<std::string> &dst);
+
+private:
+	// Open and initialize the database if needed
+	void verifyDatabase();
+
+	bool m_initialized;
+
+	std::string m_savedir;
+
+	sqlite3 *m_database;
+	sqlite3_stmt *m_stmt_read;
+	sqlite3_stmt *m_stmt_write;
+	sqlite3_stmt *m_stmt_list;
+	sqlite3_stmt *m_stmt_delete;
+	sqlite3_stmt *m_stmt_begin;
+	sqlite3_stmt *m_stmt_end;
+
+	s64 m_busy_handler_data[2];
+};
+
+class ModStorageDatabaseSQLite3 : public ModStorageDatabase
+{
+public:
+	ModStorageDatabaseSQLite3(const std::string &savedir);
+	~ModStorageDatabaseSQLite3();
+
+	virtual void beginSave();
+	virtual void endSave();
+	virtual void abortSave();
+
+	virtual void getModEntries(const std::string &modname,
+			std::map<std::string, std::string> &storage);
+	virtual bool setModEntry(const std::string &modname,
+			const std::string &key, const std::string &value);
+	virtual bool removeModEntry(const std::string &modname,
+			const std::string &key);
+	virtual void listMods(std::vector<std::string> &res);
+
+private:
+	// Open and initialize the database if needed
+	void verifyDatabase();
+
+	bool m_initialized;
+
+	std::string m_savedir;
+
+	sqlite3 *m_database;
+	sqlite3_stmt *m_stmt_get;
+	sqlite3_stmt *m_stmt_set;
+	sqlite3_stmt *m_stmt_remove;
+	sqlite3_stmt *m_stmt_list;
+	sqlite3_stmt *m_stmt_begin;
+	sqlite3_stmt *m_stmt_end;
+
+	s64 m_busy_handler_data[2];
+};
+
+class AuthDatabaseSQLite3 : public AuthDatabase
+{
+public:
+	AuthDatabaseSQLite3(const std::string &savedir);
+	~AuthDatabaseSQLite3();
+
+	virtual void beginSave();
+	virtual bool endSave();
+
+	virtual bool getAuth(const std::string &name, AuthEntry &res);
+	virtual bool saveAuth(const AuthEntry &entry);
+	virtual bool deleteAuth(const std::string &name);
+	virtual void listNames(std::vector<std::string> &res);
+
+private:
+	// Open and initialize the database if needed
+	void verifyDatabase();
+
+	bool m_initialized;
+
+	std::string m_savedir;
+
+	sqlite3 *m_database;
+	sqlite3_stmt *m_stmt_read;
+	sqlite3_stmt *m_stmt_write;
+	sqlite3_stmt *m_stmt_list;
+	sqlite3_stmt *m_stmt_delete;
+	sqlite3_stmt *m_stmt_begin;
+	sqlite3_stmt *m_stmt_end;
+
+	s64 m_busy_handler_data[2];
 };
 
 #endif
@@ -19,6 +19,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "database.h"
 #include "irrlichttypes.h"
+#include "porting.h"
+#include "util/basic_macros.h"
+#include "util/string.h"
 
 
 /****************
@@ -67,3 +70,135 @@ v3s16 Database::getIntegerAsBlock(s64 i)
 	return pos;
 }
 
+
+/*
+	AuthEntry
+*/
+
+std::string AuthEntry::toLine() const
+{
+	std::string line = name + ":" + password + ":";
+	for (std::vector<std::string>::const_iterator it = privileges.begin();
+			it != privileges.end(); ++it) {
+		if (it != privileges.begin())
+			line += ",";
+		line += *it;
+	}
+	line += ":";
+	if (last_login >= 0)
+		line += to_string(last_login);
+	return line;
+}
+
+bool AuthEntry::fromLine(const std::string &line)
+{
+	std::vector<std::string> fields = str_split(line, ':');
+	if (fields.size() < 3 || fields[0].empty())
+		return false;
+
+	name = fields[0];
+	password = fields[1];
+	privileges.clear();
+	std::vector<std::string> privs = str_split(fields[2], ',');
+	for (std::vector<std::string>::iterator it = privs.begin();
+			it != privs.end(); ++it) {
+		std::string priv = trim(*it);
+		if (!priv.empty())
+			privileges.push_back(priv);
+	}
+	last_login = -1;
+	if (fields.size() >= 4 && !fields[3].empty())
+		last_login = strtoll(fields[3].c_str(), NULL, 10);
+	return true;
+}
+
+
+/*
+	AuthDatabaseCache
+*/
+
+AuthDatabaseCache::AuthDatabaseCache(AuthDatabase *backend, u32 capacity) :
+	m_backend(backend),
+	m_capacity(MYMAX(capacity, 1))
+{
+}
+
+AuthDatabaseCache::~AuthDatabaseCache()
+{
+	delete m_backend;
+}
+
+void AuthDatabaseCache::insert(const AuthEntry &entry)
+{
+	std::map<std::string, std::list<AuthEntry>::iterator>::iterator it =
+		m_entries.find(entry.name);
+	if (it != m_entries.end()) {
+		*it->second = entry;
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return;
+	}
+
+	if (m_entries.size() >= m_capacity) {
+		m_entries.erase(m_lru.back().name);
+		m_lru.pop_back();
+	}
+	m_lru.push_front(entry);
+	m_entries[entry.name] = m_lru.begin();
+}
+
+void AuthDatabaseCache::beginSave()
+{
+	m_backend->beginSave();
+}
+
+bool AuthDatabaseCache::endSave()
+{
+	return m_backend->endSave();
+}
+
+bool AuthDatabaseCache::getAuth(const std::string &name, AuthEntry &res)
+{
+	std::map<std::string, std::list<AuthEntry>::iterator>::iterator it =
+		m_entries.find(name);
+	if (it != m_entries.end()) {
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		res = *it->second;
+		return true;
+	}
+
+	if (!m_backend->getAuth(name, res))
+		return false;
+	insert(res);
+	return true;
+}
+
+bool AuthDatabaseCache::saveAuth(const AuthEntry &entry)
+{
+	if (!m_backend->saveAuth(entry))
+		return false;
+	insert(entry);
+	return true;
+}
+
+bool AuthDatabaseCache::deleteAuth(const std::string &name)
+{
+	std::map<std::string, std::list<AuthEntry>::iterator>::iterator it =
+		m_entries.find(name);
+	if (it != m_entries.end()) {
+		m_lru.erase(it->second);
+		m_entries.erase(it);
+	}
+	return m_backend->deleteAuth(name);
+}
+
+void AuthDatabaseCache::listNames(std::vector<std::string> &res)
+{
+	m_backend->listNames(res);
+}
+
+void AuthDatabaseCache::reload()
+{
+	m_lru.clear();
+	m_entries.clear();
+	m_backend->reload();
+}
@@ -22,6 +22,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <vector>
 #include <string>
+#include <list>
+#include <map>
 #include "irr_v3d.h"
 #include "irrlichttypes.h"
 
@@ -49,5 +51,119 @@ class Database
 	virtual bool initialized() const { return true; }
 };
 
+/*
+	Storage of player data by player name. The data is produced by
+	Player::serializeBinary.
+*/
+class PlayerDatabase
+{
+public:
+	virtual ~PlayerDatabase() {}
+
+	virtual void beginSave() {}
+	virtual void endSave() {}
+
+	virtual bool savePlayer(const std::string &name, const std::string &data) = 0;
+	// Returns an empty string if the player doesn't exist
+	virtual std::string loadPlayer(const std::string &name) = 0;
+	virtual bool deletePlayer(const std::string &name) = 0;
+
+	virtual void listPlayers(std::vector<std::string> &dst) = 0;
+};
+
+struct AuthEntry
+{
+	AuthEntry() : last_login(-1) {}
+
+	std::string name;
+	std::string password;
+	std::vector<std::string> privileges;
+	// Unix time of the last login, -1 if unknown
+	s64 last_login;
+
+	// auth.txt line format: <name>:<password>:<privilege1,...>:<last_login>
+	std::string toLine() const;
+	// Returns false if the line is malformed
+	bool fromLine(const std::string &line);
+};
+
+/*
+	Storage of authentication data by player name. Every save writes just
+	the record of that player.
+*/
+class AuthDatabase
+{
+public:
+	virtual ~AuthDatabase() {}
+
+	// Saves between these two calls may be written at once by endSave.
+	// endSave returns false if writing them failed.
+	virtual void beginSave() {}
+	virtual bool endSave() { return true; }
+
+	// Returns false if the player has no entry
+	virtual bool getAuth(const std::string &name, AuthEntry &res) = 0;
+	// Creates the entry if it doesn't exist yet
+	virtual bool saveAuth(const AuthEntry &entry) = 0;
+	virtual bool deleteAuth(const std::string &name) = 0;
+	virtual void listNames(std::vector<std::string> &res) = 0;
+	// Re-reads the storage, dropping anything read ahead
+	virtual void reload() {}
+};
+
+/*
+	Keeps the most recently used entries of another AuthDatabase in memory,
+	which covers the online players whose privileges are checked all the
+	time. Writes go through to the backend immediately.
+*/
+class AuthDatabaseCache : public AuthDatabase
+{
+public:
+	// Takes ownership of the backend
+	AuthDatabaseCache(AuthDatabase *backend, u32 capacity);
+	~AuthDatabaseCache();
+
+	virtual void beginSave();
+	virtual bool endSave();
+
+	virtual bool getAuth(const std::string &name, AuthEntry &res);
+	virtual bool saveAuth(const AuthEntry &entry);
+	virtual bool deleteAuth(const std::string &name);
+	virtual void listNames(std::vector<std::string> &res);
+	virtual void reload();
+
+private:
+	void insert(const AuthEntry &entry);
+
+	AuthDatabase *m_backend;
+	u32 m_capacity;
+	// Most recently used first
+	std::list<AuthEntry> m_lru;
+	std::map<std::string, std::list<AuthEntry>::iterator> m_entries;
+};
+
+/*
+	Storage of the key-value pairs that mods keep in their mod storage.
+*/
+class ModStorageDatabase
+{
+public:
+	virtual ~ModStorageDatabase() {}
+
+	virtual void beginSave() {}
+	virtual void endSave() {}
+	// Discards the changes since beginSave() after one of them failed
+	virtual void abortSave() {}
+
+	// Adds all pairs of the mod to storage
+	virtual void getModEntries(const std::string &modname,
+			std::map<std::string, std::string> &storage) = 0;
+	virtual bool setModEntry(const std::string &modname,
+			const std::string &key, const std::string &value) = 0;
+	virtual bool removeModEntry(const std::string &modname,
+			const std::string &key) = 0;
+	virtual void listMods(std::vector<std::string> &res) = 0;
+};
+
 #endif
 
@@ -177,6 +177,7 @@ void set_default_settings(Settings *settings)
 	settings->setDefault("enable_shaders", "true");
 	settings->setDefault("repeat_rightclick_time", "0.25");
 	settings->setDefault("enable_particles", "true");
+	settings->setDefault("particles_cheap_collision", "false");
 	settings->setDefault("enable_mesh_cache", "false");
 	settings->setDefault("enable_vbo", "true");
 	
@@ -234,6 +235,7 @@ void set_default_settings(Settings *settings)
 	// "map-dir" doesn't exist by default.
 	settings->setDefault("workaround_window_size","5");
 	settings->setDefault("max_packets_per_iteration","1024");
+	settings->setDefault("network_compression", "true");
 	settings->setDefault("port", "30000");
 	settings->setDefault("bind_address", "");
 	settings->setDefault("default_game", "minetest");
@@ -262,8 +264,14 @@ void set_default_settings(Settings *settings)
 	settings->setDefault("ask_reconnect_on_crash", "false");
 
 	settings->setDefault("profiler_print_interval", "0");
+	settings->setDefault("script_profiler", "false");
+	settings->setDefault("script_profiler_sample_interval", "0");
 	settings->setDefault("enable_mapgen_debug_info", "false");
 	settings->setDefault("active_object_send_range_blocks", "3");
+	settings->setDefault("object_update_near_range", "16");
+	settings->setDefault("object_update_far_range", "32");
+	settings->setDefault("object_update_medium_interval", "0.3");
+	settings->setDefault("object_update_far_interval", "1.0");
 	settings->setDefault("active_block_range", "2");
 	//settings->setDefault("max_simultaneous_block_sends_per_client", "1");
 	// This causes frametime jitter on client side, or does it?
@@ -280,11 +288,17 @@ void set_default_settings(Settings *settings)
 	settings->setDefault("sqlite_synchronous", "2");
 	settings->setDefault("full_block_send_enable_min_time_from_building", "2.0");
 	settings->setDefault("dedicated_server_step", "0.1");
+	settings->setDefault("globalstep_time_budget", "25");
 	settings->setDefault("active_block_mgmt_interval", "2.0");
 	settings->setDefault("abm_interval", "1.0");
 	settings->setDefault("nodetimer_interval", "1.0");
 	settings->setDefault("ignore_world_load_errors", "false");
+	settings->setDefault("server_async_threads", "2");
+	settings->setDefault("entity_step_batching", "false");
+	settings->setDefault("mod_storage_flush_interval", "5.0");
 	settings->setDefault("remote_media", "");
+	settings->setDefault("media_server_port", "0");
+	settings->setDefault("media_server_threads", "4");
 	settings->setDefault("debug_log_level", "action");
 	settings->setDefault("emergequeue_limit_total", "256");
 	settings->setDefault("emergequeue_limit_diskonly", "32");
@@ -45,6 +45,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "emerge.h"
 #include "util/serialize.h"
 #include "threading/mutex_auto_lock.h"
+#include "config.h"
+#include "database-dummy.h"
+#include "database-files.h"
+#include "database-sqlite3.h"
+#if USE_LEVELDB
+#include "database-leveldb.h"
+#endif
+#if USE_REDIS
+#include "database-redis.h"
+#endif
 
 #define PP(x) "("<<(x).X<<","<<(x).Y<<","<<(x).Z<<")"
 
@@ -583,6 +593,7 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	m_script(scriptIface),
 	m_gamedef(gamedef),
 	m_path_world(path_world),
+	m_object_grid_valid(false),
 	m_send_recommended_timer(0),
 	m_active_block_interval_overload_skip(0),
 	m_game_time(0),
@@ -591,6 +602,29 @@ ServerEnvironment::ServerEnvironment(ServerMap *map,
 	m_recommended_send_interval(0.1),
 	m_max_lag_estimate(0.1)
 {
+	// Determine which player database backend to use
+	std::string conf_path = path_world + DIR_DELIM + "world.mt";
+	Settings conf;
+	bool succeeded = conf.readConfigFile(conf_path.c_str());
+	if (!succeeded || !conf.exists("player_backend")) {
+		// Worlds that already have player files keep using them
+		// until they are migrated with --migrateplayers
+		std::string players_path = path_world + DIR_DELIM "players";
+		if (!fs::GetDirListing(players_path).empty()) {
+			conf.set("player_backend", "files");
+			warningstream << "World has player files, consider migrating "
+				"them to a player database with --migrateplayers sqlite3"
+				<< std::endl;
+		} else {
+			conf.set("player_backend", "sqlite3");
+		}
+	}
+	std::string backend = conf.get("player_backend");
+	m_player_database = createPlayerDatabase(backend, path_world, conf);
+
+	if (!conf.updateConfigFile(conf_path.c_str()))
+		errorstream << "ServerEnvironment::ServerEnvironment(): "
+			"Failed to update world.mt!" << std::endl;
 }
 
 ServerEnvironment::~ServerEnvironment()
@@ -605,6 +639,8 @@ ServerEnvironment::~ServerEnvironment()
 	// Drop/delete map
 	m_map->drop();
 
+	delete m_player_database;
+
 	// Delete ActiveBlockModifiers
 	for(std::vector<ABMWithState>::iterator
 			i = m_abms.begin(); i != m_abms.end(); ++i){
@@ -663,59 +699,51 @@ void ServerEnvironment::kickAllPlayers(AccessDeniedCode reason,
 
 void ServerEnvironment::saveLoadedPlayers()
 {
-	std::string players_path = m_path_world + DIR_DELIM "players";
-	fs::CreateDir(players_path);
-
+	// Saved in one transaction by backends that support it
+	m_player_database->beginSave();
 	for (std::vector<Player*>::iterator it = m_players.begin();
 			it != m_players.end();
 			++it) {
 		RemotePlayer *player = static_cast<RemotePlayer*>(*it);
-		if (player->checkModified()) {
-			player->save(players_path);
-		}
+		if (player->checkModified())
+			savePlayer(player);
 	}
+	m_player_database->endSave();
 }
 
 void ServerEnvironment::savePlayer(RemotePlayer *player)
 {
-	std::string players_path = m_path_world + DIR_DELIM "players";
-	fs::CreateDir(players_path);
-
-	player->save(players_path);
+	// Players that failed to save stay modified and are retried later
+	if (!m_player_database->savePlayer(player->getName(),
+			player->serializeBinary())) {
+		errorstream << "Failed to save player " << player->getName()
+			<< std::endl;
+		return;
+	}
+	player->setModified(false);
 }
 
 Player *ServerEnvironment::loadPlayer(const std::string &playername)
 {
-	bool newplayer = false;
-	bool found = false;
-	std::string players_path = m_path_world + DIR_DELIM "players" DIR_DELIM;
-	std::string path = players_path + playername;
+	std::string data = m_player_database->loadPlayer(playername);
+	if (data.empty()) {
+		infostream << "Player data for player " << playername
+				<< " not found" << std::endl;
+		return NULL;
+	}
 
+	bool newplayer = false;
 	RemotePlayer *player = static_cast<RemotePlayer *>(getPlayer(playername.c_str()));
 	if (!player) {
 		player = new RemotePlayer(m_gamedef, "");
 		newplayer = true;
 	}
 
-	for (u32 i = 0; i < PLAYER_FILE_ALTERNATE_TRIES; i++) {
-		//// Open file and deserialize
-		std::ifstream is(path.c_str(), std::ios_base::binary);
-		if (!is.good())
-			continue;
-		player->deSerialize(is, path);
-		is.close();
-
-		if (player->getName() == playername) {
-			found = true;
-			break;
-		}
-
-		path = players_path + playername + itos(i);
-	}
-
-	if (!found) {
-		infostream << "Player file for player " << playername
-				<< " not found" << std::endl;
+	try {
+		player->deSerializeBinary(data, playername);
+	} catch (SerializationError &e) {
+		errorstream << "Failed to load player " << playername << ": "
+				<< e.what() << std::endl;
 		if (newplayer)
 			delete player;
 		return NULL;
@@ -727,6 +755,27 @@ Player *ServerEnvironment::loadPlayer(const std::string &playername)
 	return player;
 }
 
+PlayerDatabase *ServerEnvironment::createPlayerDatabase(const std::string &name,
+		const std::string &savedir, Settings &conf)
+{
+	if (name == "sqlite3")
+		return new PlayerDatabaseSQLite3(savedir);
+	if (name == "dummy")
+		return new PlayerDatabaseDummy();
+	if (name == "files")
+		return new PlayerDatabaseFiles(savedir);
+	#if USE_LEVELDB
+	else if (name == "leveldb")
+		return new PlayerDatabaseLevelDB(savedir);
+	#endif
+	#if USE_REDIS
+	else if (name == "redis")
+		return new PlayerDatabaseRedis(conf);
+	#endif
+	else
+		throw BaseException(std::string("Player database backend ") + name + " not supported.");
+}
+
 void ServerEnvironment::saveMeta()
 {
 	std::string path = m_path_world + DIR_DELIM "env_meta.txt";
@@ -1134,6 +1183,59 @@ void ServerEnvironment::getObjectsInsideRadius(std::vector<u16> &objects, v3f po
 	}
 }
 
+// Edge length of an object grid cell, in BS units
+#define OBJECT_GRID_CELL_SIZE (MAP_BLOCKSIZE * BS)
+
+void ServerEnvironment::getCollisionObjectsInsideRadius(
+		std::vector<u16> &objects, v3f pos, float radius)
+{
+	// Objects may have moved since the grid was built; search one more
+	// cell in every direction to make up for that.
+	v3s16 cell_min = floatToInt(pos - v3f(1, 1, 1) * radius,
+			OBJECT_GRID_CELL_SIZE) - v3s16(1, 1, 1);
+	v3s16 cell_max = floatToInt(pos + v3f(1, 1, 1) * radius,
+			OBJECT_GRID_CELL_SIZE) + v3s16(1, 1, 1);
+	v3s16 cells = cell_max - cell_min + v3s16(1, 1, 1);
+
+	// Scanning all objects is cheaper if there are more cells than objects
+	if ((u32)cells.X * cells.Y * cells.Z > m_active_objects.size()) {
+		getObjectsInsideRadius(objects, pos, radius);
+		return;
+	}
+
+	if (!m_object_grid_valid) {
+		m_object_grid.clear();
+		for (std::map<u16, ServerActiveObject*>::iterator
+				i = m_active_objects.begin();
+				i != m_active_objects.end(); ++i) {
+			v3s16 cell = floatToInt(i->second->getBasePosition(),
+					OBJECT_GRID_CELL_SIZE);
+			m_object_grid[cell].push_back(i->first);
+		}
+		m_object_grid_valid = true;
+	}
+
+	for (s16 z = cell_min.Z; z <= cell_max.Z; z++)
+	for (s16 y = cell_min.Y; y <= cell_max.Y; y++)
+	for (s16 x = cell_min.X; x <= cell_max.X; x++) {
+		std::map<v3s16, std::vector<u16> >::iterator it =
+				m_object_grid.find(v3s16(x, y, z));
+		if (it == m_object_grid.end())
+			continue;
+
+		for (std::vector<u16>::iterator
+				i = it->second.begin();
+				i != it->second.end(); ++i) {
+			ServerActiveObject *obj = getActiveObject(*i);
+			if (obj == NULL)
+				continue;
+			if (obj->getBasePosition().getDistanceFrom(pos) > radius)
+				continue;
+			objects.push_back(*i);
+		}
+	}
+}
+
 void ServerEnvironment::clearObjects(ClearObjectsMode mode)
 {
 	infostream << "ServerEnvironment::clearObjects(): "
@@ -1293,6 +1395,10 @@ void ServerEnvironment::step(float dtime)
 	static const float server_step = g_settings->getFloat("dedicated_server_step");
 	m_recommended_send_interval = server_step;
 
+	// Nodes and objects may have changed since the last step
+	m_map->getCollisionBoxCache().clear();
+	m_object_grid_valid = false;
+
 	/*
 		Increment game time
 	*/
@@ -1513,6 +1619,15 @@ void ServerEnvironment::step(float dtime)
 			send_recommended = true;
 		}
 
+		// Lua entities are moved first, then on_step of all of them is
+		// called at once, then they send their updates
+		bool batch_entities = g_settings->getBool("entity_step_batching");
+		std::vector<u16> batched_ids;
+		for (std::map<std::string, std::vector<u16> >::iterator
+				i = m_entity_step_batches.begin();
+				i != m_entity_step_batches.end(); ++i)
+			i->second.clear();
+
 		for(std::map<u16, ServerActiveObject*>::iterator
 				i = m_active_objects.begin();
 				i != m_active_objects.end(); ++i)
@@ -1521,6 +1636,15 @@ void ServerEnvironment::step(float dtime)
 			// Don't step if is to be removed or stored statically
 			if(obj->m_removed || obj->m_pending_deactivation)
 				continue;
+			if (batch_entities &&
+					obj->getType() == ACTIVEOBJECT_TYPE_LUAENTITY) {
+				LuaEntitySAO *lsao = (LuaEntitySAO *)obj;
+				lsao->stepMovement(dtime);
+				if (lsao->isRegistered())
+					m_entity_step_batches[lsao->getName()].push_back(i->first);
+				batched_ids.push_back(i->first);
+				continue;
+			}
 			// Step object
 			obj->step(dtime, send_recommended);
 			// Read messages from object
@@ -1531,6 +1655,25 @@ void ServerEnvironment::step(float dtime)
 				obj->m_messages_out.pop();
 			}
 		}
+
+		if (!batched_ids.empty()) {
+			m_script->luaentity_StepBatch(m_entity_step_batches, dtime);
+
+			// on_step may have removed any object, look them up again
+			for (size_t i = 0; i < batched_ids.size(); i++) {
+				ServerActiveObject *obj = getActiveObject(batched_ids[i]);
+				if (obj == NULL || obj->getType() != ACTIVEOBJECT_TYPE_LUAENTITY ||
+						obj->m_removed || obj->m_pending_deactivation)
+					continue;
+				((LuaEntitySAO *)obj)->stepSend(send_recommended);
+				while(!obj->m_messages_out.empty())
+				{
+					m_active_object_messages.push(
+							obj->m_messages_out.front());
+					obj->m_messages_out.pop();
+				}
+			}
+		}
 	}
 
 	/*
@@ -1781,6 +1924,7 @@ u16 ServerEnvironment::addActiveObjectRaw(ServerActiveObject *object,
 			<<"added (id="<<object->getId()<<")"<<std::endl;*/
 
 	m_active_objects[object->getId()] = object;
+	m_object_grid_valid = false;
 
 	verbosestream<<"ServerEnvironment::addActiveObjectRaw(): "
 			<<"Added id="<<object->getId()<<"; there are now "
@@ -2352,6 +2496,9 @@ void ClientEnvironment::step(float dtime)
 	/* Step time of day */
 	stepTimeOfDay(dtime);
 
+	// Nodes may have changed since the last step
+	m_map->getCollisionBoxCache().clear();
+
 	// Get some settings
 	bool fly_allowed = m_gamedef->checkLocalPrivilege("fly");
 	bool free_move = fly_allowed && g_settings->getBool("free_move");
@@ -54,6 +54,8 @@ class ClientMap;
 class GameScripting;
 class Player;
 class RemotePlayer;
+class PlayerDatabase;
+class Settings;
 
 class Environment
 {
@@ -328,6 +330,9 @@ class ServerEnvironment : public Environment
 	void savePlayer(RemotePlayer *player);
 	Player *loadPlayer(const std::string &playername);
 
+	static PlayerDatabase *createPlayerDatabase(const std::string &name,
+			const std::string &savedir, Settings &conf);
+
 	/*
 		Save and load time of day and game timer
 	*/
@@ -414,6 +419,15 @@ class ServerEnvironment : public Environment
 	// Find all active objects inside a radius around a point
 	void getObjectsInsideRadius(std::vector<u16> &objects, v3f pos, float radius);
 
+	/*
+		Same as getObjectsInsideRadius, but looks the objects up in a grid
+		that is built at most once per step instead of scanning all of them.
+		Objects that moved further than a grid cell since the grid was built
+		may be missed, so this is meant for collision detection only.
+	*/
+	void getCollisionObjectsInsideRadius(std::vector<u16> &objects,
+			v3f pos, float radius);
+
 	// Clear objects, loading and going through every MapBlock
 	void clearObjects(ClearObjectsMode mode);
 
@@ -487,10 +501,17 @@ class ServerEnvironment : public Environment
 	IGameDef *m_gamedef;
 	// World path
 	const std::string m_path_world;
+	// Player storage, selected by player_backend in world.mt
+	PlayerDatabase *m_player_database;
 	// Active object list
 	std::map<u16, ServerActiveObject*> m_active_objects;
 	// Outgoing network message buffer for active objects
 	std::queue<ActiveObjectMessage> m_active_object_messages;
+	// Object ids by grid cell, see getCollisionObjectsInsideRadius
+	std::map<v3s16, std::vector<u16> > m_object_grid;
+	bool m_object_grid_valid;
+	// Lua entity ids by name to be stepped together, kept to reuse memory
+	std::map<std::string, std::vector<u16> > m_entity_step_batches;
 	// Some timers
 	float m_send_recommended_timer;
 	IntervalLimiter m_object_management_interval;
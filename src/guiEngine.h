@@ -54,6 +54,7 @@ class GUIEngine;
 class MainMenuScripting;
 class Clouds;
 struct MainMenuData;
+struct PackedValue;
 
 /******************************************************************************/
 /* declarations                                                               */
@@ -175,7 +176,7 @@ class GUIEngine {
 	}
 
 	/** pass async callback to scriptengine **/
-	unsigned int queueAsync(std::string serialized_fct,std::string serialized_params);
+	unsigned int queueAsync(const std::string &func, const PackedValue &params);
 
 private:
 
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "imagefilters.h"
 #include "util/numeric.h"
 #include <math.h>
+#include <vector>
 
 /* Fill in RGB values for transparent pixels, to correct for odd colors
  * appearing at borders when blending.  This is because many PNG optimizers
@@ -35,6 +36,14 @@ void imageCleanTransparent(video::IImage *src, u32 threshold)
 {
 	core::dimension2d<u32> dim = src->getDimension();
 
+	// Work on the pixel buffer directly if its layout is known.
+	if (src->getColorFormat() == video::ECF_A8R8G8B8) {
+		imageCleanTransparentRaw((u32 *)src->lock(), src->getPitch() / 4,
+				dim, threshold);
+		src->unlock();
+		return;
+	}
+
 	// Walk each pixel looking for fully transparent ones.
 	// Note: loop y around x for better cache locality.
 	for (u32 ctry = 0; ctry < dim.Height; ctry++)
@@ -91,6 +100,18 @@ void imageScaleNNAA(video::IImage *src, const core::rect<s32> &srcrect, video::I
 	u32 dy, dx;
 	video::SColor pxl;
 
+	// Work on the pixel buffers directly if their layout is known.
+	if (src->getColorFormat() == video::ECF_A8R8G8B8 &&
+			dest->getColorFormat() == video::ECF_A8R8G8B8) {
+		imageScaleNNAARaw((const u32 *)src->lock(), src->getPitch() / 4,
+				src->getDimension(), srcrect,
+				(u32 *)dest->lock(), dest->getPitch() / 4,
+				dest->getDimension());
+		dest->unlock();
+		src->unlock();
+		return;
+	}
+
 	// Cache rectsngle boundaries.
 	double sox = srcrect.UpperLeftCorner.X * 1.0;
 	double soy = srcrect.UpperLeftCorner.Y * 1.0;
@@ -170,3 +191,160 @@ void imageScaleNNAA(video::IImage *src, const core::rect<s32> &srcrect, video::I
 		dest->setPixel(dx, dy, pxl);
 	}
 }
+
+void imageCleanTransparentRaw(u32 *data, u32 pitch,
+		const core::dimension2d<u32> &dim, u32 threshold)
+{
+	for (u32 ctry = 0; ctry < dim.Height; ctry++) {
+		u32 *row = data + ctry * pitch;
+		for (u32 ctrx = 0; ctrx < dim.Width; ctrx++) {
+
+			// Ignore opaque pixels.
+			if ((row[ctrx] >> 24) > threshold)
+				continue;
+
+			u32 ss = 0, sr = 0, sg = 0, sb = 0;
+
+			u32 symin = (ctry < 1) ? 0 : (ctry - 1);
+			u32 symax = MYMIN(ctry + 1, dim.Height - 1);
+			u32 sxmin = (ctrx < 1) ? 0 : (ctrx - 1);
+			u32 sxmax = MYMIN(ctrx + 1, dim.Width - 1);
+			for (u32 sy = symin; sy <= symax; sy++) {
+				const u32 *srow = data + sy * pitch;
+				for (u32 sx = sxmin; sx <= sxmax; sx++) {
+					u32 d = srow[sx];
+					u32 a = d >> 24;
+					if (a <= threshold)
+						continue;
+					ss += a;
+					sr += a * ((d >> 16) & 0xff);
+					sg += a * ((d >> 8) & 0xff);
+					sb += a * (d & 0xff);
+				}
+			}
+
+			if (ss > 0) {
+				row[ctrx] = (row[ctrx] & 0xff000000) |
+					((sr / ss) << 16) | ((sg / ss) << 8) | (sb / ss);
+			}
+		}
+	}
+}
+
+void imageScaleNNAARaw(const u32 *src, u32 src_pitch,
+		const core::dimension2d<u32> &srcdim, const core::rect<s32> &srcrect,
+		u32 *dest, u32 dest_pitch, const core::dimension2d<u32> &destdim)
+{
+	if (destdim.Width == 0 || destdim.Height == 0)
+		return;
+
+	double sox = srcrect.UpperLeftCorner.X * 1.0;
+	double soy = srcrect.UpperLeftCorner.Y * 1.0;
+	double sw = srcrect.getWidth() * 1.0;
+	double sh = srcrect.getHeight() * 1.0;
+
+	// The horizontal source span only depends on the destination column,
+	// so compute it once per column instead of once per pixel.
+	std::vector<double> minsxs(destdim.Width), maxsxs(destdim.Width);
+	for (u32 dx = 0; dx < destdim.Width; dx++) {
+		double minsx = sox + (dx * sw / destdim.Width);
+		minsx = rangelim(minsx, 0, sw);
+		double maxsx = minsx + sw / destdim.Width;
+		maxsx = rangelim(maxsx, 0, sw);
+		if (minsx > maxsx)
+			SWAP(double, minsx, maxsx);
+		minsxs[dx] = minsx;
+		maxsxs[dx] = maxsx;
+	}
+
+	for (u32 dy = 0; dy < destdim.Height; dy++) {
+		double minsy = soy + (dy * sh / destdim.Height);
+		minsy = rangelim(minsy, 0, sh);
+		double maxsy = minsy + sh / destdim.Height;
+		maxsy = rangelim(maxsy, 0, sh);
+		if (minsy > maxsy)
+			SWAP(double, minsy, maxsy);
+
+		u32 *drow = dest + dy * dest_pitch;
+		for (u32 dx = 0; dx < destdim.Width; dx++) {
+			double minsx = minsxs[dx];
+			double maxsx = maxsxs[dx];
+			double area = 0, ra = 0, ga = 0, ba = 0, aa = 0;
+
+			for (double sy = floor(minsy); sy < maxsy; sy++) {
+				double ph = 1;
+				if (minsy > sy)
+					ph += sy - minsy;
+				if (maxsy < (sy + 1))
+					ph += maxsy - sy - 1;
+
+				bool row_valid = (u32)sy < srcdim.Height;
+				const u32 *srow = row_valid ? src + (u32)sy * src_pitch : NULL;
+				for (double sx = floor(minsx); sx < maxsx; sx++) {
+					double pw = 1;
+					if (minsx > sx)
+						pw += sx - minsx;
+					if (maxsx < (sx + 1))
+						pw += maxsx - sx - 1;
+					double pa = pw * ph;
+
+					u32 pxl = (row_valid && (u32)sx < srcdim.Width) ?
+						srow[(u32)sx] : 0;
+					area += pa;
+					ra += pa * ((pxl >> 16) & 0xff);
+					ga += pa * ((pxl >> 8) & 0xff);
+					ba += pa * (pxl & 0xff);
+					aa += pa * (pxl >> 24);
+				}
+			}
+
+			if (area > 0) {
+				drow[dx] = ((u32)(aa / area + 0.5) << 24) |
+					((u32)(ra / area + 0.5) << 16) |
+					((u32)(ga / area + 0.5) << 8) |
+					(u32)(ba / area + 0.5);
+			} else {
+				drow[dx] = 0;
+			}
+		}
+	}
+}
+
+void imageBlitWithAlphaRaw(const u32 *src, u32 src_pitch,
+		u32 *dst, u32 dst_pitch, const v2u32 &size, bool overlay)
+{
+	for (u32 y = 0; y < size.Y; y++) {
+		const u32 *srow = src + y * src_pitch;
+		u32 *drow = dst + y * dst_pitch;
+		for (u32 x = 0; x < size.X; x++) {
+			u32 s = srow[x];
+			u32 a = s >> 24;
+			// Fully transparent source pixels leave the destination as it
+			// is and fully opaque ones replace it; only blend the rest.
+			if (a == 0)
+				continue;
+			if (overlay && (drow[x] >> 24) != 255)
+				continue;
+			if (a == 255) {
+				drow[x] = s;
+				continue;
+			}
+			drow[x] = video::SColor(s).getInterpolated(
+					video::SColor(drow[x]), a / 255.0f).color;
+		}
+	}
+}
+
+void imageBrightenRaw(u32 *data, u32 pitch, const core::dimension2d<u32> &dim)
+{
+	// Per channel this is (255 + c) / 2 == 127 + (c >> 1) + (c & 1), which
+	// can be done for all three channels at once without carries.
+	for (u32 y = 0; y < dim.Height; y++) {
+		u32 *row = data + y * pitch;
+		for (u32 x = 0; x < dim.Width; x++) {
+			u32 c = row[x];
+			row[x] = (c & 0xff000000) + ((c >> 1) & 0x007f7f7f) +
+				0x007f7f7f + (c & 0x00010101);
+		}
+	}
+}
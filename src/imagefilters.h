@@ -43,4 +43,35 @@ void imageCleanTransparent(video::IImage *src, u32 threshold);
  */
 void imageScaleNNAA(video::IImage *src, const core::rect<s32> &srcrect, video::IImage *dest);
 
+/* Raw buffer kernels.
+ *
+ * These operate directly on 32-bit A8R8G8B8 pixel buffers instead of going
+ * through the virtual IImage::getPixel()/setPixel() interface for every pixel,
+ * which makes them considerably faster on large textures.  Pitches are given
+ * in pixels, not bytes.  The IImage based functions above and the blitting
+ * helpers in client/tile.cpp dispatch to these when the images involved are
+ * in ECF_A8R8G8B8 format; the results are identical to the per-pixel code.
+ */
+
+// See imageCleanTransparent().
+void imageCleanTransparentRaw(u32 *data, u32 pitch,
+		const core::dimension2d<u32> &dim, u32 threshold);
+
+// See imageScaleNNAA().  Source pixels outside of srcdim read as transparent
+// black, matching IImage::getPixel().
+void imageScaleNNAARaw(const u32 *src, u32 src_pitch,
+		const core::dimension2d<u32> &srcdim, const core::rect<s32> &srcrect,
+		u32 *dest, u32 dest_pitch, const core::dimension2d<u32> &destdim);
+
+/* Draw size.X * size.Y pixels of src on top of dst, using the alpha channel
+ * of the source.  If overlay is true, only destination pixels that are fully
+ * opaque are modified.  Both buffers must point to the first pixel of the
+ * respective (already clipped) region.
+ */
+void imageBlitWithAlphaRaw(const u32 *src, u32 src_pitch,
+		u32 *dst, u32 dst_pitch, const v2u32 &size, bool overlay);
+
+// Move every color channel halfway towards white, keeping alpha.
+void imageBrightenRaw(u32 *data, u32 pitch, const core::dimension2d<u32> &dim);
+
 #endif
@@ -50,6 +50,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "fontengine.h"
 #include "gameparams.h"
 #include "database.h"
+#include "environment.h"
 #include "config.h"
 #if USE_CURSES
 	#include "terminal_chat_console.h"
@@ -112,6 +113,8 @@ static bool determine_subgame(GameParams *game_params);
 
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_database(const GameParams &game_params, const Settings &cmd_args);
+static bool migrate_players_database(const GameParams &game_params, const Settings &cmd_args);
+static bool migrate_auth_database(const GameParams &game_params, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -295,6 +298,10 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Set gameid (\"--gameid list\" prints available ones)"))));
 	allowed_options->insert(std::make_pair("migrate", ValueSpec(VALUETYPE_STRING,
 			_("Migrate from current map backend to another (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("migrateplayers", ValueSpec(VALUETYPE_STRING,
+			_("Migrate from current players backend to another (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("migrateauth", ValueSpec(VALUETYPE_STRING,
+			_("Migrate from current auth backend to another, \"files\" is auth.txt (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("terminal", ValueSpec(VALUETYPE_FLAG,
 			_("Feature an interactive terminal (Only works when using minetestserver or with --server)"))));
 #ifndef SERVER
@@ -830,6 +837,12 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.exists("migrate"))
 		return migrate_database(game_params, cmd_args);
 
+	if (cmd_args.exists("migrateplayers"))
+		return migrate_players_database(game_params, cmd_args);
+
+	if (cmd_args.exists("migrateauth"))
+		return migrate_auth_database(game_params, cmd_args);
+
 	if (cmd_args.exists("terminal")) {
 #if USE_CURSES
 		bool name_ok = true;
@@ -976,3 +989,136 @@ static bool migrate_database(const GameParams &game_params, const Settings &cmd_
 	return true;
 }
 
+static bool migrate_players_database(const GameParams &game_params, const Settings &cmd_args)
+{
+	std::string migrate_to = cmd_args.get("migrateplayers");
+	Settings world_mt;
+	std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.mt!" << std::endl;
+		return false;
+	}
+	// Worlds without the key predate the player database
+	std::string backend = "files";
+	if (world_mt.exists("player_backend"))
+		backend = world_mt.get("player_backend");
+	if (backend == migrate_to) {
+		errorstream << "Cannot migrate: new backend is same"
+			<< " as the old one" << std::endl;
+		return false;
+	}
+	PlayerDatabase *old_db = ServerEnvironment::createPlayerDatabase(backend,
+			game_params.world_path, world_mt),
+		*new_db = ServerEnvironment::createPlayerDatabase(migrate_to,
+			game_params.world_path, world_mt);
+
+	u32 count = 0, failed = 0;
+	bool &kill = *porting::signal_handler_killstatus();
+
+	std::vector<std::string> players;
+	old_db->listPlayers(players);
+	new_db->beginSave();
+	for (std::vector<std::string>::const_iterator it = players.begin();
+			it != players.end(); ++it) {
+		if (kill) return false;
+
+		const std::string &data = old_db->loadPlayer(*it);
+		if (data.empty()) {
+			errorstream << "Failed to load player " << *it
+				<< ", skipping it." << std::endl;
+		} else if (!new_db->savePlayer(*it, data)) {
+			errorstream << "Failed to save player " << *it << std::endl;
+			failed++;
+		}
+		if (++count % 0xFF == 0) {
+			new_db->endSave();
+			new_db->beginSave();
+		}
+	}
+	new_db->endSave();
+	delete old_db;
+	delete new_db;
+
+	if (failed > 0) {
+		errorstream << "Failed to migrate " << failed << " players."
+			<< " world.mt was not changed." << std::endl;
+		return false;
+	}
+
+	actionstream << "Successfully migrated " << count << " players" << std::endl;
+	world_mt.set("player_backend", migrate_to);
+	if (!world_mt.updateConfigFile(world_mt_path.c_str()))
+		errorstream << "Failed to update world.mt!" << std::endl;
+	else
+		actionstream << "world.mt updated" << std::endl;
+
+	return true;
+}
+
+static bool migrate_auth_database(const GameParams &game_params, const Settings &cmd_args)
+{
+	std::string migrate_to = cmd_args.get("migrateauth");
+	Settings world_mt;
+	std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.mt!" << std::endl;
+		return false;
+	}
+	// Worlds without the key predate the auth database
+	std::string backend = "files";
+	if (world_mt.exists("auth_backend"))
+		backend = world_mt.get("auth_backend");
+	if (backend == migrate_to) {
+		errorstream << "Cannot migrate: new backend is same"
+			<< " as the old one" << std::endl;
+		return false;
+	}
+	AuthDatabase *old_db = Server::createAuthDatabase(backend,
+			game_params.world_path),
+		*new_db = Server::createAuthDatabase(migrate_to,
+			game_params.world_path);
+
+	u32 count = 0, failed = 0;
+	bool &kill = *porting::signal_handler_killstatus();
+
+	std::vector<std::string> names;
+	old_db->listNames(names);
+	new_db->beginSave();
+	for (std::vector<std::string>::const_iterator it = names.begin();
+			it != names.end(); ++it) {
+		if (kill) return false;
+
+		AuthEntry entry;
+		if (!old_db->getAuth(*it, entry)) {
+			errorstream << "Failed to load auth of " << *it
+				<< ", skipping it." << std::endl;
+		} else if (!new_db->saveAuth(entry)) {
+			errorstream << "Failed to save auth of " << *it << std::endl;
+			failed++;
+		}
+		if (++count % 0xFF == 0) {
+			if (!new_db->endSave())
+				failed++;
+			new_db->beginSave();
+		}
+	}
+	if (!new_db->endSave())
+		failed++;
+	delete old_db;
+	delete new_db;
+
+	if (failed > 0) {
+		errorstream << "Failed to migrate auth entries, " << failed
+			<< " errors. world.mt was not changed." << std::endl;
+		return false;
+	}
+
+	actionstream << "Successfully migrated " << count << " auth entries" << std::endl;
+	world_mt.set("auth_backend", migrate_to);
+	if (!world_mt.updateConfigFile(world_mt_path.c_str()))
+		errorstream << "Failed to update world.mt!" << std::endl;
+	else
+		actionstream << "world.mt updated" << std::endl;
+
+	return true;
+}
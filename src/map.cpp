@@ -93,6 +93,10 @@ void Map::removeEventReceiver(MapEventReceiver *event_receiver)
 
 void Map::dispatchEvent(MapEditEvent *event)
 {
+	// Blocks were changed without going through setNode()
+	if (event->type == MEET_OTHER)
+		m_collision_box_cache.clear();
+
 	for(std::set<MapEventReceiver*>::iterator
 			i = m_event_receivers.begin();
 			i != m_event_receivers.end(); ++i)
@@ -193,6 +197,84 @@ MapNode Map::getNodeNoEx(v3s16 p, bool *is_valid_position)
 	return node;
 }
 
+// Returns the node data of a block for findNodesInArea, NULL if not available
+static const MapNode *get_query_block_data(Map *map, v3s16 blockpos,
+		bool load_blocks)
+{
+	MapBlock *block = load_blocks ?
+		map->emergeBlock(blockpos, false) :
+		map->getBlockNoCreateNoEx(blockpos);
+	return block ? block->getDataNoCheck() : NULL;
+}
+
+void Map::findNodesInArea(v3s16 minp, v3s16 maxp, const ContentIdSet &filter,
+		std::vector<v3s16> &result, std::vector<u32> *counts,
+		bool under_air, u32 limit, bool load_blocks)
+{
+	if (minp.X > maxp.X || minp.Y > maxp.Y || minp.Z > maxp.Z)
+		return;
+
+	const s16 bs = MAP_BLOCKSIZE;
+	const bool find_ignore = filter.contains(CONTENT_IGNORE);
+	v3s16 bpmin = getNodeBlockPos(minp);
+	v3s16 bpmax = getNodeBlockPos(maxp);
+	u32 found = 0;
+
+	for (s32 bz = bpmin.Z; bz <= bpmax.Z; bz++)
+	for (s32 by = bpmin.Y; by <= bpmax.Y; by++)
+	for (s32 bx = bpmin.X; bx <= bpmax.X; bx++) {
+		v3s16 blockpos(bx, by, bz);
+		v3s16 base = blockpos * bs;
+
+		const MapNode *data = get_query_block_data(this, blockpos, load_blocks);
+		// A missing block reads as "ignore" everywhere
+		if (data == NULL && !find_ignore)
+			continue;
+
+		// The part of the area inside this block, relative to it
+		v3s16 rmin(MYMAX(minp.X - base.X, 0), MYMAX(minp.Y - base.Y, 0),
+			MYMAX(minp.Z - base.Z, 0));
+		v3s16 rmax(MYMIN(maxp.X - base.X, bs - 1),
+			MYMIN(maxp.Y - base.Y, bs - 1), MYMIN(maxp.Z - base.Z, bs - 1));
+
+		// The nodes above the top layer are in the block above
+		const MapNode *data_above = NULL;
+		if (under_air && rmax.Y == bs - 1)
+			data_above = get_query_block_data(this,
+				blockpos + v3s16(0, 1, 0), load_blocks);
+
+		for (s16 z = rmin.Z; z <= rmax.Z; z++)
+		for (s16 y = rmin.Y; y <= rmax.Y; y++) {
+			u32 i = z * bs * bs + y * bs + rmin.X;
+			for (s16 x = rmin.X; x <= rmax.X; x++, i++) {
+				content_t c = data ? data[i].getContent() : CONTENT_IGNORE;
+				if (!filter.contains(c))
+					continue;
+
+				if (under_air) {
+					if (c == CONTENT_AIR)
+						continue;
+					content_t c_above = CONTENT_IGNORE;
+					if (y < bs - 1) {
+						if (data)
+							c_above = data[i + bs].getContent();
+					} else if (data_above) {
+						c_above = data_above[i - (bs - 1) * bs].getContent();
+					}
+					if (c_above != CONTENT_AIR)
+						continue;
+				}
+
+				result.push_back(base + v3s16(x, y, z));
+				if (counts)
+					(*counts)[c]++;
+				if (++found == limit)
+					return;
+			}
+		}
+	}
+}
+
 #if 0
 // Deprecated
 // throws InvalidPositionException if not found
@@ -229,6 +311,7 @@ void Map::setNode(v3s16 p, MapNode & n)
 		return;
 	}
 	block->setNodeNoCheck(relpos, n);
+	m_collision_box_cache.invalidate(p);
 }
 
 
@@ -1543,6 +1626,7 @@ void Map::timerUpdate(float dtime, float unload_timeout, u32 max_loaded_blocks,
 
 	if(deleted_blocks_count != 0)
 	{
+		m_collision_box_cache.clear();
 		PrintInfo(infostream); // ServerMap/ClientMap:
 		infostream<<"Unloaded "<<deleted_blocks_count
 				<<" blocks from memory";
@@ -1575,6 +1659,9 @@ void Map::deleteSectors(std::vector<v2s16> &sectorList)
 		m_sectors.erase(*j);
 		delete sector;
 	}
+
+	if (!sectorList.empty())
+		m_collision_box_cache.clear();
 }
 
 void Map::PrintInfo(std::ostream &out)
@@ -2051,6 +2138,7 @@ bool Map::setNodeMetadata(v3s16 p, NodeMetadata *meta)
 		return false;
 	}
 	block->m_node_metadata.set(p_rel, meta);
+	block->logMetadataChange();
 	return true;
 }
 
@@ -2066,6 +2154,7 @@ void Map::removeNodeMetadata(v3s16 p)
 		return;
 	}
 	block->m_node_metadata.remove(p_rel);
+	block->logMetadataChange();
 }
 
 NodeTimer Map::getNodeTimer(v3s16 p)
@@ -33,6 +33,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "modifiedstate.h"
 #include "util/container.h"
 #include "nodetimer.h"
+#include "collision.h"
 
 class Settings;
 class Database;
@@ -130,6 +131,39 @@ struct MapEditEvent
 	}
 };
 
+/*
+	Set of content ids, stored as a bitmap for quick lookups
+	when filtering large amounts of nodes.
+*/
+class ContentIdSet
+{
+public:
+	void insert(content_t c)
+	{
+		if (c >= m_bits.size())
+			m_bits.resize(c + 1, false);
+		if (!m_bits[c]) {
+			m_bits[c] = true;
+			m_ids.push_back(c);
+		}
+	}
+
+	bool contains(content_t c) const
+		{ return c < m_bits.size() && m_bits[c]; }
+
+	// The ids in the set, in insertion order
+	const std::vector<content_t> &getIds() const
+		{ return m_ids; }
+
+	// One past the highest id in the set
+	size_t getEnd() const
+		{ return m_bits.size(); }
+
+private:
+	std::vector<bool> m_bits;
+	std::vector<content_t> m_ids;
+};
+
 class MapEventReceiver
 {
 public:
@@ -206,6 +240,22 @@ class Map /*: public NodeContainer*/
 	// position is valid, otherwise false
 	MapNode getNodeNoEx(v3s16 p, bool *is_valid_position = NULL);
 
+	/*
+		Finds the nodes in minp..maxp whose content is in filter and
+		appends their positions to result. The area is walked one block
+		at a time, in the order the nodes are stored in.
+
+		- under_air: only find nodes with an air node right above them
+		- limit: stop after this many positions, 0 for no limit
+		- load_blocks: load blocks that are not in memory with
+		  emergeBlock() instead of treating them as "ignore"
+		- counts: if not NULL, counts[c] is incremented for each found
+		  node of content c; it must have at least filter.getEnd() items
+	*/
+	void findNodesInArea(v3s16 minp, v3s16 maxp, const ContentIdSet &filter,
+			std::vector<v3s16> &result, std::vector<u32> *counts = NULL,
+			bool under_air = false, u32 limit = 0, bool load_blocks = false);
+
 	void unspreadLight(enum LightBank bank,
 			std::map<v3s16, u8> & from_nodes,
 			std::set<v3s16> & light_sources,
@@ -335,6 +385,9 @@ class Map /*: public NodeContainer*/
 	*/
 	std::map<v2s16, MapSector*> *getSectorsPtr(){return &m_sectors;}
 
+	// Cleared by the environment on every step
+	CollisionBoxCache &getCollisionBoxCache() { return m_collision_box_cache; }
+
 	/*
 		Variables
 	*/
@@ -360,6 +413,8 @@ class Map /*: public NodeContainer*/
 	// Queued transforming water nodes
 	UniqueQueue<v3s16> m_transforming_liquid;
 
+	CollisionBoxCache m_collision_box_cache;
+
 private:
 	f32 m_transforming_liquid_loop_count_multiplier;
 	u32 m_unprocessed_count;
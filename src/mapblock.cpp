@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapblock.h"
 
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 #include "map.h"
 #include "light.h"
 #include "nodedef.h"
@@ -35,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 #include "util/string.h"
 #include "util/serialize.h"
+#include "threading/atomic.h"
 
 #define PP(x) "("<<(x).X<<","<<(x).Y<<","<<(x).Z<<")"
 
@@ -81,11 +84,17 @@ MapBlock::MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef, bool dummy):
 		m_timestamp(BLOCK_TIMESTAMP_UNDEFINED),
 		m_disk_timestamp(BLOCK_TIMESTAMP_UNDEFINED),
 		m_usage_timer(0),
-		m_refcount(0)
+		m_refcount(0),
+		m_change_log_enabled(false),
+		m_incarnation(0),
+		m_version(0),
+		m_change_log_base(0)
 {
 	data = NULL;
 	if(dummy == false)
 		reallocate();
+	else
+		resetChangeLog();
 
 #ifndef SERVER
 	mesh = NULL;
@@ -295,7 +304,11 @@ bool MapBlock::propagateSunlight(std::set<v3s16> & light_sources,
 
 				if(current_light > old_light || remove_light)
 				{
+					u8 old_param1 = n.param1;
 					n.setLight(LIGHTBANK_DAY, current_light, nodemgr);
+					// getNodeRef() bypasses setNode(), which logs changes
+					if (m_change_log_enabled && n.param1 != old_param1)
+						logChange(z * zstride + y * ystride + x);
 				}
 
 				if(diminish_light(current_light) != 0)
@@ -367,9 +380,73 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
-	// Copy from VoxelManipulator to data
+	if (!m_change_log_enabled || data == NULL) {
+		// Copy from VoxelManipulator to data
+		dst.copyTo(data, data_area, v3s16(0,0,0),
+				getPosRelative(), data_size);
+		return;
+	}
+
+	// Keep the old data around to find out which nodes changed
+	std::vector<MapNode> old_data(data, data + nodecount);
+
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+
+	for (u32 i = 0; i < nodecount; i++) {
+		if (!(data[i] == old_data[i]))
+			logChange(i);
+	}
+}
+
+void MapBlock::enableChangeLog()
+{
+	m_change_log_enabled = true;
+}
+
+bool MapBlock::getChangesSince(u32 version, std::vector<u16> &indices,
+		bool &metadata_changed)
+{
+	indices.clear();
+	metadata_changed = false;
+
+	if (!m_change_log_enabled || version > m_version ||
+			version < m_change_log_base)
+		return false;
+
+	for (u32 i = version - m_change_log_base; i < m_change_log.size(); i++) {
+		if (m_change_log[i] == CHANGE_LOG_METADATA)
+			metadata_changed = true;
+		else
+			indices.push_back(m_change_log[i]);
+	}
+
+	std::sort(indices.begin(), indices.end());
+	indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+	return true;
+}
+
+void MapBlock::logChange(u16 index)
+{
+	if (m_change_log.size() >= CHANGE_LOG_MAX_LENGTH) {
+		u32 dropped = CHANGE_LOG_MAX_LENGTH / 2;
+		m_change_log.erase(m_change_log.begin(),
+				m_change_log.begin() + dropped);
+		m_change_log_base += dropped;
+	}
+	m_change_log.push_back(index);
+	m_version++;
+}
+
+void MapBlock::resetChangeLog()
+{
+	static Atomic<u32> next_incarnation(1);
+
+	m_change_log_enabled = false;
+	m_incarnation = next_incarnation++;
+	m_version = 0;
+	m_change_log_base = 0;
+	m_change_log.clear();
 }
 
 void MapBlock::actuallyUpdateDayNightDiff()
@@ -664,6 +741,9 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 
 	m_day_night_differs_expired = false;
 
+	// Nobody has this version of the block yet
+	resetChangeLog();
+
 	if(version <= 21)
 	{
 		deSerialize_pre22(is, version, disk);
@@ -775,6 +855,76 @@ void MapBlock::deSerializeNetworkSpecific(std::istream &is)
 	}
 }
 
+void MapBlock::serializeDelta(std::ostream &os, const std::vector<u16> &indices,
+		bool include_metadata)
+{
+	if(data == NULL)
+	{
+		throw SerializationError("ERROR: Not writing dummy block.");
+	}
+
+	std::ostringstream oss(std::ios_base::binary);
+
+	u8 flags = 0;
+	if(is_underground)
+		flags |= 0x01;
+	if(getDayNightDiff())
+		flags |= 0x02;
+	if(m_lighting_expired)
+		flags |= 0x04;
+	if(m_generated == false)
+		flags |= 0x08;
+	writeU8(oss, flags);
+
+	writeU16(oss, indices.size());
+	for (std::vector<u16>::const_iterator it = indices.begin();
+			it != indices.end(); ++it) {
+		const MapNode &n = data[*it];
+		writeU16(oss, *it);
+		writeU16(oss, n.param0);
+		writeU8(oss, n.param1);
+		writeU8(oss, n.param2);
+	}
+
+	writeU8(oss, include_metadata ? 1 : 0);
+	if (include_metadata)
+		m_node_metadata.serialize(oss);
+
+	compressZlib(oss.str(), os);
+}
+
+void MapBlock::deSerializeDelta(std::istream &is)
+{
+	if(data == NULL)
+		throw SerializationError("MapBlock::deSerializeDelta(): dummy block");
+
+	std::ostringstream oss(std::ios_base::binary);
+	decompressZlib(is, oss);
+	std::istringstream iss(oss.str(), std::ios_base::binary);
+
+	u8 flags = readU8(iss);
+	is_underground = (flags & 0x01) ? true : false;
+	m_day_night_differs = (flags & 0x02) ? true : false;
+	m_day_night_differs_expired = false;
+	m_lighting_expired = (flags & 0x04) ? true : false;
+	m_generated = (flags & 0x08) ? false : true;
+
+	u16 count = readU16(iss);
+	for (u16 i = 0; i < count; i++) {
+		u16 index = readU16(iss);
+		if (index >= nodecount)
+			throw SerializationError("MapBlock::deSerializeDelta(): "
+					"invalid node index");
+		MapNode &n = data[index];
+		n.param0 = readU16(iss);
+		n.param1 = readU8(iss);
+		n.param2 = readU8(iss);
+	}
+
+	if (readU8(iss))
+		m_node_metadata.deSerialize(iss, m_gamedef->idef());
+}
+
 /*
 	Legacy serialization
 */
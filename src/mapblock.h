@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define MAPBLOCK_HEADER
 
 #include <set>
+#include <vector>
 #include "debug.h"
 #include "irr_v3d.h"
 #include "mapnode.h"
@@ -150,6 +151,7 @@ class MapBlock /*: public NodeContainer*/
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = MapNode(CONTENT_IGNORE);
 
+		resetChangeLog();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
@@ -314,7 +316,10 @@ class MapBlock /*: public NodeContainer*/
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
-		data[z * zstride + y * ystride + x] = n;
+		u32 i = z * zstride + y * ystride + x;
+		if (m_change_log_enabled && !(data[i] == n))
+			logChange(i);
+		data[i] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -327,6 +332,12 @@ class MapBlock /*: public NodeContainer*/
 	//// Non-checking variants of the above
 	////
 
+	// The node data in z, y, x order, or NULL for a dummy block
+	inline const MapNode *getDataNoCheck() const
+	{
+		return data;
+	}
+
 	inline MapNode getNodeNoCheck(s16 x, s16 y, s16 z, bool *valid_position)
 	{
 		*valid_position = data != NULL;
@@ -346,7 +357,10 @@ class MapBlock /*: public NodeContainer*/
 		if (data == NULL)
 			throw InvalidPositionException();
 
-		data[z * zstride + y * ystride + x] = n;
+		u32 i = z * zstride + y * ystride + x;
+		if (m_change_log_enabled && !(data[i] == n))
+			logChange(i);
+		data[i] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE_NO_CHECK);
 	}
 
@@ -474,6 +488,41 @@ class MapBlock /*: public NodeContainer*/
 		return m_refcount;
 	}
 
+	////
+	//// Change log (see m_change_log)
+	////
+
+	// Starts logging node changes; does nothing if already logging
+	void enableChangeLog();
+
+	// Set when the block is created or loaded; never reused by another block
+	inline u32 getIncarnation()
+	{
+		return m_incarnation;
+	}
+
+	// Incremented for every logged change
+	inline u32 getVersion()
+	{
+		return m_version;
+	}
+
+	/*
+		Puts the indices of the nodes changed after version into indices,
+		sorted and without duplicates. metadata_changed is set if the node
+		metadata was changed.
+		Returns false if the log does not reach back to version.
+	*/
+	bool getChangesSince(u32 version, std::vector<u16> &indices,
+			bool &metadata_changed);
+
+	// Call after modifying m_node_metadata
+	inline void logMetadataChange()
+	{
+		if (m_change_log_enabled)
+			logChange(CHANGE_LOG_METADATA);
+	}
+
 	////
 	//// Node Timers
 	////
@@ -513,6 +562,13 @@ class MapBlock /*: public NodeContainer*/
 	void serializeNetworkSpecific(std::ostream &os, u16 net_proto_version);
 	void deSerializeNetworkSpecific(std::istream &is);
 
+	// Over-the-network format only: writes the flags and the nodes at
+	// indices, and the node metadata if include_metadata is set.
+	// deSerializeDelta() applies this on top of an older copy.
+	void serializeDelta(std::ostream &os, const std::vector<u16> &indices,
+			bool include_metadata);
+	void deSerializeDelta(std::istream &is);
+
 private:
 	/*
 		Private methods
@@ -520,6 +576,10 @@ class MapBlock /*: public NodeContainer*/
 
 	void deSerialize_pre22(std::istream &is, u8 version, bool disk);
 
+	void logChange(u16 index);
+	// Forgets the log and gives the block a new incarnation
+	void resetChangeLog();
+
 	/*
 		Used only internally, because changes can't be tracked
 	*/
@@ -555,6 +615,11 @@ class MapBlock /*: public NodeContainer*/
 
 	static const u32 nodecount = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
 
+	// Logged in place of a node index when the node metadata changes
+	static const u16 CHANGE_LOG_METADATA = 0xffff;
+	// The oldest half of the log is dropped when it reaches this length
+	static const u32 CHANGE_LOG_MAX_LENGTH = 1024;
+
 private:
 	/*
 		Private member variables
@@ -633,6 +698,19 @@ class MapBlock /*: public NodeContainer*/
 		the list of blocks to be drawn.
 	*/
 	int m_refcount;
+
+	/*
+		Indices of changed nodes, oldest first. The block is at version
+		m_change_log_base + i + 1 after the change at m_change_log[i].
+		Only kept once enableChangeLog() has been called, which the
+		server does when the block is first sent to a client; clients
+		holding an older version can then be sent just the changes.
+	*/
+	bool m_change_log_enabled;
+	u32 m_incarnation;
+	u32 m_version;
+	u32 m_change_log_base;
+	std::vector<u16> m_change_log;
 };
 
 typedef std::vector<MapBlock*> MapBlockVect;
@@ -41,6 +41,12 @@ MinimapUpdateThread::~MinimapUpdateThread()
 		delete it->second;
 	}
 
+	for (std::map<v2s16, MinimapColumn *>::iterator
+			it = m_columns_cache.begin();
+			it != m_columns_cache.end(); ++it) {
+		delete it->second;
+	}
+
 	for (std::deque<QueuedMinimapUpdate>::iterator
 			it = m_update_queue.begin();
 			it != m_update_queue.end(); ++it) {
@@ -100,6 +106,14 @@ void MinimapUpdateThread::doUpdate()
 	QueuedMinimapUpdate update;
 
 	while (popBlockUpdate(&update)) {
+		// The composed column containing this block is out of date now
+		std::map<v2s16, MinimapColumn *>::iterator cit =
+			m_columns_cache.find(v2s16(update.pos.X, update.pos.Z));
+		if (cit != m_columns_cache.end()) {
+			delete cit->second;
+			m_columns_cache.erase(cit);
+		}
+
 		if (update.data) {
 			// Swap two values in the map using single lookup
 			std::pair<std::map<v3s16, MinimapMapblock*>::iterator, bool>
@@ -124,84 +138,117 @@ void MinimapUpdateThread::doUpdate()
 	}
 }
 
-MinimapPixel *MinimapUpdateThread::getMinimapPixel(v3s16 pos,
-	s16 scan_height, s16 *pixel_height)
+MinimapColumn *MinimapUpdateThread::getColumn(v2s16 pos,
+	s16 ymin, s16 ymax, s16 scan_height)
 {
-	s16 height = scan_height - MAP_BLOCKSIZE;
-	v3s16 blockpos_max, blockpos_min, relpos;
-
-	getNodeBlockPosWithOffset(
-		v3s16(pos.X, pos.Y - scan_height / 2, pos.Z),
-		blockpos_min, relpos);
-	getNodeBlockPosWithOffset(
-		v3s16(pos.X, pos.Y + scan_height / 2, pos.Z),
-		blockpos_max, relpos);
-
-	for (s16 i = blockpos_max.Y; i > blockpos_min.Y - 1; i--) {
-		std::map<v3s16, MinimapMapblock *>::iterator it =
-			m_blocks_cache.find(v3s16(blockpos_max.X, i, blockpos_max.Z));
-		if (it != m_blocks_cache.end()) {
-			MinimapMapblock *mmblock = it->second;
-			MinimapPixel *pixel = &mmblock->data[relpos.Z * MAP_BLOCKSIZE + relpos.X];
-			if (pixel->id != CONTENT_AIR) {
-				*pixel_height = height + pixel->height;
-				return pixel;
-			}
-		}
-
-		height -= MAP_BLOCKSIZE;
+	MinimapColumn *column;
+	std::map<v2s16, MinimapColumn *>::iterator it = m_columns_cache.find(pos);
+	if (it != m_columns_cache.end()) {
+		column = it->second;
+		if (column->ymin == ymin && column->ymax == ymax &&
+				column->scan_height == scan_height)
+			return column;
+	} else {
+		column = new MinimapColumn;
+		m_columns_cache[pos] = column;
 	}
 
-	return NULL;
+	column->ymin = ymin;
+	column->ymax = ymax;
+	column->scan_height = scan_height;
+	composeColumn(column, pos);
+
+	return column;
 }
 
-s16 MinimapUpdateThread::getAirCount(v3s16 pos, s16 height)
+void MinimapUpdateThread::composeColumn(MinimapColumn *column, v2s16 pos)
 {
-	s16 air_count = 0;
-	v3s16 blockpos_max, blockpos_min, relpos;
-
-	getNodeBlockPosWithOffset(
-		v3s16(pos.X, pos.Y - height / 2, pos.Z),
-		blockpos_min, relpos);
-	getNodeBlockPosWithOffset(
-		v3s16(pos.X, pos.Y + height / 2, pos.Z),
-		blockpos_max, relpos);
+	for (u16 i = 0; i < MAP_BLOCKSIZE * MAP_BLOCKSIZE; i++) {
+		MinimapPixel *pixel = &column->data[i];
+		pixel->id = CONTENT_AIR;
+		pixel->height = 0;
+		pixel->air_count = 0;
+		pixel->light = 0;
+	}
 
-	for (s16 i = blockpos_max.Y; i > blockpos_min.Y - 1; i--) {
+	// Walk the blocks from top to bottom; the first non-air node found in
+	// each node column is its surface.
+	s16 height = column->scan_height - MAP_BLOCKSIZE;
+	for (s16 y = column->ymax; y >= column->ymin; y--) {
 		std::map<v3s16, MinimapMapblock *>::iterator it =
-			m_blocks_cache.find(v3s16(blockpos_max.X, i, blockpos_max.Z));
+			m_blocks_cache.find(v3s16(pos.X, y, pos.Y));
 		if (it != m_blocks_cache.end()) {
 			MinimapMapblock *mmblock = it->second;
-			MinimapPixel *pixel = &mmblock->data[relpos.Z * MAP_BLOCKSIZE + relpos.X];
-			air_count += pixel->air_count;
+			for (u16 i = 0; i < MAP_BLOCKSIZE * MAP_BLOCKSIZE; i++) {
+				MinimapPixel *block_pixel = &mmblock->data[i];
+				MinimapPixel *pixel = &column->data[i];
+				pixel->air_count += block_pixel->air_count;
+				if (pixel->id == CONTENT_AIR && block_pixel->id != CONTENT_AIR) {
+					pixel->id = block_pixel->id;
+					pixel->height = height + block_pixel->height;
+				}
+			}
 		}
-	}
 
-	return air_count;
+		height -= MAP_BLOCKSIZE;
+	}
 }
 
 void MinimapUpdateThread::getMap(v3s16 pos, s16 size, s16 height, bool is_radar)
 {
 	v3s16 p = v3s16(pos.X - size / 2, pos.Y, pos.Z - size / 2);
 
-	for (s16 x = 0; x < size; x++)
-	for (s16 z = 0; z < size; z++) {
-		u16 id = CONTENT_AIR;
-		MinimapPixel *mmpixel = &data->minimap_scan[x + z * size];
-
-		if (!is_radar) {
-			s16 pixel_height = 0;
-			MinimapPixel *cached_pixel =
-				getMinimapPixel(v3s16(p.X + x, p.Y, p.Z + z), height, &pixel_height);
-			if (cached_pixel) {
-				id = cached_pixel->id;
-				mmpixel->height = pixel_height;
+	s16 ymin = getNodeBlockY(pos.Y - height / 2);
+	s16 ymax = getNodeBlockY(pos.Y + height / 2);
+
+	// Copy the area out of the composed columns, one block column at a time
+	v2s16 colpos_min = getNodeSectorPos(v2s16(p.X, p.Z));
+	v2s16 colpos_max = getNodeSectorPos(v2s16(p.X + size - 1, p.Z + size - 1));
+
+	for (s16 cz = colpos_min.Y; cz <= colpos_max.Y; cz++)
+	for (s16 cx = colpos_min.X; cx <= colpos_max.X; cx++) {
+		MinimapColumn *column = getColumn(v2s16(cx, cz), ymin, ymax, height);
+
+		s16 x0 = MYMAX(cx * MAP_BLOCKSIZE, p.X);
+		s16 x1 = MYMIN(cx * MAP_BLOCKSIZE + MAP_BLOCKSIZE, p.X + size);
+		s16 z0 = MYMAX(cz * MAP_BLOCKSIZE, p.Z);
+		s16 z1 = MYMIN(cz * MAP_BLOCKSIZE + MAP_BLOCKSIZE, p.Z + size);
+
+		for (s16 z = z0; z < z1; z++)
+		for (s16 x = x0; x < x1; x++) {
+			MinimapPixel *mmpixel =
+				&data->minimap_scan[(x - p.X) + (z - p.Z) * size];
+			MinimapPixel *cpixel = &column->data[
+				(z - cz * MAP_BLOCKSIZE) * MAP_BLOCKSIZE +
+				(x - cx * MAP_BLOCKSIZE)];
+
+			if (!is_radar) {
+				mmpixel->id = cpixel->id;
+				mmpixel->height = cpixel->height;
+			} else {
+				mmpixel->id = CONTENT_AIR;
+				mmpixel->air_count = cpixel->air_count;
 			}
-		} else {
-			mmpixel->air_count = getAirCount(v3s16(p.X + x, p.Y, p.Z + z), height);
 		}
+	}
 
-		mmpixel->id = id;
+	// Drop composed columns that are far outside of the minimap area, so the
+	// cache doesn't grow forever while travelling
+	s32 area_columns = (colpos_max.X - colpos_min.X + 1) *
+		(colpos_max.Y - colpos_min.Y + 1);
+	if ((s32)m_columns_cache.size() > area_columns * 4) {
+		for (std::map<v2s16, MinimapColumn *>::iterator
+				it = m_columns_cache.begin();
+				it != m_columns_cache.end();) {
+			const v2s16 &cp = it->first;
+			if (cp.X < colpos_min.X || cp.X > colpos_max.X ||
+					cp.Y < colpos_min.Y || cp.Y > colpos_max.Y) {
+				delete it->second;
+				m_columns_cache.erase(it++);
+			} else {
+				++it;
+			}
+		}
 	}
 }
 
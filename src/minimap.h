@@ -64,6 +64,20 @@ struct MinimapMapblock {
 	MinimapPixel data[MAP_BLOCKSIZE * MAP_BLOCKSIZE];
 };
 
+/*
+	The surface and air count of a whole column of blocks, composed from the
+	MinimapMapblocks between ymin and ymax. These are cached per block column
+	so that a minimap refresh only has to recompose the columns whose blocks
+	have changed.
+*/
+struct MinimapColumn {
+	s16 ymin;
+	s16 ymax;
+	s16 scan_height;
+
+	MinimapPixel data[MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+};
+
 struct MinimapData {
 	bool is_radar;
 	MinimapMode mode;
@@ -97,8 +111,8 @@ class MinimapUpdateThread : public UpdateThread {
 	virtual ~MinimapUpdateThread();
 
 	void getMap(v3s16 pos, s16 size, s16 height, bool radar);
-	MinimapPixel *getMinimapPixel(v3s16 pos, s16 height, s16 *pixel_height);
-	s16 getAirCount(v3s16 pos, s16 height);
+	MinimapColumn *getColumn(v2s16 pos, s16 ymin, s16 ymax, s16 height);
+	void composeColumn(MinimapColumn *column, v2s16 pos);
 	video::SColor getColorFromId(u16 id);
 
 	void enqueueBlock(v3s16 pos, MinimapMapblock *data);
@@ -115,6 +129,7 @@ class MinimapUpdateThread : public UpdateThread {
 	Mutex m_queue_mutex;
 	std::deque<QueuedMinimapUpdate> m_update_queue;
 	std::map<v3s16, MinimapMapblock *> m_blocks_cache;
+	std::map<v2s16, MinimapColumn *> m_columns_cache;
 };
 
 class Mapper {
@@ -0,0 +1,176 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "mod_storage.h"
+#include "database.h"
+#include "exceptions.h"
+#include "log.h"
+#include "threading/mutex_auto_lock.h"
+
+/*
+	ModStorage
+*/
+
+ModStorage::ModStorage(ModStorageManager *manager, const std::string &modname) :
+	m_manager(manager),
+	m_modname(modname)
+{
+}
+
+bool ModStorage::contains(const std::string &key) const
+{
+	return m_entries.find(key) != m_entries.end();
+}
+
+std::string ModStorage::getString(const std::string &key) const
+{
+	StringMap::const_iterator it = m_entries.find(key);
+	if (it == m_entries.end())
+		return "";
+	return it->second;
+}
+
+bool ModStorage::setString(const std::string &key, const std::string &value)
+{
+	if (value.empty()) {
+		if (m_entries.erase(key) == 0)
+			return false;
+		m_manager->queueChange(m_modname, key, "", true);
+		return true;
+	}
+
+	StringMap::iterator it = m_entries.find(key);
+	if (it != m_entries.end()) {
+		if (it->second == value)
+			return false;
+		it->second = value;
+	} else {
+		m_entries[key] = value;
+	}
+	m_manager->queueChange(m_modname, key, value, false);
+	return true;
+}
+
+/*
+	ModStorageManager
+*/
+
+ModStorageManager::ModStorageManager(ModStorageDatabase *database,
+		float flush_interval) :
+	Thread("ModStorage"),
+	m_database(database),
+	m_flush_interval_ms(MYMAX(flush_interval, 0.1f) * 1000)
+{
+}
+
+ModStorageManager::~ModStorageManager()
+{
+	stop();
+	m_wakeup.post();
+	wait();
+
+	// Anything changed after the last flush of the thread
+	flush();
+
+	for (std::map<std::string, ModStorage *>::iterator
+			it = m_storages.begin(); it != m_storages.end(); ++it)
+		delete it->second;
+	delete m_database;
+}
+
+ModStorage *ModStorageManager::getModStorage(const std::string &modname)
+{
+	std::map<std::string, ModStorage *>::iterator it = m_storages.find(modname);
+	if (it != m_storages.end())
+		return it->second;
+
+	ModStorage *storage = new ModStorage(this, modname);
+	{
+		MutexAutoLock lock(m_database_mutex);
+		m_database->getModEntries(modname, storage->m_entries);
+	}
+	m_storages[modname] = storage;
+	return storage;
+}
+
+void ModStorageManager::queueChange(const std::string &modname,
+		const std::string &key, const std::string &value, bool removed)
+{
+	MutexAutoLock lock(m_pending_mutex);
+	PendingEntry &entry = m_pending[modname][key];
+	entry.removed = removed;
+	entry.value = value;
+}
+
+void ModStorageManager::flush()
+{
+	std::map<std::string, PendingEntries> pending;
+	{
+		MutexAutoLock lock(m_pending_mutex);
+		pending.swap(m_pending);
+	}
+	if (pending.empty())
+		return;
+
+	MutexAutoLock lock(m_database_mutex);
+	try {
+		// One transaction, so a crash leaves either all or none of it
+		m_database->beginSave();
+		for (std::map<std::string, PendingEntries>::const_iterator
+				mod = pending.begin(); mod != pending.end(); ++mod) {
+			for (PendingEntries::const_iterator it = mod->second.begin();
+					it != mod->second.end(); ++it) {
+				if (it->second.removed)
+					m_database->removeModEntry(mod->first, it->first);
+				else
+					m_database->setModEntry(mod->first, it->first,
+						it->second.value);
+			}
+		}
+		m_database->endSave();
+	} catch (BaseException &e) {
+		errorstream << "ModStorageManager: Failed to save mod storage: "
+			<< e.what() << std::endl;
+
+		// Leave the database ready for the next transaction
+		try {
+			m_database->abortSave();
+		} catch (BaseException &e) {
+			errorstream << "ModStorageManager: Failed to abort saving: "
+				<< e.what() << std::endl;
+		}
+
+		// Retry with the next flush, keeping changes made meanwhile
+		MutexAutoLock lock(m_pending_mutex);
+		for (std::map<std::string, PendingEntries>::iterator
+				mod = pending.begin(); mod != pending.end(); ++mod) {
+			PendingEntries &dst = m_pending[mod->first];
+			dst.insert(mod->second.begin(), mod->second.end());
+		}
+	}
+}
+
+void *ModStorageManager::run()
+{
+	while (!stopRequested()) {
+		m_wakeup.wait(m_flush_interval_ms);
+		flush();
+	}
+	return NULL;
+}
@@ -0,0 +1,109 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef MOD_STORAGE_HEADER
+#define MOD_STORAGE_HEADER
+
+#include "util/string.h"
+#include "threading/thread.h"
+#include "threading/mutex.h"
+#include "threading/semaphore.h"
+#include <map>
+#include <string>
+
+class ModStorageDatabase;
+class ModStorageManager;
+
+/*
+	Key-value pairs of one mod. Reads are served from memory, changes are
+	handed to the ModStorageManager which writes them behind.
+*/
+class ModStorage
+{
+public:
+	const std::string &getModName() const { return m_modname; }
+
+	bool contains(const std::string &key) const;
+	// Returns "" if the key doesn't exist
+	std::string getString(const std::string &key) const;
+	// An empty value removes the key. Returns false if nothing changed.
+	bool setString(const std::string &key, const std::string &value);
+	const StringMap &getEntries() const { return m_entries; }
+
+private:
+	friend class ModStorageManager;
+	ModStorage(ModStorageManager *manager, const std::string &modname);
+
+	ModStorageManager *m_manager;
+	std::string m_modname;
+	StringMap m_entries;
+};
+
+/*
+	Owns the storage of all mods and persists their changes on a thread of
+	its own: changes are collected in memory and written in one database
+	transaction every flush interval, so saving never blocks the server
+	step and a crash loses at most the last interval.
+*/
+class ModStorageManager : public Thread
+{
+public:
+	// Takes ownership of the database
+	ModStorageManager(ModStorageDatabase *database, float flush_interval);
+	// Stops the thread and writes the remaining changes
+	~ModStorageManager();
+
+	// Loads the storage of a mod on first use
+	ModStorage *getModStorage(const std::string &modname);
+
+	// Writes all queued changes now
+	void flush();
+
+	void *run();
+
+private:
+	friend class ModStorage;
+
+	struct PendingEntry
+	{
+		bool removed;
+		std::string value;
+	};
+	// Latest change by key
+	typedef std::map<std::string, PendingEntry> PendingEntries;
+
+	void queueChange(const std::string &modname, const std::string &key,
+			const std::string &value, bool removed);
+
+	ModStorageDatabase *m_database;
+	// Serializes database access of the server and flush threads
+	Mutex m_database_mutex;
+	u32 m_flush_interval_ms;
+
+	std::map<std::string, ModStorage *> m_storages;
+
+	// Changes not yet written, by mod name
+	std::map<std::string, PendingEntries> m_pending;
+	Mutex m_pending_mutex;
+
+	// Posted to flush early when stopping
+	Semaphore m_wakeup;
+};
+
+#endif
@@ -66,8 +66,8 @@ const ToClientCommandHandler toClientCommandTable[TOCLIENT_NUM_MSG_TYPES] =
 	{ "TOCLIENT_INVENTORY",                TOCLIENT_STATE_CONNECTED, &Client::handleCommand_Inventory }, // 0x27
 	null_command_handler,
 	{ "TOCLIENT_TIME_OF_DAY",              TOCLIENT_STATE_CONNECTED, &Client::handleCommand_TimeOfDay }, // 0x29
-	null_command_handler,
-	null_command_handler,
+	{ "TOCLIENT_NODE_EDITS",               TOCLIENT_STATE_CONNECTED, &Client::handleCommand_NodeEdits }, // 0x2A
+	{ "TOCLIENT_BLOCK_DELTA",              TOCLIENT_STATE_CONNECTED, &Client::handleCommand_BlockDelta }, // 0x2B
 	null_command_handler,
 	null_command_handler,
 	null_command_handler,
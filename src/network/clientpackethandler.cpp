@@ -277,6 +277,45 @@ void Client::handleCommand_AddNode(NetworkPacket* pkt)
 
 	addNode(p, n, remove_metadata);
 }
+
+void Client::handleCommand_NodeEdits(NetworkPacket* pkt)
+{
+	v3s16 blockpos;
+	u16 count;
+	*pkt >> blockpos >> count;
+
+	// Apply all edits before updating the meshes of the touched blocks once
+	std::map<v3s16, MapBlock*> modified_blocks;
+	v3s16 blockpos_nodes = blockpos * MAP_BLOCKSIZE;
+	for (u16 i = 0; i < count; i++) {
+		u16 index;
+		u8 type;
+		*pkt >> index >> type;
+
+		v3s16 p = blockpos_nodes + v3s16(
+				index % MAP_BLOCKSIZE,
+				(index / MAP_BLOCKSIZE) % MAP_BLOCKSIZE,
+				index / (MAP_BLOCKSIZE * MAP_BLOCKSIZE));
+
+		try {
+			if (type == NODE_EDIT_REMOVE) {
+				m_env.getMap().removeNodeAndUpdate(p, modified_blocks);
+			} else {
+				MapNode n;
+				*pkt >> n.param0 >> n.param1 >> n.param2;
+				m_env.getMap().addNodeAndUpdate(p, n, modified_blocks,
+						type != NODE_EDIT_ADD_KEEP_METADATA);
+			}
+		} catch (InvalidPositionException &e) {
+		}
+	}
+
+	for (std::map<v3s16, MapBlock *>::iterator
+			i = modified_blocks.begin();
+			i != modified_blocks.end(); ++i) {
+		addUpdateMeshTaskWithEdge(i->first, false, true);
+	}
+}
 void Client::handleCommand_BlockData(NetworkPacket* pkt)
 {
 	// Ignore too small packet
@@ -325,6 +364,32 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	addUpdateMeshTaskWithEdge(p, true);
 }
 
+void Client::handleCommand_BlockDelta(NetworkPacket* pkt)
+{
+	// Ignore too small packet
+	if (pkt->getSize() < 6)
+		return;
+
+	v3s16 p;
+	*pkt >> p;
+
+	// The block may have been deleted while the delta was on its way.
+	// The server sends it whole once it gets TOSERVER_DELETEDBLOCKS.
+	MapBlock *block = m_env.getMap().getBlockNoCreateNoEx(p);
+	if (block == NULL)
+		return;
+
+	std::string datastring(pkt->getString(6), pkt->getSize() - 6);
+	std::istringstream istr(datastring, std::ios_base::binary);
+	block->deSerializeDelta(istr);
+
+	if (m_localdb) {
+		ServerMap::saveBlock(block, m_localdb);
+	}
+
+	addUpdateMeshTaskWithEdge(p, true);
+}
+
 void Client::handleCommand_Inventory(NetworkPacket* pkt)
 {
 	if (pkt->getSize() < 1)
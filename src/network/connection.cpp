@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/string.h"
 #include "settings.h"
 #include "profiler.h"
+#include "zlib.h"
 
 namespace con
 {
@@ -67,6 +68,20 @@ static inline float CALC_DTIME(unsigned int lasttime, unsigned int curtime) {
  /* starting value for window size */
 #define MIN_RELIABLE_WINDOW_SIZE 0x40
 
+/* number of ACKs for later packets after which a packet is resent */
+#define FAST_RETRANSMIT_THRESHOLD 3
+/* resend timeout doubles with every resend up to this factor */
+#define MAX_RESEND_BACKOFF 8
+/* maximum number of seqnum ranges in a CONTROLTYPE_SACK */
+#define SACK_MAX_RANGES 64
+
+/* pacing allows sending this much faster than window per rtt */
+#define PACING_GAIN 1.25
+/* smallest burst pacing allows, in packets */
+#define PACING_MIN_BURST 16
+/* how often the send thread wakes up while pacing holds back packets */
+#define PACING_INTERVAL_MS 5
+
 #define MAX_UDP_PEERS 65535
 
 #define PING_TIMEOUT 5.0
@@ -103,75 +118,92 @@ BufferedPacket makePacket(Address &address, SharedBuffer<u8> &data,
 			protocol_id, sender_peer_id, channel);
 }
 
-SharedBuffer<u8> makeOriginalPacket(
-		SharedBuffer<u8> data)
+BufferedPacket makePacket(Address &address, const PacketChunk &chunk,
+		u32 protocol_id, u16 sender_peer_id, u8 channel)
 {
-	u32 header_size = 1;
-	u32 packet_size = data.getSize() + header_size;
-	SharedBuffer<u8> b(packet_size);
+	u32 packet_size = chunk.getSize() + BASE_HEADER_SIZE;
+	BufferedPacket p(packet_size);
+	p.address = address;
 
-	writeU8(&(b[0]), TYPE_ORIGINAL);
-	if (data.getSize() > 0) {
-		memcpy(&(b[header_size]), *data, data.getSize());
-	}
-	return b;
+	writeU32(&p.data[0], protocol_id);
+	writeU16(&p.data[4], sender_peer_id);
+	writeU8(&p.data[6], channel);
+
+	chunk.copyTo(&p.data[BASE_HEADER_SIZE]);
+
+	return p;
 }
 
-std::list<SharedBuffer<u8> > makeSplitPacket(
+void PacketChunk::prependHeader(const u8 *h, u32 len)
+{
+	FATAL_ERROR_IF(header_size + len > sizeof(header),
+			"PacketChunk: too many headers");
+	memmove(&header[len], &header[0], header_size);
+	memcpy(&header[0], h, len);
+	header_size += len;
+}
+
+void PacketChunk::copyTo(u8 *dst) const
+{
+	memcpy(dst, header, header_size);
+	if (size > 0)
+		memcpy(dst + header_size, *data + offset, size);
+}
+
+PacketChunk makeOriginalPacket(
+		SharedBuffer<u8> data)
+{
+	PacketChunk chunk(data);
+	u8 header[ORIGINAL_HEADER_SIZE];
+	writeU8(&header[0], TYPE_ORIGINAL);
+	chunk.prependHeader(header, ORIGINAL_HEADER_SIZE);
+	return chunk;
+}
+
+std::list<PacketChunk> makeSplitPacket(
 		SharedBuffer<u8> data,
 		u32 chunksize_max,
 		u16 seqnum)
 {
 	// Chunk packets, containing the TYPE_SPLIT header
-	std::list<SharedBuffer<u8> > chunks;
+	std::list<PacketChunk> chunks;
 
 	u32 chunk_header_size = 7;
 	u32 maximum_data_size = chunksize_max - chunk_header_size;
+	u16 chunk_count = (data.getSize() + maximum_data_size - 1)
+			/ maximum_data_size;
 	u32 start = 0;
-	u32 end = 0;
-	u32 chunk_num = 0;
-	u16 chunk_count = 0;
+	u16 chunk_num = 0;
 	do{
-		end = start + maximum_data_size - 1;
-		if (end > data.getSize() - 1)
-			end = data.getSize() - 1;
-
-		u32 payload_size = end - start + 1;
-		u32 packet_size = chunk_header_size + payload_size;
-
-		SharedBuffer<u8> chunk(packet_size);
-
-		writeU8(&chunk[0], TYPE_SPLIT);
-		writeU16(&chunk[1], seqnum);
-		// [3] u16 chunk_count is written at next stage
-		writeU16(&chunk[5], chunk_num);
-		memcpy(&chunk[chunk_header_size], &data[start], payload_size);
+		// The chunks only refer to their part of data
+		PacketChunk chunk(data);
+		chunk.offset = start;
+		chunk.size = MYMIN(maximum_data_size, data.getSize() - start);
+
+		u8 header[7];
+		writeU8(&header[0], TYPE_SPLIT);
+		writeU16(&header[1], seqnum);
+		writeU16(&header[3], chunk_count);
+		writeU16(&header[5], chunk_num);
+		chunk.prependHeader(header, chunk_header_size);
 
 		chunks.push_back(chunk);
-		chunk_count++;
 
-		start = end + 1;
+		start += chunk.size;
 		chunk_num++;
 	}
-	while(end != data.getSize() - 1);
-
-	for(std::list<SharedBuffer<u8> >::iterator i = chunks.begin();
-		i != chunks.end(); ++i)
-	{
-		// Write chunk_count
-		writeU16(&((*i)[3]), chunk_count);
-	}
+	while(start < data.getSize());
 
 	return chunks;
 }
 
-std::list<SharedBuffer<u8> > makeAutoSplitPacket(
+std::list<PacketChunk> makeAutoSplitPacket(
 		SharedBuffer<u8> data,
 		u32 chunksize_max,
 		u16 &split_seqnum)
 {
 	u32 original_header_size = 1;
-	std::list<SharedBuffer<u8> > list;
+	std::list<PacketChunk> list;
 	if (data.getSize() + original_header_size > chunksize_max)
 	{
 		list = makeSplitPacket(data, chunksize_max, split_seqnum);
@@ -201,6 +233,122 @@ SharedBuffer<u8> makeReliablePacket(
 	return b;
 }
 
+PacketChunk makeReliablePacket(
+		const PacketChunk &chunk,
+		u16 seqnum)
+{
+	PacketChunk reliable = chunk;
+	u8 header[RELIABLE_HEADER_SIZE];
+	writeU8(&header[0], TYPE_RELIABLE);
+	writeU16(&header[1], seqnum);
+	reliable.prependHeader(header, RELIABLE_HEADER_SIZE);
+	return reliable;
+}
+
+// The CONTROLFLAG_* sent with CONTROLTYPE_ENABLE_BIG_SEND_WINDOW
+static u8 getControlFlags()
+{
+	u8 flags = CONTROLFLAG_SACK;
+	if (g_settings->getBool("network_compression"))
+		flags |= CONTROLFLAG_COMPRESSION;
+	return flags;
+}
+
+/*
+	ChannelCompression
+*/
+
+// Z_SYNC_FLUSH ends the output with an empty stored block
+static const u8 SYNC_FLUSH_TAIL[4] = { 0x00, 0x00, 0xff, 0xff };
+
+ChannelCompression::ChannelCompression():
+	m_deflate(NULL),
+	m_inflate(NULL)
+{
+}
+
+ChannelCompression::~ChannelCompression()
+{
+	if (m_deflate) {
+		deflateEnd(m_deflate);
+		delete m_deflate;
+	}
+	if (m_inflate) {
+		inflateEnd(m_inflate);
+		delete m_inflate;
+	}
+}
+
+SharedBuffer<u8> ChannelCompression::compress(const u8 *data, u32 size)
+{
+	if (!m_deflate) {
+		m_deflate = new z_stream();
+		int ret = deflateInit2(m_deflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+				-COMPRESSION_WINDOW_BITS, COMPRESSION_MEM_LEVEL,
+				Z_DEFAULT_STRATEGY);
+		FATAL_ERROR_IF(ret != Z_OK, "deflateInit2 failed");
+	}
+
+	// Stored blocks add 5 bytes each, plus the flush
+	u32 bufsize = size + size / 8 + 64;
+	SharedBuffer<u8> buf(COMPRESSED_HEADER_SIZE + bufsize);
+	writeU8(&buf[0], TYPE_COMPRESSED);
+
+	m_deflate->next_in = (Bytef *)data;
+	m_deflate->avail_in = size;
+	m_deflate->next_out = &buf[COMPRESSED_HEADER_SIZE];
+	m_deflate->avail_out = bufsize;
+	int ret = deflate(m_deflate, Z_SYNC_FLUSH);
+	FATAL_ERROR_IF(ret != Z_OK || m_deflate->avail_in != 0 ||
+			m_deflate->avail_out == 0, "deflate failed");
+
+	u32 compressed_size = bufsize - m_deflate->avail_out;
+	sanity_check(compressed_size >= 4 &&
+			memcmp(&buf[COMPRESSED_HEADER_SIZE + compressed_size - 4],
+				SYNC_FLUSH_TAIL, 4) == 0);
+	compressed_size -= 4;
+
+	SharedBuffer<u8> result(COMPRESSED_HEADER_SIZE + compressed_size);
+	memcpy(*result, *buf, result.getSize());
+	return result;
+}
+
+SharedBuffer<u8> ChannelCompression::decompress(const u8 *packetdata, u32 size)
+{
+	if (!m_inflate) {
+		m_inflate = new z_stream();
+		int ret = inflateInit2(m_inflate, -COMPRESSION_WINDOW_BITS);
+		FATAL_ERROR_IF(ret != Z_OK, "inflateInit2 failed");
+	}
+
+	std::vector<u8> in(packetdata + COMPRESSED_HEADER_SIZE, packetdata + size);
+	in.insert(in.end(), SYNC_FLUSH_TAIL, SYNC_FLUSH_TAIL + 4);
+
+	std::vector<u8> out;
+	u8 buf[1024];
+	m_inflate->next_in = &in[0];
+	m_inflate->avail_in = in.size();
+	do {
+		m_inflate->next_out = buf;
+		m_inflate->avail_out = sizeof(buf);
+		int ret = inflate(m_inflate, Z_SYNC_FLUSH);
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+			throw InvalidIncomingDataException("Broken compressed packet");
+		out.insert(out.end(), buf, buf + sizeof(buf) - m_inflate->avail_out);
+		if (out.size() > COMPRESSION_MAX_INFLATED_SIZE)
+			throw InvalidIncomingDataException("Compressed packet too large");
+		if (ret == Z_BUF_ERROR && m_inflate->avail_out != 0)
+			break;
+	} while (m_inflate->avail_in > 0 || m_inflate->avail_out == 0);
+
+	if (m_inflate->avail_in > 0 || out.empty())
+		throw InvalidIncomingDataException("Broken compressed packet");
+
+	SharedBuffer<u8> data(out.size());
+	memcpy(*data, &out[0], out.size());
+	return data;
+}
+
 /*
 	ReliablePacketBuffer
 */
@@ -428,11 +576,17 @@ std::list<BufferedPacket> ReliablePacketBuffer::getTimedOuts(float timeout,
 	for(std::list<BufferedPacket>::iterator i = m_list.begin();
 		i != m_list.end(); ++i)
 	{
-		if (i->time >= timeout) {
+		float backoff = i->resend_count < 3 ?
+				1 << i->resend_count : MAX_RESEND_BACKOFF;
+		if ((i->time >= timeout * backoff) ||
+				(i->nack_count >= FAST_RETRANSMIT_THRESHOLD)) {
 			timed_outs.push_back(*i);
 
 			//this packet will be sent right afterwards reset timeout here
 			i->time = 0.0;
+			i->nack_count = 0;
+			// no rtt is calculated from resent packets
+			i->resend_count++;
 			if (timed_outs.size() >= max_packets)
 				break;
 		}
@@ -440,6 +594,83 @@ std::list<BufferedPacket> ReliablePacketBuffer::getTimedOuts(float timeout,
 	return timed_outs;
 }
 
+void ReliablePacketBuffer::popAcked(u16 next_expected,
+		const std::vector<std::pair<u16, u16> > &ranges,
+		std::list<BufferedPacket> &acked)
+{
+	MutexAutoLock listlock(m_list_mutex);
+	std::list<BufferedPacket>::iterator i = m_list.begin();
+	while (i != m_list.end()) {
+		u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+		// everything before next_expected has been received
+		bool is_acked = seqnum_in_window(s,
+				next_expected - MAX_RELIABLE_WINDOW_SIZE,
+				MAX_RELIABLE_WINDOW_SIZE);
+		for (std::vector<std::pair<u16, u16> >::const_iterator
+				r = ranges.begin();
+				r != ranges.end() && !is_acked; ++r) {
+			is_acked = seqnum_in_window(s, r->first,
+					(u16)(r->second - r->first + 1));
+		}
+
+		if (is_acked) {
+			acked.push_back(*i);
+			m_list.erase(i++);
+			--m_list_size;
+		} else {
+			++i;
+		}
+	}
+
+	if (m_list_size == 0)
+	{ m_oldest_non_answered_ack = 0; }
+	else
+	{ m_oldest_non_answered_ack = readU16(&(*m_list.begin()).data[BASE_HEADER_SIZE+1]);	}
+}
+
+void ReliablePacketBuffer::getRanges(std::vector<std::pair<u16, u16> > &ranges,
+		unsigned int max_ranges)
+{
+	MutexAutoLock listlock(m_list_mutex);
+	for (std::list<BufferedPacket>::iterator i = m_list.begin();
+			i != m_list.end(); ++i) {
+		u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+		if (!ranges.empty() && (u16)(ranges.back().second + 1) == s) {
+			ranges.back().second = s;
+			continue;
+		}
+		if (ranges.size() >= max_ranges)
+			break;
+		ranges.push_back(std::make_pair(s, s));
+	}
+}
+
+unsigned int ReliablePacketBuffer::markLostBefore(u16 seqnum,
+		float acked_age, unsigned int threshold, u16 &first_lost)
+{
+	MutexAutoLock listlock(m_list_mutex);
+	unsigned int lost = 0;
+	// the list is sorted, so all packets sent before seqnum come first
+	for (std::list<BufferedPacket>::iterator i = m_list.begin();
+			i != m_list.end(); ++i) {
+		u16 s = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+		if (!seqnum_higher(seqnum, s))
+			break;
+
+		// resent after the acked packet was sent, it can't be overtaken yet
+		if (i->time < acked_age)
+			continue;
+
+		i->nack_count++;
+		if (i->nack_count == threshold) {
+			if (lost == 0)
+				first_lost = s;
+			lost++;
+		}
+	}
+	return lost;
+}
+
 /*
 	IncomingSplitBuffer
 */
@@ -575,13 +806,18 @@ void IncomingSplitBuffer::removeUnreliableTimedOuts(float dtime, float timeout)
 
 Channel::Channel() :
 		window_size(MIN_RELIABLE_WINDOW_SIZE),
+		m_congestion_control(false),
+		m_congestion_window(MIN_RELIABLE_WINDOW_SIZE),
+		m_slow_start_threshold(MAX_RELIABLE_WINDOW_SIZE),
+		m_in_recovery(false),
+		m_recovery_seqnum(0),
+		m_pacing_budget(PACING_MIN_BURST),
 		next_incoming_seqnum(SEQNUM_INITIAL),
 		next_outgoing_seqnum(SEQNUM_INITIAL),
 		next_outgoing_split_seqnum(SEQNUM_INITIAL),
 		current_packet_loss(0),
 		current_packet_too_late(0),
 		current_packet_successfull(0),
-		packet_loss_counter(0),
 		current_bytes_transfered(0),
 		current_bytes_received(0),
 		current_bytes_lost(0),
@@ -715,89 +951,9 @@ void Channel::UpdatePacketTooLateCounter()
 	current_packet_too_late++;
 }
 
-void Channel::UpdateTimers(float dtime,bool legacy_peer)
+void Channel::UpdateTimers(float dtime)
 {
 	bpm_counter += dtime;
-	packet_loss_counter += dtime;
-
-	if (packet_loss_counter > 1.0)
-	{
-		packet_loss_counter -= 1.0;
-
-		unsigned int packet_loss = 11; /* use a neutral value for initialization */
-		unsigned int packets_successfull = 0;
-		//unsigned int packet_too_late = 0;
-
-		bool reasonable_amount_of_data_transmitted = false;
-
-		{
-			MutexAutoLock internal(m_internal_mutex);
-			packet_loss = current_packet_loss;
-			//packet_too_late = current_packet_too_late;
-			packets_successfull = current_packet_successfull;
-
-			if (current_bytes_transfered > (unsigned int) (window_size*512/2))
-			{
-				reasonable_amount_of_data_transmitted = true;
-			}
-			current_packet_loss = 0;
-			current_packet_too_late = 0;
-			current_packet_successfull = 0;
-		}
-
-		/* dynamic window size is only available for non legacy peers */
-		if (!legacy_peer) {
-			float successfull_to_lost_ratio = 0.0;
-			bool done = false;
-
-			if (packets_successfull > 0) {
-				successfull_to_lost_ratio = packet_loss/packets_successfull;
-			}
-			else if (packet_loss > 0)
-			{
-				window_size = MYMAX(
-						(window_size - 10),
-						MIN_RELIABLE_WINDOW_SIZE);
-				done = true;
-			}
-
-			if (!done)
-			{
-				if ((successfull_to_lost_ratio < 0.01) &&
-					(window_size < MAX_RELIABLE_WINDOW_SIZE))
-				{
-					/* don't even think about increasing if we didn't even
-					 * use major parts of our window */
-					if (reasonable_amount_of_data_transmitted)
-						window_size = MYMIN(
-								(window_size + 100),
-								MAX_RELIABLE_WINDOW_SIZE);
-				}
-				else if ((successfull_to_lost_ratio < 0.05) &&
-						(window_size < MAX_RELIABLE_WINDOW_SIZE))
-				{
-					/* don't even think about increasing if we didn't even
-					 * use major parts of our window */
-					if (reasonable_amount_of_data_transmitted)
-						window_size = MYMIN(
-								(window_size + 50),
-								MAX_RELIABLE_WINDOW_SIZE);
-				}
-				else if (successfull_to_lost_ratio > 0.15)
-				{
-					window_size = MYMAX(
-							(window_size - 100),
-							MIN_RELIABLE_WINDOW_SIZE);
-				}
-				else if (successfull_to_lost_ratio > 0.1)
-				{
-					window_size = MYMAX(
-							(window_size - 50),
-							MIN_RELIABLE_WINDOW_SIZE);
-				}
-			}
-		}
-	}
 
 	if (bpm_counter > 10.0)
 	{
@@ -840,6 +996,88 @@ void Channel::UpdateTimers(float dtime,bool legacy_peer)
 	}
 }
 
+void Channel::enableCongestionControl(unsigned int initial_window)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	m_congestion_control = true;
+	m_congestion_window = rangelim(initial_window,
+			MIN_RELIABLE_WINDOW_SIZE, MAX_RELIABLE_WINDOW_SIZE);
+	m_slow_start_threshold = MAX_RELIABLE_WINDOW_SIZE;
+	window_size = m_congestion_window;
+}
+
+void Channel::onPacketAcked(u16 seqnum)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	if (!m_congestion_control)
+		return;
+
+	// recovery ends with the first ACK for a packet sent after the loss
+	if (m_in_recovery && !seqnum_higher(m_recovery_seqnum, seqnum))
+		m_in_recovery = false;
+
+	// don't grow a window that isn't used
+	if (outgoing_reliables_sent.size() * 2 < (unsigned int) window_size)
+		return;
+
+	if (m_congestion_window < m_slow_start_threshold)
+		m_congestion_window += 1;
+	else
+		m_congestion_window += 1 / m_congestion_window;
+
+	m_congestion_window = MYMIN(m_congestion_window,
+			MAX_RELIABLE_WINDOW_SIZE);
+	window_size = m_congestion_window;
+}
+
+void Channel::onPacketLost(u16 seqnum, bool timeout)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	if (!m_congestion_control)
+		return;
+
+	// packets sent before the last reduction are from the same loss event
+	if (m_in_recovery && seqnum_higher(m_recovery_seqnum, seqnum))
+		return;
+
+	m_slow_start_threshold = MYMAX(m_congestion_window / 2,
+			MIN_RELIABLE_WINDOW_SIZE);
+	m_congestion_window = timeout ?
+			MIN_RELIABLE_WINDOW_SIZE : m_slow_start_threshold;
+	m_in_recovery = true;
+	m_recovery_seqnum = next_outgoing_seqnum;
+	window_size = m_congestion_window;
+}
+
+void Channel::updatePacing(float dtime, float rtt)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	if (!m_congestion_control)
+		return;
+
+	float max_burst = MYMAX(m_congestion_window / 4, PACING_MIN_BURST);
+	m_pacing_budget += m_congestion_window * PACING_GAIN * dtime /
+			MYMAX(rtt, RESEND_TIMEOUT_MIN / 10);
+	m_pacing_budget = MYMIN(m_pacing_budget, max_burst);
+}
+
+unsigned int Channel::getPacingBudget(unsigned int wanted)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	if (!m_congestion_control)
+		return wanted;
+
+	return MYMIN(wanted, (unsigned int) m_pacing_budget);
+}
+
+void Channel::consumePacingBudget(unsigned int count)
+{
+	MutexAutoLock internal(m_internal_mutex);
+	if (!m_congestion_control)
+		return;
+
+	m_pacing_budget = MYMAX(m_pacing_budget - count, 0);
+}
 
 /*
 	Peer
@@ -1014,7 +1252,11 @@ UDPPeer::UDPPeer(u16 a_id, Address a_address, Connection* connection) :
 	Peer(a_address,a_id,connection),
 	m_pending_disconnect(false),
 	resend_timeout(0.5),
-	m_legacy_peer(true)
+	m_smoothed_rtt(-1.0),
+	m_rtt_variance(0.0),
+	m_legacy_peer(true),
+	m_sack_enabled(false),
+	m_compression_enabled(false)
 {
 }
 
@@ -1034,7 +1276,8 @@ void UDPPeer::setNonLegacyPeer()
 	m_legacy_peer = false;
 	for(unsigned int i=0; i< CHANNEL_COUNT; i++)
 	{
-		channels->setWindowSize(g_settings->getU16("max_packets_per_iteration"));
+		channels[i].enableCongestionControl(
+				g_settings->getU16("max_packets_per_iteration"));
 	}
 }
 
@@ -1045,13 +1288,25 @@ void UDPPeer::reportRTT(float rtt)
 	}
 	RTTStatistics(rtt,"rudp",MAX_RELIABLE_WINDOW_SIZE*10);
 
-	float timeout = getStat(AVG_RTT) * RESEND_TIMEOUT_FACTOR;
+	MutexAutoLock usage_lock(m_exclusive_access_mutex);
+
+	// Smoothing as in RFC 6298
+	if (m_smoothed_rtt < 0) {
+		m_smoothed_rtt = rtt;
+		m_rtt_variance = rtt / 2;
+	} else {
+		m_rtt_variance = 0.75 * m_rtt_variance +
+				0.25 * fabs(m_smoothed_rtt - rtt);
+		m_smoothed_rtt = 0.875 * m_smoothed_rtt + 0.125 * rtt;
+	}
+
+	float timeout = m_smoothed_rtt +
+			RESEND_TIMEOUT_VARIANCE_FACTOR * m_rtt_variance;
 	if (timeout < RESEND_TIMEOUT_MIN)
 		timeout = RESEND_TIMEOUT_MIN;
 	if (timeout > RESEND_TIMEOUT_MAX)
 		timeout = RESEND_TIMEOUT_MAX;
 
-	MutexAutoLock usage_lock(m_exclusive_access_mutex);
 	resend_timeout = timeout;
 }
 
@@ -1107,24 +1362,32 @@ bool UDPPeer::processReliableSendCommand(
 
 	sanity_check(c.data.getSize() < MAX_RELIABLE_WINDOW_SIZE*512);
 
-	std::list<SharedBuffer<u8> > originals;
+	std::list<PacketChunk> originals;
 	u16 split_sequence_number = channels[c.channelnum].readNextSplitSeqNum();
 
 	if (c.raw)
 	{
-		originals.push_back(c.data);
+		originals.push_back(PacketChunk(c.data));
 	}
 	else {
 		originals = makeAutoSplitPacket(c.data, chunksize_max,split_sequence_number);
 		channels[c.channelnum].setNextSplitSeqNum(split_sequence_number);
 	}
 
+	// The deflate stream must only see packets that are sent. A single
+	// packet surely is once it got a sequence number.
+	bool compress = !c.raw && originals.size() == 1 &&
+			c.data.getSize() >= COMPRESSION_MIN_SIZE &&
+			c.data.getSize() + COMPRESSED_HEADER_SIZE + COMPRESSION_MARGIN
+				<= chunksize_max &&
+			getCompressionEnabled();
+
 	bool have_sequence_number = true;
 	bool have_initial_sequence_number = false;
 	std::queue<BufferedPacket> toadd;
 	volatile u16 initial_sequence_number = 0;
 
-	for(std::list<SharedBuffer<u8> >::iterator i = originals.begin();
+	for(std::list<PacketChunk>::iterator i = originals.begin();
 		i != originals.end(); ++i)
 	{
 		u16 seqnum = channels[c.channelnum].getOutgoingSequenceNumber(have_sequence_number);
@@ -1139,7 +1402,12 @@ bool UDPPeer::processReliableSendCommand(
 			have_initial_sequence_number = true;
 		}
 
-		SharedBuffer<u8> reliable = makeReliablePacket(*i, seqnum);
+		PacketChunk inner = *i;
+		if (compress)
+			inner = PacketChunk(channels[c.channelnum].compression.compress(
+					*c.data, c.data.getSize()));
+
+		PacketChunk reliable = makeReliablePacket(inner, seqnum);
 
 		// Add base headers and make a packet
 		BufferedPacket p = con::makePacket(address, reliable,
@@ -1263,7 +1531,10 @@ ConnectionSendThread::ConnectionSendThread(unsigned int max_packet_size,
 	m_timeout(timeout),
 	m_max_commands_per_iteration(1),
 	m_max_data_packets_per_iteration(g_settings->getU16("max_packets_per_iteration")),
-	m_max_packets_requeued(256)
+	m_max_packets_requeued(256),
+	m_pacing_limited(false),
+	m_simulated_loss(0),
+	m_simulated_latency_ms(0)
 {
 }
 
@@ -1288,8 +1559,13 @@ void * ConnectionSendThread::run()
 
 		m_iteration_packets_avaialble = m_max_data_packets_per_iteration;
 
-		/* wait for trigger or timeout */
-		m_send_sleep_semaphore.wait(50);
+		/* wait for trigger or timeout, wake up early if packets are held
+		 * back by pacing or the simulated link */
+		if (m_pacing_limited || !m_delayed_packets.empty())
+			m_send_sleep_semaphore.wait(PACING_INTERVAL_MS);
+		else
+			m_send_sleep_semaphore.wait(50);
+		m_pacing_limited = false;
 
 		/* remove all triggers */
 		while(m_send_sleep_semaphore.wait(0)) {}
@@ -1316,6 +1592,8 @@ void * ConnectionSendThread::run()
 		/* send non reliable packets */
 		sendPackets(dtime);
 
+		sendDelayedPackets(stopRequested());
+
 		END_DEBUG_EXCEPTION_HANDLER
 	}
 
@@ -1399,6 +1677,7 @@ void ConnectionSendThread::runTimeouts(float dtime)
 		}
 
 		float resend_timeout = dynamic_cast<UDPPeer*>(&peer)->getResendTimeout();
+		float rtt = dynamic_cast<UDPPeer*>(&peer)->getRoundTripTime();
 		for(u16 i=0; i<CHANNEL_COUNT; i++)
 		{
 			std::list<BufferedPacket> timed_outs;
@@ -1412,16 +1691,24 @@ void ConnectionSendThread::runTimeouts(float dtime)
 
 			// Increment reliable packet times
 			channel->outgoing_reliables_sent.incrementTimeouts(dtime);
+			channel->updatePacing(dtime, rtt);
 
 			unsigned int numpeers = m_connection->m_peers.size();
 
 			if (numpeers == 0)
 				return;
 
-			// Re-send timed out outgoing reliables
+			// Re-send timed out outgoing reliables, paced like new ones so
+			// losses don't turn into bursts
+			unsigned int max_resend = m_max_data_packets_per_iteration/numpeers;
+			unsigned int budget = channel->getPacingBudget(max_resend);
+			if (budget < max_resend)
+				m_pacing_limited = true;
+
 			timed_outs = channel->
 					outgoing_reliables_sent.getTimedOuts(resend_timeout,
-							(m_max_data_packets_per_iteration/numpeers));
+							MYMAX(budget, 1));
+			channel->consumePacingBudget(timed_outs.size());
 
 			channel->UpdatePacketLossCounter(timed_outs.size());
 			g_profiler->graphAdd("packets_lost", timed_outs.size());
@@ -1436,7 +1723,9 @@ void ConnectionSendThread::runTimeouts(float dtime)
 				u16 seqnum  = readU16(&(k->data[BASE_HEADER_SIZE+1]));
 
 				channel->UpdateBytesLost(k->data.getSize());
-				k->resend_count++;
+				// fast retransmits were already reported as lost
+				if (k->nack_count < FAST_RETRANSMIT_THRESHOLD)
+					channel->onPacketLost(seqnum, true);
 
 				LOG(derr_con<<m_connection->getDesc()
 						<<"RE-SENDING timed-out RELIABLE to "
@@ -1452,7 +1741,7 @@ void ConnectionSendThread::runTimeouts(float dtime)
 				// do not handle rtt here as we can't decide if this packet was
 				// lost or really takes more time to transmit
 			}
-			channel->UpdateTimers(dtime,dynamic_cast<UDPPeer*>(&peer)->getLegacyPeer());
+			channel->UpdateTimers(dtime);
 		}
 
 		/* send ping if necessary */
@@ -1484,6 +1773,31 @@ void ConnectionSendThread::runTimeouts(float dtime)
 }
 
 void ConnectionSendThread::rawSend(const BufferedPacket &packet)
+{
+	if (m_simulated_loss > 0 &&
+			myrand_range(0, 9999) < m_simulated_loss * 10000)
+		return;
+
+	if (m_simulated_latency_ms > 0) {
+		m_delayed_packets.push(std::make_pair(
+				porting::getTimeMs() + m_simulated_latency_ms, packet));
+		return;
+	}
+
+	socketSend(packet);
+}
+
+void ConnectionSendThread::sendDelayedPackets(bool all)
+{
+	u32 now = porting::getTimeMs();
+	while (!m_delayed_packets.empty() &&
+			(all || m_delayed_packets.front().first <= now)) {
+		socketSend(m_delayed_packets.front().second);
+		m_delayed_packets.pop();
+	}
+}
+
+void ConnectionSendThread::socketSend(const BufferedPacket &packet)
 {
 	try{
 		m_connection->m_udpSocket.Send(packet.address, *packet.data,
@@ -1519,7 +1833,7 @@ void ConnectionSendThread::sendAsPacketReliable(BufferedPacket& p, Channel* chan
 }
 
 bool ConnectionSendThread::rawSendAsPacket(u16 peer_id, u8 channelnum,
-		SharedBuffer<u8> data, bool reliable)
+		const PacketChunk &data, bool reliable)
 {
 	PeerHelper peer = m_connection->getPeerNoEx(peer_id);
 	if (!peer) {
@@ -1540,7 +1854,7 @@ bool ConnectionSendThread::rawSendAsPacket(u16 peer_id, u8 channelnum,
 		if (!have_sequence_number_for_raw_packet)
 			return false;
 
-		SharedBuffer<u8> reliable = makeReliablePacket(data, seqnum);
+		PacketChunk reliable = makeReliablePacket(data, seqnum);
 		Address peer_address;
 		peer->getAddress(MTP_MINETEST_RELIABLE_UDP, peer_address);
 
@@ -1550,8 +1864,10 @@ bool ConnectionSendThread::rawSendAsPacket(u16 peer_id, u8 channelnum,
 				channelnum);
 
 		// first check if our send window is already maxed out
-		if (channel->outgoing_reliables_sent.size()
-				< channel->getWindowSize()) {
+		if ((channel->outgoing_reliables_sent.size()
+				< channel->getWindowSize()) &&
+				(channel->getPacingBudget(1) > 0)) {
+			channel->consumePacingBudget(1);
 			LOG(dout_con<<m_connection->getDesc()
 					<<" INFO: sending a reliable packet to peer_id " << peer_id
 					<<" channel: " << channelnum
@@ -1565,6 +1881,9 @@ bool ConnectionSendThread::rawSendAsPacket(u16 peer_id, u8 channelnum,
 					<<" channel: " << channelnum
 					<<" seqnum: " << seqnum << std::endl);
 			channel->queued_reliables.push(p);
+			if (channel->outgoing_reliables_sent.size()
+					< channel->getWindowSize())
+				m_pacing_limited = true;
 			return false;
 		}
 	}
@@ -1811,17 +2130,16 @@ void ConnectionSendThread::send(u16 peer_id, u8 channelnum,
 	u16 split_sequence_number = peer->getNextSplitSequenceNumber(channelnum);
 
 	u32 chunksize_max = m_max_packet_size - BASE_HEADER_SIZE;
-	std::list<SharedBuffer<u8> > originals;
+	std::list<PacketChunk> originals;
 
 	originals = makeAutoSplitPacket(data, chunksize_max,split_sequence_number);
 
 	peer->setNextSplitSequenceNumber(channelnum,split_sequence_number);
 
-	for(std::list<SharedBuffer<u8> >::iterator i = originals.begin();
+	for(std::list<PacketChunk>::iterator i = originals.begin();
 		i != originals.end(); ++i)
 	{
-		SharedBuffer<u8> original = *i;
-		sendAsPacket(peer_id, channelnum, original);
+		sendAsPacket(peer_id, channelnum, *i);
 	}
 }
 
@@ -1927,14 +2245,20 @@ void ConnectionSendThread::sendPackets(float dtime)
 						<< dynamic_cast<UDPPeer*>(&peer)->channels[i].queued_commands.size()
 						<< std::endl);
 
-			while ((dynamic_cast<UDPPeer*>(&peer)->channels[i].queued_reliables.size() > 0) &&
-					(dynamic_cast<UDPPeer*>(&peer)->channels[i].outgoing_reliables_sent.size()
-							< dynamic_cast<UDPPeer*>(&peer)->channels[i].getWindowSize())&&
+			Channel* channel = &(dynamic_cast<UDPPeer*>(&peer)->channels[i]);
+			while ((channel->queued_reliables.size() > 0) &&
+					(channel->outgoing_reliables_sent.size()
+							< channel->getWindowSize())&&
 							(peer->m_increment_packets_remaining > 0))
 			{
-				BufferedPacket p = dynamic_cast<UDPPeer*>(&peer)->channels[i].queued_reliables.front();
-				dynamic_cast<UDPPeer*>(&peer)->channels[i].queued_reliables.pop();
-				Channel* channel = &(dynamic_cast<UDPPeer*>(&peer)->channels[i]);
+				if (channel->getPacingBudget(1) == 0) {
+					m_pacing_limited = true;
+					break;
+				}
+				channel->consumePacingBudget(1);
+
+				BufferedPacket p = channel->queued_reliables.front();
+				channel->queued_reliables.pop();
 				LOG(dout_con<<m_connection->getDesc()
 						<<" INFO: sending a queued reliable packet "
 						<<" channel: " << i
@@ -2004,7 +2328,7 @@ void ConnectionSendThread::sendPackets(float dtime)
 }
 
 void ConnectionSendThread::sendAsPacket(u16 peer_id, u8 channelnum,
-		SharedBuffer<u8> data, bool ack)
+		const PacketChunk &data, bool ack)
 {
 	OutgoingPacket packet(peer_id, channelnum, data, false, ack);
 	m_outgoing_queue.push(packet);
@@ -2258,6 +2582,26 @@ void ConnectionReceiveThread::receive()
 			catch(ProcessedQueued &e) {
 				packet_queued = true;
 			}
+
+			/* packets buffered behind this one can be delivered now, without
+			 * waiting for the next packet to arrive */
+			bool data_left = (channel != 0);
+			while (data_left) {
+				try {
+					u16 buffered_peer_id = peer_id;
+					SharedBuffer<u8> resultdata;
+					data_left = checkIncomingBuffers(channel, buffered_peer_id,
+							resultdata);
+					if (data_left) {
+						ConnectionEvent e;
+						e.dataReceived(buffered_peer_id, resultdata);
+						m_connection->putEvent(e);
+					}
+				}
+				catch(ProcessedSilentlyException &e) {
+					/* try reading again */
+				}
+			}
 		}
 		catch(InvalidIncomingDataException &e) {
 		}
@@ -2326,6 +2670,21 @@ bool ConnectionReceiveThread::checkIncomingBuffers(Channel *channel,
 	return false;
 }
 
+void ConnectionReceiveThread::detectLostPackets(Channel *channel,
+		u16 acked_seqnum, float acked_age)
+{
+	u16 first_lost = 0;
+	unsigned int lost = channel->outgoing_reliables_sent.markLostBefore(
+			acked_seqnum, acked_age, FAST_RETRANSMIT_THRESHOLD, first_lost);
+	if (lost > 0) {
+		LOG(dout_con<<m_connection->getDesc()
+				<<" Fast retransmit of " << lost << " packets from seqnum "
+				<< first_lost << std::endl);
+		channel->onPacketLost(first_lost, false);
+		m_connection->TriggerSend();
+	}
+}
+
 SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 		SharedBuffer<u8> packetdata, u16 peer_id, u8 channelnum, bool reliable)
 {
@@ -2399,6 +2758,8 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 				}
 				//put bytes for max bandwidth calculation
 				channel->UpdateBytesSent(p.data.getSize(),1);
+				channel->onPacketAcked(seqnum);
+				detectLostPackets(channel, seqnum, p.time);
 				if (channel->outgoing_reliables_sent.size() == 0)
 				{
 					m_connection->TriggerSend();
@@ -2413,6 +2774,58 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 			}
 			throw ProcessedSilentlyException("Got an ACK");
 		}
+		else if (controltype == CONTROLTYPE_SACK)
+		{
+			assert(channel != NULL);
+
+			if (packetdata.getSize() < 5) {
+				throw InvalidIncomingDataException(
+					"packetdata.getSize() < 5 (SACK header size)");
+			}
+
+			u16 next_expected = readU16(&packetdata[2]);
+			u8 range_count = readU8(&packetdata[4]);
+			if (packetdata.getSize() < 5 + (u32) range_count * 4) {
+				throw InvalidIncomingDataException(
+					"packetdata.getSize() too small for SACK ranges");
+			}
+
+			std::vector<std::pair<u16, u16> > ranges;
+			u16 highest_acked = next_expected - 1;
+			for (u8 i = 0; i < range_count; i++) {
+				u16 first = readU16(&packetdata[5 + i * 4]);
+				u16 last = readU16(&packetdata[5 + i * 4 + 2]);
+				ranges.push_back(std::make_pair(first, last));
+				if (seqnum_higher(last, highest_acked))
+					highest_acked = last;
+			}
+			LOG(dout_con<<m_connection->getDesc()
+					<<" [ CONTROLTYPE_SACK: channelnum="
+					<<((int)channelnum&0xff)<<", peer_id="<<peer_id
+					<<", next_expected="<<next_expected
+					<<", ranges="<<((int)range_count)<< " ]"<<std::endl);
+
+			// No rtt is taken from these, the packets may have been
+			// received long before
+			std::list<BufferedPacket> acked;
+			channel->outgoing_reliables_sent.popAcked(next_expected, ranges,
+					acked);
+			float highest_acked_age = 0;
+			for (std::list<BufferedPacket>::iterator i = acked.begin();
+					i != acked.end(); ++i) {
+				u16 acked_seqnum = readU16(&(i->data[BASE_HEADER_SIZE+1]));
+				channel->UpdateBytesSent(i->data.getSize(), 1);
+				channel->onPacketAcked(acked_seqnum);
+				if (acked_seqnum == highest_acked)
+					highest_acked_age = i->time;
+			}
+
+			if (!acked.empty()) {
+				detectLostPackets(channel, highest_acked, highest_acked_age);
+				m_connection->TriggerSend();
+			}
+			throw ProcessedSilentlyException("Got a SACK");
+		}
 		else if (controltype == CONTROLTYPE_SET_PEER_ID) {
 			// Got a packet to set our peer id
 			if (packetdata.getSize() < 4)
@@ -2436,9 +2849,10 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 
 			ConnectionCommand cmd;
 
-			SharedBuffer<u8> reply(2);
+			SharedBuffer<u8> reply(3);
 			writeU8(&reply[0], TYPE_CONTROL);
 			writeU8(&reply[1], CONTROLTYPE_ENABLE_BIG_SEND_WINDOW);
+			writeU8(&reply[2], getControlFlags());
 			cmd.disableLegacy(PEER_ID_SERVER,reply);
 			m_connection->putCommand(cmd);
 
@@ -2468,7 +2882,38 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 		}
 		else if (controltype == CONTROLTYPE_ENABLE_BIG_SEND_WINDOW)
 		{
-			dynamic_cast<UDPPeer*>(&peer)->setNonLegacyPeer();
+			UDPPeer *udp_peer = dynamic_cast<UDPPeer*>(&peer);
+			bool had_sack = udp_peer->getSackEnabled();
+			bool had_compression = udp_peer->getCompressionEnabled();
+			udp_peer->setNonLegacyPeer();
+
+			u8 flags = 0;
+			if (packetdata.getSize() >= 3)
+				flags = readU8(&packetdata[2]);
+			u8 own_flags = getControlFlags();
+
+			bool changed = false;
+			if ((flags & CONTROLFLAG_SACK) && !had_sack) {
+				udp_peer->setSackEnabled();
+				changed = true;
+			}
+			if ((flags & own_flags & CONTROLFLAG_COMPRESSION) &&
+					!had_compression) {
+				udp_peer->setCompressionEnabled();
+				changed = true;
+			}
+
+			// Let the client know what the server understands too.
+			// Older clients never ask, so they don't get this.
+			if (changed && m_connection->GetPeerID() == PEER_ID_SERVER) {
+				ConnectionCommand cmd;
+				SharedBuffer<u8> reply(3);
+				writeU8(&reply[0], TYPE_CONTROL);
+				writeU8(&reply[1], CONTROLTYPE_ENABLE_BIG_SEND_WINDOW);
+				writeU8(&reply[2], own_flags);
+				cmd.disableLegacy(peer_id, reply);
+				m_connection->putCommand(cmd);
+			}
 			throw ProcessedSilentlyException("Got non legacy control");
 		}
 		else{
@@ -2491,6 +2936,30 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 		memcpy(*payload, &(packetdata[ORIGINAL_HEADER_SIZE]), payload.getSize());
 		return payload;
 	}
+	else if (type == TYPE_COMPRESSED)
+	{
+		// Packets are only decompressed in the order they were compressed
+		// in if they are reliable
+		if (!reliable)
+			throw InvalidIncomingDataException("Unreliable compressed packet");
+
+		assert(channel != NULL);
+		try {
+			SharedBuffer<u8> data = channel->compression.decompress(
+					*packetdata, packetdata.getSize());
+			LOG(dout_con<<m_connection->getDesc()
+					<<"RETURNING TYPE_COMPRESSED to user, size="
+					<<data.getSize()<<std::endl);
+			return data;
+		}
+		catch(InvalidIncomingDataException &e) {
+			// The following packets can't be decompressed either
+			ConnectionCommand discon;
+			discon.disconnect_peer(peer_id);
+			m_connection->putCommand(discon);
+			throw;
+		}
+	}
 	else if (type == TYPE_SPLIT)
 	{
 		Address peer_address;
@@ -2539,11 +3008,15 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 		u16 seqnum = readU16(&packetdata[1]);
 		bool is_future_packet = false;
 		bool is_old_packet = false;
+		bool use_sack = dynamic_cast<UDPPeer*>(&peer)->getSackEnabled();
 
 		/* packet is within our receive window send ack */
 		if (seqnum_in_window(seqnum, channel->readNextIncomingSeqNum(),MAX_RELIABLE_WINDOW_SIZE))
 		{
-			m_connection->sendAck(peer_id,channelnum,seqnum);
+			/* packets out of order are acknowledged by a SACK together
+			 * with all other buffered ones once they are buffered */
+			if (!use_sack || seqnum == channel->readNextIncomingSeqNum())
+				m_connection->sendAck(peer_id,channelnum,seqnum);
 		}
 		else {
 			is_future_packet = seqnum_higher(seqnum, channel->readNextIncomingSeqNum());
@@ -2564,7 +3037,10 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 						<< "RE-SENDING ACK: peer_id: " << peer_id
 						<< ", channel: " << (channelnum&0xFF)
 						<< ", seqnum: " << seqnum << std::endl;)
-				m_connection->sendAck(peer_id,channelnum,seqnum);
+				if (use_sack)
+					m_connection->sendSack(peer_id, channelnum, channel);
+				else
+					m_connection->sendAck(peer_id,channelnum,seqnum);
 
 				// we already have this packet so this one was on wire at least
 				// the current timeout
@@ -2592,6 +3068,8 @@ SharedBuffer<u8> ConnectionReceiveThread::processPacket(Channel *channel,
 					channelnum);
 			try{
 				channel->incoming_reliables.insert(packet,channel->readNextIncomingSeqNum());
+				if (use_sack)
+					m_connection->sendSack(peer_id, channelnum, channel);
 
 				LOG(dout_con<<m_connection->getDesc()
 						<< "BUFFERING, TYPE_RELIABLE peer_id: " << peer_id
@@ -2918,6 +3396,17 @@ void Connection::Send(u16 peer_id, u8 channelnum,
 	putCommand(c);
 }
 
+void Connection::Send(u16 peer_id, u8 channelnum,
+		const SharedBuffer<u8> &data, bool reliable)
+{
+	assert(channelnum < CHANNEL_COUNT); // Pre-condition
+
+	ConnectionCommand c;
+
+	c.send(peer_id, channelnum, data, reliable);
+	putCommand(c);
+}
+
 Address Connection::GetPeerAddress(u16 peer_id)
 {
 	PeerHelper peer = getPeerNoEx(peer_id);
@@ -3076,6 +3565,34 @@ void Connection::sendAck(u16 peer_id, u8 channelnum, u16 seqnum)
 	m_sendThread.Trigger();
 }
 
+void Connection::sendSack(u16 peer_id, u8 channelnum, Channel *channel)
+{
+	assert(channelnum < CHANNEL_COUNT); // Pre-condition
+
+	std::vector<std::pair<u16, u16> > ranges;
+	channel->incoming_reliables.getRanges(ranges, SACK_MAX_RANGES);
+
+	LOG(dout_con<<getDesc()
+			<<" Queuing SACK command to peer_id: " << peer_id <<
+			" channel: " << (channelnum & 0xFF) <<
+			" ranges: " << ranges.size() << std::endl);
+
+	ConnectionCommand c;
+	SharedBuffer<u8> sack(5 + ranges.size() * 4);
+	writeU8(&sack[0], TYPE_CONTROL);
+	writeU8(&sack[1], CONTROLTYPE_SACK);
+	writeU16(&sack[2], channel->readNextIncomingSeqNum());
+	writeU8(&sack[4], ranges.size());
+	for (u32 i = 0; i < ranges.size(); i++) {
+		writeU16(&sack[5 + i * 4], ranges[i].first);
+		writeU16(&sack[5 + i * 4 + 2], ranges[i].second);
+	}
+
+	c.ack(peer_id, channelnum, sack);
+	putCommand(c);
+	m_sendThread.Trigger();
+}
+
 UDPPeer* Connection::createServerPeer(Address& address)
 {
 	if (getPeerNoEx(PEER_ID_SERVER) != 0)
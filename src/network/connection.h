@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "exceptions.h"
 #include "constants.h"
 #include "network/networkpacket.h"
+#include "util/basic_macros.h"
 #include "util/pointer.h"
 #include "util/container.h"
 #include "util/thread.h"
@@ -33,8 +34,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <fstream>
 #include <list>
 #include <map>
+#include <vector>
 
 class NetworkPacket;
+struct z_stream_s;
 
 namespace con
 {
@@ -166,18 +169,54 @@ struct BufferedPacket
 {
 	BufferedPacket(u8 *a_data, u32 a_size):
 		data(a_data, a_size), time(0.0), totaltime(0.0), absolute_send_time(-1),
-		resend_count(0)
+		resend_count(0), nack_count(0)
 	{}
 	BufferedPacket(u32 a_size):
 		data(a_size), time(0.0), totaltime(0.0), absolute_send_time(-1),
-		resend_count(0)
+		resend_count(0), nack_count(0)
 	{}
-	Buffer<u8> data; // Data of the packet, including headers
+	SharedBuffer<u8> data; // Data of the packet, including headers
 	float time; // Seconds from buffering the packet or re-sending
 	float totaltime; // Seconds from buffering the packet
 	unsigned int absolute_send_time;
 	Address address; // Sender or destination
 	unsigned int resend_count;
+	// ACKs received for later packets since this one was (re-)sent
+	unsigned int nack_count;
+};
+
+/*
+	The contents of one datagram before the base header is added.
+	The payload is a range of a SharedBuffer that is shared with the
+	whole packet, so splitting a packet into chunks and adding headers
+	doesn't copy it. The headers are kept in front of it separately.
+	The data is copied only once, by makePacket().
+*/
+struct PacketChunk
+{
+	PacketChunk():
+		header_size(0), offset(0), size(0)
+	{}
+	// All of data, without headers
+	PacketChunk(const SharedBuffer<u8> &a_data):
+		header_size(0), data(a_data), offset(0), size(a_data.getSize())
+	{}
+
+	u32 getSize() const
+	{
+		return header_size + size;
+	}
+
+	// Puts a header in front of the ones already added
+	void prependHeader(const u8 *h, u32 len);
+	// Copies the headers and the payload to dst (getSize() bytes)
+	void copyTo(u8 *dst) const;
+
+	u8 header[16];
+	u32 header_size;
+	SharedBuffer<u8> data;
+	u32 offset;
+	u32 size;
 };
 
 // This adds the base headers to the data and makes a packet out of it
@@ -185,20 +224,22 @@ BufferedPacket makePacket(Address &address, u8 *data, u32 datasize,
 		u32 protocol_id, u16 sender_peer_id, u8 channel);
 BufferedPacket makePacket(Address &address, SharedBuffer<u8> &data,
 		u32 protocol_id, u16 sender_peer_id, u8 channel);
+BufferedPacket makePacket(Address &address, const PacketChunk &chunk,
+		u32 protocol_id, u16 sender_peer_id, u8 channel);
 
 // Add the TYPE_ORIGINAL header to the data
-SharedBuffer<u8> makeOriginalPacket(
+PacketChunk makeOriginalPacket(
 		SharedBuffer<u8> data);
 
 // Split data in chunks and add TYPE_SPLIT headers to them
-std::list<SharedBuffer<u8> > makeSplitPacket(
+std::list<PacketChunk> makeSplitPacket(
 		SharedBuffer<u8> data,
 		u32 chunksize_max,
 		u16 seqnum);
 
 // Depending on size, make a TYPE_ORIGINAL or TYPE_SPLIT packet
 // Increments split_seqnum if a split packet is made
-std::list<SharedBuffer<u8> > makeAutoSplitPacket(
+std::list<PacketChunk> makeAutoSplitPacket(
 		SharedBuffer<u8> data,
 		u32 chunksize_max,
 		u16 &split_seqnum);
@@ -207,6 +248,9 @@ std::list<SharedBuffer<u8> > makeAutoSplitPacket(
 SharedBuffer<u8> makeReliablePacket(
 		SharedBuffer<u8> data,
 		u16 seqnum);
+PacketChunk makeReliablePacket(
+		const PacketChunk &chunk,
+		u16 seqnum);
 
 struct IncomingSplitPacket
 {
@@ -264,6 +308,19 @@ controltype and data description:
 	- There is no actual reply, but this can be sent in a reliable
 	  packet to get a reply
 	CONTROLTYPE_DISCO
+	CONTROLTYPE_ENABLE_BIG_SEND_WINDOW
+		[2] u8 flags (optional, CONTROLFLAG_*)
+	- Sent by the client once it has a peer id. A server receiving
+	  CONTROLFLAG_SACK answers with its own ENABLE_BIG_SEND_WINDOW.
+	CONTROLTYPE_SACK
+		[2] u16 next expected seqnum (everything before was received)
+		[4] u8 range count
+		[5] u16 first seqnum, u16 last seqnum (inclusive), per range
+	- Only sent to peers that announced CONTROLFLAG_SACK. Acknowledges
+	  all reliable packets that have been received out of order.
+	CONTROLFLAG_COMPRESSION tells that the sender can receive
+	TYPE_COMPRESSED packets. It is only announced if the
+	network_compression setting is enabled.
 */
 #define TYPE_CONTROL 0
 #define CONTROLTYPE_ACK 0
@@ -271,6 +328,10 @@ controltype and data description:
 #define CONTROLTYPE_PING 2
 #define CONTROLTYPE_DISCO 3
 #define CONTROLTYPE_ENABLE_BIG_SEND_WINDOW 4
+#define CONTROLTYPE_SACK 5
+
+#define CONTROLFLAG_SACK 0x01
+#define CONTROLFLAG_COMPRESSION 0x02
 
 /*
 ORIGINAL: This is a plain packet with no control and no error
@@ -311,6 +372,52 @@ with a buffer in the receiving and transmitting end.
 #define TYPE_RELIABLE 3
 #define RELIABLE_HEADER_SIZE 3
 #define SEQNUM_INITIAL 65500
+/*
+COMPRESSED: An ORIGINAL packet whose data is deflated. Only sent atop of
+a RELIABLE packet stream, to peers that announced CONTROLFLAG_COMPRESSION.
+- All compressed packets of a channel share one raw deflate stream, so
+  later packets refer to the data of earlier ones. Each is flushed with
+  Z_SYNC_FLUSH and the trailing 00 00 ff ff is left out.
+- Only small packets are compressed, split packets never are.
+	Header (1 byte):
+	[0] u8 type
+*/
+#define TYPE_COMPRESSED 4
+#define COMPRESSED_HEADER_SIZE 1
+// Packets with less data are sent as they are
+#define COMPRESSION_MIN_SIZE 32
+// Room left for the deflate overhead of incompressible data
+#define COMPRESSION_MARGIN 16
+#define COMPRESSION_WINDOW_BITS 12
+#define COMPRESSION_MEM_LEVEL 4
+// Largest data a compressed packet may inflate to
+#define COMPRESSION_MAX_INFLATED_SIZE 65536
+
+/*
+	The deflate and inflate streams of the compressed packets of a channel.
+	Compressing is only done by the send thread and decompressing only
+	by the receive thread. Both are set up on first use.
+*/
+class ChannelCompression
+{
+public:
+	ChannelCompression();
+	~ChannelCompression();
+
+	// Returns a TYPE_COMPRESSED packet holding data
+	SharedBuffer<u8> compress(const u8 *data, u32 size);
+
+	// Returns the data of a TYPE_COMPRESSED packet.
+	// Throws InvalidIncomingDataException if it is broken, after which
+	// the stream cannot be used anymore.
+	SharedBuffer<u8> decompress(const u8 *packetdata, u32 size);
+
+private:
+	z_stream_s *m_deflate;
+	z_stream_s *m_inflate;
+
+	DISABLE_CLASS_COPY(ChannelCompression);
+};
 
 /*
 	A buffer which stores reliable packets and sorts them internally
@@ -334,6 +441,22 @@ class ReliablePacketBuffer
 	std::list<BufferedPacket> getTimedOuts(float timeout,
 			unsigned int max_packets);
 
+	// Removes the packets acknowledged by a CONTROLTYPE_SACK
+	void popAcked(u16 next_expected,
+			const std::vector<std::pair<u16, u16> > &ranges,
+			std::list<BufferedPacket> &acked);
+	// Gets the seqnum ranges of the buffered packets, in order
+	void getRanges(std::vector<std::pair<u16, u16> > &ranges,
+			unsigned int max_ranges);
+	/*
+		Counts an ACK of seqnum, last sent acked_age seconds ago, against
+		every packet that was sent before it. Returns how many packets
+		reached threshold with this ACK; those are returned by the next
+		getTimedOuts() call.
+	*/
+	unsigned int markLostBefore(u16 seqnum, float acked_age,
+			unsigned int threshold, u16 &first_lost);
+
 	void print();
 	bool empty();
 	bool containsPacket(u16 seqnum);
@@ -379,11 +502,11 @@ struct OutgoingPacket
 {
 	u16 peer_id;
 	u8 channelnum;
-	SharedBuffer<u8> data;
+	PacketChunk data;
 	bool reliable;
 	bool ack;
 
-	OutgoingPacket(u16 peer_id_, u8 channelnum_, SharedBuffer<u8> data_,
+	OutgoingPacket(u16 peer_id_, u8 channelnum_, const PacketChunk &data_,
 			bool reliable_,bool ack_=false):
 		peer_id(peer_id_),
 		channelnum(channelnum_),
@@ -413,7 +536,7 @@ struct ConnectionCommand
 	Address address;
 	u16 peer_id;
 	u8 channelnum;
-	Buffer<u8> data;
+	SharedBuffer<u8> data;
 	bool reliable;
 	bool raw;
 
@@ -447,6 +570,15 @@ struct ConnectionCommand
 		data = pkt->oldForgePacket();
 		reliable = reliable_;
 	}
+	void send(u16 peer_id_, u8 channelnum_,
+			const SharedBuffer<u8> &data_, bool reliable_)
+	{
+		type = CONNCMD_SEND;
+		peer_id = peer_id_;
+		channelnum = channelnum_;
+		data = data_;
+		reliable = reliable_;
+	}
 
 	void ack(u16 peer_id_, u8 channelnum_, SharedBuffer<u8> data_)
 	{
@@ -507,6 +639,8 @@ class Channel
 
 	IncomingSplitBuffer incoming_splits;
 
+	ChannelCompression compression;
+
 	Channel();
 	~Channel();
 
@@ -516,7 +650,27 @@ class Channel
 	void UpdateBytesLost(unsigned int bytes);
 	void UpdateBytesReceived(unsigned int bytes);
 
-	void UpdateTimers(float dtime, bool legacy_peer);
+	void UpdateTimers(float dtime);
+
+	/*
+		Congestion control, only done for non legacy peers.
+		The window grows by one packet per ACK below the slow start
+		threshold and by about one packet per window above it. A lost
+		packet halves it, a resend timeout drops it to the minimum.
+		Either happens at most once per window of packets.
+	*/
+	void enableCongestionControl(unsigned int initial_window);
+	void onPacketAcked(u16 seqnum);
+	void onPacketLost(u16 seqnum, bool timeout);
+
+	/*
+		Pacing spreads the window over one round trip time instead of
+		sending it in one burst. The budget is the number of packets
+		that may be sent now.
+	*/
+	void updatePacing(float dtime, float rtt);
+	unsigned int getPacingBudget(unsigned int wanted);
+	void consumePacingBudget(unsigned int count);
 
 	const float getCurrentDownloadRateKB()
 		{ MutexAutoLock lock(m_internal_mutex); return cur_kbps; };
@@ -547,6 +701,13 @@ class Channel
 	Mutex m_internal_mutex;
 	int window_size;
 
+	bool m_congestion_control;
+	float m_congestion_window;
+	float m_slow_start_threshold;
+	bool m_in_recovery;
+	u16 m_recovery_seqnum;
+	float m_pacing_budget;
+
 	u16 next_incoming_seqnum;
 
 	u16 next_outgoing_seqnum;
@@ -555,7 +716,6 @@ class Channel
 	unsigned int current_packet_loss;
 	unsigned int current_packet_too_late;
 	unsigned int current_packet_successfull;
-	float packet_loss_counter;
 
 	unsigned int current_bytes_transfered;
 	unsigned int current_bytes_received;
@@ -805,6 +965,20 @@ class UDPPeer : public Peer
 	bool getLegacyPeer()
 	{ return m_legacy_peer; }
 
+	// Whether the peer understands CONTROLTYPE_SACK
+	void setSackEnabled()
+	{ MutexAutoLock lock(m_exclusive_access_mutex); m_sack_enabled = true; }
+
+	bool getSackEnabled()
+	{ MutexAutoLock lock(m_exclusive_access_mutex); return m_sack_enabled; }
+
+	// Whether small reliable packets to the peer are compressed
+	void setCompressionEnabled()
+	{ MutexAutoLock lock(m_exclusive_access_mutex); m_compression_enabled = true; }
+
+	bool getCompressionEnabled()
+	{ MutexAutoLock lock(m_exclusive_access_mutex); return m_compression_enabled; }
+
 	u16 getNextSplitSequenceNumber(u8 channel);
 	void setNextSplitSequenceNumber(u8 channel, u16 seqnum);
 
@@ -816,10 +990,16 @@ class UDPPeer : public Peer
 protected:
 	/*
 		Calculates avg_rtt and resend_timeout.
+		resend_timeout is the smoothed rtt plus four times its variance.
 		rtt=-1 only recalculates resend_timeout
 	*/
 	void reportRTT(float rtt);
 
+	// Smoothed round trip time, RESEND_TIMEOUT_MIN while unknown
+	float getRoundTripTime()
+		{ MutexAutoLock lock(m_exclusive_access_mutex);
+		  return m_smoothed_rtt < 0 ? RESEND_TIMEOUT_MIN : m_smoothed_rtt; }
+
 	void RunCommandQueues(
 					unsigned int max_packet_size,
 					unsigned int maxcommands,
@@ -837,12 +1017,16 @@ class UDPPeer : public Peer
 private:
 	// This is changed dynamically
 	float resend_timeout;
+	float m_smoothed_rtt;
+	float m_rtt_variance;
 
 	bool processReliableSendCommand(
 					ConnectionCommand &c,
 					unsigned int max_packet_size);
 
 	bool m_legacy_peer;
+	bool m_sack_enabled;
+	bool m_compression_enabled;
 };
 
 /*
@@ -929,11 +1113,20 @@ class ConnectionSendThread : public Thread {
 	void setPeerTimeout(float peer_timeout)
 		{ m_timeout = peer_timeout; }
 
+	/*
+		Simulates a bad link for testing: drops loss_ratio of all sent
+		packets and delays the others by latency_ms.
+	*/
+	void setSimulatedLink(float loss_ratio, u32 latency_ms)
+		{ m_simulated_loss = loss_ratio; m_simulated_latency_ms = latency_ms; }
+
 private:
 	void runTimeouts    (float dtime);
 	void rawSend        (const BufferedPacket &packet);
+	void socketSend     (const BufferedPacket &packet);
+	void sendDelayedPackets(bool all);
 	bool rawSendAsPacket(u16 peer_id, u8 channelnum,
-							SharedBuffer<u8> data, bool reliable);
+							const PacketChunk &data, bool reliable);
 
 	void processReliableCommand (ConnectionCommand &c);
 	void processNonReliableCommand (ConnectionCommand &c);
@@ -951,7 +1144,7 @@ class ConnectionSendThread : public Thread {
 	void sendPackets    (float dtime);
 
 	void sendAsPacket   (u16 peer_id, u8 channelnum,
-							SharedBuffer<u8> data,bool ack=false);
+							const PacketChunk &data, bool ack=false);
 
 	void sendAsPacketReliable(BufferedPacket& p, Channel* channel);
 
@@ -967,6 +1160,13 @@ class ConnectionSendThread : public Thread {
 	unsigned int          m_max_commands_per_iteration;
 	unsigned int          m_max_data_packets_per_iteration;
 	unsigned int          m_max_packets_requeued;
+	// Set when pacing held back packets that could have been sent
+	bool                  m_pacing_limited;
+
+	float                 m_simulated_loss;
+	u32                   m_simulated_latency_ms;
+	// Packets delayed by the simulated link, with their time to send
+	std::queue<std::pair<u32, BufferedPacket> > m_delayed_packets;
 };
 
 class ConnectionReceiveThread : public Thread {
@@ -991,6 +1191,10 @@ class ConnectionReceiveThread : public Thread {
 	bool checkIncomingBuffers(Channel *channel, u16 &peer_id,
 							SharedBuffer<u8> &dst);
 
+	// Fast retransmit of packets that later packets overtook
+	void detectLostPackets(Channel *channel, u16 acked_seqnum,
+			float acked_age);
+
 	/*
 		Processes a packet with the basic header stripped out.
 		Parameters:
@@ -1028,6 +1232,10 @@ class Connection
 	void Disconnect();
 	void Receive(NetworkPacket* pkt);
 	void Send(u16 peer_id, u8 channelnum, NetworkPacket* pkt, bool reliable);
+	// Sends a packet made with NetworkPacket::oldForgePacket(); lets the
+	// same packet be sent to several peers without copying it
+	void Send(u16 peer_id, u8 channelnum, const SharedBuffer<u8> &data,
+			bool reliable);
 	u16 GetPeerID() { return m_peer_id; }
 	Address GetPeerAddress(u16 peer_id);
 	float getPeerStat(u16 peer_id, rtt_stat_type type);
@@ -1036,6 +1244,10 @@ class Connection
 	const std::string getDesc();
 	void DisconnectPeer(u16 peer_id);
 
+	// For testing, see ConnectionSendThread::setSimulatedLink()
+	void setSimulatedLink(float loss_ratio, u32 latency_ms)
+		{ m_sendThread.setSimulatedLink(loss_ratio, latency_ms); }
+
 protected:
 	PeerHelper getPeer(u16 peer_id);
 	PeerHelper getPeerNoEx(u16 peer_id);
@@ -1048,6 +1260,7 @@ class Connection
 	void SetPeerID(u16 id) { m_peer_id = id; }
 
 	void sendAck(u16 peer_id, u8 channelnum, u16 seqnum);
+	void sendSack(u16 peer_id, u8 channelnum, Channel *channel);
 
 	void PrintInfo(std::ostream &out);
 	void PrintInfo();
@@ -0,0 +1,617 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "mediaserver.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include "threading/thread.h"
+#include "debug.h"
+#include "log.h"
+#include "porting.h"
+#include "util/hex.h"
+#include "util/serialize.h"
+#include "util/string.h"
+
+#ifdef _WIN32
+	#define LAST_SOCKET_ERR() WSAGetLastError()
+	#define close_socket(fd) closesocket(fd)
+	typedef int socklen_t;
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <sys/select.h>
+	#include <sys/stat.h>
+	#include <sys/time.h>
+	#include <netinet/in.h>
+	#include <fcntl.h>
+	#include <signal.h>
+	#include <pthread.h>
+	#include <unistd.h>
+	#define LAST_SOCKET_ERR() (errno)
+	#define close_socket(fd) close(fd)
+#endif
+
+#ifdef __linux__
+	#include <sys/sendfile.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+// Same as in clientmedia.cpp
+#define MTHASHSET_FILE_SIGNATURE 0x4d544853 // 'MTHS'
+#define MTHASHSET_FILE_VERSION 1
+
+class MediaServerAcceptThread : public Thread
+{
+public:
+	MediaServerAcceptThread(MediaHTTPServer *server):
+		Thread("MediaServerAccept"),
+		m_server(server)
+	{}
+
+	void *run()
+	{
+		DSTACK(FUNCTION_NAME);
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		m_server->acceptConnections(this);
+
+		END_DEBUG_EXCEPTION_HANDLER
+
+		return NULL;
+	}
+
+private:
+	MediaHTTPServer *m_server;
+};
+
+class MediaServerWorkerThread : public Thread
+{
+public:
+	MediaServerWorkerThread(MediaHTTPServer *server):
+		Thread("MediaServer"),
+		m_server(server)
+	{}
+
+	void *run()
+	{
+		DSTACK(FUNCTION_NAME);
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+#ifndef _WIN32
+		// A client closing its connection early must not kill the process.
+		// sendfile() has no MSG_NOSIGNAL.
+		sigset_t sigpipe;
+		sigemptyset(&sigpipe);
+		sigaddset(&sigpipe, SIGPIPE);
+		pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+#endif
+
+		while (!stopRequested()) {
+			MediaConnection conn;
+			try {
+				conn = m_server->m_connections.pop_front(MEDIA_SERVER_POLL_MS);
+			} catch (ItemNotFoundException &e) {
+				continue;
+			}
+
+			if (m_server->serveConnection(conn, this)) {
+				conn.idle_since = porting::getTimeMs();
+				m_server->m_idle_connections.push_back(conn);
+			} else {
+				close_socket(conn.fd);
+			}
+		}
+
+		END_DEBUG_EXCEPTION_HANDLER
+
+		return NULL;
+	}
+
+private:
+	MediaHTTPServer *m_server;
+};
+
+// Waits until fd is readable, a stop is requested or timeout_ms passed.
+static bool waitReadable(int fd, Thread *thread, u32 timeout_ms)
+{
+	u32 start = porting::getTimeMs();
+	for (;;) {
+		u32 waited_ms = porting::getTimeMs() - start;
+		if (waited_ms >= timeout_ms || thread->stopRequested())
+			return false;
+
+		fd_set readset;
+		FD_ZERO(&readset);
+		FD_SET(fd, &readset);
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = MYMIN(timeout_ms - waited_ms, MEDIA_SERVER_POLL_MS) * 1000;
+
+		int result = select(fd + 1, &readset, NULL, NULL, &tv);
+		if (result < 0 && LAST_SOCKET_ERR() != EINTR)
+			return false;
+		if (result > 0)
+			return true;
+	}
+}
+
+// Appends what arrives on fd to buf.
+// Returns false if the connection was closed or the deadline from
+// porting::getTimeMs() passed.
+static bool receiveSome(int fd, std::string &buf, Thread *thread, u32 deadline)
+{
+	s32 remaining = deadline - porting::getTimeMs();
+	if (remaining <= 0 || !waitReadable(fd, thread, remaining))
+		return false;
+
+	char data[4096];
+	int received = recv(fd, data, sizeof(data), 0);
+	if (received <= 0)
+		return false;
+	buf.append(data, received);
+	return true;
+}
+
+static bool sendAll(int fd, const char *data, size_t size)
+{
+	while (size > 0) {
+		int sent = send(fd, data, size, MSG_NOSIGNAL);
+		if (sent < 0 && LAST_SOCKET_ERR() == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+static bool sendResponseHeader(int fd, const char *status, u64 content_length,
+		bool keep_alive)
+{
+	std::ostringstream os;
+	os << "HTTP/1.1 " << status << "\r\n"
+		<< "Content-Length: " << content_length << "\r\n"
+		<< "Content-Type: application/octet-stream\r\n"
+		<< "Connection: " << (keep_alive ? "keep-alive" : "close") << "\r\n"
+		<< "\r\n";
+	std::string header = os.str();
+	return sendAll(fd, header.c_str(), header.size());
+}
+
+// Sends a response without a body and closes the connection afterwards
+static bool sendError(int fd, const char *status)
+{
+	sendResponseHeader(fd, status, 0, false);
+	return false;
+}
+
+/*
+	MediaHTTPServer
+*/
+
+MediaHTTPServer::MediaHTTPServer(const std::map<std::string, std::string> &files):
+	m_files(files),
+	m_socket(-1),
+	m_accept_thread(NULL)
+{
+}
+
+MediaHTTPServer::~MediaHTTPServer()
+{
+	stop();
+}
+
+void MediaHTTPServer::start(const Address &bind_addr, u32 thread_count)
+{
+	stop();
+
+	int family = bind_addr.isIPv6() ? AF_INET6 : AF_INET;
+	m_socket = socket(family, SOCK_STREAM, IPPROTO_TCP);
+	if (m_socket < 0)
+		throw SocketException("Failed to create media server socket");
+
+	int value = 1;
+	setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR,
+			(const char *)&value, sizeof(value));
+
+	int result;
+	if (bind_addr.isIPv6()) {
+		struct sockaddr_in6 address = bind_addr.getAddress6();
+		address.sin6_family = AF_INET6;
+		address.sin6_port = htons(bind_addr.getPort());
+		result = bind(m_socket, (const struct sockaddr *)&address,
+				sizeof(address));
+	} else {
+		struct sockaddr_in address = bind_addr.getAddress();
+		address.sin_family = AF_INET;
+		address.sin_port = htons(bind_addr.getPort());
+		result = bind(m_socket, (const struct sockaddr *)&address,
+				sizeof(address));
+	}
+
+	if (result < 0 || listen(m_socket, 64) < 0) {
+		std::ostringstream os;
+		os << "Failed to listen on " << bind_addr.serializeString() << ":"
+			<< bind_addr.getPort() << ": " << strerror(LAST_SOCKET_ERR());
+		close_socket(m_socket);
+		m_socket = -1;
+		throw SocketException(os.str());
+	}
+
+	m_accept_thread = new MediaServerAcceptThread(this);
+	m_accept_thread->start();
+	for (u32 i = 0; i < MYMAX(thread_count, 1U); i++) {
+		MediaServerWorkerThread *worker = new MediaServerWorkerThread(this);
+		m_workers.push_back(worker);
+		worker->start();
+	}
+
+	infostream << "MediaHTTPServer: Serving " << m_files.size()
+		<< " files on port " << bind_addr.getPort() << std::endl;
+}
+
+void MediaHTTPServer::stop()
+{
+	if (m_accept_thread == NULL)
+		return;
+
+	// Set all threads stopping first
+	m_accept_thread->stop();
+	for (u32 i = 0; i < m_workers.size(); i++)
+		m_workers[i]->stop();
+
+	m_accept_thread->wait();
+	delete m_accept_thread;
+	m_accept_thread = NULL;
+	for (u32 i = 0; i < m_workers.size(); i++) {
+		m_workers[i]->wait();
+		delete m_workers[i];
+	}
+	m_workers.clear();
+
+	while (!m_connections.empty())
+		close_socket(m_connections.pop_frontNoEx().fd);
+	while (!m_idle_connections.empty())
+		close_socket(m_idle_connections.pop_frontNoEx().fd);
+	close_socket(m_socket);
+	m_socket = -1;
+}
+
+void MediaHTTPServer::acceptConnections(Thread *thread)
+{
+	// Connections waiting for a request
+	std::vector<MediaConnection> idle;
+
+	while (!thread->stopRequested()) {
+		while (!m_idle_connections.empty())
+			idle.push_back(m_idle_connections.pop_frontNoEx());
+
+		u32 now = porting::getTimeMs();
+		fd_set readset;
+		FD_ZERO(&readset);
+		FD_SET(m_socket, &readset);
+		int max_fd = m_socket;
+		for (size_t i = 0; i < idle.size();) {
+			if (now - idle[i].idle_since > MEDIA_SERVER_IDLE_TIMEOUT * 1000) {
+				close_socket(idle[i].fd);
+				idle[i] = idle.back();
+				idle.pop_back();
+				continue;
+			}
+			FD_SET(idle[i].fd, &readset);
+			max_fd = MYMAX(max_fd, idle[i].fd);
+			i++;
+		}
+
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = MEDIA_SERVER_POLL_MS * 1000;
+		if (select(max_fd + 1, &readset, NULL, NULL, &tv) <= 0)
+			continue;
+
+		// Hand connections with a request (or a close) to the workers
+		for (size_t i = 0; i < idle.size();) {
+			if (FD_ISSET(idle[i].fd, &readset)) {
+				m_connections.push_back(idle[i]);
+				idle[i] = idle.back();
+				idle.pop_back();
+			} else {
+				i++;
+			}
+		}
+
+		if (!FD_ISSET(m_socket, &readset))
+			continue;
+
+		int fd = accept(m_socket, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		// select() can only wait for a limited number of sockets
+		u32 open = idle.size() + m_connections.size() + m_workers.size();
+#ifdef _WIN32
+		if (open >= MYMIN(MEDIA_SERVER_MAX_CONNECTIONS, FD_SETSIZE - 1)) {
+#else
+		if (open >= MEDIA_SERVER_MAX_CONNECTIONS || fd >= FD_SETSIZE) {
+#endif
+			close_socket(fd);
+			continue;
+		}
+
+		// Don't let a client that stopped reading hold a worker forever
+#ifdef _WIN32
+		DWORD timeout = MEDIA_SERVER_IDLE_TIMEOUT * 1000;
+#else
+		struct timeval timeout;
+		timeout.tv_sec = MEDIA_SERVER_IDLE_TIMEOUT;
+		timeout.tv_usec = 0;
+#endif
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,
+				(const char *)&timeout, sizeof(timeout));
+
+		// Wait for the first request like for any other
+		MediaConnection conn(fd);
+		conn.idle_since = now;
+		idle.push_back(conn);
+	}
+
+	for (size_t i = 0; i < idle.size(); i++)
+		close_socket(idle[i].fd);
+}
+
+bool MediaHTTPServer::serveConnection(MediaConnection &conn, Thread *thread)
+{
+	for (;;) {
+		if (!serveRequest(conn, thread))
+			return false;
+
+		// Clients usually send the next request right after the response;
+		// if this one doesn't, give the connection back instead of
+		// keeping a worker waiting for it.
+		if (conn.buf.empty() &&
+				!waitReadable(conn.fd, thread, MEDIA_SERVER_LINGER_MS))
+			return true;
+	}
+}
+
+bool MediaHTTPServer::serveRequest(MediaConnection &conn, Thread *thread)
+{
+	int fd = conn.fd;
+	std::string &buf = conn.buf;
+	// Slow clients must not hold a worker
+	u32 deadline = porting::getTimeMs() + MEDIA_SERVER_REQUEST_TIMEOUT * 1000;
+
+	size_t header_end;
+	while ((header_end = buf.find("\r\n\r\n")) == std::string::npos) {
+		if (buf.size() > MEDIA_SERVER_MAX_HEADER_SIZE)
+			return sendError(fd, "431 Request Header Fields Too Large");
+		if (!receiveSome(fd, buf, thread, deadline))
+			return false;
+	}
+
+	HTTPRequest req;
+	if (!parseRequestHeader(buf.substr(0, header_end + 2), req))
+		return sendError(fd, "400 Bad Request");
+	buf.erase(0, header_end + 4);
+
+	if (req.content_length > MEDIA_SERVER_MAX_BODY_SIZE)
+		return sendError(fd, "413 Payload Too Large");
+	if (req.expect_continue && buf.size() < req.content_length) {
+		static const char *response = "HTTP/1.1 100 Continue\r\n\r\n";
+		if (!sendAll(fd, response, strlen(response)))
+			return false;
+	}
+	while (buf.size() < req.content_length) {
+		if (!receiveSome(fd, buf, thread, deadline))
+			return false;
+	}
+	std::string body = buf.substr(0, req.content_length);
+	buf.erase(0, req.content_length);
+
+	return handleRequest(fd, req, body) && req.keep_alive;
+}
+
+bool MediaHTTPServer::handleRequest(int fd, const HTTPRequest &req,
+		const std::string &body)
+{
+	if (req.path == "index.mth") {
+		if (req.method != "POST")
+			return sendError(fd, "405 Method Not Allowed");
+
+		std::string answer;
+		if (!answerHashSet(body, m_files, answer))
+			return sendError(fd, "400 Bad Request");
+
+		return sendResponseHeader(fd, "200 OK", answer.size(), req.keep_alive) &&
+			sendAll(fd, answer.c_str(), answer.size());
+	}
+
+	std::string sha1;
+	std::map<std::string, std::string>::const_iterator it;
+	if (!parseMediaPath(req.path, sha1) ||
+			(it = m_files.find(sha1)) == m_files.end())
+		return sendResponseHeader(fd, "404 Not Found", 0, req.keep_alive);
+
+	if (req.method != "GET" && req.method != "HEAD")
+		return sendError(fd, "405 Method Not Allowed");
+
+	return sendFile(fd, req, it->second);
+}
+
+bool MediaHTTPServer::sendFile(int fd, const HTTPRequest &req,
+		const std::string &path)
+{
+#ifdef __linux__
+	int file = open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if (file < 0 || fstat(file, &st) < 0) {
+		errorstream << "MediaHTTPServer: Can't open " << path << std::endl;
+		if (file >= 0)
+			close(file);
+		return sendError(fd, "500 Internal Server Error");
+	}
+
+	bool ok = sendResponseHeader(fd, "200 OK", st.st_size, req.keep_alive);
+	if (req.method == "GET") {
+		// Copies the file from the page cache without going through
+		// userspace
+		off_t offset = 0;
+		while (ok && offset < st.st_size) {
+			ssize_t sent = sendfile(fd, file, &offset, st.st_size - offset);
+			if (sent < 0 && errno == EINTR)
+				continue;
+			ok = sent > 0;
+		}
+	}
+	close(file);
+	return ok;
+#else
+	std::ifstream is(path.c_str(), std::ios_base::binary);
+	if (!is.good()) {
+		errorstream << "MediaHTTPServer: Can't open " << path << std::endl;
+		return sendError(fd, "500 Internal Server Error");
+	}
+	is.seekg(0, std::ios_base::end);
+	u64 size = is.tellg();
+	is.seekg(0, std::ios_base::beg);
+
+	bool ok = sendResponseHeader(fd, "200 OK", size, req.keep_alive);
+	if (req.method == "GET") {
+		char data[16384];
+		while (ok && size > 0) {
+			is.read(data, MYMIN(size, sizeof(data)));
+			if (is.gcount() <= 0)
+				return false;
+			ok = sendAll(fd, data, is.gcount());
+			size -= is.gcount();
+		}
+	}
+	return ok;
+#endif
+}
+
+bool MediaHTTPServer::parseRequestHeader(const std::string &header,
+		HTTPRequest &req)
+{
+	std::vector<std::string> lines = str_split(header, '\n');
+	if (lines.empty())
+		return false;
+
+	// Request line: METHOD SP target SP HTTP/x.y
+	std::vector<std::string> parts = str_split(trim(lines[0]), ' ');
+	if (parts.size() != 3 || parts[1].empty() ||
+			parts[2].compare(0, 5, "HTTP/") != 0)
+		return false;
+
+	req.method = parts[0];
+	std::string target = parts[1];
+	size_t query = target.find('?');
+	if (query != std::string::npos)
+		target.erase(query);
+	if (target.empty() || target[0] != '/')
+		return false;
+	req.path = target.substr(1);
+
+	bool http10 = parts[2] == "HTTP/1.0";
+	req.keep_alive = !http10;
+	req.content_length = 0;
+	req.expect_continue = false;
+
+	for (size_t i = 1; i < lines.size(); i++) {
+		std::string line = trim(lines[i]);
+		if (line.empty())
+			continue;
+		size_t colon = line.find(':');
+		if (colon == std::string::npos || colon == 0)
+			return false;
+		std::string name = lowercase(trim(line.substr(0, colon)));
+		std::string value = trim(line.substr(colon + 1));
+
+		if (name == "content-length") {
+			if (value.empty() || value.size() > 9 ||
+					value.find_first_not_of("0123456789") != std::string::npos)
+				return false;
+			req.content_length = strtoul(value.c_str(), NULL, 10);
+		} else if (name == "connection") {
+			std::string token = lowercase(value);
+			if (token == "close")
+				req.keep_alive = false;
+			else if (token == "keep-alive")
+				req.keep_alive = true;
+		} else if (name == "expect") {
+			if (lowercase(value) != "100-continue")
+				return false;
+			req.expect_continue = !http10;
+		} else if (name == "transfer-encoding") {
+			// Clients always send the length of what they post
+			return false;
+		}
+	}
+	return true;
+}
+
+bool MediaHTTPServer::answerHashSet(const std::string &request,
+		const std::map<std::string, std::string> &files,
+		std::string &answer)
+{
+	/*
+		u32 signature 'MTHS'
+		u16 version 1
+		then raw SHA1 digests of 20 bytes each
+	*/
+	if (request.size() < 6 || (request.size() - 6) % 20 != 0 ||
+			readU32((const u8 *)&request[0]) != MTHASHSET_FILE_SIGNATURE ||
+			readU16((const u8 *)&request[4]) != MTHASHSET_FILE_VERSION)
+		return false;
+
+	std::ostringstream os(std::ios_base::binary);
+	writeU32(os, MTHASHSET_FILE_SIGNATURE);
+	writeU16(os, MTHASHSET_FILE_VERSION);
+	for (size_t pos = 6; pos < request.size(); pos += 20) {
+		std::string sha1 = request.substr(pos, 20);
+		if (files.find(sha1) != files.end())
+			os << sha1;
+	}
+	answer = os.str();
+	return true;
+}
+
+bool MediaHTTPServer::parseMediaPath(const std::string &path, std::string &sha1)
+{
+	if (path.size() != 40)
+		return false;
+
+	sha1.clear();
+	for (size_t i = 0; i < 40; i += 2) {
+		unsigned char high, low;
+		if (!hex_digit_decode(path[i], high) ||
+				!hex_digit_decode(path[i + 1], low))
+			return false;
+		sha1 += (char)((high << 4) | low);
+	}
+	return true;
+}
@@ -0,0 +1,146 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef MEDIASERVER_HEADER
+#define MEDIASERVER_HEADER
+
+#include <map>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "socket.h"
+#include "util/container.h"
+#include "util/basic_macros.h"
+
+#define MEDIA_SERVER_MAX_HEADER_SIZE 8192
+// index.mth requests carry 20 bytes per file
+#define MEDIA_SERVER_MAX_BODY_SIZE (6 + 20 * 65536)
+// Keep-alive connections are closed after this many idle seconds
+#define MEDIA_SERVER_IDLE_TIMEOUT 15
+// A request has to arrive completely within this many seconds
+#define MEDIA_SERVER_REQUEST_TIMEOUT 10
+// A worker waits this long for the next request on a connection before
+// giving it back to the accepting thread
+#define MEDIA_SERVER_LINGER_MS 100
+// Open connections beyond this many are refused
+#define MEDIA_SERVER_MAX_CONNECTIONS 256
+// Granularity in which blocking calls check for stop requests
+#define MEDIA_SERVER_POLL_MS 100
+
+class MediaServerAcceptThread;
+class MediaServerWorkerThread;
+class Thread;
+
+struct HTTPRequest
+{
+	HTTPRequest():
+		content_length(0),
+		keep_alive(false),
+		expect_continue(false)
+	{}
+
+	std::string method;
+	// Without the leading '/' and the query string
+	std::string path;
+	u32 content_length;
+	bool keep_alive;
+	bool expect_continue;
+};
+
+struct MediaConnection
+{
+	MediaConnection(int fd_=-1):
+		fd(fd_),
+		idle_since(0)
+	{}
+
+	int fd;
+	// Data received but not handled yet, requests may be pipelined
+	std::string buf;
+	// Time from porting::getTimeMs()
+	u32 idle_since;
+};
+
+/*
+	Serves media files to clients over HTTP, in the format that
+	ClientMediaDownloader expects from a remote_media server:
+	- POST index.mth with a hash set of the wanted files is answered with
+	  the hash set of those that are available
+	- GET <hex sha1> returns the file
+
+	One thread accepts connections and waits for requests on all idle
+	ones. It hands connections with a request to a pool of worker
+	threads, which give them back once the client pauses, so idle
+	keep-alive connections don't hold a worker. Connections idle for
+	MEDIA_SERVER_IDLE_TIMEOUT seconds are closed.
+*/
+class MediaHTTPServer
+{
+public:
+	// files maps raw SHA1 digests to the paths of the files
+	MediaHTTPServer(const std::map<std::string, std::string> &files);
+	~MediaHTTPServer();
+
+	// Throws SocketException if the socket can't be set up
+	void start(const Address &bind_addr, u32 thread_count);
+	void stop();
+
+	// Parses the header of a request, excluding the empty line that ends it.
+	// Returns false if it is malformed or uses features not supported here.
+	static bool parseRequestHeader(const std::string &header, HTTPRequest &req);
+
+	// Answers an index.mth hash set with the hash set of the requested files
+	// that are in files.
+	// Returns false if request is not a valid hash set.
+	static bool answerHashSet(const std::string &request,
+			const std::map<std::string, std::string> &files,
+			std::string &answer);
+
+	// Converts a path of 40 hex digits to a raw SHA1 digest.
+	// Returns false if path has a different form.
+	static bool parseMediaPath(const std::string &path, std::string &sha1);
+
+private:
+	friend class MediaServerAcceptThread;
+	friend class MediaServerWorkerThread;
+
+	void acceptConnections(Thread *thread);
+	// Returns false if the connection has to be closed
+	bool serveConnection(MediaConnection &conn, Thread *thread);
+	bool serveRequest(MediaConnection &conn, Thread *thread);
+	// Returns false if the connection has to be closed afterwards
+	bool handleRequest(int fd, const HTTPRequest &req,
+			const std::string &body);
+	bool sendFile(int fd, const HTTPRequest &req, const std::string &path);
+
+	// Read only while the threads run
+	std::map<std::string, std::string> m_files;
+
+	int m_socket;
+	MediaServerAcceptThread *m_accept_thread;
+	std::vector<MediaServerWorkerThread *> m_workers;
+	// Connections with a request, waiting for a worker
+	MutexedQueue<MediaConnection> m_connections;
+	// Connections given back by the workers, waiting for a request
+	MutexedQueue<MediaConnection> m_idle_connections;
+
+	DISABLE_CLASS_COPY(MediaHTTPServer);
+};
+
+#endif
@@ -48,12 +48,12 @@ class NetworkPacket
 		void putRawString(const char* src, u32 len);
 
 		NetworkPacket& operator>>(std::string& dst);
-		NetworkPacket& operator<<(std::string src);
+		NetworkPacket& operator<<(const std::string &src);
 
-		void putLongString(std::string src);
+		void putLongString(const std::string &src);
 
 		NetworkPacket& operator>>(std::wstring& dst);
-		NetworkPacket& operator<<(std::wstring src);
+		NetworkPacket& operator<<(const std::wstring &src);
 
 		std::string readLongString();
 
@@ -108,8 +108,9 @@ class NetworkPacket
 		NetworkPacket& operator>>(video::SColor& dst);
 		NetworkPacket& operator<<(video::SColor src);
 
-		// Temp, we remove SharedBuffer when migration finished
-		Buffer<u8> oldForgePacket();
+		// The command followed by the data, as handed to the connection.
+		// The connection shares this buffer instead of copying it.
+		SharedBuffer<u8> oldForgePacket();
 private:
 		void checkReadOffset(u32 from_offset, u32 field_size);
 
@@ -136,9 +136,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 		backface_culling: backwards compatibility for playing with
 		newer client on pre-27 servers.
 		Add nodedef v3 - connected nodeboxes
+	PROTOCOL_VERSION 28:
+		Add TOCLIENT_NODE_EDITS for batched node changes within a block
+	PROTOCOL_VERSION 29:
+		Add TOCLIENT_BLOCK_DELTA for resending only the changed nodes of
+		a block the client already has
 */
 
-#define LATEST_PROTOCOL_VERSION 27
+#define LATEST_PROTOCOL_VERSION 29
 
 // Server's supported network protocol range
 #define SERVER_PROTOCOL_VERSION_MIN 13
@@ -281,6 +286,41 @@ enum ToClientCommand
 		f1000 time_speed
 	*/
 
+	TOCLIENT_NODE_EDITS = 0x2A,
+	/*
+		v3s16 blockpos
+		u16 count
+		for each edit {
+			u16 node index within the block (z * 256 + y * 16 + x)
+			u8 type (0 = remove, 1 = add, 2 = add and keep metadata)
+			if type != 0 {
+				u16 param0
+				u8 param1
+				u8 param2
+			}
+		}
+	*/
+
+	TOCLIENT_BLOCK_DELTA = 0x2B,
+	/*
+		Changes to a block that was sent earlier with TOCLIENT_BLOCKDATA
+		or TOCLIENT_BLOCK_DELTA. Sent on the same channel as those.
+
+		v3s16 blockpos
+		zlib-compressed {
+			u8 flags (as in the block data)
+			u16 count
+			for each changed node {
+				u16 node index within the block (z * 256 + y * 16 + x)
+				u16 param0
+				u8 param1
+				u8 param2
+			}
+			u8 1 if node metadata follows, else 0
+			node metadata list (as in the block data, but not compressed)
+		}
+	*/
+
 	// (oops, there is some gap here)
 
 	TOCLIENT_CHAT_MESSAGE = 0x30,
@@ -904,6 +944,12 @@ enum AccessDeniedCode {
 	SERVER_ACCESSDENIED_MAX,
 };
 
+enum NodeEditType {
+	NODE_EDIT_REMOVE = 0,
+	NODE_EDIT_ADD = 1,
+	NODE_EDIT_ADD_KEEP_METADATA = 2,
+};
+
 enum NetProtoCompressionMode {
 	NETPROTO_COMPRESSION_NONE = 0,
 };
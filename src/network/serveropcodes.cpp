@@ -155,8 +155,8 @@ const ClientCommandFactory clientCommandFactoryTable[TOCLIENT_NUM_MSG_TYPES] =
 	{ "TOCLIENT_INVENTORY",                0, true }, // 0x27
 	null_command_factory,
 	{ "TOCLIENT_TIME_OF_DAY",              0, true }, // 0x29
-	null_command_factory,
-	null_command_factory,
+	{ "TOCLIENT_NODE_EDITS",               0, true }, // 0x2A
+	{ "TOCLIENT_BLOCK_DELTA",              2, true }, // 0x2B
 	null_command_factory,
 	null_command_factory,
 	null_command_factory,
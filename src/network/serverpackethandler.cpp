@@ -638,10 +638,10 @@ void Server::handleCommand_Init2(NetworkPacket* pkt)
 	SendMovement(pkt->getPeerId());
 
 	// Send item definitions
-	SendItemDef(pkt->getPeerId(), m_itemdef, protocol_version);
+	SendItemDef(pkt->getPeerId(), protocol_version);
 
 	// Send node definitions
-	SendNodeDef(pkt->getPeerId(), m_nodedef, protocol_version);
+	SendNodeDef(pkt->getPeerId(), protocol_version);
 
 	m_clients.event(pkt->getPeerId(), CSE_SetDefinitionsSent);
 
@@ -776,36 +776,21 @@ void Server::handleCommand_GotBlocks(NetworkPacket* pkt)
 
 void Server::handleCommand_PlayerPos(NetworkPacket* pkt)
 {
-	if (pkt->getSize() < 12 + 12 + 4 + 4)
+	PlayerPosUpdate pos;
+	if (!pos.deSerialize(pkt))
 		return;
 
-	v3s32 ps, ss;
-	s32 f32pitch, f32yaw;
-
-	*pkt >> ps;
-	*pkt >> ss;
-	*pkt >> f32pitch;
-	*pkt >> f32yaw;
-
-	f32 pitch = (f32)f32pitch / 100.0;
-	f32 yaw = (f32)f32yaw / 100.0;
-	u32 keyPressed = 0;
-
-	if (pkt->getSize() >= 12 + 12 + 4 + 4 + 4)
-		*pkt >> keyPressed;
-
-	v3f position((f32)ps.X / 100.0, (f32)ps.Y / 100.0, (f32)ps.Z / 100.0);
-	v3f speed((f32)ss.X / 100.0, (f32)ss.Y / 100.0, (f32)ss.Z / 100.0);
-
-	pitch = modulo360f(pitch);
-	yaw = modulo360f(yaw);
+	handlePlayerPos(pkt->getPeerId(), pos);
+}
 
-	Player *player = m_env->getPlayer(pkt->getPeerId());
+void Server::handlePlayerPos(u16 peer_id, const PlayerPosUpdate &pos)
+{
+	Player *player = m_env->getPlayer(peer_id);
 	if (player == NULL) {
 		errorstream << "Server::ProcessData(): Canceling: "
-				"No player for peer_id=" << pkt->getPeerId()
+				"No player for peer_id=" << peer_id
 				<< " disconnecting peer!" << std::endl;
-		m_con.DisconnectPeer(pkt->getPeerId());
+		m_con.DisconnectPeer(peer_id);
 		return;
 	}
 
@@ -819,16 +804,17 @@ void Server::handleCommand_PlayerPos(NetworkPacket* pkt)
 	PlayerSAO *playersao = player->getPlayerSAO();
 	if (playersao == NULL) {
 		errorstream << "Server::ProcessData(): Canceling: "
-				"No player object for peer_id=" << pkt->getPeerId()
+				"No player object for peer_id=" << peer_id
 				<< " disconnecting peer!" << std::endl;
-		m_con.DisconnectPeer(pkt->getPeerId());
+		m_con.DisconnectPeer(peer_id);
 		return;
 	}
 
-	player->setPosition(position);
-	player->setSpeed(speed);
-	player->setPitch(pitch);
-	player->setYaw(yaw);
+	u32 keyPressed = pos.keys_pressed;
+	player->setPosition(pos.position);
+	player->setSpeed(pos.speed);
+	player->setPitch(pos.pitch);
+	player->setYaw(pos.yaw);
 	player->keyPressed = keyPressed;
 	player->control.up = (keyPressed & 1);
 	player->control.down = (keyPressed & 2);
@@ -843,7 +829,7 @@ void Server::handleCommand_PlayerPos(NetworkPacket* pkt)
 	if (playersao->checkMovementCheat()) {
 		// Call callbacks
 		m_script->on_cheat(playersao, "moved_too_fast");
-		SendMovePlayer(pkt->getPeerId());
+		SendMovePlayer(peer_id);
 	}
 }
 
@@ -873,7 +859,7 @@ void Server::handleCommand_DeletedBlocks(NetworkPacket* pkt)
 	for (u16 i = 0; i < count; i++) {
 		v3s16 p;
 		*pkt >> p;
-		client->SetBlockNotSent(p);
+		client->SetBlockDeleted(p);
 	}
 }
 
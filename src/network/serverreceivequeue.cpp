@@ -0,0 +1,112 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "serverreceivequeue.h"
+#include "networkpacket.h"
+#include "networkprotocol.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/numeric.h"
+
+bool PlayerPosUpdate::deSerialize(NetworkPacket *pkt)
+{
+	/*
+		[0] u16 command
+		[2] v3s32 position*100
+		[2+12] v3s32 speed*100
+		[2+12+12] s32 pitch*100
+		[2+12+12+4] s32 yaw*100
+		[2+12+12+4+4] u32 keyPressed
+	*/
+	if (pkt->getSize() < 12 + 12 + 4 + 4)
+		return false;
+
+	v3s32 ps, ss;
+	s32 f32pitch, f32yaw;
+
+	*pkt >> ps;
+	*pkt >> ss;
+	*pkt >> f32pitch;
+	*pkt >> f32yaw;
+
+	keys_pressed = 0;
+	if (pkt->getSize() >= 12 + 12 + 4 + 4 + 4)
+		*pkt >> keys_pressed;
+
+	position = v3f((f32)ps.X / 100.0, (f32)ps.Y / 100.0, (f32)ps.Z / 100.0);
+	speed = v3f((f32)ss.X / 100.0, (f32)ss.Y / 100.0, (f32)ss.Z / 100.0);
+	pitch = modulo360f((f32)f32pitch / 100.0);
+	yaw = modulo360f((f32)f32yaw / 100.0);
+	return true;
+}
+
+ServerReceiveQueue::~ServerReceiveQueue()
+{
+	for (std::vector<ReceivedCommand>::iterator it = m_commands.begin();
+			it != m_commands.end(); ++it)
+		delete it->pkt;
+}
+
+void ServerReceiveQueue::push(const ReceivedCommand &cmd)
+{
+	MutexAutoLock lock(m_mutex);
+
+	bool decoded_playerpos = cmd.command == TOSERVER_PLAYERPOS &&
+			cmd.pkt == NULL;
+
+	std::map<u16, u32>::iterator it = m_last_playerpos.find(cmd.peer_id);
+	if (it != m_last_playerpos.end()) {
+		// A short key press would be lost by replacing the position
+		// that came with it
+		if (decoded_playerpos && cmd.playerpos.keys_pressed ==
+				m_commands[it->second].playerpos.keys_pressed) {
+			m_commands[it->second] = cmd;
+			return;
+		}
+		m_last_playerpos.erase(it);
+	}
+
+	if (decoded_playerpos)
+		m_last_playerpos[cmd.peer_id] = m_commands.size();
+
+	m_commands.push_back(cmd);
+	if (m_commands.size() == 1)
+		m_signal.post();
+}
+
+bool ServerReceiveQueue::popAll(std::vector<ReceivedCommand> &dst,
+		u32 timeout_ms)
+{
+	if (!m_signal.wait(timeout_ms))
+		return false;
+
+	MutexAutoLock lock(m_mutex);
+	if (m_commands.empty())
+		return false;
+
+	dst.insert(dst.end(), m_commands.begin(), m_commands.end());
+	m_commands.clear();
+	m_last_playerpos.clear();
+	return true;
+}
+
+u32 ServerReceiveQueue::size()
+{
+	MutexAutoLock lock(m_mutex);
+	return m_commands.size();
+}
@@ -0,0 +1,106 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef SERVERRECEIVEQUEUE_HEADER
+#define SERVERRECEIVEQUEUE_HEADER
+
+#include <map>
+#include <vector>
+#include "irrlichttypes_bloated.h"
+#include "threading/mutex.h"
+#include "threading/semaphore.h"
+
+class NetworkPacket;
+
+/*
+	Contents of a TOSERVER_PLAYERPOS packet
+*/
+struct PlayerPosUpdate
+{
+	PlayerPosUpdate():
+		pitch(0),
+		yaw(0),
+		keys_pressed(0)
+	{}
+
+	// Returns false if the packet is too short
+	bool deSerialize(NetworkPacket *pkt);
+
+	v3f position;
+	v3f speed;
+	f32 pitch; // In degrees, 0...360
+	f32 yaw; // In degrees, 0...360
+	u32 keys_pressed;
+};
+
+/*
+	A command from a client, decoded as far as possible without
+	access to the environment.
+*/
+struct ReceivedCommand
+{
+	ReceivedCommand():
+		peer_id(0),
+		command(0),
+		pkt(NULL)
+	{}
+
+	u16 peer_id;
+	u16 command;
+	// The packet, or NULL if it was decoded into one of the members below
+	NetworkPacket *pkt;
+	// If command is TOSERVER_PLAYERPOS
+	PlayerPosUpdate playerpos;
+};
+
+/*
+	Passes received commands from the thread that decodes them to the
+	server thread, which applies them in batches.
+
+	Only the newest position of a player matters, so a TOSERVER_PLAYERPOS
+	replaces the queued one of the same peer unless other commands from
+	that peer came in between or the pressed keys differ.
+*/
+class ServerReceiveQueue
+{
+public:
+	ServerReceiveQueue() {}
+	~ServerReceiveQueue();
+
+	// Takes ownership of cmd.pkt
+	void push(const ReceivedCommand &cmd);
+
+	// Waits up to timeout_ms for commands and appends all queued ones to
+	// dst. The caller owns their packets then.
+	// Returns false if there were none.
+	bool popAll(std::vector<ReceivedCommand> &dst, u32 timeout_ms);
+
+	u32 size();
+
+private:
+	Mutex m_mutex;
+	// Posted when the queue becomes non-empty
+	Semaphore m_signal;
+	std::vector<ReceivedCommand> m_commands;
+	// Peers whose last queued command is a decoded TOSERVER_PLAYERPOS,
+	// with its index in m_commands
+	std::map<u16, u32> m_last_playerpos;
+};
+
+#endif
@@ -43,27 +43,29 @@ v3f random_v3f(v3f min, v3f max)
 			rand()/(float)RAND_MAX*(max.Z-min.Z)+min.Z);
 }
 
-Particle::Particle(
+enum ParticleFlags {
+	PARTICLE_COLLISIONDETECTION = 1,
+	PARTICLE_VERTICAL = 2,
+};
+
+/*
+	ParticleBuffer
+*/
+
+ParticleBuffer::ParticleBuffer(
 	IGameDef *gamedef,
 	scene::ISceneManager* smgr,
 	LocalPlayer *player,
 	ClientEnvironment *env,
-	v3f pos,
-	v3f velocity,
-	v3f acceleration,
-	float expirationtime,
-	float size,
-	bool collisiondetection,
-	bool vertical,
-	video::ITexture *texture,
-	v2f texpos,
-	v2f texsize
+	video::ITexture *texture
 ):
 	scene::ISceneNode(smgr->getRootSceneNode(), smgr)
 {
 	// Misc
 	m_gamedef = gamedef;
 	m_env = env;
+	m_player = player;
+	m_cheap_collision = g_settings->getBool("particles_cheap_collision");
 
 	// Texture
 	m_material.setFlag(video::EMF_LIGHTING, false);
@@ -72,94 +74,121 @@ Particle::Particle(
 	m_material.setFlag(video::EMF_FOG_ENABLE, true);
 	m_material.MaterialType = video::EMT_TRANSPARENT_ALPHA_CHANNEL;
 	m_material.setTexture(0, texture);
-	m_texpos = texpos;
-	m_texsize = texsize;
-
-
-	// Particle related
-	m_pos = pos;
-	m_velocity = velocity;
-	m_acceleration = acceleration;
-	m_expiration = expirationtime;
-	m_time = 0;
-	m_player = player;
-	m_size = size;
-	m_collisiondetection = collisiondetection;
-	m_vertical = vertical;
 
 	// Irrlicht stuff
-	m_collisionbox = aabb3f
-			(-size/2,-size/2,-size/2,size/2,size/2,size/2);
+	m_box = aabb3f(-BS, -BS, -BS, BS, BS, BS);
 	this->setAutomaticCulling(scene::EAC_OFF);
-
-	// Init lighting
-	updateLight();
-
-	// Init model
-	updateVertices();
 }
 
-Particle::~Particle()
+ParticleBuffer::~ParticleBuffer()
 {
 }
 
-void Particle::OnRegisterSceneNode()
+void ParticleBuffer::OnRegisterSceneNode()
 {
-	if (IsVisible)
+	if (IsVisible && !m_pos.empty())
 		SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT_EFFECT);
 
 	ISceneNode::OnRegisterSceneNode();
 }
 
-void Particle::render()
+void ParticleBuffer::addParticle(v3f pos, v3f velocity, v3f acceleration,
+	float expirationtime, float size, bool collisiondetection, bool vertical,
+	v2f texpos, v2f texsize)
 {
-	video::IVideoDriver* driver = SceneManager->getVideoDriver();
-	driver->setMaterial(m_material);
-	driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
+	m_pos.push_back(pos);
+	m_velocity.push_back(velocity);
+	m_acceleration.push_back(acceleration);
+	m_time.push_back(0);
+	m_expiration.push_back(expirationtime);
+	m_size.push_back(size);
+	m_texpos.push_back(texpos);
+	m_texsize.push_back(texsize);
+	m_light.push_back(getLight(pos));
+	m_flags.push_back((collisiondetection ? PARTICLE_COLLISIONDETECTION : 0) |
+		(vertical ? PARTICLE_VERTICAL : 0));
+}
 
-	u16 indices[] = {0,1,2, 2,3,0};
-	driver->drawVertexPrimitiveList(m_vertices, 4,
-			indices, 2, video::EVT_STANDARD,
-			scene::EPT_TRIANGLES, video::EIT_16BIT);
+void ParticleBuffer::removeParticle(u32 i)
+{
+	// Order doesn't matter, so move the last particle into the gap
+	u32 last = m_pos.size() - 1;
+	if (i != last) {
+		m_pos[i]          = m_pos[last];
+		m_velocity[i]     = m_velocity[last];
+		m_acceleration[i] = m_acceleration[last];
+		m_time[i]         = m_time[last];
+		m_expiration[i]   = m_expiration[last];
+		m_size[i]         = m_size[last];
+		m_texpos[i]       = m_texpos[last];
+		m_texsize[i]      = m_texsize[last];
+		m_light[i]        = m_light[last];
+		m_flags[i]        = m_flags[last];
+	}
+	m_pos.pop_back();
+	m_velocity.pop_back();
+	m_acceleration.pop_back();
+	m_time.pop_back();
+	m_expiration.pop_back();
+	m_size.pop_back();
+	m_texpos.pop_back();
+	m_texsize.pop_back();
+	m_light.pop_back();
+	m_flags.pop_back();
 }
 
-void Particle::step(float dtime)
+void ParticleBuffer::step(float dtime)
 {
-	m_time += dtime;
-	if (m_collisiondetection)
-	{
-		aabb3f box = m_collisionbox;
-		v3f p_pos = m_pos*BS;
-		v3f p_velocity = m_velocity*BS;
+	// Remove expired particles first, so they aren't stepped anymore
+	for (u32 i = 0; i < m_pos.size();) {
+		if (m_expiration[i] < m_time[i]) {
+			removeParticle(i);
+		} else {
+			m_time[i] += dtime;
+			i++;
+		}
+	}
+
+	u32 count = m_pos.size();
+
+	// Particles without collision detection only need integrating
+	for (u32 i = 0; i < count; i++) {
+		if (m_flags[i] & PARTICLE_COLLISIONDETECTION)
+			continue;
+		m_velocity[i] += m_acceleration[i] * dtime;
+		m_pos[i] += m_velocity[i] * dtime;
+	}
+
+	for (u32 i = 0; i < count; i++) {
+		if (!(m_flags[i] & PARTICLE_COLLISIONDETECTION))
+			continue;
+		f32 size = m_size[i];
+		aabb3f box(-size/2, -size/2, -size/2, size/2, size/2, size/2);
+		v3f p_pos = m_pos[i]*BS;
+		v3f p_velocity = m_velocity[i]*BS;
 		collisionMoveSimple(m_env, m_gamedef,
 			BS*0.5, box,
 			0, dtime,
-			&p_pos, &p_velocity, m_acceleration * BS);
-		m_pos = p_pos/BS;
-		m_velocity = p_velocity/BS;
-	}
-	else
-	{
-		m_velocity += m_acceleration * dtime;
-		m_pos += m_velocity * dtime;
+			&p_pos, &p_velocity, m_acceleration[i] * BS,
+			NULL, !m_cheap_collision);
+		m_pos[i] = p_pos/BS;
+		m_velocity[i] = p_velocity/BS;
 	}
 
 	// Update lighting
-	updateLight();
-
-	// Update model
-	updateVertices();
+	for (u32 i = 0; i < count; i++)
+		m_light[i] = getLight(m_pos[i]);
 }
 
-void Particle::updateLight()
+u8 ParticleBuffer::getLight(v3f pos)
 {
 	u8 light = 0;
 	bool pos_ok;
 
 	v3s16 p = v3s16(
-		floor(m_pos.X+0.5),
-		floor(m_pos.Y+0.5),
-		floor(m_pos.Z+0.5)
+		floor(pos.X+0.5),
+		floor(pos.Y+0.5),
+		floor(pos.Z+0.5)
 	);
 	MapNode n = m_env->getClientMap().getNodeNoEx(p, &pos_ok);
 	if (pos_ok)
@@ -167,38 +196,85 @@ void Particle::updateLight()
 	else
 		light = blend_light(m_env->getDayNightRatio(), LIGHT_SUN, 0);
 
-	m_light = decode_light(light);
+	return decode_light(light);
 }
 
-void Particle::updateVertices()
+void ParticleBuffer::render()
 {
-	video::SColor c(255, m_light, m_light, m_light);
-	f32 tx0 = m_texpos.X;
-	f32 tx1 = m_texpos.X + m_texsize.X;
-	f32 ty0 = m_texpos.Y;
-	f32 ty1 = m_texpos.Y + m_texsize.Y;
-
-	m_vertices[0] = video::S3DVertex(-m_size/2,-m_size/2,0, 0,0,0,
-			c, tx0, ty1);
-	m_vertices[1] = video::S3DVertex(m_size/2,-m_size/2,0, 0,0,0,
-			c, tx1, ty1);
-	m_vertices[2] = video::S3DVertex(m_size/2,m_size/2,0, 0,0,0,
-			c, tx1, ty0);
-	m_vertices[3] = video::S3DVertex(-m_size/2,m_size/2,0, 0,0,0,
-			c, tx0, ty0);
-
-	v3s16 camera_offset = m_env->getCameraOffset();
-	for(u16 i=0; i<4; i++)
-	{
-		if (m_vertical) {
-			v3f ppos = m_player->getPosition()/BS;
-			m_vertices[i].Pos.rotateXZBy(atan2(ppos.Z-m_pos.Z, ppos.X-m_pos.X)/core::DEGTORAD+90);
+	u32 count = m_pos.size();
+	if (count == 0)
+		return;
+
+	// Facing the camera is the same rotation for every particle, so do the
+	// trigonometry once per frame. Vertical particles only turn around Y,
+	// which depends on their position and is done below.
+	static const v3f corners[4] = {
+		v3f(-0.5, -0.5, 0),
+		v3f( 0.5, -0.5, 0),
+		v3f( 0.5,  0.5, 0),
+		v3f(-0.5,  0.5, 0),
+	};
+	v3f facing[4];
+	for (u16 j = 0; j < 4; j++) {
+		facing[j] = corners[j];
+		facing[j].rotateYZBy(m_player->getPitch());
+		facing[j].rotateXZBy(m_player->getYaw());
+	}
+
+	v3f ppos = m_player->getPosition()/BS;
+	v3f offset = intToFloat(m_env->getCameraOffset(), BS);
+
+	m_vertices.resize(count * 4);
+	for (u32 i = 0; i < count; i++) {
+		video::SColor c(255, m_light[i], m_light[i], m_light[i]);
+		f32 tx0 = m_texpos[i].X;
+		f32 tx1 = m_texpos[i].X + m_texsize[i].X;
+		f32 ty0 = m_texpos[i].Y;
+		f32 ty1 = m_texpos[i].Y + m_texsize[i].Y;
+		f32 size = m_size[i];
+		v3f center = m_pos[i]*BS - offset;
+
+		video::S3DVertex *v = &m_vertices[i * 4];
+		v[0] = video::S3DVertex(0,0,0, 0,0,0, c, tx0, ty1);
+		v[1] = video::S3DVertex(0,0,0, 0,0,0, c, tx1, ty1);
+		v[2] = video::S3DVertex(0,0,0, 0,0,0, c, tx1, ty0);
+		v[3] = video::S3DVertex(0,0,0, 0,0,0, c, tx0, ty0);
+
+		if (m_flags[i] & PARTICLE_VERTICAL) {
+			f64 angle = atan2(ppos.Z-m_pos[i].Z, ppos.X-m_pos[i].X)
+				/ core::DEGTORAD + 90;
+			for (u16 j = 0; j < 4; j++) {
+				v[j].Pos = corners[j] * size;
+				v[j].Pos.rotateXZBy(angle);
+				v[j].Pos += center;
+			}
 		} else {
-			m_vertices[i].Pos.rotateYZBy(m_player->getPitch());
-			m_vertices[i].Pos.rotateXZBy(m_player->getYaw());
+			for (u16 j = 0; j < 4; j++)
+				v[j].Pos = facing[j] * size + center;
 		}
-		m_box.addInternalPoint(m_vertices[i].Pos);
-		m_vertices[i].Pos += m_pos*BS - intToFloat(camera_offset, BS);
+	}
+
+	// Indices are 16 bit, so draw in chunks of at most 16384 particles
+	const u32 max_chunk = 16384;
+	if (m_indices.size() < MYMIN(count, max_chunk) * 6) {
+		u32 n = MYMIN(count, max_chunk);
+		m_indices.resize(n * 6);
+		for (u32 i = 0; i < n; i++) {
+			u16 *idx = &m_indices[i * 6];
+			idx[0] = i*4 + 0; idx[1] = i*4 + 1; idx[2] = i*4 + 2;
+			idx[3] = i*4 + 2; idx[4] = i*4 + 3; idx[5] = i*4 + 0;
+		}
+	}
+
+	video::IVideoDriver* driver = SceneManager->getVideoDriver();
+	driver->setMaterial(m_material);
+	driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
+
+	for (u32 start = 0; start < count; start += max_chunk) {
+		u32 n = MYMIN(count - start, max_chunk);
+		driver->drawVertexPrimitiveList(&m_vertices[start * 4], n * 4,
+				&m_indices[0], n * 2, video::EVT_STANDARD,
+				scene::EPT_TRIANGLES, video::EIT_16BIT);
 	}
 }
 
@@ -243,7 +319,7 @@ ParticleSpawner::ParticleSpawner(IGameDef* gamedef, scene::ISceneManager *smgr,
 
 ParticleSpawner::~ParticleSpawner() {}
 
-void ParticleSpawner::step(float dtime, ClientEnvironment* env)
+void ParticleSpawner::step(float dtime)
 {
 	m_time += dtime;
 
@@ -266,11 +342,11 @@ void ParticleSpawner::step(float dtime, ClientEnvironment* env)
 						*(m_maxsize-m_minsize)
 						+m_minsize;
 
-				Particle* toadd = new Particle(
+				m_particlemanager->addParticle(
 					m_gamedef,
 					m_smgr,
 					m_player,
-					env,
+					m_texture,
 					pos,
 					vel,
 					acc,
@@ -278,10 +354,8 @@ void ParticleSpawner::step(float dtime, ClientEnvironment* env)
 					size,
 					m_collisiondetection,
 					m_vertical,
-					m_texture,
 					v2f(0.0, 0.0),
 					v2f(1.0, 1.0));
-				m_particlemanager->addParticle(toadd);
 				i = m_spawntimes.erase(i);
 			}
 			else
@@ -306,11 +380,11 @@ void ParticleSpawner::step(float dtime, ClientEnvironment* env)
 						*(m_maxsize-m_minsize)
 						+m_minsize;
 
-				Particle* toadd = new Particle(
+				m_particlemanager->addParticle(
 					m_gamedef,
 					m_smgr,
 					m_player,
-					env,
+					m_texture,
 					pos,
 					vel,
 					acc,
@@ -318,10 +392,8 @@ void ParticleSpawner::step(float dtime, ClientEnvironment* env)
 					size,
 					m_collisiondetection,
 					m_vertical,
-					m_texture,
 					v2f(0.0, 0.0),
 					v2f(1.0, 1.0));
-				m_particlemanager->addParticle(toadd);
 			}
 		}
 	}
@@ -357,7 +429,7 @@ void ParticleManager::stepSpawners (float dtime)
 		}
 		else
 		{
-			i->second->step(dtime, m_env);
+			i->second->step(dtime);
 			++i;
 		}
 	}
@@ -366,18 +438,19 @@ void ParticleManager::stepSpawners (float dtime)
 void ParticleManager::stepParticles (float dtime)
 {
 	MutexAutoLock lock(m_particle_list_lock);
-	for(std::vector<Particle*>::iterator i = m_particles.begin();
-			i != m_particles.end();)
+	for(std::map<video::ITexture*, ParticleBuffer*>::iterator i =
+			m_particle_buffers.begin();
+			i != m_particle_buffers.end();)
 	{
-		if ((*i)->get_expired())
+		i->second->step(dtime);
+		if (i->second->getParticleCount() == 0)
 		{
-			(*i)->remove();
-			delete *i;
-			i = m_particles.erase(i);
+			i->second->remove();
+			i->second->drop();
+			m_particle_buffers.erase(i++);
 		}
 		else
 		{
-			(*i)->step(dtime);
 			++i;
 		}
 	}
@@ -395,13 +468,13 @@ void ParticleManager::clearAll ()
 		m_particle_spawners.erase(i++);
 	}
 
-	for(std::vector<Particle*>::iterator i =
-			m_particles.begin();
-			i != m_particles.end();)
+	for(std::map<video::ITexture*, ParticleBuffer*>::iterator i =
+			m_particle_buffers.begin();
+			i != m_particle_buffers.end();)
 	{
-		(*i)->remove();
-		delete *i;
-		i = m_particles.erase(i);
+		i->second->remove();
+		i->second->drop();
+		m_particle_buffers.erase(i++);
 	}
 }
 
@@ -477,7 +550,7 @@ void ParticleManager::handleParticleEvent(ClientEvent *event, IGameDef *gamedef,
 		video::ITexture *texture =
 			gamedef->tsrc()->getTextureForMesh(*(event->spawn_particle.texture));
 
-		Particle* toadd = new Particle(gamedef, smgr, player, m_env,
+		addParticle(gamedef, smgr, player, texture,
 				*event->spawn_particle.pos,
 				*event->spawn_particle.vel,
 				*event->spawn_particle.acc,
@@ -485,12 +558,9 @@ void ParticleManager::handleParticleEvent(ClientEvent *event, IGameDef *gamedef,
 				event->spawn_particle.size,
 				event->spawn_particle.collisiondetection,
 				event->spawn_particle.vertical,
-				texture,
 				v2f(0.0, 0.0),
 				v2f(1.0, 1.0));
 
-		addParticle(toadd);
-
 		delete event->spawn_particle.pos;
 		delete event->spawn_particle.vel;
 		delete event->spawn_particle.acc;
@@ -545,11 +615,11 @@ void ParticleManager::addNodeParticle(IGameDef* gamedef, scene::ISceneManager* s
 		(f32) pos.Z + rand() %100 /200. - 0.25
 	);
 
-	Particle* toadd = new Particle(
+	addParticle(
 		gamedef,
 		smgr,
 		player,
-		m_env,
+		texture,
 		particlepos,
 		velocity,
 		acceleration,
@@ -557,15 +627,29 @@ void ParticleManager::addNodeParticle(IGameDef* gamedef, scene::ISceneManager* s
 		visual_size,
 		true,
 		false,
-		texture,
 		texpos,
 		texsize);
-
-	addParticle(toadd);
 }
 
-void ParticleManager::addParticle(Particle* toadd)
+void ParticleManager::addParticle(IGameDef *gamedef, scene::ISceneManager *smgr,
+		LocalPlayer *player, video::ITexture *texture,
+		v3f pos, v3f velocity, v3f acceleration,
+		float expirationtime, float size,
+		bool collisiondetection, bool vertical,
+		v2f texpos, v2f texsize)
 {
 	MutexAutoLock lock(m_particle_list_lock);
-	m_particles.push_back(toadd);
+
+	ParticleBuffer *buffer;
+	std::map<video::ITexture*, ParticleBuffer*>::iterator i =
+			m_particle_buffers.find(texture);
+	if (i != m_particle_buffers.end()) {
+		buffer = i->second;
+	} else {
+		buffer = new ParticleBuffer(gamedef, smgr, player, m_env, texture);
+		m_particle_buffers[texture] = buffer;
+	}
+
+	buffer->addParticle(pos, velocity, acceleration, expirationtime, size,
+			collisiondetection, vertical, texpos, texsize);
 }
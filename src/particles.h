@@ -31,26 +31,22 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 struct ClientEvent;
 class ParticleManager;
 
-class Particle : public scene::ISceneNode
+/*
+	All particles sharing one texture. The particles are stored as a structure
+	of arrays, stepped together and drawn as a single vertex buffer, instead
+	of being a scene node each.
+*/
+class ParticleBuffer : public scene::ISceneNode
 {
 	public:
-	Particle(
+	ParticleBuffer(
 		IGameDef* gamedef,
 		scene::ISceneManager* mgr,
 		LocalPlayer *player,
 		ClientEnvironment *env,
-		v3f pos,
-		v3f velocity,
-		v3f acceleration,
-		float expirationtime,
-		float size,
-		bool collisiondetection,
-		bool vertical,
-		video::ITexture *texture,
-		v2f texpos,
-		v2f texsize
+		video::ITexture *texture
 	);
-	~Particle();
+	~ParticleBuffer();
 
 	virtual const aabb3f &getBoundingBox() const
 	{
@@ -70,35 +66,49 @@ class Particle : public scene::ISceneNode
 	virtual void OnRegisterSceneNode();
 	virtual void render();
 
+	void addParticle(
+		v3f pos,
+		v3f velocity,
+		v3f acceleration,
+		float expirationtime,
+		float size,
+		bool collisiondetection,
+		bool vertical,
+		v2f texpos,
+		v2f texsize
+	);
+
 	void step(float dtime);
 
-	bool get_expired ()
-	{ return m_expiration < m_time; }
+	u32 getParticleCount() const
+	{ return m_pos.size(); }
 
 private:
-	void updateLight();
-	void updateVertices();
-
-	video::S3DVertex m_vertices[4];
-	float m_time;
-	float m_expiration;
+	void removeParticle(u32 i);
+	u8 getLight(v3f pos);
 
 	ClientEnvironment *m_env;
 	IGameDef *m_gamedef;
+	LocalPlayer *m_player;
 	aabb3f m_box;
-	aabb3f m_collisionbox;
 	video::SMaterial m_material;
-	v2f m_texpos;
-	v2f m_texsize;
-	v3f m_pos;
-	v3f m_velocity;
-	v3f m_acceleration;
-	LocalPlayer *m_player;
-	float m_size;
-	u8 m_light;
-	bool m_collisiondetection;
-	bool m_vertical;
-	v3s16 m_camera_offset;
+	bool m_cheap_collision;
+
+	// Per-particle data, all of the same length
+	std::vector<v3f> m_pos;
+	std::vector<v3f> m_velocity;
+	std::vector<v3f> m_acceleration;
+	std::vector<float> m_time;
+	std::vector<float> m_expiration;
+	std::vector<float> m_size;
+	std::vector<v2f> m_texpos;
+	std::vector<v2f> m_texsize;
+	std::vector<u8> m_light;
+	std::vector<u8> m_flags;
+
+	// Reused between frames to avoid reallocation
+	std::vector<video::S3DVertex> m_vertices;
+	std::vector<u16> m_indices;
 };
 
 class ParticleSpawner
@@ -122,7 +132,7 @@ class ParticleSpawner
 
 	~ParticleSpawner();
 
-	void step(float dtime, ClientEnvironment *env);
+	void step(float dtime);
 
 	bool get_expired ()
 	{ return (m_amount <= 0) && m_spawntime != 0; }
@@ -177,7 +187,12 @@ friend class ParticleSpawner;
 		LocalPlayer *player, v3s16 pos, const TileSpec tiles[]);
 
 protected:
-	void addParticle(Particle* toadd);
+	void addParticle(IGameDef *gamedef, scene::ISceneManager *smgr,
+		LocalPlayer *player, video::ITexture *texture,
+		v3f pos, v3f velocity, v3f acceleration,
+		float expirationtime, float size,
+		bool collisiondetection, bool vertical,
+		v2f texpos, v2f texsize);
 
 private:
 
@@ -186,7 +201,7 @@ friend class ParticleSpawner;
 
 	void clearAll ();
 
-	std::vector<Particle*> m_particles;
+	std::map<video::ITexture*, ParticleBuffer*> m_particle_buffers;
 	std::map<u32, ParticleSpawner*> m_particle_spawners;
 
 	ClientEnvironment* m_env;
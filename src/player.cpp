@@ -19,7 +19,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "player.h"
 
-#include <fstream>
 #include "threading/mutex_auto_lock.h"
 #include "util/numeric.h"
 #include "hud.h"
@@ -27,9 +26,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gamedef.h"
 #include "settings.h"
 #include "content_sao.h"
-#include "filesys.h"
 #include "log.h"
 #include "porting.h"  // strlcpy
+#include "serialization.h"
+#include "util/serialize.h"
 
 
 Player::Player(IGameDef *gamedef, const char *name):
@@ -181,6 +181,40 @@ void Player::deSerialize(std::istream &is, std::string playername)
 	}
 }
 
+std::string Player::serializeBinary()
+{
+	std::ostringstream os(std::ios_base::binary);
+	serialize(os);
+	return textToBinary(os.str());
+}
+
+void Player::deSerializeBinary(const std::string &data,
+		const std::string &playername)
+{
+	std::istringstream is(binaryToText(data), std::ios_base::binary);
+	deSerialize(is, playername);
+}
+
+std::string Player::textToBinary(const std::string &text)
+{
+	std::ostringstream os(std::ios_base::binary);
+	writeU8(os, PLAYER_BINARY_VERSION);
+	compressZlib(text, os);
+	return os.str();
+}
+
+std::string Player::binaryToText(const std::string &data)
+{
+	std::istringstream is(data, std::ios_base::binary);
+	u8 version = readU8(is);
+	if (version != PLAYER_BINARY_VERSION)
+		throw SerializationError("Unsupported player data version " +
+				itos(version));
+	std::ostringstream os(std::ios_base::binary);
+	decompressZlib(is, os);
+	return os.str();
+}
+
 u32 Player::addHud(HudElement *toadd)
 {
 	MutexAutoLock lock(m_mutex);
@@ -245,55 +279,6 @@ RemotePlayer::RemotePlayer(IGameDef *gamedef, const char *name):
 	movement_gravity                = g_settings->getFloat("movement_gravity")                * BS;
 }
 
-void RemotePlayer::save(std::string savedir)
-{
-	/*
-	 * We have to open all possible player files in the players directory
-	 * and check their player names because some file systems are not
-	 * case-sensitive and player names are case-sensitive.
-	 */
-
-	// A player to deserialize files into to check their names
-	RemotePlayer testplayer(m_gamedef, "");
-
-	savedir += DIR_DELIM;
-	std::string path = savedir + m_name;
-	for (u32 i = 0; i < PLAYER_FILE_ALTERNATE_TRIES; i++) {
-		if (!fs::PathExists(path)) {
-			// Open file and serialize
-			std::ostringstream ss(std::ios_base::binary);
-			serialize(ss);
-			if (!fs::safeWriteToFile(path, ss.str())) {
-				infostream << "Failed to write " << path << std::endl;
-			}
-			setModified(false);
-			return;
-		}
-		// Open file and deserialize
-		std::ifstream is(path.c_str(), std::ios_base::binary);
-		if (!is.good()) {
-			infostream << "Failed to open " << path << std::endl;
-			return;
-		}
-		testplayer.deSerialize(is, path);
-		is.close();
-		if (strcmp(testplayer.getName(), m_name) == 0) {
-			// Open file and serialize
-			std::ostringstream ss(std::ios_base::binary);
-			serialize(ss);
-			if (!fs::safeWriteToFile(path, ss.str())) {
-				infostream << "Failed to write " << path << std::endl;
-			}
-			setModified(false);
-			return;
-		}
-		path = savedir + m_name + itos(i);
-	}
-
-	infostream << "Didn't find free file for player " << m_name << std::endl;
-	return;
-}
-
 /*
 	RemotePlayer
 */
@@ -31,6 +31,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define PLAYERNAME_ALLOWED_CHARS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_"
 #define PLAYERNAME_ALLOWED_CHARS_USER_EXPL "'a' to 'z', 'A' to 'Z', '0' to '9', '-', '_'"
 
+// Version of the format written by Player::serializeBinary
+#define PLAYER_BINARY_VERSION 1
+
 struct PlayerControl
 {
 	PlayerControl()
@@ -303,6 +306,16 @@ class Player
 	void serialize(std::ostream &os);
 	void deSerialize(std::istream &is, std::string playername);
 
+	/*
+		Compact form stored by the player databases: a version byte
+		followed by the zlib compressed text written by serialize().
+	*/
+	std::string serializeBinary();
+	void deSerializeBinary(const std::string &data,
+			const std::string &playername);
+	static std::string textToBinary(const std::string &text);
+	static std::string binaryToText(const std::string &data);
+
 	bool checkModified() const
 	{
 		return m_dirty || inventory.checkModified();
@@ -425,8 +438,6 @@ class RemotePlayer : public Player
 	RemotePlayer(IGameDef *gamedef, const char *name);
 	virtual ~RemotePlayer() {}
 
-	void save(std::string savedir);
-
 	PlayerSAO *getPlayerSAO()
 	{ return m_sao; }
 	void setPlayerSAO(PlayerSAO *sao)
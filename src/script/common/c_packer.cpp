@@ -0,0 +1,272 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "common/c_packer.h"
+#include "common/c_types.h"
+#include "lua_api/l_sharedbuffer.h"
+#include "util/serialize.h"
+#include <cstring>
+#include <set>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+/*
+	Packed format, all values start with a type byte:
+
+	PACK_NIL, PACK_FALSE, PACK_TRUE
+	PACK_NUMBER   f64 (native byte order, never leaves the process)
+	PACK_STRING   u32 length, bytes
+	PACK_TABLE    u32 array length, array values,
+	              key-value pairs of the other keys, PACK_END
+	PACK_BUFFER   u32 index into PackedValue::buffers
+*/
+enum PackType {
+	PACK_END,
+	PACK_NIL,
+	PACK_FALSE,
+	PACK_TRUE,
+	PACK_NUMBER,
+	PACK_STRING,
+	PACK_TABLE,
+	PACK_BUFFER
+};
+
+// Tables are nested deeper than this only by mistake
+#define PACK_MAX_DEPTH 200
+
+/******************************************************************************/
+PackedValue::PackedValue(const PackedValue &other) :
+	data(other.data),
+	buffers(other.buffers)
+{
+	for (size_t i = 0; i < buffers.size(); i++)
+		buffers[i]->grab();
+}
+
+PackedValue::~PackedValue()
+{
+	clear();
+}
+
+PackedValue &PackedValue::operator=(const PackedValue &other)
+{
+	if (this != &other) {
+		PackedValue copy(other);
+		swap(copy);
+	}
+	return *this;
+}
+
+void PackedValue::swap(PackedValue &other)
+{
+	data.swap(other.data);
+	buffers.swap(other.buffers);
+}
+
+void PackedValue::clear()
+{
+	for (size_t i = 0; i < buffers.size(); i++)
+		buffers[i]->drop();
+	buffers.clear();
+	data.clear();
+}
+
+/******************************************************************************/
+static void pack_u32(std::string &os, u32 i)
+{
+	u8 buf[4];
+	writeU32(buf, i);
+	os.append((const char *)buf, 4);
+}
+
+static void pack_value(lua_State *L, int idx, PackedValue &result,
+		std::set<const void *> &tables);
+
+static void pack_table(lua_State *L, int idx, PackedValue &result,
+		std::set<const void *> &tables)
+{
+	const void *ptr = lua_topointer(L, idx);
+	if (tables.find(ptr) != tables.end())
+		throw LuaError("Cannot pack a recursive table");
+	if (tables.size() >= PACK_MAX_DEPTH)
+		throw LuaError("Cannot pack a table nested this deep");
+	if (!lua_checkstack(L, 3))
+		throw LuaError("Out of Lua stack space while packing");
+	tables.insert(ptr);
+
+	result.data += (char)PACK_TABLE;
+
+	// Array part, holes are packed as nil and skipped when unpacking
+	u32 len = lua_objlen(L, idx);
+	pack_u32(result.data, len);
+	for (u32 i = 1; i <= len; i++) {
+		lua_rawgeti(L, idx, i);
+		pack_value(L, -1, result, tables);
+		lua_pop(L, 1);
+	}
+
+	// Everything else
+	lua_pushnil(L);
+	while (lua_next(L, idx) != 0) {
+		// key at -2, value at -1
+		bool in_array = false;
+		if (lua_type(L, -2) == LUA_TNUMBER) {
+			lua_Number k = lua_tonumber(L, -2);
+			in_array = k >= 1 && k <= len && k == (lua_Number)(u32)k;
+		}
+		if (!in_array) {
+			pack_value(L, -2, result, tables);
+			pack_value(L, -1, result, tables);
+		}
+		lua_pop(L, 1);
+	}
+	result.data += (char)PACK_END;
+
+	tables.erase(ptr);
+}
+
+static void pack_value(lua_State *L, int idx, PackedValue &result,
+		std::set<const void *> &tables)
+{
+	if (idx < 0)
+		idx = lua_gettop(L) + idx + 1;
+
+	switch (lua_type(L, idx)) {
+	case LUA_TNONE:
+	case LUA_TNIL:
+		result.data += (char)PACK_NIL;
+		break;
+	case LUA_TBOOLEAN:
+		result.data += (char)(lua_toboolean(L, idx) ? PACK_TRUE : PACK_FALSE);
+		break;
+	case LUA_TNUMBER: {
+		double n = lua_tonumber(L, idx);
+		result.data += (char)PACK_NUMBER;
+		result.data.append((const char *)&n, sizeof(n));
+		break;
+	}
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, idx, &len);
+		result.data += (char)PACK_STRING;
+		pack_u32(result.data, len);
+		result.data.append(s, len);
+		break;
+	}
+	case LUA_TTABLE:
+		pack_table(L, idx, result, tables);
+		break;
+	case LUA_TUSERDATA: {
+		LuaSharedBuffer *o = LuaSharedBuffer::toobject(L, idx);
+		if (o) {
+			SharedBufferData *data = o->getData();
+			data->grab();
+			result.buffers.push_back(data);
+			result.data += (char)PACK_BUFFER;
+			pack_u32(result.data, result.buffers.size() - 1);
+			break;
+		}
+	}
+	// Fall through
+	default:
+		throw LuaError(std::string("Cannot pack a value of type ") +
+			luaL_typename(L, idx));
+	}
+}
+
+void script_pack(lua_State *L, int idx, PackedValue &result)
+{
+	std::set<const void *> tables;
+	result.clear();
+	pack_value(L, idx, result, tables);
+}
+
+/******************************************************************************/
+static u32 unpack_u32(const PackedValue &packed, size_t &pos)
+{
+	u32 i = readU32((const u8 *)&packed.data[pos]);
+	pos += 4;
+	return i;
+}
+
+// Pushes the value at pos, returns false on PACK_END
+static bool unpack_value(lua_State *L, const PackedValue &packed, size_t &pos)
+{
+	u8 type = packed.data[pos++];
+	switch (type) {
+	case PACK_END:
+		return false;
+	case PACK_NIL:
+		lua_pushnil(L);
+		break;
+	case PACK_FALSE:
+	case PACK_TRUE:
+		lua_pushboolean(L, type == PACK_TRUE);
+		break;
+	case PACK_NUMBER: {
+		double n;
+		memcpy(&n, &packed.data[pos], sizeof(n));
+		pos += sizeof(n);
+		lua_pushnumber(L, n);
+		break;
+	}
+	case PACK_STRING: {
+		u32 len = unpack_u32(packed, pos);
+		lua_pushlstring(L, packed.data.data() + pos, len);
+		pos += len;
+		break;
+	}
+	case PACK_TABLE: {
+		if (!lua_checkstack(L, 3))
+			throw LuaError("Out of Lua stack space while unpacking");
+		u32 len = unpack_u32(packed, pos);
+		lua_createtable(L, len, 0);
+		for (u32 i = 1; i <= len; i++) {
+			unpack_value(L, packed, pos);
+			if (lua_isnil(L, -1))
+				lua_pop(L, 1);
+			else
+				lua_rawseti(L, -2, i);
+		}
+		while (unpack_value(L, packed, pos)) {
+			unpack_value(L, packed, pos);
+			lua_rawset(L, -3);
+		}
+		break;
+	}
+	case PACK_BUFFER:
+		LuaSharedBuffer::create(L, packed.buffers[unpack_u32(packed, pos)]);
+		break;
+	default:
+		throw LuaError("Invalid packed value");
+	}
+	return true;
+}
+
+void script_unpack(lua_State *L, const PackedValue &packed)
+{
+	if (packed.data.empty()) {
+		lua_pushnil(L);
+		return;
+	}
+	size_t pos = 0;
+	unpack_value(L, packed, pos);
+}
@@ -0,0 +1,66 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/******************************************************************************/
+/******************************************************************************/
+/* WARNING!!!! do NOT add this header in any include file or any code file    */
+/*             not being a script/modapi file!!!!!!!!                         */
+/******************************************************************************/
+/******************************************************************************/
+#ifndef C_PACKER_H_
+#define C_PACKER_H_
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+class SharedBufferData;
+
+/*
+	A Lua value packed into a compact binary form, so that it can be moved
+	to another Lua state (e.g. between the game and its async workers).
+
+	Shared buffers are not copied, only referenced.
+*/
+struct PackedValue
+{
+	std::string data;
+	std::vector<SharedBufferData *> buffers;
+
+	PackedValue() {}
+	PackedValue(const PackedValue &other);
+	~PackedValue();
+
+	PackedValue &operator=(const PackedValue &other);
+	void swap(PackedValue &other);
+	void clear();
+};
+
+// Packs the value at index idx.
+// Throws LuaError on values that can't be packed: functions, userdata
+// other than shared buffers, threads and recursive tables.
+void script_pack(lua_State *L, int idx, PackedValue &result);
+
+// Pushes the value packed by script_pack
+void script_unpack(lua_State *L, const PackedValue &packed);
+
+#endif /* C_PACKER_H_ */
@@ -0,0 +1,187 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "common/c_profiler.h"
+#include "common/c_internal.h"
+#include "cpp_api/s_base.h"
+#include "porting.h"
+#include "util/numeric.h"
+#include "util/string.h"
+
+#include <ctime>
+#include <vector>
+
+// Instructions between checks whether a sample is due
+#define SAMPLE_HOOK_COUNT 1000
+// Deepest Lua stack that is sampled
+#define SAMPLE_MAX_DEPTH 64
+
+bool ScriptProfiler::Key::operator<(const Key &other) const
+{
+	if (mod != other.mod)
+		return mod < other.mod;
+	if (type != other.type)
+		return type < other.type;
+	return function < other.function;
+}
+
+void ScriptProfiler::Timer::start()
+{
+	m_wall_start = porting::getTimeUs();
+	m_cpu_start = getThreadCpuTimeUs();
+}
+
+void ScriptProfiler::Timer::stop(ScriptProfiler &profiler, const Key &key)
+{
+	u32 wall_us = porting::getTimeUs() - m_wall_start;
+	u64 cpu_us = getThreadCpuTimeUs() - m_cpu_start;
+	profiler.record(key, wall_us, cpu_us);
+}
+
+ScriptProfiler::ScriptProfiler() :
+	m_enabled(false),
+	m_sample_interval_us(0),
+	m_last_sample_us(0),
+	m_sample_count(0),
+	m_current_type("")
+{
+}
+
+void ScriptProfiler::setEnabled(lua_State *L, bool enabled,
+		u32 sample_interval_us)
+{
+	m_enabled = enabled;
+	m_sample_interval_us = enabled ? sample_interval_us : 0;
+
+	if (m_sample_interval_us != 0) {
+		m_last_sample_us = porting::getTimeUs();
+		lua_sethook(L, sampleHook, LUA_MASKCOUNT, SAMPLE_HOOK_COUNT);
+	} else {
+		lua_sethook(L, NULL, 0, 0);
+	}
+}
+
+const char *ScriptProfiler::setCurrentType(const char *type)
+{
+	const char *old = m_current_type;
+	m_current_type = type;
+	return old;
+}
+
+void ScriptProfiler::record(const Key &key, u64 wall_us, u64 cpu_us)
+{
+	Stats &stats = m_stats[key];
+	stats.count++;
+	stats.wall_us += wall_us;
+	stats.cpu_us += cpu_us;
+	stats.max_wall_us = MYMAX(stats.max_wall_us, wall_us);
+}
+
+void ScriptProfiler::writeFolded(std::ostream &os) const
+{
+	for (std::map<std::string, u32>::const_iterator it = m_samples.begin();
+			it != m_samples.end(); ++it)
+		os << it->first << " " << it->second << "\n";
+}
+
+void ScriptProfiler::clear()
+{
+	m_stats.clear();
+	m_samples.clear();
+	m_sample_count = 0;
+}
+
+std::string ScriptProfiler::describeFunction(lua_State *L, int index)
+{
+	lua_Debug ar;
+	lua_pushvalue(L, index);
+	if (!lua_getinfo(L, ">S", &ar))
+		return "?";
+	if (ar.linedefined < 0)
+		return ar.short_src;
+	return std::string(ar.short_src) + ":" + itos(ar.linedefined);
+}
+
+u64 ScriptProfiler::getThreadCpuTimeUs()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+	u64 t = ((u64)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) +
+		((u64)user.dwHighDateTime << 32 | user.dwLowDateTime);
+	return t / 10; // 100 ns units
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return (u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	// Process time is the closest we have
+	return (u64)clock() * 1000000 / CLOCKS_PER_SEC;
+#endif
+}
+
+void ScriptProfiler::sampleHook(lua_State *L, lua_Debug *ar)
+{
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_SCRIPTAPI);
+	ScriptApiBase *sapi = (ScriptApiBase *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	if (sapi)
+		sapi->getProfiler().takeSample(L, sapi);
+}
+
+void ScriptProfiler::takeSample(lua_State *L, ScriptApiBase *sapi)
+{
+	u32 now = porting::getTimeUs();
+	if (m_sample_interval_us == 0 || now - m_last_sample_us < m_sample_interval_us)
+		return;
+	m_last_sample_us = now;
+
+	std::vector<std::string> frames;
+	lua_Debug ar;
+	for (int level = 0; level < SAMPLE_MAX_DEPTH &&
+			lua_getstack(L, level, &ar); level++) {
+		if (!lua_getinfo(L, "Sn", &ar))
+			break;
+		std::string frame;
+		if (ar.linedefined < 0)
+			frame = ar.name ? ar.name : ar.short_src;
+		else if (ar.name)
+			frame = std::string(ar.name) + "@" + ar.short_src + ":" +
+				itos(ar.linedefined);
+		else
+			frame = std::string(ar.short_src) + ":" + itos(ar.linedefined);
+		// ';' separates the frames
+		str_replace(frame, ';', ',');
+		frames.push_back(frame);
+	}
+
+	// Outermost frame first, below the mod that is running
+	std::string stack = sapi->getOrigin();
+	if (stack.empty())
+		stack = "??";
+	for (std::vector<std::string>::reverse_iterator it = frames.rbegin();
+			it != frames.rend(); ++it) {
+		stack += ';';
+		stack += *it;
+	}
+	m_samples[stack]++;
+	m_sample_count++;
+}
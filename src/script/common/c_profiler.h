@@ -0,0 +1,123 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef C_PROFILER_H_
+#define C_PROFILER_H_
+
+#include <map>
+#include <ostream>
+#include <string>
+
+extern "C" {
+#include <lua.h>
+}
+
+#include "irrlichttypes.h"
+
+class ScriptApiBase;
+
+/*
+	Accounts the time spent in Lua callbacks per mod, callback type and
+	function, and optionally samples Lua stacks with a count hook.
+
+	Must only be used with the script lock held.
+*/
+class ScriptProfiler
+{
+public:
+	struct Key
+	{
+		std::string mod;
+		// Name of the C++ function that called into Lua
+		// (e.g. "environment_Step", "luaentity_Step")
+		std::string type;
+		// Source and line of the Lua function
+		std::string function;
+
+		bool operator<(const Key &other) const;
+	};
+
+	struct Stats
+	{
+		Stats() : count(0), wall_us(0), cpu_us(0), max_wall_us(0) {}
+
+		u32 count;
+		u64 wall_us;
+		u64 cpu_us;
+		u64 max_wall_us;
+	};
+
+	typedef std::map<Key, Stats> StatsMap;
+
+	// Measures one call
+	class Timer
+	{
+	public:
+		Timer() : m_wall_start(0), m_cpu_start(0) {}
+
+		void start();
+		void stop(ScriptProfiler &profiler, const Key &key);
+
+	private:
+		u32 m_wall_start;
+		u64 m_cpu_start;
+	};
+
+	ScriptProfiler();
+
+	bool isEnabled() const { return m_enabled; }
+	// Starts or stops accounting callback times. Pass a sampling
+	// interval of 0 to not sample stacks.
+	void setEnabled(lua_State *L, bool enabled, u32 sample_interval_us = 0);
+	bool isSampling() const { return m_sample_interval_us != 0; }
+
+	// Type of the callbacks currently being run
+	const char *getCurrentType() const { return m_current_type; }
+	const char *setCurrentType(const char *type);
+
+	void record(const Key &key, u64 wall_us, u64 cpu_us);
+	const StatsMap &getStats() const { return m_stats; }
+
+	// Writes the sampled stacks in the folded format used by flamegraph
+	// tools: "frame;frame;frame count" per line, outermost frame first
+	void writeFolded(std::ostream &os) const;
+	u32 getSampleCount() const { return m_sample_count; }
+
+	void clear();
+
+	// Describes the function at index as "source:line"
+	static std::string describeFunction(lua_State *L, int index);
+	static u64 getThreadCpuTimeUs();
+
+private:
+	static void sampleHook(lua_State *L, lua_Debug *ar);
+	void takeSample(lua_State *L, ScriptApiBase *sapi);
+
+	bool m_enabled;
+	u32 m_sample_interval_us;
+	u32 m_last_sample_us;
+	u32 m_sample_count;
+	const char *m_current_type;
+
+	StatsMap m_stats;
+	// Folded stack -> number of samples
+	std::map<std::string, u32> m_samples;
+};
+
+#endif /* C_PROFILER_H_ */
@@ -31,7 +31,9 @@ extern "C" {
 #include "log.h"
 #include "filesys.h"
 #include "porting.h"
+#include "settings.h"
 #include "common/c_internal.h"
+#include "lua_api/l_sharedbuffer.h"
 
 /******************************************************************************/
 AsyncEngine::AsyncEngine() :
@@ -86,60 +88,79 @@ bool AsyncEngine::registerFunction(const char* name, lua_CFunction func)
 }
 
 /******************************************************************************/
-void AsyncEngine::initialize(unsigned int numEngines)
+bool AsyncEngine::registerScript(const std::string &path,
+		const std::string &mod_name)
+{
+	if (initDone) {
+		return false;
+	}
+	scriptList.push_back(std::make_pair(path, mod_name));
+	return true;
+}
+
+/******************************************************************************/
+void AsyncEngine::initialize(unsigned int numEngines, Server *server)
 {
 	initDone = true;
 
+	bool secure = server != NULL &&
+		g_settings->getBool("secure.enable_security");
+
 	for (unsigned int i = 0; i < numEngines; i++) {
 		AsyncWorkerThread *toAdd = new AsyncWorkerThread(this,
-			std::string("AsyncWorker-") + itos(i));
+			std::string("AsyncWorker-") + itos(i), server, secure);
 		workerThreads.push_back(toAdd);
 		toAdd->start();
 	}
 }
 
 /******************************************************************************/
-unsigned int AsyncEngine::queueAsyncJob(std::string func, std::string params)
+unsigned int AsyncEngine::queueAsyncJob(const std::string &func,
+		const PackedValue &params)
 {
 	jobQueueMutex.lock();
-	LuaJobInfo toAdd;
+	jobQueue.push_back(LuaJobInfo());
+	LuaJobInfo &toAdd = jobQueue.back();
 	toAdd.id = jobIdCounter++;
-	toAdd.serializedFunction = func;
-	toAdd.serializedParams = params;
-
-	jobQueue.push_back(toAdd);
+	toAdd.function = func;
+	toAdd.params = params;
+	unsigned int id = toAdd.id;
 
 	jobQueueCounter.post();
 
 	jobQueueMutex.unlock();
 
-	return toAdd.id;
+	return id;
 }
 
 /******************************************************************************/
-LuaJobInfo AsyncEngine::getJob()
+void AsyncEngine::getJob(LuaJobInfo &job)
 {
 	jobQueueCounter.wait();
 	jobQueueMutex.lock();
 
-	LuaJobInfo retval;
-	retval.valid = false;
+	job.valid = false;
 
 	if (!jobQueue.empty()) {
-		retval = jobQueue.front();
+		// Swap instead of copying the packed parameters
+		LuaJobInfo &front = jobQueue.front();
+		job.function.swap(front.function);
+		job.params.swap(front.params);
+		job.result.clear();
+		job.id = front.id;
 		jobQueue.pop_front();
-		retval.valid = true;
+		job.valid = true;
 	}
 	jobQueueMutex.unlock();
-
-	return retval;
 }
 
 /******************************************************************************/
-void AsyncEngine::putJobResult(LuaJobInfo result)
+void AsyncEngine::putJobResult(LuaJobInfo &result)
 {
 	resultQueueMutex.lock();
-	resultQueue.push_back(result);
+	resultQueue.push_back(LuaJobInfo());
+	resultQueue.back().id = result.id;
+	resultQueue.back().result.swap(result.result);
 	resultQueueMutex.unlock();
 }
 
@@ -150,8 +171,7 @@ void AsyncEngine::step(lua_State *L)
 	lua_getglobal(L, "core");
 	resultQueueMutex.lock();
 	while (!resultQueue.empty()) {
-		LuaJobInfo jobDone = resultQueue.front();
-		resultQueue.pop_front();
+		LuaJobInfo &jobDone = resultQueue.front();
 
 		lua_getfield(L, -1, "async_event_handler");
 
@@ -162,8 +182,8 @@ void AsyncEngine::step(lua_State *L)
 		luaL_checktype(L, -1, LUA_TFUNCTION);
 
 		lua_pushinteger(L, jobDone.id);
-		lua_pushlstring(L, jobDone.serializedResult.data(),
-				jobDone.serializedResult.size());
+		script_unpack(L, jobDone.result);
+		resultQueue.pop_front();
 
 		PCALL_RESL(L, lua_pcall(L, 2, 0, error_handler));
 	}
@@ -181,8 +201,7 @@ void AsyncEngine::pushFinishedJobs(lua_State* L) {
 	int top = lua_gettop(L);
 
 	while (!resultQueue.empty()) {
-		LuaJobInfo jobDone = resultQueue.front();
-		resultQueue.pop_front();
+		LuaJobInfo &jobDone = resultQueue.front();
 
 		lua_createtable(L, 0, 2);  // Pre-allocate space for two map fields
 		int top_lvl2 = lua_gettop(L);
@@ -192,10 +211,11 @@ void AsyncEngine::pushFinishedJobs(lua_State* L) {
 		lua_settable(L, top_lvl2);
 
 		lua_pushstring(L, "retval");
-		lua_pushlstring(L, jobDone.serializedResult.data(),
-			jobDone.serializedResult.size());
+		script_unpack(L, jobDone.result);
 		lua_settable(L, top_lvl2);
 
+		resultQueue.pop_front();
+
 		lua_rawseti(L, top, index++);
 	}
 }
@@ -213,13 +233,20 @@ void AsyncEngine::prepareEnvironment(lua_State* L, int top)
 
 /******************************************************************************/
 AsyncWorkerThread::AsyncWorkerThread(AsyncEngine* jobDispatcher,
-		const std::string &name) :
-	Thread(name),
+		const std::string &name, Server *server, bool secure) :
 	ScriptApiBase(),
+	Thread(name),
 	jobDispatcher(jobDispatcher)
 {
+	// The server is only used to look up mod and world paths
+	setServer(server);
+
 	lua_State *L = getStack();
 
+	if (secure) {
+		initializeSecurity();
+	}
+
 	// Prepare job lua environment
 	lua_getglobal(L, "core");
 	int top = lua_gettop(L);
@@ -229,6 +256,9 @@ AsyncWorkerThread::AsyncWorkerThread(AsyncEngine* jobDispatcher,
 	lua_setglobal(L, "INIT");
 
 	jobDispatcher->prepareEnvironment(L, top);
+	lua_pop(L, 1);
+
+	LuaSharedBuffer::Register(L);
 }
 
 /******************************************************************************/
@@ -242,9 +272,14 @@ void* AsyncWorkerThread::run()
 {
 	lua_State *L = getStack();
 
-	std::string script = getServer()->getBuiltinLuaPath() + DIR_DELIM + "init.lua";
+	std::string script = porting::path_share + DIR_DELIM "builtin"
+		DIR_DELIM "init.lua";
 	try {
-		loadScript(script);
+		loadMod(script, BUILTIN_MOD_NAME);
+		for (size_t i = 0; i < jobDispatcher->scriptList.size(); i++) {
+			loadMod(jobDispatcher->scriptList[i].first,
+				jobDispatcher->scriptList[i].second);
+		}
 	} catch (const ModError &e) {
 		errorstream << "Execution of async base environment failed: "
 			<< e.what() << std::endl;
@@ -259,14 +294,17 @@ void* AsyncWorkerThread::run()
 	}
 
 	// Main loop
+	LuaJobInfo toProcess;
 	while (!stopRequested()) {
 		// Wait for job
-		LuaJobInfo toProcess = jobDispatcher->getJob();
+		jobDispatcher->getJob(toProcess);
 
 		if (toProcess.valid == false || stopRequested()) {
 			continue;
 		}
 
+		int top = lua_gettop(L);
+
 		lua_getfield(L, -1, "job_processor");
 		if (lua_isnil(L, -1)) {
 			FATAL_ERROR("Unable to get async job processor!");
@@ -274,26 +312,45 @@ void* AsyncWorkerThread::run()
 
 		luaL_checktype(L, -1, LUA_TFUNCTION);
 
-		// Call it
-		lua_pushlstring(L,
-				toProcess.serializedFunction.data(),
-				toProcess.serializedFunction.size());
-		lua_pushlstring(L,
-				toProcess.serializedParams.data(),
-				toProcess.serializedParams.size());
-
-		int result = lua_pcall(L, 2, 1, error_handler);
-		if (result) {
-			PCALL_RES(result);
-			toProcess.serializedResult = "";
+		// Push the function, or its name to be looked up by the processor.
+		// Only the first byte of LUA_SIGNATURE is shared by PUC Lua ("\033Lua")
+		// and LuaJIT ("\033LJ") bytecode.
+		int result = 0;
+		if (!toProcess.function.empty() &&
+				toProcess.function[0] == LUA_SIGNATURE[0]) {
+			if (m_secure) {
+				lua_pushliteral(L, "Bytecode jobs are not allowed"
+					" with mod security enabled, use"
+					" core.register_async_function instead");
+				result = LUA_ERRRUN;
+			} else {
+				result = luaL_loadbuffer(L, toProcess.function.data(),
+					toProcess.function.size(), "=(async job)");
+			}
 		} else {
-			// Fetch result
-			size_t length;
-			const char *retval = lua_tolstring(L, -1, &length);
-			toProcess.serializedResult = std::string(retval, length);
+			lua_pushlstring(L, toProcess.function.data(),
+				toProcess.function.size());
 		}
 
-		lua_pop(L, 1);  // Pop retval
+		toProcess.result.clear();
+		try {
+			if (result == 0) {
+				script_unpack(L, toProcess.params);
+				result = lua_pcall(L, 2, 1, error_handler);
+			}
+			if (result == 0) {
+				script_pack(L, -1, toProcess.result);
+			} else {
+				const char *err = lua_tostring(L, -1);
+				errorstream << "Async job failed: "
+					<< (err ? err : "<no description>") << std::endl;
+			}
+		} catch (LuaError &e) {
+			errorstream << "Async job failed: " << e.what() << std::endl;
+			toProcess.result.clear();
+		}
+
+		lua_settop(L, top);
 
 		// Put job result
 		jobDispatcher->putJobResult(toProcess);
@@ -303,4 +360,3 @@ void* AsyncWorkerThread::run()
 
 	return 0;
 }
-
@@ -30,21 +30,25 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "debug.h"
 #include "lua.h"
 #include "cpp_api/s_base.h"
+#include "cpp_api/s_security.h"
+#include "common/c_packer.h"
 
 // Forward declarations
 class AsyncEngine;
+class Server;
 
 
 // Declarations
 
 // Data required to queue a job
 struct LuaJobInfo {
-	// Function to be called in async environment
-	std::string serializedFunction;
+	// Function to be called in async environment, either dumped bytecode
+	// or the name of a function registered in the async environment
+	std::string function;
 	// Parameter to be passed to function
-	std::string serializedParams;
+	PackedValue params;
 	// Result of function call
-	std::string serializedResult;
+	PackedValue result;
 	// JobID used to identify a job and match it to callback
 	unsigned int id;
 
@@ -52,9 +56,11 @@ struct LuaJobInfo {
 };
 
 // Asynchronous working environment
-class AsyncWorkerThread : public Thread, public ScriptApiBase {
+class AsyncWorkerThread : public Thread,
+		virtual public ScriptApiBase, public ScriptApiSecurity {
 public:
-	AsyncWorkerThread(AsyncEngine* jobDispatcher, const std::string &name);
+	AsyncWorkerThread(AsyncEngine* jobDispatcher, const std::string &name,
+		Server *server, bool secure);
 	virtual ~AsyncWorkerThread();
 
 	void *run();
@@ -78,18 +84,28 @@ class AsyncEngine {
 	bool registerFunction(const char* name, lua_CFunction func);
 
 	/**
-	 * Create async engine tasks and lock function registration
+	 * Register script to be run in every async environment after builtin,
+	 * e.g. to define functions with core.register_async_function
+	 * @param path Path of the script
+	 * @param mod_name Mod the script belongs to
+	 */
+	bool registerScript(const std::string &path, const std::string &mod_name);
+
+	/**
+	 * Create async engine tasks and lock function and script registration
 	 * @param numEngines Number of async threads to be started
+	 * @param server Server the jobs belong to, NULL for the main menu
 	 */
-	void initialize(unsigned int numEngines);
+	void initialize(unsigned int numEngines, Server *server = NULL);
 
 	/**
 	 * Queue an async job
-	 * @param func Serialized lua function
-	 * @param params Serialized parameters
+	 * @param func Dumped lua function or name of a registered function
+	 * @param params Packed parameters
 	 * @return jobid The job is queued
 	 */
-	unsigned int queueAsyncJob(std::string func, std::string params);
+	unsigned int queueAsyncJob(const std::string &func,
+			const PackedValue &params);
 
 	/**
 	 * Engine step to process finished jobs
@@ -110,13 +126,13 @@ class AsyncEngine {
 	 *  this function blocks until a job is ready
 	 * @return a job to be processed
 	 */
-	LuaJobInfo getJob();
+	void getJob(LuaJobInfo &job);
 
 	/**
 	 * Put a Job result back to result queue
-	 * @param result result of completed job
+	 * @param result result of completed job, emptied by the call
 	 */
-	void putJobResult(LuaJobInfo result);
+	void putJobResult(LuaJobInfo &result);
 
 	/**
 	 * Initialize environment with current registred functions
@@ -134,6 +150,9 @@ class AsyncEngine {
 	// Internal store for registred functions
 	std::map<std::string, lua_CFunction> functionList;
 
+	// Scripts run in every async environment, with the mod they belong to
+	std::vector<std::pair<std::string, std::string> > scriptList;
+
 	// Internal counter to create job IDs
 	unsigned int jobIdCounter;
 
@@ -187,13 +187,143 @@ void ScriptApiBase::runCallbacksRaw(int nargs,
 	// Stack now looks like this:
 	// ... <error handler> <run_callbacks> <table> <mode> <arg#1> <arg#2> ... <arg#n>
 
+	if (m_profiler.isEnabled())
+		wrapProfiledCallbacks(error_handler + 2);
+
+	const char *old_type = m_profiler.setCurrentType(fxn);
 	int result = lua_pcall(L, nargs + 2, 1, error_handler);
+	m_profiler.setCurrentType(old_type);
 	if (result != 0)
 		scriptError(result, fxn);
 
 	lua_remove(L, error_handler);
 }
 
+int ScriptApiBase::pcallProfiledRaw(int nargs, int nresults,
+		int error_handler, const char *fxn)
+{
+	lua_State *L = getStack();
+	if (!m_profiler.isEnabled())
+		return lua_pcall(L, nargs, nresults, error_handler);
+
+	ScriptProfiler::Key key;
+	key.mod = m_last_run_mod;
+	key.type = fxn;
+	key.function = ScriptProfiler::describeFunction(L, -nargs - 1);
+
+	ScriptProfiler::Timer timer;
+	timer.start();
+	int result = lua_pcall(L, nargs, nresults, error_handler);
+	if (m_profiler.isEnabled())
+		timer.stop(m_profiler, key);
+	return result;
+}
+
+// Calls the callback in upvalue 1 and accounts the time spent in it to
+// the mod in upvalue 2 (or the last run mod, if nil) and the function
+// description in upvalue 3
+static int script_profiled_callback(lua_State *L)
+{
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_SCRIPTAPI);
+	ScriptApiBase *sapi = (ScriptApiBase *) lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	ScriptProfiler &profiler = sapi->getProfiler();
+
+	if (!lua_isnil(L, lua_upvalueindex(2)))
+		sapi->setOriginDirect(lua_tostring(L, lua_upvalueindex(2)));
+
+	// No C++ objects may live across lua_call, errors skip their
+	// destructors. Keep the mod name on the stack instead.
+	int nargs = lua_gettop(L);
+	lua_pushstring(L, sapi->getOrigin().c_str());
+	lua_insert(L, 1);
+	lua_pushvalue(L, lua_upvalueindex(1));
+	lua_insert(L, 2);
+
+	ScriptProfiler::Timer timer;
+	timer.start();
+	lua_call(L, nargs, LUA_MULTRET);
+	if (profiler.isEnabled()) {
+		ScriptProfiler::Key key;
+		key.mod = lua_tostring(L, 1);
+		key.type = profiler.getCurrentType();
+		key.function = lua_tostring(L, lua_upvalueindex(3));
+		timer.stop(profiler, key);
+	}
+	lua_remove(L, 1);
+	return lua_gettop(L);
+}
+
+// Registry key of the table of profiled callback wrappers
+static char profiled_callbacks_key;
+
+// Replaces the table of callbacks at index with a copy where every
+// function is wrapped by script_profiled_callback.
+// The wrappers are created once per function and kept, as callbacks are
+// hardly ever unregistered.
+void ScriptApiBase::wrapProfiledCallbacks(int table)
+{
+	lua_State *L = getStack();
+
+	lua_pushlightuserdata(L, &profiled_callbacks_key);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+	if (lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushlightuserdata(L, &profiled_callbacks_key);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	}
+	int wrappers = lua_gettop(L);
+
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "callback_origins");
+	lua_remove(L, -2);
+	int origins = lua_gettop(L);
+
+	int n = lua_objlen(L, table);
+	lua_createtable(L, n, 0);
+	int wrapped = lua_gettop(L);
+	for (int i = 1; i <= n; i++) {
+		lua_rawgeti(L, table, i);
+		int callback = lua_gettop(L);
+		if (!lua_isfunction(L, callback)) {
+			lua_rawseti(L, wrapped, i);
+			continue;
+		}
+
+		lua_pushvalue(L, callback);
+		lua_rawget(L, wrappers);
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			lua_pushvalue(L, callback);
+			// Mod that registered the callback
+			lua_pushnil(L);
+			if (lua_istable(L, origins)) {
+				lua_pushvalue(L, callback);
+				lua_rawget(L, origins);
+				if (lua_istable(L, -1)) {
+					lua_getfield(L, -1, "mod");
+					lua_replace(L, -3);
+				}
+				lua_pop(L, 1);
+			}
+			lua_pushstring(L,
+				ScriptProfiler::describeFunction(L, callback).c_str());
+			lua_pushcclosure(L, script_profiled_callback, 3);
+
+			lua_pushvalue(L, callback);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, wrappers);
+		}
+		lua_rawseti(L, wrapped, i);
+		lua_pop(L, 1); // Pop callback
+	}
+
+	lua_replace(L, table);
+	lua_pop(L, 2); // Pop callback origins and wrappers
+}
+
 void ScriptApiBase::realityCheck()
 {
 	int top = lua_gettop(m_luastack);
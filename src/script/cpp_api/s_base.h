@@ -33,6 +33,7 @@ extern "C" {
 #include "threading/mutex_auto_lock.h"
 #include "common/c_types.h"
 #include "common/c_internal.h"
+#include "common/c_profiler.h"
 
 #define SCRIPTAPI_LOCK_DEBUG
 #define SCRIPTAPI_DEBUG
@@ -51,6 +52,9 @@ extern "C" {
 #define runCallbacks(nargs, mode) \
 	runCallbacksRaw((nargs), (mode), __FUNCTION__)
 
+#define pcallProfiled(nargs, nresults, error_handler) \
+	pcallProfiledRaw((nargs), (nresults), (error_handler), __FUNCTION__)
+
 #define setOriginFromTable(index) \
 	setOriginFromTableRaw(index, __FUNCTION__)
 
@@ -70,6 +74,10 @@ class ScriptApiBase {
 
 	void runCallbacksRaw(int nargs,
 		RunCallbacksMode mode, const char *fxn);
+	// Like lua_pcall, but accounts the time to the profiler if it is
+	// enabled
+	int pcallProfiledRaw(int nargs, int nresults, int error_handler,
+		const char *fxn);
 
 	/* object */
 	void addObjectReference(ServerActiveObject *cobj);
@@ -81,6 +89,11 @@ class ScriptApiBase {
 	void setOriginDirect(const char *origin);
 	void setOriginFromTableRaw(int index, const char *fxn);
 
+	ScriptProfiler &getProfiler() { return m_profiler; }
+	// Starts or stops the profiler, see ScriptProfiler::setEnabled
+	void setProfiling(bool enabled, u32 sample_interval_us = 0)
+		{ m_profiler.setEnabled(m_luastack, enabled, sample_interval_us); }
+
 protected:
 	friend class LuaABM;
 	friend class LuaLBM;
@@ -106,6 +119,8 @@ class ScriptApiBase {
 	GUIEngine* getGuiEngine() { return m_guiengine; }
 	void setGuiEngine(GUIEngine* guiengine) { m_guiengine = guiengine; }
 
+	void wrapProfiledCallbacks(int table);
+
 	void objectrefGetOrCreate(lua_State *L, ServerActiveObject *cobj);
 	void objectrefGet(lua_State *L, u16 id);
 
@@ -123,6 +138,8 @@ class ScriptApiBase {
 	Server*         m_server;
 	Environment*    m_environment;
 	GUIEngine*      m_guiengine;
+
+	ScriptProfiler  m_profiler;
 };
 
 #endif /* S_BASE_H_ */
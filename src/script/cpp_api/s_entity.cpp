@@ -19,7 +19,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "cpp_api/s_entity.h"
 #include "cpp_api/s_internal.h"
+#include "environment.h"
 #include "log.h"
+#include "porting.h"
+#include "profiler.h"
+#include "serverobject.h"
 #include "object_properties.h"
 #include "common/c_converter.h"
 #include "common/c_content.h"
@@ -95,7 +99,7 @@ void ScriptApiEntity::luaentity_Activate(u16 id,
 		lua_pushinteger(L, dtime_s);
 
 		setOriginFromTable(object);
-		PCALL_RES(lua_pcall(L, 3, 0, error_handler));
+		PCALL_RES(pcallProfiled(3, 0, error_handler));
 	} else {
 		lua_pop(L, 1);
 	}
@@ -144,7 +148,7 @@ std::string ScriptApiEntity::luaentity_GetStaticdata(u16 id)
 	lua_pushvalue(L, object); // self
 
 	setOriginFromTable(object);
-	PCALL_RES(lua_pcall(L, 1, 1, error_handler));
+	PCALL_RES(pcallProfiled(1, 1, error_handler));
 
 	lua_remove(L, object);
 	lua_remove(L, error_handler);
@@ -218,11 +222,69 @@ void ScriptApiEntity::luaentity_Step(u16 id, float dtime)
 	lua_pushnumber(L, dtime); // dtime
 
 	setOriginFromTable(object);
-	PCALL_RES(lua_pcall(L, 2, 0, error_handler));
+	PCALL_RES(pcallProfiled(2, 0, error_handler));
 
 	lua_pop(L, 2); // Pop object and error handler
 }
 
+void ScriptApiEntity::luaentity_StepBatch(const EntityStepBatches &batches,
+		float dtime)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	ServerEnvironment *env = (ServerEnvironment *)getEnv();
+	int error_handler = PUSH_ERROR_HANDLER(L);
+
+	// Get core.luaentities once for all entities
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "luaentities");
+	luaL_checktype(L, -1, LUA_TTABLE);
+	int luaentities = lua_gettop(L);
+
+	for (EntityStepBatches::const_iterator it = batches.begin();
+			it != batches.end(); ++it) {
+		const std::vector<u16> &ids = it->second;
+		if (ids.empty())
+			continue;
+
+		u32 t_start = porting::getTimeUs();
+		u32 stepped = 0;
+		for (size_t i = 0; i < ids.size(); i++) {
+			// An earlier on_step may have removed the object
+			ServerActiveObject *obj = env->getActiveObject(ids[i]);
+			if (obj == NULL || obj->m_removed || obj->m_pending_deactivation)
+				continue;
+
+			lua_rawgeti(L, luaentities, ids[i]);
+			int object = lua_gettop(L);
+			// Get step function
+			lua_getfield(L, -1, "on_step");
+			if (lua_isnil(L, -1)) {
+				lua_pop(L, 2); // Pop on_step and entity
+				continue;
+			}
+			luaL_checktype(L, -1, LUA_TFUNCTION);
+			lua_pushvalue(L, object); // self
+			lua_pushnumber(L, dtime); // dtime
+
+			setOriginFromTable(object);
+			PCALL_RES(pcallProfiled(2, 0, error_handler));
+
+			lua_pop(L, 1); // Pop object
+			stepped++;
+		}
+		u32 t_spent = porting::getTimeUs() - t_start;
+
+		EntityStepStats &stats = m_entity_step_stats[it->first];
+		stats.count += stepped;
+		stats.time_us += t_spent;
+		g_profiler->avg("Entity step: " + it->first + " [ms]",
+			t_spent / 1000.0f);
+	}
+
+	lua_pop(L, 3); // Pop luaentities, core and error handler
+}
+
 // Calls entity:on_punch(ObjectRef puncher, time_from_last_punch,
 //                       tool_capabilities, direction)
 void ScriptApiEntity::luaentity_Punch(u16 id,
@@ -253,7 +315,7 @@ void ScriptApiEntity::luaentity_Punch(u16 id,
 	push_v3f(L, dir);
 
 	setOriginFromTable(object);
-	PCALL_RES(lua_pcall(L, 5, 0, error_handler));
+	PCALL_RES(pcallProfiled(5, 0, error_handler));
 
 	lua_pop(L, 2); // Pop object and error handler
 }
@@ -283,7 +345,7 @@ void ScriptApiEntity::luaentity_Rightclick(u16 id,
 	objectrefGetOrCreate(L, clicker); // Clicker reference
 
 	setOriginFromTable(object);
-	PCALL_RES(lua_pcall(L, 2, 0, error_handler));
+	PCALL_RES(pcallProfiled(2, 0, error_handler));
 
 	lua_pop(L, 2); // Pop object and error handler
 }
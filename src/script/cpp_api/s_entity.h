@@ -22,10 +22,25 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "cpp_api/s_base.h"
 #include "irr_v3d.h"
+#include <map>
+#include <vector>
 
 struct ObjectProperties;
 struct ToolCapabilities;
 
+// Entity ids to be stepped, grouped by entity name
+typedef std::map<std::string, std::vector<u16> > EntityStepBatches;
+
+struct EntityStepStats
+{
+	EntityStepStats() : count(0), time_us(0) {}
+
+	// Number of on_step calls
+	u32 count;
+	// Time spent in on_step
+	u64 time_us;
+};
+
 class ScriptApiEntity
 		: virtual public ScriptApiBase
 {
@@ -38,11 +53,22 @@ class ScriptApiEntity
 	void luaentity_GetProperties(u16 id,
 			ObjectProperties *prop);
 	void luaentity_Step(u16 id, float dtime);
+	// Steps the entities of all batches with one lock and lookup of
+	// core.luaentities, and accounts the time spent per entity name
+	void luaentity_StepBatch(const EntityStepBatches &batches, float dtime);
 	void luaentity_Punch(u16 id,
 			ServerActiveObject *puncher, float time_from_last_punch,
 			const ToolCapabilities *toolcap, v3f dir);
 	void luaentity_Rightclick(u16 id,
 			ServerActiveObject *clicker);
+
+	const std::map<std::string, EntityStepStats> &getEntityStepStats() const
+		{ return m_entity_step_stats; }
+	void clearEntityStepStats()
+		{ m_entity_step_stats.clear(); }
+
+private:
+	std::map<std::string, EntityStepStats> m_entity_step_stats;
 };
 
 
@@ -24,7 +24,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "environment.h"
 #include "mapgen.h"
 #include "lua_api/l_env.h"
+#include "profiler.h"
 #include "server.h"
+#include "settings.h"
+#include "util/timetaker.h"
+
+ScriptApiEnv::ScriptApiEnv()
+{
+	m_step_budget_us = g_settings->getFloat("globalstep_time_budget") * 1000;
+}
 
 void ScriptApiEnv::environment_OnGenerated(v3s16 minp, v3s16 maxp,
 	u32 blockseed)
@@ -46,6 +54,8 @@ void ScriptApiEnv::environment_Step(float dtime)
 	SCRIPTAPI_PRECHECKHEADER
 	//infostream << "scriptapi_environment_step" << std::endl;
 
+	TimeTaker timer("environment_Step", NULL, PRECISION_MICRO);
+
 	// Get core.registered_globalsteps
 	lua_getglobal(L, "core");
 	lua_getfield(L, -1, "registered_globalsteps");
@@ -56,6 +66,126 @@ void ScriptApiEnv::environment_Step(float dtime)
 	} catch (LuaError &e) {
 		getServer()->setAsyncFatalError(e.what());
 	}
+
+	u32 globalstep_us = timer.getTimerTime();
+	g_profiler->avg("Server: globalsteps [ms]", globalstep_us / 1000.0f);
+	if (m_tasks.empty())
+		return;
+
+	// Tasks get what the globalsteps left of the budget
+	try {
+		runTasks(m_step_budget_us > globalstep_us ?
+			m_step_budget_us - globalstep_us : 0);
+	} catch (LuaError &e) {
+		getServer()->setAsyncFatalError(e.what());
+	}
+	g_profiler->avg("Server: Lua tasks [ms]",
+		(timer.stop(true) - globalstep_us) / 1000.0f);
+	g_profiler->avg("Server: Lua tasks pending", m_tasks.size());
+}
+
+// Every task that isn't deferrable is resumed at least once per step, also
+// when the budget is used up. After that all tasks are resumed in turns
+// until the budget is used up. The first task is moved to the end after
+// every step, so that deferred tasks get their turn eventually.
+void ScriptApiEnv::runTasks(u32 budget_us)
+{
+	TimeTaker timer("runTasks", NULL, PRECISION_MICRO);
+
+	bool first_round = true;
+	while (!m_tasks.empty()) {
+		// Tasks added while running are only resumed in the next round
+		size_t count = m_tasks.size();
+		std::list<ScriptTask>::iterator it = m_tasks.begin();
+		for (size_t i = 0; i < count; i++) {
+			u32 used_us = timer.getTimerTime();
+			if (used_us >= budget_us && (!first_round || it->deferrable)) {
+				++it;
+				continue;
+			}
+
+			bool finished;
+			try {
+				finished = resumeTask(*it);
+			} catch (LuaError &e) {
+				// The coroutine is dead, don't resume it again
+				m_tasks.erase(it);
+				throw;
+			}
+
+			u32 end_us = timer.getTimerTime();
+			if (end_us > budget_us) {
+				// Report the time spent after the budget ran out
+				g_profiler->add("Server: Lua task overrun: " + it->mod +
+					" [ms]", (end_us - MYMAX(used_us, budget_us)) / 1000.0f);
+			}
+
+			if (finished)
+				it = m_tasks.erase(it);
+			else
+				++it;
+		}
+		first_round = false;
+		if (timer.getTimerTime() >= budget_us)
+			break;
+	}
+
+	if (m_tasks.size() > 1)
+		m_tasks.splice(m_tasks.end(), m_tasks, m_tasks.begin());
+}
+
+bool ScriptApiEnv::resumeTask(const ScriptTask &task)
+{
+	lua_State *L = getStack();
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, task.thread_ref);
+	lua_State *thread = lua_tothread(L, -1);
+	// Pops the thread, the reference keeps it alive
+	lua_pop(L, 1);
+
+	// Drop the values of the last yield. Before the first resume the
+	// stack holds the task function.
+	if (lua_status(thread) == LUA_YIELD)
+		lua_settop(thread, 0);
+
+	setOriginDirect(task.mod.c_str());
+	ScriptProfiler::Timer timer;
+	timer.start();
+	int result = lua_resume(thread, 0);
+	if (getProfiler().isEnabled()) {
+		ScriptProfiler::Key key;
+		key.mod = task.mod;
+		key.type = "environment_Task";
+		key.function = task.function;
+		timer.stop(getProfiler(), key);
+	}
+
+	if (result == LUA_YIELD)
+		return false;
+
+	std::string error;
+	if (result != 0) {
+		const char *msg = lua_tostring(thread, -1);
+		error = "Error in a task of mod \"" + task.mod + "\": " +
+			(msg ? msg : "(error object is not a string)");
+
+		// Add the traceback of the coroutine, debug.traceback(thread, error)
+		lua_getglobal(L, "debug");
+		if (lua_istable(L, -1)) {
+			lua_getfield(L, -1, "traceback");
+			lua_pushthread(thread);
+			lua_xmove(thread, L, 1);
+			lua_pushstring(L, error.c_str());
+			if (lua_pcall(L, 2, 1, 0) == 0 && lua_isstring(L, -1))
+				error = lua_tostring(L, -1);
+			lua_pop(L, 1); // Pop traceback or error
+		}
+		lua_pop(L, 1); // Pop debug
+	}
+	luaL_unref(L, LUA_REGISTRYINDEX, task.thread_ref);
+	if (result != 0)
+		throw LuaError(error);
+	return true;
 }
 
 void ScriptApiEnv::player_event(ServerActiveObject *player, const std::string &type)
@@ -233,7 +363,7 @@ void ScriptApiEnv::on_emerge_area_completion(
 	setOriginDirect(state->origin.c_str());
 
 	try {
-		PCALL_RES(lua_pcall(L, 4, 0, error_handler));
+		PCALL_RES(pcallProfiled(4, 0, error_handler));
 	} catch (LuaError &e) {
 		server->setAsyncFatalError(e.what());
 	}
@@ -22,16 +22,37 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "cpp_api/s_base.h"
 #include "irr_v3d.h"
+#include <list>
 
 class ServerEnvironment;
 struct ScriptCallbackState;
 
+// A coroutine added with core.add_task()
+struct ScriptTask
+{
+	ScriptTask() : thread_ref(LUA_NOREF), deferrable(false) {}
+
+	// Registry reference to the coroutine
+	int thread_ref;
+	std::string mod;
+	// Source and line of the task function
+	std::string function;
+	// Only resumed when time of the step's budget is left
+	bool deferrable;
+};
+
 class ScriptApiEnv : virtual public ScriptApiBase
 {
 public:
-	// Called on environment step
+	ScriptApiEnv();
+
+	// Called on environment step, runs the globalsteps and then the tasks
+	// until the step's time budget is used up
 	void environment_Step(float dtime);
 
+	void addTask(const ScriptTask &task) { m_tasks.push_back(task); }
+	size_t getTaskCount() const { return m_tasks.size(); }
+
 	// Called after generating a piece of map
 	void environment_OnGenerated(v3s16 minp, v3s16 maxp, u32 blockseed);
 
@@ -43,6 +64,16 @@ class ScriptApiEnv : virtual public ScriptApiBase
 		ScriptCallbackState *state);
 
 	void initializeEnvironment(ServerEnvironment *env);
+
+private:
+	void runTasks(u32 budget_us);
+	// Resumes a task, returns true when it has finished.
+	// Throws LuaError if the task failed, which finishes it as well.
+	bool resumeTask(const ScriptTask &task);
+
+	// Time that globalsteps and tasks may use per step
+	u32 m_step_budget_us;
+	std::list<ScriptTask> m_tasks;
 };
 
 #endif /* S_ENV_H_ */
@@ -110,7 +110,7 @@ bool ScriptApiNode::node_on_punch(v3s16 p, MapNode node,
 	pushnode(L, node, ndef);
 	objectrefGetOrCreate(L, puncher);
 	pushPointedThing(pointed);
-	PCALL_RES(lua_pcall(L, 4, 0, error_handler));
+	PCALL_RES(pcallProfiled(4, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 	return true;
 }
@@ -132,7 +132,7 @@ bool ScriptApiNode::node_on_dig(v3s16 p, MapNode node,
 	push_v3s16(L, p);
 	pushnode(L, node, ndef);
 	objectrefGetOrCreate(L, digger);
-	PCALL_RES(lua_pcall(L, 3, 0, error_handler));
+	PCALL_RES(pcallProfiled(3, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 	return true;
 }
@@ -151,7 +151,7 @@ void ScriptApiNode::node_on_construct(v3s16 p, MapNode node)
 
 	// Call function
 	push_v3s16(L, p);
-	PCALL_RES(lua_pcall(L, 1, 0, error_handler));
+	PCALL_RES(pcallProfiled(1, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -169,7 +169,7 @@ void ScriptApiNode::node_on_destruct(v3s16 p, MapNode node)
 
 	// Call function
 	push_v3s16(L, p);
-	PCALL_RES(lua_pcall(L, 1, 0, error_handler));
+	PCALL_RES(pcallProfiled(1, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -188,7 +188,7 @@ void ScriptApiNode::node_after_destruct(v3s16 p, MapNode node)
 	// Call function
 	push_v3s16(L, p);
 	pushnode(L, node, ndef);
-	PCALL_RES(lua_pcall(L, 2, 0, error_handler));
+	PCALL_RES(pcallProfiled(2, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -207,7 +207,7 @@ bool ScriptApiNode::node_on_timer(v3s16 p, MapNode node, f32 dtime)
 	// Call function
 	push_v3s16(L, p);
 	lua_pushnumber(L,dtime);
-	PCALL_RES(lua_pcall(L, 2, 1, error_handler));
+	PCALL_RES(pcallProfiled(2, 1, error_handler));
 	lua_remove(L, error_handler);
 	return (bool) lua_isboolean(L, -1) && (bool) lua_toboolean(L, -1) == true;
 }
@@ -245,7 +245,7 @@ void ScriptApiNode::node_on_receive_fields(v3s16 p,
 		lua_settable(L, -3);
 	}
 	objectrefGetOrCreate(L, sender);        // player
-	PCALL_RES(lua_pcall(L, 4, 0, error_handler));
+	PCALL_RES(pcallProfiled(4, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -257,7 +257,7 @@ void ScriptApiNode::node_falling_update(v3s16 p)
 
 	lua_getglobal(L, "nodeupdate");
 	push_v3s16(L, p);
-	PCALL_RES(lua_pcall(L, 1, 0, error_handler));
+	PCALL_RES(pcallProfiled(1, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -269,6 +269,6 @@ void ScriptApiNode::node_falling_update_single(v3s16 p)
 
 	lua_getglobal(L, "nodeupdate_single");
 	push_v3s16(L, p);
-	PCALL_RES(lua_pcall(L, 1, 0, error_handler));
+	PCALL_RES(pcallProfiled(1, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
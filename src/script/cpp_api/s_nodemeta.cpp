@@ -56,7 +56,7 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowMove(v3s16 p,
 	lua_pushinteger(L, to_index + 1);     // to_index
 	lua_pushinteger(L, count);            // count
 	objectrefGetOrCreate(L, player);      // player
-	PCALL_RES(lua_pcall(L, 7, 1, error_handler));
+	PCALL_RES(pcallProfiled(7, 1, error_handler));
 	if (!lua_isnumber(L, -1))
 		throw LuaError("allow_metadata_inventory_move should"
 				" return a number, guilty node: " + nodename);
@@ -92,7 +92,7 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowPut(v3s16 p,
 	lua_pushinteger(L, index + 1);       // index
 	LuaItemStack::create(L, stack);      // stack
 	objectrefGetOrCreate(L, player);     // player
-	PCALL_RES(lua_pcall(L, 5, 1, error_handler));
+	PCALL_RES(pcallProfiled(5, 1, error_handler));
 	if(!lua_isnumber(L, -1))
 		throw LuaError("allow_metadata_inventory_put should"
 				" return a number, guilty node: " + nodename);
@@ -128,7 +128,7 @@ int ScriptApiNodemeta::nodemeta_inventory_AllowTake(v3s16 p,
 	lua_pushinteger(L, index + 1);       // index
 	LuaItemStack::create(L, stack);      // stack
 	objectrefGetOrCreate(L, player);     // player
-	PCALL_RES(lua_pcall(L, 5, 1, error_handler));
+	PCALL_RES(pcallProfiled(5, 1, error_handler));
 	if (!lua_isnumber(L, -1))
 		throw LuaError("allow_metadata_inventory_take should"
 				" return a number, guilty node: " + nodename);
@@ -167,7 +167,7 @@ void ScriptApiNodemeta::nodemeta_inventory_OnMove(v3s16 p,
 	lua_pushinteger(L, to_index + 1);     // to_index
 	lua_pushinteger(L, count);            // count
 	objectrefGetOrCreate(L, player);      // player
-	PCALL_RES(lua_pcall(L, 7, 0, error_handler));
+	PCALL_RES(pcallProfiled(7, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -198,7 +198,7 @@ void ScriptApiNodemeta::nodemeta_inventory_OnPut(v3s16 p,
 	lua_pushinteger(L, index + 1);       // index
 	LuaItemStack::create(L, stack);      // stack
 	objectrefGetOrCreate(L, player);     // player
-	PCALL_RES(lua_pcall(L, 5, 0, error_handler));
+	PCALL_RES(pcallProfiled(5, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
@@ -229,7 +229,7 @@ void ScriptApiNodemeta::nodemeta_inventory_OnTake(v3s16 p,
 	lua_pushinteger(L, index + 1);       // index
 	LuaItemStack::create(L, stack);      // stack
 	objectrefGetOrCreate(L, player);     // player
-	PCALL_RES(lua_pcall(L, 5, 0, error_handler));
+	PCALL_RES(pcallProfiled(5, 0, error_handler));
 	lua_pop(L, 1);  // Pop error handler
 }
 
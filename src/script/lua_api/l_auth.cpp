@@ -0,0 +1,149 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "lua_api/l_auth.h"
+#include "lua_api/l_internal.h"
+#include "common/c_converter.h"
+#include "database.h"
+#include "server.h"
+
+AuthDatabase *ModApiAuth::getAuthDb(lua_State *L)
+{
+	AuthDatabase *auth_db = getServer(L)->getAuthDatabase();
+	if (!auth_db)
+		throw LuaError("Authentication database not available");
+	return auth_db;
+}
+
+void ModApiAuth::pushAuthEntry(lua_State *L, const AuthEntry &entry)
+{
+	lua_newtable(L);
+	int table = lua_gettop(L);
+	lua_pushstring(L, entry.name.c_str());
+	lua_setfield(L, table, "name");
+	lua_pushstring(L, entry.password.c_str());
+	lua_setfield(L, table, "password");
+	lua_createtable(L, 0, entry.privileges.size());
+	for (std::vector<std::string>::const_iterator it = entry.privileges.begin();
+			it != entry.privileges.end(); ++it) {
+		lua_pushboolean(L, true);
+		lua_setfield(L, -2, it->c_str());
+	}
+	lua_setfield(L, table, "privileges");
+	if (entry.last_login >= 0) {
+		lua_pushnumber(L, entry.last_login);
+		lua_setfield(L, table, "last_login");
+	}
+}
+
+// auth.read(name) -> entry or nil
+int ModApiAuth::l_auth_read(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	std::string name = luaL_checkstring(L, 1);
+	AuthEntry entry;
+	if (!getAuthDb(L)->getAuth(name, entry))
+		return 0;
+
+	pushAuthEntry(L, entry);
+	return 1;
+}
+
+// auth.save(entry) -> bool
+int ModApiAuth::l_auth_save(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	AuthEntry entry;
+	if (!getstringfield(L, 1, "name", entry.name) || entry.name.empty())
+		throw LuaError("auth.save: entry has no name");
+	if (!getstringfield(L, 1, "password", entry.password))
+		throw LuaError("auth.save: entry has no password");
+
+	lua_getfield(L, 1, "privileges");
+	if (!lua_istable(L, -1))
+		throw LuaError("auth.save: entry has no privilege table");
+	lua_pushnil(L);
+	while (lua_next(L, -2) != 0) {
+		// key at index -2 and value at index -1
+		if (lua_type(L, -2) == LUA_TSTRING && lua_toboolean(L, -1))
+			entry.privileges.push_back(lua_tostring(L, -2));
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	lua_getfield(L, 1, "last_login");
+	if (lua_isnumber(L, -1))
+		entry.last_login = lua_tonumber(L, -1);
+	lua_pop(L, 1);
+
+	lua_pushboolean(L, getAuthDb(L)->saveAuth(entry));
+	return 1;
+}
+
+// auth.delete(name) -> bool
+int ModApiAuth::l_auth_delete(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	std::string name = luaL_checkstring(L, 1);
+	lua_pushboolean(L, getAuthDb(L)->deleteAuth(name));
+	return 1;
+}
+
+// auth.list_names() -> {name1, name2, ...}
+int ModApiAuth::l_auth_list_names(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	std::vector<std::string> names;
+	getAuthDb(L)->listNames(names);
+	lua_createtable(L, names.size(), 0);
+	for (size_t i = 0; i < names.size(); i++) {
+		lua_pushstring(L, names[i].c_str());
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+// auth.reload()
+int ModApiAuth::l_auth_reload(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	getAuthDb(L)->reload();
+	return 0;
+}
+
+void ModApiAuth::Initialize(lua_State *L, int top)
+{
+	// Kept in core.auth, core.auth_reload belongs to the auth handler
+	lua_newtable(L);
+	int auth_top = lua_gettop(L);
+
+	registerFunction(L, "read", l_auth_read, auth_top);
+	registerFunction(L, "save", l_auth_save, auth_top);
+	registerFunction(L, "delete", l_auth_delete, auth_top);
+	registerFunction(L, "list_names", l_auth_list_names, auth_top);
+	registerFunction(L, "reload", l_auth_reload, auth_top);
+
+	lua_setfield(L, top, "auth");
+}
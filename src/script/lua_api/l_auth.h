@@ -0,0 +1,58 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef L_AUTH_H_
+#define L_AUTH_H_
+
+#include "lua_api/l_base.h"
+
+class AuthDatabase;
+struct AuthEntry;
+
+/*
+	core.auth: access to the authentication database for the builtin auth
+	handler. Entries are tables {name=, password=, privileges={priv=true, ...},
+	last_login=}.
+*/
+class ModApiAuth : public ModApiBase
+{
+private:
+	static AuthDatabase *getAuthDb(lua_State *L);
+	static void pushAuthEntry(lua_State *L, const AuthEntry &entry);
+
+	// auth.read(name) -> entry or nil
+	static int l_auth_read(lua_State *L);
+
+	// auth.save(entry) -> bool
+	static int l_auth_save(lua_State *L);
+
+	// auth.delete(name) -> bool
+	static int l_auth_delete(lua_State *L);
+
+	// auth.list_names() -> {name1, name2, ...}
+	static int l_auth_list_names(lua_State *L);
+
+	// auth.reload()
+	static int l_auth_reload(lua_State *L);
+
+public:
+	static void Initialize(lua_State *L, int top);
+};
+
+#endif /* L_AUTH_H_ */
@@ -83,7 +83,8 @@ void LuaABM::trigger(ServerEnvironment *env, v3s16 p, MapNode n,
 	lua_pushnumber(L, active_object_count);
 	lua_pushnumber(L, active_object_count_wider);
 
-	int result = lua_pcall(L, 4, 0, error_handler);
+	int result = scriptIface->pcallProfiledRaw(4, 0, error_handler,
+		"LuaABM::trigger");
 	if (result)
 		scriptIface->scriptError(result, "LuaABM::trigger");
 
@@ -123,7 +124,8 @@ void LuaLBM::trigger(ServerEnvironment *env, v3s16 p, MapNode n)
 	push_v3s16(L, p);
 	pushnode(L, n, env->getGameDef()->ndef());
 
-	int result = lua_pcall(L, 2, 0, error_handler);
+	int result = scriptIface->pcallProfiledRaw(2, 0, error_handler,
+		"LuaLBM::trigger");
 	if (result)
 		scriptIface->scriptError(result, "LuaLBM::trigger");
 
@@ -233,6 +235,64 @@ int ModApiEnvMod::l_get_node_or_nil(lua_State *L)
 	return 1;
 }
 
+// Reads a position given as three numbers, rounded like read_v3s16
+static inline v3s16 check_raw_pos(lua_State *L, int index)
+{
+	v3f pf(luaL_checknumber(L, index),
+		luaL_checknumber(L, index + 1),
+		luaL_checknumber(L, index + 2));
+	return floatToInt(pf, 1.0);
+}
+
+// Reads content_id, param1, param2 starting at index.
+// Like VoxelManip data, content ids are not checked for registration.
+static inline MapNode check_raw_node(lua_State *L, int index)
+{
+	lua_Integer c = luaL_checkinteger(L, index);
+	if (c < 0 || c > MAX_REGISTERED_CONTENT)
+		throw LuaError("Invalid content id " + itos(c));
+	u8 param1 = luaL_optinteger(L, index + 1, 0);
+	u8 param2 = luaL_optinteger(L, index + 2, 0);
+	return MapNode((content_t)c, param1, param2);
+}
+
+// get_node_raw(x, y, z) -> content_id, param1, param2, pos_ok
+int ModApiEnvMod::l_get_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 pos = check_raw_pos(L, 1);
+	bool pos_ok;
+	MapNode n = env->getMap().getNodeNoEx(pos, &pos_ok);
+	lua_pushinteger(L, n.getContent());
+	lua_pushinteger(L, n.getParam1());
+	lua_pushinteger(L, n.getParam2());
+	lua_pushboolean(L, pos_ok);
+	return 4;
+}
+
+// set_node_raw(x, y, z, content_id, param1, param2) -> success
+int ModApiEnvMod::l_set_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 pos = check_raw_pos(L, 1);
+	MapNode n = check_raw_node(L, 4);
+	lua_pushboolean(L, env->setNode(pos, n));
+	return 1;
+}
+
+// swap_node_raw(x, y, z, content_id, param1, param2) -> success
+int ModApiEnvMod::l_swap_node_raw(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 pos = check_raw_pos(L, 1);
+	MapNode n = check_raw_node(L, 4);
+	lua_pushboolean(L, env->swapNode(pos, n));
+	return 1;
+}
+
 // get_node_light(pos, timeofday)
 // pos = {x=num, y=num, z=num}
 // timeofday: nil = current time, 0 = night, 0.5 = day
@@ -581,37 +641,80 @@ int ModApiEnvMod::l_get_gametime(lua_State *L)
 }
 
 
-// find_node_near(pos, radius, nodenames) -> pos or nil
+// Reads a nodenames argument of the find_nodes_* functions
 // nodenames: eg. {"ignore", "group:tree"} or "default:dirt"
-int ModApiEnvMod::l_find_node_near(lua_State *L)
+static void read_node_filter(lua_State *L, int index, INodeDefManager *ndef,
+		ContentIdSet &filter)
 {
-	GET_ENV_PTR;
-
-	INodeDefManager *ndef = getServer(L)->ndef();
-	v3s16 pos = read_v3s16(L, 1);
-	int radius = luaL_checkinteger(L, 2);
-	std::set<content_t> filter;
-	if(lua_istable(L, 3)){
-		int table = 3;
+	std::set<content_t> ids;
+	if (lua_istable(L, index)) {
 		lua_pushnil(L);
-		while(lua_next(L, table) != 0){
+		while (lua_next(L, index) != 0) {
 			// key at index -2 and value at index -1
 			luaL_checktype(L, -1, LUA_TSTRING);
-			ndef->getIds(lua_tostring(L, -1), filter);
+			ndef->getIds(lua_tostring(L, -1), ids);
 			// removes value, keeps key for next iteration
 			lua_pop(L, 1);
 		}
-	} else if(lua_isstring(L, 3)){
-		ndef->getIds(lua_tostring(L, 3), filter);
+	} else if (lua_isstring(L, index)) {
+		ndef->getIds(lua_tostring(L, index), ids);
 	}
 
+	for (std::set<content_t>::iterator it = ids.begin();
+			it != ids.end(); ++it)
+		filter.insert(*it);
+}
+
+// Reads the options table of the find_nodes_* functions
+static void read_find_options(lua_State *L, int index, u32 *limit,
+		bool *load_blocks, bool *packed)
+{
+	if (!lua_istable(L, index))
+		return;
+
+	*limit = MYMAX(getintfield_default(L, index, "limit", 0), 0);
+	*load_blocks = getboolfield_default(L, index, "load_blocks", false);
+	*packed = getboolfield_default(L, index, "packed", false);
+}
+
+// Pushes a list of positions, as position tables or, if packed, as
+// numbers in the format of minetest.hash_node_position()
+static void push_position_list(lua_State *L, const std::vector<v3s16> &list,
+		bool packed)
+{
+	lua_createtable(L, list.size(), 0);
+	for (u32 i = 0; i < list.size(); i++) {
+		const v3s16 &p = list[i];
+		if (packed) {
+			u64 hash = ((u64)(p.Z + 32768) << 32) |
+				((u64)(p.Y + 32768) << 16) | (u64)(p.X + 32768);
+			lua_pushnumber(L, (lua_Number)hash);
+		} else {
+			push_v3s16(L, p);
+		}
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
+// find_node_near(pos, radius, nodenames) -> pos or nil
+// nodenames: eg. {"ignore", "group:tree"} or "default:dirt"
+int ModApiEnvMod::l_find_node_near(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	INodeDefManager *ndef = getServer(L)->ndef();
+	v3s16 pos = read_v3s16(L, 1);
+	int radius = luaL_checkinteger(L, 2);
+	ContentIdSet filter;
+	read_node_filter(L, 3, ndef, filter);
+
 	for(int d=1; d<=radius; d++){
 		std::vector<v3s16> list = FacePositionCache::getFacePositions(d);
 		for(std::vector<v3s16>::iterator i = list.begin();
 				i != list.end(); ++i){
 			v3s16 p = pos + (*i);
 			content_t c = env->getMap().getNodeNoEx(p).getContent();
-			if(filter.count(c) != 0){
+			if(filter.contains(c)){
 				push_v3s16(L, p);
 				return 1;
 			}
@@ -620,8 +723,9 @@ int ModApiEnvMod::l_find_node_near(lua_State *L)
 	return 0;
 }
 
-// find_nodes_in_area(minp, maxp, nodenames) -> list of positions
+// find_nodes_in_area(minp, maxp, nodenames, [options]) -> list of positions
 // nodenames: eg. {"ignore", "group:tree"} or "default:dirt"
+// options: {limit=number, load_blocks=bool, packed=bool}
 int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 {
 	GET_ENV_PTR;
@@ -629,47 +733,34 @@ int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 	INodeDefManager *ndef = getServer(L)->ndef();
 	v3s16 minp = read_v3s16(L, 1);
 	v3s16 maxp = read_v3s16(L, 2);
-	std::set<content_t> filter;
-	if(lua_istable(L, 3)) {
-		int table = 3;
-		lua_pushnil(L);
-		while(lua_next(L, table) != 0) {
-			// key at index -2 and value at index -1
-			luaL_checktype(L, -1, LUA_TSTRING);
-			ndef->getIds(lua_tostring(L, -1), filter);
-			// removes value, keeps key for next iteration
-			lua_pop(L, 1);
-		}
-	} else if(lua_isstring(L, 3)) {
-		ndef->getIds(lua_tostring(L, 3), filter);
-	}
-
-	std::map<content_t, u16> individual_count;
-
-	lua_newtable(L);
-	u64 i = 0;
-	for (s16 x = minp.X; x <= maxp.X; x++)
-		for (s16 y = minp.Y; y <= maxp.Y; y++)
-			for (s16 z = minp.Z; z <= maxp.Z; z++) {
-				v3s16 p(x, y, z);
-				content_t c = env->getMap().getNodeNoEx(p).getContent();
-				if (filter.count(c) != 0) {
-					push_v3s16(L, p);
-					lua_rawseti(L, -2, ++i);
-					individual_count[c]++;
-				}
-	}
-	lua_newtable(L);
-	for (std::set<content_t>::iterator it = filter.begin();
-			it != filter.end(); ++it) {
-		lua_pushnumber(L, individual_count[*it]);
-		lua_setfield(L, -2, ndef->get(*it).name.c_str());
+	ContentIdSet filter;
+	read_node_filter(L, 3, ndef, filter);
+
+	u32 limit = 0;
+	bool load_blocks = false;
+	bool packed = false;
+	read_find_options(L, 4, &limit, &load_blocks, &packed);
+
+	std::vector<v3s16> found;
+	std::vector<u32> individual_count(filter.getEnd(), 0);
+	env->getMap().findNodesInArea(minp, maxp, filter, found,
+		&individual_count, false, limit, load_blocks);
+
+	push_position_list(L, found, packed);
+
+	const std::vector<content_t> &ids = filter.getIds();
+	lua_createtable(L, 0, ids.size());
+	for (u32 i = 0; i < ids.size(); i++) {
+		lua_pushnumber(L, individual_count[ids[i]]);
+		lua_setfield(L, -2, ndef->get(ids[i]).name.c_str());
 	}
 	return 2;
 }
 
-// find_nodes_in_area_under_air(minp, maxp, nodenames) -> list of positions
+// find_nodes_in_area_under_air(minp, maxp, nodenames, [options])
+// -> list of positions
 // nodenames: e.g. {"ignore", "group:tree"} or "default:dirt"
+// options: {limit=number, load_blocks=bool, packed=bool}
 int ModApiEnvMod::l_find_nodes_in_area_under_air(lua_State *L)
 {
 	/* Note: A similar but generalized (and therefore slower) version of this
@@ -684,40 +775,19 @@ int ModApiEnvMod::l_find_nodes_in_area_under_air(lua_State *L)
 	INodeDefManager *ndef = getServer(L)->ndef();
 	v3s16 minp = read_v3s16(L, 1);
 	v3s16 maxp = read_v3s16(L, 2);
-	std::set<content_t> filter;
+	ContentIdSet filter;
+	read_node_filter(L, 3, ndef, filter);
 
-	if (lua_istable(L, 3)) {
-		int table = 3;
-		lua_pushnil(L);
-		while(lua_next(L, table) != 0) {
-			// key at index -2 and value at index -1
-			luaL_checktype(L, -1, LUA_TSTRING);
-			ndef->getIds(lua_tostring(L, -1), filter);
-			// removes value, keeps key for next iteration
-			lua_pop(L, 1);
-		}
-	} else if (lua_isstring(L, 3)) {
-		ndef->getIds(lua_tostring(L, 3), filter);
-	}
+	u32 limit = 0;
+	bool load_blocks = false;
+	bool packed = false;
+	read_find_options(L, 4, &limit, &load_blocks, &packed);
 
-	lua_newtable(L);
-	u64 i = 0;
-	for (s16 x = minp.X; x <= maxp.X; x++)
-	for (s16 z = minp.Z; z <= maxp.Z; z++) {
-		s16 y = minp.Y;
-		v3s16 p(x, y, z);
-		content_t c = env->getMap().getNodeNoEx(p).getContent();
-		for (; y <= maxp.Y; y++) {
-			v3s16 psurf(x, y + 1, z);
-			content_t csurf = env->getMap().getNodeNoEx(psurf).getContent();
-			if(c != CONTENT_AIR && csurf == CONTENT_AIR &&
-					filter.count(c) != 0) {
-				push_v3s16(L, v3s16(x, y, z));
-				lua_rawseti(L, -2, ++i);
-			}
-			c = csurf;
-		}
-	}
+	std::vector<v3s16> found;
+	env->getMap().findNodesInArea(minp, maxp, filter, found,
+		NULL, true, limit, load_blocks);
+
+	push_position_list(L, found, packed);
 	return 1;
 }
 
@@ -1038,6 +1108,58 @@ int ModApiEnvMod::l_forceload_free_block(lua_State *L)
 	return 0;
 }
 
+// get_entity_step_stats([reset]) -> {name = {count=, time=}, ...}
+// time is in microseconds
+int ModApiEnvMod::l_get_entity_step_stats(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	ScriptApiEntity *script = getScriptApi<ScriptApiEntity>(L);
+	const std::map<std::string, EntityStepStats> &stats =
+		script->getEntityStepStats();
+
+	lua_createtable(L, 0, stats.size());
+	for (std::map<std::string, EntityStepStats>::const_iterator
+			it = stats.begin(); it != stats.end(); ++it) {
+		lua_createtable(L, 0, 2);
+		lua_pushnumber(L, it->second.count);
+		lua_setfield(L, -2, "count");
+		lua_pushnumber(L, it->second.time_us);
+		lua_setfield(L, -2, "time");
+		lua_setfield(L, -2, it->first.c_str());
+	}
+
+	if (lua_toboolean(L, 1))
+		script->clearEntityStepStats();
+	return 1;
+}
+
+// add_task(func, [{deferrable=bool}])
+int ModApiEnvMod::l_add_task(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+
+	ScriptTask task;
+	if (lua_istable(L, 2))
+		task.deferrable = getboolfield_default(L, 2, "deferrable", false);
+	task.function = ScriptProfiler::describeFunction(L, 1);
+
+	// The loading mod, or the mod whose callback is running
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_CURRENT_MOD_NAME);
+	const char *mod = lua_tostring(L, -1);
+	task.mod = mod ? mod : getScriptApiBase(L)->getOrigin();
+	lua_pop(L, 1);
+
+	lua_State *thread = lua_newthread(L);
+	lua_pushvalue(L, 1);
+	lua_xmove(L, thread, 1);
+	task.thread_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	getScriptApi<ScriptApiEnv>(L)->addTask(task);
+	return 0;
+}
+
 void ModApiEnvMod::Initialize(lua_State *L, int top)
 {
 	API_FCT(set_node);
@@ -1047,6 +1169,9 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(remove_node);
 	API_FCT(get_node);
 	API_FCT(get_node_or_nil);
+	API_FCT(get_node_raw);
+	API_FCT(set_node_raw);
+	API_FCT(swap_node_raw);
 	API_FCT(get_node_light);
 	API_FCT(place_node);
 	API_FCT(dig_node);
@@ -1080,4 +1205,6 @@ void ModApiEnvMod::Initialize(lua_State *L, int top)
 	API_FCT(transforming_liquid_add);
 	API_FCT(forceload_block);
 	API_FCT(forceload_free_block);
+	API_FCT(get_entity_step_stats);
+	API_FCT(add_task);
 }
@@ -47,6 +47,16 @@ class ModApiEnvMod : public ModApiBase {
 	// pos = {x=num, y=num, z=num}
 	static int l_get_node_or_nil(lua_State *L);
 
+	// Variants without tables, for tight loops
+	// get_node_raw(x, y, z) -> content_id, param1, param2, pos_ok
+	static int l_get_node_raw(lua_State *L);
+
+	// set_node_raw(x, y, z, content_id, param1, param2) -> success
+	static int l_set_node_raw(lua_State *L);
+
+	// swap_node_raw(x, y, z, content_id, param1, param2) -> success
+	static int l_swap_node_raw(lua_State *L);
+
 	// get_node_light(pos, timeofday)
 	// pos = {x=num, y=num, z=num}
 	// timeofday: nil = current time, 0 = night, 0.5 = day
@@ -171,6 +181,14 @@ class ModApiEnvMod : public ModApiBase {
 	// stops forceloading a position
 	static int l_forceload_free_block(lua_State *L);
 
+	// get_entity_step_stats([reset]) -> {name = {count=, time=}, ...}
+	// on_step calls and time spent in them per entity name
+	static int l_get_entity_step_stats(lua_State *L);
+
+	// add_task(func, [{deferrable=bool}])
+	// runs func as a coroutine within the time budget of the server steps
+	static int l_add_task(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 
@@ -22,10 +22,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "cpp_api/s_base.h"
+#include "scripting_game.h"
 #include "server.h"
 #include "environment.h"
 #include "player.h"
 #include "log.h"
+#include <sstream>
 
 // request_shutdown()
 int ModApiServer::l_request_shutdown(lua_State *L)
@@ -474,6 +476,114 @@ int ModApiServer::l_set_last_run_mod(lua_State *L)
 	return 0;
 }
 
+// set_script_profiling(enabled, [sample_interval])
+// sample_interval is in milliseconds, 0 or nil to not sample stacks
+int ModApiServer::l_set_script_profiling(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	bool enabled = lua_toboolean(L, 1);
+	u32 sample_interval = luaL_optnumber(L, 2, 0) * 1000;
+	getScriptApiBase(L)->setProfiling(enabled, sample_interval);
+	return 0;
+}
+
+// get_script_profile() -> list of {mod=, type=, func=, count=, wall=,
+//                                  cpu=, max_wall=}
+// Times are in microseconds
+int ModApiServer::l_get_script_profile(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	const ScriptProfiler::StatsMap &stats =
+		getScriptApiBase(L)->getProfiler().getStats();
+
+	lua_createtable(L, stats.size(), 0);
+	int i = 0;
+	for (ScriptProfiler::StatsMap::const_iterator it = stats.begin();
+			it != stats.end(); ++it) {
+		lua_createtable(L, 0, 7);
+		lua_pushstring(L, it->first.mod.c_str());
+		lua_setfield(L, -2, "mod");
+		lua_pushstring(L, it->first.type.c_str());
+		lua_setfield(L, -2, "type");
+		lua_pushstring(L, it->first.function.c_str());
+		lua_setfield(L, -2, "func");
+		lua_pushnumber(L, it->second.count);
+		lua_setfield(L, -2, "count");
+		lua_pushnumber(L, it->second.wall_us);
+		lua_setfield(L, -2, "wall");
+		lua_pushnumber(L, it->second.cpu_us);
+		lua_setfield(L, -2, "cpu");
+		lua_pushnumber(L, it->second.max_wall_us);
+		lua_setfield(L, -2, "max_wall");
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
+// get_script_profile_folded() -> string, sample count
+int ModApiServer::l_get_script_profile_folded(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	ScriptProfiler &profiler = getScriptApiBase(L)->getProfiler();
+	std::ostringstream os(std::ios_base::binary);
+	profiler.writeFolded(os);
+	std::string folded = os.str();
+	lua_pushlstring(L, folded.c_str(), folded.size());
+	lua_pushnumber(L, profiler.getSampleCount());
+	return 2;
+}
+
+// clear_script_profile()
+int ModApiServer::l_clear_script_profile(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	getScriptApiBase(L)->getProfiler().clear();
+	return 0;
+}
+
+// do_async_callback(func, param) -> jobid
+// func is dumped bytecode or the name of a registered async function
+int ModApiServer::l_do_async_callback(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	size_t func_length;
+	const char *func = luaL_checklstring(L, 1, &func_length);
+
+	PackedValue param;
+	script_pack(L, 2, param);
+
+	AsyncEngine &engine = getScriptApi<GameScripting>(L)->getAsyncEngine();
+	lua_pushinteger(L, engine.queueAsyncJob(
+		std::string(func, func_length), param));
+	return 1;
+}
+
+// get_finished_jobs() -> list of {jobid=, retval=}
+int ModApiServer::l_get_finished_jobs(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	getScriptApi<GameScripting>(L)->getAsyncEngine().pushFinishedJobs(L);
+	return 1;
+}
+
+// register_async_dofile(path)
+int ModApiServer::l_register_async_dofile(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	std::string path = luaL_checkstring(L, 1);
+	CHECK_SECURE_PATH_OPTIONAL(L, path.c_str());
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_CURRENT_MOD_NAME);
+	std::string mod_name = lua_isstring(L, -1) ? lua_tostring(L, -1) : "";
+	lua_pop(L, 1);
+
+	AsyncEngine &engine = getScriptApi<GameScripting>(L)->getAsyncEngine();
+	if (!engine.registerScript(path, mod_name))
+		throw LuaError("register_async_dofile can only be called at load time");
+	lua_pushboolean(L, true);
+	return 1;
+}
+
 #ifndef NDEBUG
 // cause_error(type_of_error)
 int ModApiServer::l_cause_error(lua_State *L)
@@ -535,6 +645,15 @@ void ModApiServer::Initialize(lua_State *L, int top)
 
 	API_FCT(get_last_run_mod);
 	API_FCT(set_last_run_mod);
+
+	API_FCT(set_script_profiling);
+	API_FCT(get_script_profile);
+	API_FCT(get_script_profile_folded);
+	API_FCT(clear_script_profile);
+
+	API_FCT(do_async_callback);
+	API_FCT(get_finished_jobs);
+	API_FCT(register_async_dofile);
 #ifndef NDEBUG
 	API_FCT(cause_error);
 #endif
@@ -97,6 +97,27 @@ class ModApiServer : public ModApiBase {
 	// set_last_run_mod(modname)
 	static int l_set_last_run_mod(lua_State *L);
 
+	// set_script_profiling(enabled, [sample_interval])
+	static int l_set_script_profiling(lua_State *L);
+
+	// get_script_profile() -> list of {mod=, type=, func=, count=, ...}
+	static int l_get_script_profile(lua_State *L);
+
+	// get_script_profile_folded() -> string, sample count
+	static int l_get_script_profile_folded(lua_State *L);
+
+	// clear_script_profile()
+	static int l_clear_script_profile(lua_State *L);
+
+	// do_async_callback(func, param) -> jobid
+	static int l_do_async_callback(lua_State *L);
+
+	// get_finished_jobs() -> list of {jobid=, retval=}
+	static int l_get_finished_jobs(lua_State *L);
+
+	// register_async_dofile(path)
+	static int l_register_async_dofile(lua_State *L);
+
 #ifndef NDEBUG
 	//  cause_error(type_of_error)
 	static int l_cause_error(lua_State *L);
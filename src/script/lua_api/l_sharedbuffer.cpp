@@ -0,0 +1,252 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "lua_api/l_sharedbuffer.h"
+#include "lua_api/l_internal.h"
+#include "threading/mutex_auto_lock.h"
+
+SharedBufferData::SharedBufferData(const std::string &bytes) :
+	m_is_bytes(true),
+	m_bytes(bytes),
+	m_refcount(1)
+{
+}
+
+SharedBufferData::SharedBufferData(const std::vector<double> &numbers) :
+	m_is_bytes(false),
+	m_numbers(numbers),
+	m_refcount(1)
+{
+}
+
+void SharedBufferData::grab()
+{
+	MutexAutoLock lock(m_refcount_mutex);
+	m_refcount++;
+}
+
+void SharedBufferData::drop()
+{
+	bool last;
+	{
+		MutexAutoLock lock(m_refcount_mutex);
+		last = --m_refcount == 0;
+	}
+	if (last)
+		delete this;
+}
+
+/*
+	LuaSharedBuffer
+*/
+
+// garbage collector
+int LuaSharedBuffer::gc_object(lua_State *L)
+{
+	LuaSharedBuffer *o = *(LuaSharedBuffer **)(lua_touserdata(L, 1));
+	delete o;
+	return 0;
+}
+
+// __index(self, key)
+int LuaSharedBuffer::mt_index(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSharedBuffer *o = *(LuaSharedBuffer **)lua_touserdata(L, 1);
+
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		lua_Integer i = lua_tointeger(L, 2);
+		if (i < 1 || (u64)i > o->m_data->getSize())
+			lua_pushnil(L);
+		else
+			lua_pushnumber(L, o->m_data->get(i - 1));
+		return 1;
+	}
+
+	// Methods are stored in the metatable
+	luaL_getmetatable(L, className);
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	return 1;
+}
+
+// __len(self)
+int LuaSharedBuffer::mt_len(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSharedBuffer *o = *(LuaSharedBuffer **)lua_touserdata(L, 1);
+	lua_pushinteger(L, o->m_data->getSize());
+	return 1;
+}
+
+// get(self, i)
+int LuaSharedBuffer::l_get(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSharedBuffer *o = checkobject(L, 1);
+	lua_Integer i = luaL_checkinteger(L, 2);
+	if (i < 1 || (u64)i > o->m_data->getSize())
+		luaL_argerror(L, 2, "index out of range");
+	lua_pushnumber(L, o->m_data->get(i - 1));
+	return 1;
+}
+
+// size(self)
+int LuaSharedBuffer::l_size(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSharedBuffer *o = checkobject(L, 1);
+	lua_pushinteger(L, o->m_data->getSize());
+	return 1;
+}
+
+// to_string(self) -> contents of a byte buffer
+int LuaSharedBuffer::l_to_string(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSharedBuffer *o = checkobject(L, 1);
+	if (!o->m_data->isBytes())
+		throw LuaError("to_string() called on a number buffer");
+	const std::string &bytes = o->m_data->getBytes();
+	lua_pushlstring(L, bytes.data(), bytes.size());
+	return 1;
+}
+
+// to_table(self) -> list of the elements
+int LuaSharedBuffer::l_to_table(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaSharedBuffer *o = checkobject(L, 1);
+	u32 size = o->m_data->getSize();
+	lua_createtable(L, size, 0);
+	for (u32 i = 0; i < size; i++) {
+		lua_pushnumber(L, o->m_data->get(i));
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+LuaSharedBuffer::LuaSharedBuffer(SharedBufferData *data) :
+	m_data(data)
+{
+	m_data->grab();
+}
+
+LuaSharedBuffer::~LuaSharedBuffer()
+{
+	m_data->drop();
+}
+
+int LuaSharedBuffer::create_object(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	SharedBufferData *data;
+	if (lua_type(L, 1) == LUA_TSTRING) {
+		size_t len;
+		const char *s = lua_tolstring(L, 1, &len);
+		data = new SharedBufferData(std::string(s, len));
+	} else {
+		luaL_checktype(L, 1, LUA_TTABLE);
+		std::vector<double> numbers(lua_objlen(L, 1));
+		for (u32 i = 0; i < numbers.size(); i++) {
+			lua_rawgeti(L, 1, i + 1);
+			numbers[i] = luaL_checknumber(L, -1);
+			lua_pop(L, 1);
+		}
+		data = new SharedBufferData(numbers);
+	}
+
+	create(L, data);
+	data->drop();
+	return 1;
+}
+
+void LuaSharedBuffer::create(lua_State *L, SharedBufferData *data)
+{
+	LuaSharedBuffer *o = new LuaSharedBuffer(data);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+LuaSharedBuffer *LuaSharedBuffer::checkobject(lua_State *L, int narg)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	luaL_checktype(L, narg, LUA_TUSERDATA);
+
+	void *ud = luaL_checkudata(L, narg, className);
+	if (!ud)
+		luaL_typerror(L, narg, className);
+
+	return *(LuaSharedBuffer **)ud;  // unbox pointer
+}
+
+LuaSharedBuffer *LuaSharedBuffer::toobject(lua_State *L, int narg)
+{
+	void *ud = lua_touserdata(L, narg);
+	if (ud == NULL || !lua_getmetatable(L, narg))
+		return NULL;
+	luaL_getmetatable(L, className);
+	bool is_buffer = lua_rawequal(L, -1, -2);
+	lua_pop(L, 2);
+	return is_buffer ? *(LuaSharedBuffer **)ud : NULL;
+}
+
+void LuaSharedBuffer::Register(lua_State *L)
+{
+	luaL_newmetatable(L, className);
+	int metatable = lua_gettop(L);
+
+	// Keep the metatable hidden, it also holds the methods
+	lua_pushliteral(L, "__metatable");
+	lua_pushboolean(L, false);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__index");
+	lua_pushcfunction(L, mt_index);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__len");
+	lua_pushcfunction(L, mt_len);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, gc_object);
+	lua_settable(L, metatable);
+
+	luaL_openlib(L, 0, methods, 0);  // fill metatable with methods
+	lua_pop(L, 1);  // drop metatable
+}
+
+const char LuaSharedBuffer::className[] = "SharedBuffer";
+const luaL_reg LuaSharedBuffer::methods[] = {
+	luamethod(LuaSharedBuffer, get),
+	luamethod(LuaSharedBuffer, size),
+	luamethod(LuaSharedBuffer, to_string),
+	luamethod(LuaSharedBuffer, to_table),
+	{0,0}
+};
@@ -0,0 +1,109 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef L_SHAREDBUFFER_H_
+#define L_SHAREDBUFFER_H_
+
+#include "lua_api/l_base.h"
+#include "irrlichttypes.h"
+#include "threading/mutex.h"
+#include <string>
+#include <vector>
+
+/*
+	Immutable data shared by several Lua states, e.g. the game and its
+	async workers. The data never changes after creation, only the
+	reference count is protected.
+*/
+class SharedBufferData
+{
+public:
+	// Array of bytes
+	SharedBufferData(const std::string &bytes);
+	// Array of numbers
+	SharedBufferData(const std::vector<double> &numbers);
+
+	void grab();
+	// Deletes the data when the last reference is dropped
+	void drop();
+
+	bool isBytes() const
+		{ return m_is_bytes; }
+	u32 getSize() const
+		{ return m_is_bytes ? m_bytes.size() : m_numbers.size(); }
+	// i is zero-based
+	double get(u32 i) const
+		{ return m_is_bytes ? (u8)m_bytes[i] : m_numbers[i]; }
+
+	const std::string &getBytes() const
+		{ return m_bytes; }
+
+private:
+	~SharedBufferData() {}
+
+	const bool m_is_bytes;
+	const std::string m_bytes;
+	const std::vector<double> m_numbers;
+
+	Mutex m_refcount_mutex;
+	u32 m_refcount;
+};
+
+/*
+	LuaSharedBuffer
+*/
+class LuaSharedBuffer : public ModApiBase {
+private:
+	SharedBufferData *m_data;
+
+	static const char className[];
+	static const luaL_reg methods[];
+
+	// garbage collector
+	static int gc_object(lua_State *L);
+	static int mt_index(lua_State *L);
+	static int mt_len(lua_State *L);
+
+	static int l_get(lua_State *L);
+	static int l_size(lua_State *L);
+	static int l_to_string(lua_State *L);
+	static int l_to_table(lua_State *L);
+
+public:
+	LuaSharedBuffer(SharedBufferData *data);
+	~LuaSharedBuffer();
+
+	SharedBufferData *getData()
+		{ return m_data; }
+
+	// create_shared_buffer(string or list of numbers)
+	// Creates a LuaSharedBuffer and leaves it on top of stack
+	static int create_object(lua_State *L);
+
+	// Creates a LuaSharedBuffer referencing data and leaves it on top of stack
+	static void create(lua_State *L, SharedBufferData *data);
+
+	static LuaSharedBuffer *checkobject(lua_State *L, int narg);
+	// Returns NULL if the value at narg is not a LuaSharedBuffer
+	static LuaSharedBuffer *toobject(lua_State *L, int narg);
+
+	static void Register(lua_State *L);
+};
+
+#endif /* L_SHAREDBUFFER_H_ */
@@ -0,0 +1,261 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "lua_api/l_storage.h"
+#include "lua_api/l_internal.h"
+#include "common/c_converter.h"
+#include "mod_storage.h"
+#include "server.h"
+
+// get_mod_storage() -> StorageRef or nil outside of mod load time
+int ModApiStorage::l_get_mod_storage(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	lua_rawgeti(L, LUA_REGISTRYINDEX, CUSTOM_RIDX_CURRENT_MOD_NAME);
+	if (!lua_isstring(L, -1))
+		return 0;
+	std::string modname = lua_tostring(L, -1);
+	lua_pop(L, 1);
+
+	ModStorageManager *manager = getServer(L)->getModStorageManager();
+	if (!manager)
+		return 0;
+
+	StorageRef::create(L, manager->getModStorage(modname));
+	return 1;
+}
+
+void ModApiStorage::Initialize(lua_State *L, int top)
+{
+	API_FCT(get_mod_storage);
+}
+
+StorageRef::StorageRef(ModStorage *storage) :
+	m_storage(storage)
+{
+}
+
+int StorageRef::gc_object(lua_State *L)
+{
+	StorageRef *o = *(StorageRef **)(lua_touserdata(L, 1));
+	delete o;
+	return 0;
+}
+
+// contains(self, key) -> bool
+int StorageRef::l_contains(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	lua_pushboolean(L, ref->m_storage->contains(key));
+	return 1;
+}
+
+// get_string(self, key) -> string, "" if missing
+int StorageRef::l_get_string(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	std::string value = ref->m_storage->getString(key);
+	lua_pushlstring(L, value.c_str(), value.size());
+	return 1;
+}
+
+// set_string(self, key, value), "" removes the key
+int StorageRef::l_set_string(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	size_t len = 0;
+	const char *s = lua_isnoneornil(L, 3) ? "" : luaL_checklstring(L, 3, &len);
+	ref->m_storage->setString(key, std::string(s, len));
+	return 0;
+}
+
+// get_int(self, key) -> number, 0 if missing
+int StorageRef::l_get_int(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	lua_pushnumber(L, stoi(ref->m_storage->getString(key)));
+	return 1;
+}
+
+// set_int(self, key, value)
+int StorageRef::l_set_int(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	int value = luaL_checkint(L, 3);
+	ref->m_storage->setString(key, itos(value));
+	return 0;
+}
+
+// get_float(self, key) -> number, 0 if missing
+int StorageRef::l_get_float(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	lua_pushnumber(L, stof(ref->m_storage->getString(key)));
+	return 1;
+}
+
+// set_float(self, key, value)
+int StorageRef::l_set_float(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	std::string key = luaL_checkstring(L, 2);
+	float value = luaL_checknumber(L, 3);
+	ref->m_storage->setString(key, ftos(value));
+	return 0;
+}
+
+// get_keys(self) -> {key1, key2, ...}
+int StorageRef::l_get_keys(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	const StringMap &entries = ref->m_storage->getEntries();
+	lua_createtable(L, entries.size(), 0);
+	int i = 1;
+	for (StringMap::const_iterator it = entries.begin();
+			it != entries.end(); ++it) {
+		lua_pushlstring(L, it->first.c_str(), it->first.size());
+		lua_rawseti(L, -2, i++);
+	}
+	return 1;
+}
+
+// to_table(self) -> {[key1]=value1, ...}
+int StorageRef::l_to_table(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	const StringMap &entries = ref->m_storage->getEntries();
+	lua_createtable(L, 0, entries.size());
+	for (StringMap::const_iterator it = entries.begin();
+			it != entries.end(); ++it) {
+		lua_pushlstring(L, it->first.c_str(), it->first.size());
+		lua_pushlstring(L, it->second.c_str(), it->second.size());
+		lua_rawset(L, -3);
+	}
+	return 1;
+}
+
+// from_table(self, {[key1]=value1, ...}), replaces all pairs
+int StorageRef::l_from_table(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	StorageRef *ref = checkobject(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	StringMap entries;
+	lua_pushnil(L);
+	while (lua_next(L, 2) != 0) {
+		// key at index -2 and value at index -1
+		if (!lua_isstring(L, -2) || !lua_isstring(L, -1))
+			throw LuaError("from_table: keys and values must be strings or numbers");
+		// Copy the key, lua_tolstring would convert numbers in place
+		lua_pushvalue(L, -2);
+		size_t key_len, value_len;
+		const char *key = lua_tolstring(L, -1, &key_len);
+		const char *value = lua_tolstring(L, -2, &value_len);
+		entries[std::string(key, key_len)] = std::string(value, value_len);
+		lua_pop(L, 2);
+	}
+
+	// Only changed keys are queued for writing
+	StringMap old_entries = ref->m_storage->getEntries();
+	for (StringMap::const_iterator it = old_entries.begin();
+			it != old_entries.end(); ++it) {
+		if (entries.find(it->first) == entries.end())
+			ref->m_storage->setString(it->first, "");
+	}
+	for (StringMap::const_iterator it = entries.begin();
+			it != entries.end(); ++it)
+		ref->m_storage->setString(it->first, it->second);
+	return 0;
+}
+
+// Creates a StorageRef and leaves it on top of stack
+void StorageRef::create(lua_State *L, ModStorage *storage)
+{
+	StorageRef *o = new StorageRef(storage);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+}
+
+StorageRef *StorageRef::checkobject(lua_State *L, int narg)
+{
+	luaL_checktype(L, narg, LUA_TUSERDATA);
+	void *ud = luaL_checkudata(L, narg, className);
+	if (!ud) luaL_typerror(L, narg, className);
+	return *(StorageRef **)ud;  // unbox pointer
+}
+
+void StorageRef::Register(lua_State *L)
+{
+	lua_newtable(L);
+	int methodtable = lua_gettop(L);
+	luaL_newmetatable(L, className);
+	int metatable = lua_gettop(L);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushvalue(L, methodtable);
+	lua_settable(L, metatable);  // hide metatable from Lua getmetatable()
+
+	lua_pushliteral(L, "__index");
+	lua_pushvalue(L, methodtable);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, gc_object);
+	lua_settable(L, metatable);
+
+	lua_pop(L, 1);  // drop metatable
+
+	luaL_openlib(L, 0, methods, 0);  // fill methodtable
+	lua_pop(L, 1);  // drop methodtable
+
+	// Cannot be created from Lua
+}
+
+const char StorageRef::className[] = "StorageRef";
+const luaL_reg StorageRef::methods[] = {
+	luamethod(StorageRef, contains),
+	luamethod(StorageRef, get_string),
+	luamethod(StorageRef, set_string),
+	luamethod(StorageRef, get_int),
+	luamethod(StorageRef, set_int),
+	luamethod(StorageRef, get_float),
+	luamethod(StorageRef, set_float),
+	luamethod(StorageRef, get_keys),
+	luamethod(StorageRef, to_table),
+	luamethod(StorageRef, from_table),
+	{0,0}
+};
@@ -0,0 +1,88 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef L_STORAGE_H_
+#define L_STORAGE_H_
+
+#include "lua_api/l_base.h"
+
+class ModStorage;
+
+class ModApiStorage : public ModApiBase
+{
+private:
+	// get_mod_storage() -> StorageRef or nil outside of mod load time
+	static int l_get_mod_storage(lua_State *L);
+
+public:
+	static void Initialize(lua_State *L, int top);
+};
+
+/*
+	StorageRef: the mod storage of one mod, see ModStorage
+*/
+class StorageRef : public ModApiBase
+{
+private:
+	ModStorage *m_storage;
+
+	static const char className[];
+	static const luaL_reg methods[];
+
+	static int gc_object(lua_State *L);
+
+	// contains(self, key) -> bool
+	static int l_contains(lua_State *L);
+
+	// get_string(self, key) -> string, "" if missing
+	static int l_get_string(lua_State *L);
+	// set_string(self, key, value), "" removes the key
+	static int l_set_string(lua_State *L);
+
+	// get_int(self, key) -> number, 0 if missing
+	static int l_get_int(lua_State *L);
+	// set_int(self, key, value)
+	static int l_set_int(lua_State *L);
+
+	// get_float(self, key) -> number, 0 if missing
+	static int l_get_float(lua_State *L);
+	// set_float(self, key, value)
+	static int l_set_float(lua_State *L);
+
+	// get_keys(self) -> {key1, key2, ...}
+	static int l_get_keys(lua_State *L);
+
+	// to_table(self) -> {[key1]=value1, ...}
+	static int l_to_table(lua_State *L);
+	// from_table(self, {[key1]=value1, ...}), replaces all pairs
+	static int l_from_table(lua_State *L);
+
+public:
+	StorageRef(ModStorage *storage);
+	~StorageRef() {}
+
+	// Creates a StorageRef and leaves it on top of stack
+	static void create(lua_State *L, ModStorage *storage);
+
+	static StorageRef *checkobject(lua_State *L, int narg);
+
+	static void Register(lua_State *L);
+};
+
+#endif /* L_STORAGE_H_ */
@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "cpp_api/s_async.h"
+#include "lua_api/l_sharedbuffer.h"
 #include "serialization.h"
 #include "json/json.h"
 #include "cpp_api/s_security.h"
@@ -401,6 +402,13 @@ int ModApiUtil::l_request_insecure_environment(lua_State *L)
 	return 1;
 }
 
+// create_shared_buffer(string or list of numbers)
+int ModApiUtil::l_create_shared_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+	return LuaSharedBuffer::create_object(L);
+}
+
 
 void ModApiUtil::Initialize(lua_State *L, int top)
 {
@@ -433,6 +441,8 @@ void ModApiUtil::Initialize(lua_State *L, int top)
 	API_FCT(get_dir_list);
 
 	API_FCT(request_insecure_environment);
+
+	API_FCT(create_shared_buffer);
 }
 
 void ModApiUtil::InitializeAsync(AsyncEngine& engine)
@@ -459,5 +469,7 @@ void ModApiUtil::InitializeAsync(AsyncEngine& engine)
 
 	ASYNC_API_FCT(mkdir);
 	ASYNC_API_FCT(get_dir_list);
+
+	ASYNC_API_FCT(create_shared_buffer);
 }
 
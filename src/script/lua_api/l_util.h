@@ -95,6 +95,9 @@ class ModApiUtil : public ModApiBase {
 	// request_insecure_environment()
 	static int l_request_insecure_environment(lua_State *L);
 
+	// create_shared_buffer(string or list of numbers)
+	static int l_create_shared_buffer(lua_State *L);
+
 public:
 	static void Initialize(lua_State *L, int top);
 
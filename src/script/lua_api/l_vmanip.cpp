@@ -70,7 +70,7 @@ int LuaVoxelManip::l_get_data(lua_State *L)
 	if (use_buffer)
 		lua_pushvalue(L, 2);
 	else
-		lua_newtable(L);
+		lua_createtable(L, volume, 0);
 
 	for (u32 i = 0; i != volume; i++) {
 		lua_Integer cid = vm->m_data[i].getContent();
@@ -239,7 +239,7 @@ int LuaVoxelManip::l_get_light_data(lua_State *L)
 
 	u32 volume = vm->m_area.getVolume();
 
-	lua_newtable(L);
+	lua_createtable(L, volume, 0);
 	for (u32 i = 0; i != volume; i++) {
 		lua_Integer light = vm->m_data[i].param1;
 		lua_pushinteger(L, light);
@@ -281,7 +281,7 @@ int LuaVoxelManip::l_get_param2_data(lua_State *L)
 
 	u32 volume = vm->m_area.getVolume();
 
-	lua_newtable(L);
+	lua_createtable(L, volume, 0);
 	for (u32 i = 0; i != volume; i++) {
 		lua_Integer param2 = vm->m_data[i].param2;
 		lua_pushinteger(L, param2);
@@ -314,6 +314,30 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 	return 0;
 }
 
+int LuaVoxelManip::l_get_data_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	checkobject(L, 1);
+	return LuaVoxelManipBuffer::create_object(L, 1, VMBUF_CONTENT);
+}
+
+int LuaVoxelManip::l_get_light_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	checkobject(L, 1);
+	return LuaVoxelManipBuffer::create_object(L, 1, VMBUF_PARAM1);
+}
+
+int LuaVoxelManip::l_get_param2_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	checkobject(L, 1);
+	return LuaVoxelManipBuffer::create_object(L, 1, VMBUF_PARAM2);
+}
+
 int LuaVoxelManip::l_update_map(lua_State *L)
 {
 	GET_ENV_PTR;
@@ -473,7 +497,262 @@ const luaL_reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, set_light_data),
 	luamethod(LuaVoxelManip, get_param2_data),
 	luamethod(LuaVoxelManip, set_param2_data),
+	luamethod(LuaVoxelManip, get_data_buffer),
+	luamethod(LuaVoxelManip, get_light_buffer),
+	luamethod(LuaVoxelManip, get_param2_buffer),
 	luamethod(LuaVoxelManip, was_modified),
 	luamethod(LuaVoxelManip, get_emerged_area),
 	{0,0}
 };
+
+/*
+	LuaVoxelManipBuffer
+*/
+
+// garbage collector
+int LuaVoxelManipBuffer::gc_object(lua_State *L)
+{
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)(lua_touserdata(L, 1));
+	luaL_unref(L, LUA_REGISTRYINDEX, o->m_vm_ref);
+	delete o;
+
+	return 0;
+}
+
+u32 LuaVoxelManipBuffer::getSize() const
+{
+	// The area can change with read_from_map(), never cache it
+	return m_vm->vm->m_area.getVolume();
+}
+
+lua_Integer LuaVoxelManipBuffer::get(u32 i) const
+{
+	const MapNode &n = m_vm->vm->m_data[i];
+	switch (m_field) {
+	case VMBUF_CONTENT:
+		return n.getContent();
+	case VMBUF_PARAM1:
+		return n.param1;
+	default:
+		return n.param2;
+	}
+}
+
+void LuaVoxelManipBuffer::set(u32 i, lua_Integer v)
+{
+	MapNode &n = m_vm->vm->m_data[i];
+	switch (m_field) {
+	case VMBUF_CONTENT:
+		n.setContent(v);
+		break;
+	case VMBUF_PARAM1:
+		n.param1 = v;
+		break;
+	default:
+		n.param2 = v;
+	}
+}
+
+// Returns the zero-based index for the one-based Lua index at narg
+u32 LuaVoxelManipBuffer::checkIndex(lua_State *L, int narg) const
+{
+	lua_Integer i = luaL_checkinteger(L, narg);
+	if (i < 1 || (u64)i > getSize())
+		luaL_argerror(L, narg, "index out of range");
+	return i - 1;
+}
+
+// __index(self, key)
+int LuaVoxelManipBuffer::mt_index(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)lua_touserdata(L, 1);
+
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		lua_Integer i = lua_tointeger(L, 2);
+		if (i < 1 || (u64)i > o->getSize())
+			lua_pushnil(L);
+		else
+			lua_pushinteger(L, o->get(i - 1));
+		return 1;
+	}
+
+	// Methods are stored in the metatable
+	luaL_getmetatable(L, className);
+	lua_pushvalue(L, 2);
+	lua_rawget(L, -2);
+	return 1;
+}
+
+// __newindex(self, i, value)
+int LuaVoxelManipBuffer::mt_newindex(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)lua_touserdata(L, 1);
+	u32 i = o->checkIndex(L, 2);
+	o->set(i, luaL_checkinteger(L, 3));
+
+	return 0;
+}
+
+// __len(self)
+int LuaVoxelManipBuffer::mt_len(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)lua_touserdata(L, 1);
+	lua_pushinteger(L, o->getSize());
+
+	return 1;
+}
+
+// get(self, i)
+int LuaVoxelManipBuffer::l_get(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	lua_pushinteger(L, o->get(o->checkIndex(L, 2)));
+
+	return 1;
+}
+
+// set(self, i, value)
+int LuaVoxelManipBuffer::l_set(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	u32 i = o->checkIndex(L, 2);
+	o->set(i, luaL_checkinteger(L, 3));
+
+	return 0;
+}
+
+// size(self)
+int LuaVoxelManipBuffer::l_size(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	lua_pushinteger(L, o->getSize());
+
+	return 1;
+}
+
+// to_table(self, [buffer])
+int LuaVoxelManipBuffer::l_to_table(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	u32 volume = o->getSize();
+
+	if (lua_istable(L, 2))
+		lua_pushvalue(L, 2);
+	else
+		lua_createtable(L, volume, 0);
+
+	for (u32 i = 0; i != volume; i++) {
+		lua_pushinteger(L, o->get(i));
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	return 1;
+}
+
+// from_table(self, table)
+int LuaVoxelManipBuffer::l_from_table(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	u32 volume = o->getSize();
+	for (u32 i = 0; i != volume; i++) {
+		lua_rawgeti(L, 2, i + 1);
+		o->set(i, lua_tointeger(L, -1));
+		lua_pop(L, 1);
+	}
+
+	return 0;
+}
+
+LuaVoxelManipBuffer::LuaVoxelManipBuffer(LuaVoxelManip *vm, int vm_ref,
+		VoxelManipBufferField field) :
+	m_vm(vm),
+	m_vm_ref(vm_ref),
+	m_field(field)
+{
+}
+
+int LuaVoxelManipBuffer::create_object(lua_State *L, int vm_idx,
+		VoxelManipBufferField field)
+{
+	LuaVoxelManip *vm = LuaVoxelManip::checkobject(L, vm_idx);
+
+	lua_pushvalue(L, vm_idx);
+	int vm_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	LuaVoxelManipBuffer *o = new LuaVoxelManipBuffer(vm, vm_ref, field);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+LuaVoxelManipBuffer *LuaVoxelManipBuffer::checkobject(lua_State *L, int narg)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	luaL_checktype(L, narg, LUA_TUSERDATA);
+
+	void *ud = luaL_checkudata(L, narg, className);
+	if (!ud)
+		luaL_typerror(L, narg, className);
+
+	return *(LuaVoxelManipBuffer **)ud;  // unbox pointer
+}
+
+void LuaVoxelManipBuffer::Register(lua_State *L)
+{
+	luaL_newmetatable(L, className);
+	int metatable = lua_gettop(L);
+
+	// Keep the metatable hidden, it also holds the methods
+	lua_pushliteral(L, "__metatable");
+	lua_pushboolean(L, false);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__index");
+	lua_pushcfunction(L, mt_index);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__newindex");
+	lua_pushcfunction(L, mt_newindex);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__len");
+	lua_pushcfunction(L, mt_len);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, gc_object);
+	lua_settable(L, metatable);
+
+	luaL_openlib(L, 0, methods, 0);  // fill metatable with methods
+	lua_pop(L, 1);  // drop metatable
+}
+
+const char LuaVoxelManipBuffer::className[] = "VoxelManipBuffer";
+const luaL_reg LuaVoxelManipBuffer::methods[] = {
+	luamethod(LuaVoxelManipBuffer, get),
+	luamethod(LuaVoxelManipBuffer, set),
+	luamethod(LuaVoxelManipBuffer, size),
+	luamethod(LuaVoxelManipBuffer, to_table),
+	luamethod(LuaVoxelManipBuffer, from_table),
+	{0,0}
+};
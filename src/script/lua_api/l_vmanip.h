@@ -60,6 +60,10 @@ class LuaVoxelManip : public ModApiBase {
 	static int l_get_param2_data(lua_State *L);
 	static int l_set_param2_data(lua_State *L);
 
+	static int l_get_data_buffer(lua_State *L);
+	static int l_get_light_buffer(lua_State *L);
+	static int l_get_param2_buffer(lua_State *L);
+
 	static int l_was_modified(lua_State *L);
 	static int l_get_emerged_area(lua_State *L);
 
@@ -80,4 +84,57 @@ class LuaVoxelManip : public ModApiBase {
 	static void Register(lua_State *L);
 };
 
+/*
+  VoxelManipBuffer
+
+  Array view of one field of the nodes loaded into a VoxelManip. Reads and
+  writes go straight to the VoxelManip data, nothing is copied.
+ */
+enum VoxelManipBufferField {
+	VMBUF_CONTENT,
+	VMBUF_PARAM1,
+	VMBUF_PARAM2
+};
+
+class LuaVoxelManipBuffer : public ModApiBase {
+private:
+	// The VoxelManip is referenced from the registry to keep it alive
+	LuaVoxelManip *m_vm;
+	int m_vm_ref;
+	VoxelManipBufferField m_field;
+
+	static const char className[];
+	static const luaL_reg methods[];
+
+	static int gc_object(lua_State *L);
+	static int mt_index(lua_State *L);
+	static int mt_newindex(lua_State *L);
+	static int mt_len(lua_State *L);
+
+	static int l_get(lua_State *L);
+	static int l_set(lua_State *L);
+	static int l_size(lua_State *L);
+	static int l_to_table(lua_State *L);
+	static int l_from_table(lua_State *L);
+
+	u32 getSize() const;
+	lua_Integer get(u32 i) const;
+	void set(u32 i, lua_Integer v);
+	u32 checkIndex(lua_State *L, int narg) const;
+
+public:
+	LuaVoxelManipBuffer(LuaVoxelManip *vm, int vm_ref,
+		VoxelManipBufferField field);
+	~LuaVoxelManipBuffer() {}
+
+	// Creates a buffer for the VoxelManip at index vm_idx
+	// and leaves it on top of stack
+	static int create_object(lua_State *L, int vm_idx,
+		VoxelManipBufferField field);
+
+	static LuaVoxelManipBuffer *checkobject(lua_State *L, int narg);
+
+	static void Register(lua_State *L);
+};
+
 #endif /* L_VMANIP_H_ */
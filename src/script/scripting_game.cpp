@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "settings.h"
 #include "cpp_api/s_internal.h"
 #include "lua_api/l_areastore.h"
+#include "lua_api/l_auth.h"
 #include "lua_api/l_base.h"
 #include "lua_api/l_craft.h"
 #include "lua_api/l_env.h"
@@ -39,6 +40,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "lua_api/l_util.h"
 #include "lua_api/l_vmanip.h"
 #include "lua_api/l_settings.h"
+#include "lua_api/l_storage.h"
+#include "lua_api/l_sharedbuffer.h"
 #include "lua_api/l_http.h"
 
 extern "C" {
@@ -71,6 +74,10 @@ GameScripting::GameScripting(Server* server)
 	InitializeModApi(L, top);
 	lua_pop(L, 1);
 
+	if (g_settings->getBool("script_profiler"))
+		setProfiling(true,
+			g_settings->getU16("script_profiler_sample_interval") * 1000);
+
 	// Push builtin initialization type
 	lua_pushstring(L, "game");
 	lua_setglobal(L, "INIT");
@@ -81,6 +88,7 @@ GameScripting::GameScripting(Server* server)
 void GameScripting::InitializeModApi(lua_State *L, int top)
 {
 	// Initialize mod api modules
+	ModApiAuth::Initialize(L, top);
 	ModApiCraft::Initialize(L, top);
 	ModApiEnvMod::Initialize(L, top);
 	ModApiInventory::Initialize(L, top);
@@ -89,6 +97,7 @@ void GameScripting::InitializeModApi(lua_State *L, int top)
 	ModApiParticles::Initialize(L, top);
 	ModApiRollback::Initialize(L, top);
 	ModApiServer::Initialize(L, top);
+	ModApiStorage::Initialize(L, top);
 	ModApiUtil::Initialize(L, top);
 	ModApiHttp::Initialize(L, top);
 
@@ -101,11 +110,23 @@ void GameScripting::InitializeModApi(lua_State *L, int top)
 	LuaPseudoRandom::Register(L);
 	LuaPcgRandom::Register(L);
 	LuaSecureRandom::Register(L);
+	LuaSharedBuffer::Register(L);
 	LuaVoxelManip::Register(L);
+	LuaVoxelManipBuffer::Register(L);
 	NodeMetaRef::Register(L);
 	NodeTimerRef::Register(L);
 	ObjectRef::Register(L);
 	LuaSettings::Register(L);
+	StorageRef::Register(L);
+}
+
+void GameScripting::initializeAsync()
+{
+	// Register functions to async environment
+	ModApiUtil::InitializeAsync(m_async_engine);
+
+	s32 num_threads = g_settings->getS32("server_async_threads");
+	m_async_engine.initialize(MYMAX(num_threads, 1), getServer());
 }
 
 void log_deprecated(const std::string &message)
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SCRIPTING_GAME_H_
 
 #include "cpp_api/s_base.h"
+#include "cpp_api/s_async.h"
 #include "cpp_api/s_entity.h"
 #include "cpp_api/s_env.h"
 #include "cpp_api/s_inventory.h"
@@ -48,8 +49,15 @@ class GameScripting :
 
 	// use ScriptApiBase::loadMod() to load mods
 
+	// Starts the async workers, call once all mods are loaded
+	void initializeAsync();
+
+	AsyncEngine &getAsyncEngine() { return m_async_engine; }
+
 private:
 	void InitializeModApi(lua_State *L, int top);
+
+	AsyncEngine m_async_engine;
 };
 
 void log_deprecated(const std::string &message);
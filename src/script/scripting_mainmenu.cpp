@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "lua_api/l_mainmenu.h"
 #include "lua_api/l_util.h"
 #include "lua_api/l_settings.h"
+#include "lua_api/l_sharedbuffer.h"
 
 extern "C" {
 #include "lualib.h"
@@ -66,6 +67,7 @@ void MainMenuScripting::initializeModApi(lua_State *L, int top)
 
 	// Register reference classes (userdata)
 	LuaSettings::Register(L);
+	LuaSharedBuffer::Register(L);
 
 	// Register functions to async environment
 	ModApiMainMenu::InitializeAsync(asyncEngine);
@@ -82,8 +84,8 @@ void MainMenuScripting::step() {
 }
 
 /******************************************************************************/
-unsigned int MainMenuScripting::queueAsync(std::string serialized_func,
-		std::string serialized_param) {
-	return asyncEngine.queueAsyncJob(serialized_func, serialized_param);
+unsigned int MainMenuScripting::queueAsync(const std::string &func,
+		const PackedValue &param) {
+	return asyncEngine.queueAsyncJob(func, param);
 }
 
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <algorithm>
 #include "network/networkprotocol.h"
 #include "network/serveropcodes.h"
+#include "network/mediaserver.h"
 #include "ban.h"
 #include "environment.h"
 #include "map.h"
@@ -30,6 +31,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "constants.h"
 #include "voxel.h"
 #include "config.h"
+#include "database-dummy.h"
+#include "database-files.h"
+#include "database-sqlite3.h"
+#if USE_LEVELDB
+#include "database-leveldb.h"
+#endif
 #include "version.h"
 #include "filesys.h"
 #include "mapblock.h"
@@ -50,6 +57,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "content_abm.h"
 #include "content_sao.h"
 #include "mods.h"
+#include "mod_storage.h"
 #include "sound.h" // dummySoundManager
 #include "event_manager.h"
 #include "serverlist.h"
@@ -63,6 +71,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/sha1.h"
 #include "util/hex.h"
 
+// Number of auth entries kept in memory, enough for all online players
+#define AUTH_CACHE_SIZE 1024
+
+// Blocks with more changed nodes than this are sent whole instead of as
+// a TOCLIENT_BLOCK_DELTA
+#define BLOCK_DELTA_MAX_NODES 512
+
 class ClientNotFoundException : public BaseException
 {
 public:
@@ -117,6 +132,42 @@ void *ServerThread::run()
 	return NULL;
 }
 
+class ServerReceiveThread : public Thread
+{
+public:
+
+	ServerReceiveThread(Server *server):
+		Thread("ServerReceive"),
+		m_server(server)
+	{}
+
+	void *run();
+
+private:
+	Server *m_server;
+};
+
+void *ServerReceiveThread::run()
+{
+	DSTACK(FUNCTION_NAME);
+	BEGIN_DEBUG_EXCEPTION_HANDLER
+
+	while (!stopRequested()) {
+		try {
+			m_server->DecodeReceived();
+		} catch (con::NoIncomingDataException &e) {
+		} catch (con::PeerNotFoundException &e) {
+			infostream<<"Server: PeerNotFoundException"<<std::endl;
+		} catch (con::ConnectionBindFailed &e) {
+			m_server->setAsyncFatalError(e.what());
+		}
+	}
+
+	END_DEBUG_EXCEPTION_HANDLER
+
+	return NULL;
+}
+
 v3f ServerSoundParams::getPos(ServerEnvironment *env, bool *pos_exists) const
 {
 	if(pos_exists) *pos_exists = false;
@@ -162,6 +213,8 @@ Server::Server(
 			ipv6,
 			this),
 	m_banmanager(NULL),
+	m_auth_database(NULL),
+	m_mod_storage(NULL),
 	m_rollback(NULL),
 	m_enable_rollback_recording(false),
 	m_emerge(NULL),
@@ -171,6 +224,7 @@ Server::Server(
 	m_craftdef(createCraftDefManager()),
 	m_event(new EventManager()),
 	m_thread(NULL),
+	m_receive_thread(NULL),
 	m_time_of_day_send_timer(0),
 	m_uptime(0),
 	m_clients(&m_con),
@@ -179,6 +233,7 @@ Server::Server(
 	m_admin_chat(iface),
 	m_ignore_map_edit_events(false),
 	m_ignore_map_edit_events_peer_id(0),
+	m_media_server(NULL),
 	m_next_sound_id(0)
 
 {
@@ -213,6 +268,7 @@ Server::Server(
 
 	// Create server thread
 	m_thread = new ServerThread(this);
+	m_receive_thread = new ServerReceiveThread(this);
 
 	// Create emerge manager
 	m_emerge = new EmergeManager(this);
@@ -263,6 +319,34 @@ Server::Server(
 		errorstream << std::endl;
 	}
 
+	// Open the authentication database before builtin needs it
+	if (!worldmt_settings.exists("auth_backend")) {
+		// Worlds with an auth.txt keep using it until it is
+		// imported with --migrateauth
+		if (fs::PathExists(m_path_world + DIR_DELIM "auth.txt")) {
+			worldmt_settings.set("auth_backend", "files");
+			warningstream << "World has an auth.txt, consider importing "
+				"it to an auth database with --migrateauth sqlite3"
+				<< std::endl;
+		} else {
+			worldmt_settings.set("auth_backend", "sqlite3");
+		}
+		if (!worldmt_settings.updateConfigFile(worldmt.c_str()))
+			errorstream << "Server: Failed to update world.mt!" << std::endl;
+	}
+	m_auth_database = new AuthDatabaseCache(createAuthDatabase(
+		worldmt_settings.get("auth_backend"), m_path_world), AUTH_CACHE_SIZE);
+
+	if (!worldmt_settings.exists("mod_storage_backend")) {
+		worldmt_settings.set("mod_storage_backend", "sqlite3");
+		if (!worldmt_settings.updateConfigFile(worldmt.c_str()))
+			errorstream << "Server: Failed to update world.mt!" << std::endl;
+	}
+	m_mod_storage = new ModStorageManager(createModStorageDatabase(
+		worldmt_settings.get("mod_storage_backend"), m_path_world),
+		g_settings->getFloat("mod_storage_flush_interval"));
+	m_mod_storage->start();
+
 	//lock environment
 	MutexAutoLock envlock(m_env_mutex);
 
@@ -304,6 +388,9 @@ Server::Server(
 		m_script->loadMod(script_path, mod.name);
 	}
 
+	// Start the async workers now that they know all mod scripts
+	m_script->initializeAsync();
+
 	// Read Textures and calculate sha1 sums
 	fillMediaCache();
 
@@ -323,6 +410,11 @@ Server::Server(
 	// unmap node names for connected nodeboxes
 	m_nodedef->mapNodeboxConnections();
 
+	// Definitions are complete now, prepare them for the clients that
+	// will join
+	getCompressedItemDef(LATEST_PROTOCOL_VERSION);
+	getCompressedNodeDef(LATEST_PROTOCOL_VERSION);
+
 	// init the recipe hashes to speed up crafting
 	m_craftdef->initHashes(this);
 
@@ -396,6 +488,8 @@ Server::~Server()
 	// Stop threads
 	stop();
 	delete m_thread;
+	delete m_receive_thread;
+	delete m_media_server;
 
 	// stop all emerge threads before deleting players that may have
 	// requested blocks to be emerged
@@ -418,6 +512,11 @@ Server::~Server()
 	infostream<<"Server: Deinitializing scripting"<<std::endl;
 	delete m_script;
 
+	delete m_auth_database;
+
+	// Writes the changes made since the last flush
+	delete m_mod_storage;
+
 	// Delete detached inventories
 	for (std::map<std::string, Inventory*>::iterator
 			i = m_detached_inventories.begin();
@@ -426,6 +525,34 @@ Server::~Server()
 	}
 }
 
+AuthDatabase *Server::createAuthDatabase(const std::string &name,
+		const std::string &savedir)
+{
+	if (name == "sqlite3")
+		return new AuthDatabaseSQLite3(savedir);
+	if (name == "dummy")
+		return new AuthDatabaseDummy();
+	if (name == "files")
+		return new AuthDatabaseFiles(savedir);
+	#if USE_LEVELDB
+	else if (name == "leveldb")
+		return new AuthDatabaseLevelDB(savedir);
+	#endif
+	else
+		throw BaseException(std::string("Auth database backend ") + name + " not supported.");
+}
+
+ModStorageDatabase *Server::createModStorageDatabase(const std::string &name,
+		const std::string &savedir)
+{
+	if (name == "sqlite3")
+		return new ModStorageDatabaseSQLite3(savedir);
+	if (name == "dummy")
+		return new ModStorageDatabaseDummy();
+	else
+		throw BaseException(std::string("Mod storage database backend ") + name + " not supported.");
+}
+
 void Server::start(Address bind_addr)
 {
 	DSTACK(FUNCTION_NAME);
@@ -435,15 +562,19 @@ void Server::start(Address bind_addr)
 	infostream<<"Starting server on "
 			<< bind_addr.serializeString() <<"..."<<std::endl;
 
-	// Stop thread if already running
+	// Stop threads if already running
 	m_thread->stop();
+	m_receive_thread->stop();
 
 	// Initialize connection
 	m_con.SetTimeoutMs(30);
 	m_con.Serve(bind_addr);
 
-	// Start thread
+	startMediaServer();
+
+	// Start threads
 	m_thread->start();
+	m_receive_thread->start();
 
 	// ASCII art for the win!
 	actionstream
@@ -467,10 +598,15 @@ void Server::stop()
 
 	// Stop threads (set run=false first so both start stopping)
 	m_thread->stop();
+	m_receive_thread->stop();
 	//m_emergethread.setRun(false);
 	m_thread->wait();
+	m_receive_thread->wait();
 	//m_emergethread.stop();
 
+	if (m_media_server)
+		m_media_server->stop();
+
 	infostream<<"Server: Threads stopped"<<std::endl;
 }
 
@@ -496,6 +632,62 @@ void Server::step(float dtime)
 	}
 }
 
+// The active object messages of one object in their network format, built
+// once and then referenced by the packets of all clients that know the object
+struct EncodedObjectMessages
+{
+	std::string reliable;
+	std::string unreliable;
+	v3f pos;
+};
+
+static void queueNodeEdit(std::map<v3s16, BlockNodeEdits> &block_edits,
+		v3s16 p, NodeEditType type, MapNode n, u16 known_by_peer)
+{
+	v3s16 blockpos = getNodeBlockPos(p);
+	v3s16 rel = p - blockpos * MAP_BLOCKSIZE;
+	u16 index = rel.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE
+			+ rel.Y * MAP_BLOCKSIZE + rel.X;
+
+	// Only the last change of a node is sent. A swap following an add or
+	// removal still has to clear the metadata the client knows about.
+	BlockNodeEdits &edits = block_edits[blockpos];
+	BlockNodeEdits::iterator it = edits.find(index);
+	if (it != edits.end() && type == NODE_EDIT_ADD_KEEP_METADATA &&
+			it->second.type != NODE_EDIT_ADD_KEEP_METADATA)
+		type = NODE_EDIT_ADD;
+
+	QueuedNodeEdit &edit = edits[index];
+	edit.type = type;
+	edit.n = n;
+	edit.known_by_peer = known_by_peer;
+}
+
+// Writes the edits of a block to pkt, leaving out those ignore_peer
+// made itself. Returns the number of edits written.
+static u16 serializeNodeEdits(NetworkPacket &pkt, v3s16 blockpos,
+		const BlockNodeEdits &edits, u16 ignore_peer)
+{
+	u16 count = 0;
+	for (BlockNodeEdits::const_iterator i = edits.begin();
+			i != edits.end(); ++i) {
+		if (ignore_peer == 0 || i->second.known_by_peer != ignore_peer)
+			count++;
+	}
+
+	pkt << blockpos << count;
+	for (BlockNodeEdits::const_iterator i = edits.begin();
+			i != edits.end(); ++i) {
+		if (ignore_peer != 0 && i->second.known_by_peer == ignore_peer)
+			continue;
+		pkt << i->first << i->second.type;
+		if (i->second.type != NODE_EDIT_REMOVE)
+			pkt << i->second.n.param0 << i->second.n.param1
+					<< i->second.n.param2;
+	}
+	return count;
+}
+
 void Server::AsyncRunStep(bool initial_step)
 {
 	DSTACK(FUNCTION_NAME);
@@ -736,6 +928,7 @@ void Server::AsyncRunStep(bool initial_step)
 
 				// Remove from known objects
 				client->m_known_objects.erase(id);
+				client->forgetObjectUpdates(id);
 
 				if(obj && obj->m_known_by_count > 0)
 					obj->m_known_by_count--;
@@ -796,8 +989,8 @@ void Server::AsyncRunStep(bool initial_step)
 		ScopeProfiler sp(g_profiler, "Server: sending object messages");
 
 		// Key = object id
-		// Value = data sent by object
-		std::map<u16, std::vector<ActiveObjectMessage>* > buffered_messages;
+		// Value = messages of the object, encoded once for all clients
+		std::map<u16, EncodedObjectMessages> buffered_messages;
 
 		// Get active object messages from environment
 		for(;;) {
@@ -805,30 +998,56 @@ void Server::AsyncRunStep(bool initial_step)
 			if (aom.id == 0)
 				break;
 
-			std::vector<ActiveObjectMessage>* message_list = NULL;
-			std::map<u16, std::vector<ActiveObjectMessage>* >::iterator n;
-			n = buffered_messages.find(aom.id);
-			if (n == buffered_messages.end()) {
-				message_list = new std::vector<ActiveObjectMessage>;
-				buffered_messages[aom.id] = message_list;
-			}
-			else {
-				message_list = n->second;
-			}
-			message_list->push_back(aom);
+			EncodedObjectMessages &encoded = buffered_messages[aom.id];
+			std::string &data = aom.reliable ?
+				encoded.reliable : encoded.unreliable;
+			// Add object id
+			char buf[2];
+			writeU16((u8*)&buf[0], aom.id);
+			data.append(buf, 2);
+			// Add data
+			data += serializeString(aom.datastring);
+		}
+
+		// Interest tiers of unreliable messages
+		RemoteClient::ObjectUpdateTiers tiers;
+		tiers.near_range = g_settings->getFloat("object_update_near_range") * BS;
+		tiers.far_range = g_settings->getFloat("object_update_far_range") * BS;
+		tiers.medium_interval = g_settings->getFloat("object_update_medium_interval");
+		tiers.far_interval = g_settings->getFloat("object_update_far_interval");
+		const double now = m_uptime.get();
+
+		for (std::map<u16, EncodedObjectMessages>::iterator
+				i = buffered_messages.begin();
+				i != buffered_messages.end(); ++i) {
+			ServerActiveObject *obj = m_env->getActiveObject(i->first);
+			if (obj)
+				i->second.pos = obj->getBasePosition();
 		}
 
 		m_clients.lock();
 		std::map<u16, RemoteClient*> clients = m_clients.getClientList();
+		// The messages of the objects known to a client
+		std::vector<const std::string *> reliable_data;
+		std::vector<const std::string *> unreliable_data;
+		// Deferred messages whose time has come, kept until sent
+		std::vector<std::string> released;
 		// Route data to every client
 		for (std::map<u16, RemoteClient*>::iterator
 			i = clients.begin();
 			i != clients.end(); ++i) {
 			RemoteClient *client = i->second;
-			std::string reliable_data;
-			std::string unreliable_data;
+			if (buffered_messages.empty() && !client->hasObjectUpdates())
+				continue;
+
+			Player *player = m_env->getPlayer(client->peer_id);
+			u32 reliable_size = 0;
+			u32 unreliable_size = 0;
+			reliable_data.clear();
+			unreliable_data.clear();
+			released.clear();
 			// Go through all objects in message buffer
-			for (std::map<u16, std::vector<ActiveObjectMessage>* >::iterator
+			for (std::map<u16, EncodedObjectMessages>::iterator
 					j = buffered_messages.begin();
 					j != buffered_messages.end(); ++j) {
 				// If object is not known by client, skip it
@@ -836,47 +1055,47 @@ void Server::AsyncRunStep(bool initial_step)
 				if (client->m_known_objects.find(id) == client->m_known_objects.end())
 					continue;
 
-				// Get message list of object
-				std::vector<ActiveObjectMessage>* list = j->second;
-				// Go through every message
-				for (std::vector<ActiveObjectMessage>::iterator
-						k = list->begin(); k != list->end(); ++k) {
-					// Compose the full new data with header
-					ActiveObjectMessage aom = *k;
-					std::string new_data;
-					// Add object id
-					char buf[2];
-					writeU16((u8*)&buf[0], aom.id);
-					new_data.append(buf, 2);
-					// Add data
-					new_data += serializeString(aom.datastring);
-					// Add data to buffer
-					if(aom.reliable)
-						reliable_data += new_data;
-					else
-						unreliable_data += new_data;
+				const EncodedObjectMessages &encoded = j->second;
+				if (!encoded.reliable.empty()) {
+					reliable_data.push_back(&encoded.reliable);
+					reliable_size += encoded.reliable.size();
 				}
+				if (encoded.unreliable.empty())
+					continue;
+
+				f32 d = 0;
+				if (player != NULL)
+					d = player->getPosition().getDistanceFrom(encoded.pos);
+				if (!client->filterObjectUpdate(id, d, now,
+						encoded.unreliable, tiers))
+					continue;
+				unreliable_data.push_back(&encoded.unreliable);
+				unreliable_size += encoded.unreliable.size();
 			}
+
+			// Release deferred messages of objects that did not send
+			// anything newer in this step
+			client->releaseObjectUpdates(now, released);
+			for (size_t j = 0; j < released.size(); j++) {
+				unreliable_data.push_back(&released[j]);
+				unreliable_size += released[j].size();
+			}
+
 			/*
 				reliable_data and unreliable_data are now ready.
 				Send them.
 			*/
-			if(reliable_data.size() > 0) {
-				SendActiveObjectMessages(client->peer_id, reliable_data);
+			if (reliable_size > 0) {
+				SendActiveObjectMessages(client->peer_id, reliable_data,
+					reliable_size);
 			}
 
-			if(unreliable_data.size() > 0) {
-				SendActiveObjectMessages(client->peer_id, unreliable_data, false);
+			if (unreliable_size > 0) {
+				SendActiveObjectMessages(client->peer_id, unreliable_data,
+					unreliable_size, false);
 			}
 		}
 		m_clients.unlock();
-
-		// Clear buffered_messages
-		for(std::map<u16, std::vector<ActiveObjectMessage>* >::iterator
-				i = buffered_messages.begin();
-				i != buffered_messages.end(); ++i) {
-			delete i->second;
-		}
 	}
 
 	/*
@@ -899,6 +1118,9 @@ void Server::AsyncRunStep(bool initial_step)
 		// We'll log the amount of each
 		Profiler prof;
 
+		// Node changes for clients that support TOCLIENT_NODE_EDITS
+		std::map<v3s16, BlockNodeEdits> block_edits;
+
 		while(m_unsent_map_edit_queue.size() != 0)
 		{
 			MapEditEvent* event = m_unsent_map_edit_queue.front();
@@ -913,20 +1135,31 @@ void Server::AsyncRunStep(bool initial_step)
 			case MEET_ADDNODE:
 			case MEET_SWAPNODE:
 				prof.add("MEET_ADDNODE", 1);
+				queueNodeEdit(block_edits, event->p,
+						event->type == MEET_ADDNODE ? NODE_EDIT_ADD :
+						NODE_EDIT_ADD_KEEP_METADATA, event->n,
+						event->already_known_by_peer);
 				sendAddNode(event->p, event->n, event->already_known_by_peer,
 						&far_players, disable_single_change_sending ? 5 : 30,
 						event->type == MEET_ADDNODE);
 				break;
 			case MEET_REMOVENODE:
 				prof.add("MEET_REMOVENODE", 1);
+				queueNodeEdit(block_edits, event->p, NODE_EDIT_REMOVE,
+						MapNode(CONTENT_AIR), event->already_known_by_peer);
 				sendRemoveNode(event->p, event->already_known_by_peer,
 						&far_players, disable_single_change_sending ? 5 : 30);
 				break;
-			case MEET_BLOCK_NODE_METADATA_CHANGED:
+			case MEET_BLOCK_NODE_METADATA_CHANGED: {
 				infostream << "Server: MEET_BLOCK_NODE_METADATA_CHANGED" << std::endl;
 						prof.add("MEET_BLOCK_NODE_METADATA_CHANGED", 1);
+						MapBlock *block =
+								m_env->getMap().getBlockNoCreateNoEx(event->p);
+						if (block)
+							block->logMetadataChange();
 						setBlockNotSent(event->p);
 				break;
+			}
 			case MEET_OTHER:
 				infostream << "Server: MEET_OTHER" << std::endl;
 				prof.add("MEET_OTHER", 1);
@@ -973,6 +1206,9 @@ void Server::AsyncRunStep(bool initial_step)
 				break;*/
 		}
 
+		if (!block_edits.empty())
+			sendNodeEdits(block_edits);
+
 		if(event_count >= 5){
 			infostream<<"Server: MapEditEvents:"<<std::endl;
 			prof.print(infostream);
@@ -1026,34 +1262,96 @@ void Server::AsyncRunStep(bool initial_step)
 	}
 }
 
-void Server::Receive()
+void Server::DecodeReceived()
 {
 	DSTACK(FUNCTION_NAME);
-	SharedBuffer<u8> data;
-	u16 peer_id;
+	ReceivedCommand cmd;
+	cmd.pkt = new NetworkPacket();
 	try {
-		NetworkPacket pkt;
-		m_con.Receive(&pkt);
-		peer_id = pkt.getPeerId();
-		ProcessData(&pkt);
+		m_con.Receive(cmd.pkt);
+		cmd.peer_id = cmd.pkt->getPeerId();
+		cmd.command = cmd.pkt->getCommand();
+
+		// Command must be handled into ToServerCommandHandler
+		if (cmd.command >= TOSERVER_NUM_MSG_TYPES) {
+			infostream << "Server: Ignoring unknown command "
+					<< cmd.command << std::endl;
+			delete cmd.pkt;
+			return;
+		}
+
+		if (cmd.command == TOSERVER_PLAYERPOS) {
+			bool valid = cmd.playerpos.deSerialize(cmd.pkt);
+			delete cmd.pkt;
+			cmd.pkt = NULL;
+			if (!valid)
+				return;
+		}
 	}
 	catch(con::InvalidIncomingDataException &e) {
-		infostream<<"Server::Receive(): "
+		infostream<<"Server::DecodeReceived(): "
 				"InvalidIncomingDataException: what()="
 				<<e.what()<<std::endl;
+		delete cmd.pkt;
+		return;
 	}
 	catch(SerializationError &e) {
-		infostream<<"Server::Receive(): "
+		infostream<<"Server::DecodeReceived(): "
 				"SerializationError: what()="
 				<<e.what()<<std::endl;
+		delete cmd.pkt;
+		return;
 	}
-	catch(ClientStateError &e) {
-		errorstream << "ProcessData: peer=" << peer_id  << e.what() << std::endl;
-		DenyAccess_Legacy(peer_id, L"Your client sent something server didn't expect."
-				L"Try reconnecting or updating your client");
+	catch(...) {
+		delete cmd.pkt;
+		throw;
 	}
-	catch(con::PeerNotFoundException &e) {
-		// Do nothing
+
+	m_receive_queue.push(cmd);
+}
+
+void Server::Receive()
+{
+	DSTACK(FUNCTION_NAME);
+	std::vector<ReceivedCommand> commands;
+	if (!m_receive_queue.popAll(commands, 30))
+		return;
+
+	// Clients added before these commands were queued have to exist
+	handlePeerChanges();
+
+	// Environment is locked once for the whole batch
+	MutexAutoLock envlock(m_env_mutex);
+	ScopeProfiler sp(g_profiler, "Server::Receive");
+	g_profiler->avg("Server::Receive: commands per batch", commands.size());
+
+	for (std::vector<ReceivedCommand>::iterator it = commands.begin();
+			it != commands.end(); ++it) {
+		const ReceivedCommand &cmd = *it;
+		try {
+			ProcessData(cmd);
+		}
+		catch(SerializationError &e) {
+			infostream<<"Server::Receive(): "
+					"SerializationError: what()="
+					<<e.what()<<std::endl;
+		}
+		catch(ClientStateError &e) {
+			errorstream << "ProcessData: peer=" << cmd.peer_id << e.what() << std::endl;
+			DenyAccess_Legacy(cmd.peer_id, L"Your client sent something server didn't expect."
+					L"Try reconnecting or updating your client");
+		}
+		catch(con::PeerNotFoundException &e) {
+			// Do nothing
+		}
+		catch(ClientNotFoundException &e) {
+		}
+		catch(...) {
+			for (; it != commands.end(); ++it)
+				delete it->pkt;
+			throw;
+		}
+		delete cmd.pkt;
 	}
 }
 
@@ -1166,14 +1464,11 @@ inline void Server::handleCommand(NetworkPacket* pkt)
 	(this->*opHandle.handler)(pkt);
 }
 
-void Server::ProcessData(NetworkPacket *pkt)
+void Server::ProcessData(const ReceivedCommand &cmd)
 {
 	DSTACK(FUNCTION_NAME);
-	// Environment is locked first.
-	MutexAutoLock envlock(m_env_mutex);
-
 	ScopeProfiler sp(g_profiler, "Server::ProcessData");
-	u32 peer_id = pkt->getPeerId();
+	u32 peer_id = cmd.peer_id;
 
 	try {
 		Address address = getPeerAddress(peer_id);
@@ -1203,17 +1498,11 @@ void Server::ProcessData(NetworkPacket *pkt)
 	}
 
 	try {
-		ToServerCommand command = (ToServerCommand) pkt->getCommand();
-
-		// Command must be handled into ToServerCommandHandler
-		if (command >= TOSERVER_NUM_MSG_TYPES) {
-			infostream << "Server: Ignoring unknown command "
-					 << command << std::endl;
-			return;
-		}
+		// Unknown commands were already dropped by DecodeReceived()
+		ToServerCommand command = (ToServerCommand) cmd.command;
 
 		if (toServerCommandTable[command].state == TOSERVER_STATE_NOT_CONNECTED) {
-			handleCommand(pkt);
+			handleCommand(cmd.pkt);
 			return;
 		}
 
@@ -1228,7 +1517,7 @@ void Server::ProcessData(NetworkPacket *pkt)
 
 		/* Handle commands related to client startup */
 		if (toServerCommandTable[command].state == TOSERVER_STATE_STARTUP) {
-			handleCommand(pkt);
+			handleCommand(cmd.pkt);
 			return;
 		}
 
@@ -1241,7 +1530,13 @@ void Server::ProcessData(NetworkPacket *pkt)
 			return;
 		}
 
-		handleCommand(pkt);
+		if (cmd.pkt == NULL) {
+			// Decoded by DecodeReceived()
+			handlePlayerPos(peer_id, cmd.playerpos);
+			return;
+		}
+
+		handleCommand(cmd.pkt);
 	} catch (SendFailedException &e) {
 		errorstream << "Server::ProcessData(): SendFailedException: "
 				<< "what=" << e.what()
@@ -1332,8 +1627,10 @@ void Server::setInventoryModified(const InventoryLocation &loc, bool playerSend)
 		v3s16 blockpos = getNodeBlockPos(loc.p);
 
 		MapBlock *block = m_env->getMap().getBlockNoCreateNoEx(blockpos);
-		if(block)
+		if(block) {
 			block->raiseModified(MOD_STATE_WRITE_NEEDED);
+			block->logMetadataChange();
+		}
 
 		setBlockNotSent(blockpos);
 	}
@@ -1372,7 +1669,7 @@ void Server::peerAdded(con::Peer *peer)
 	c.type = con::PEER_ADDED;
 	c.peer_id = peer->id;
 	c.timeout = false;
-	m_peer_change_queue.push(c);
+	m_peer_change_queue.push_back(c);
 }
 
 void Server::deletingPeer(con::Peer *peer, bool timeout)
@@ -1381,12 +1678,11 @@ void Server::deletingPeer(con::Peer *peer, bool timeout)
 	verbosestream<<"Server::deletingPeer(): peer->id="
 			<<peer->id<<", timeout="<<timeout<<std::endl;
 
-	m_clients.event(peer->id, CSE_Disconnect);
 	con::PeerChange c;
 	c.type = con::PEER_REMOVED;
 	c.peer_id = peer->id;
 	c.timeout = timeout;
-	m_peer_change_queue.push(c);
+	m_peer_change_queue.push_back(c);
 }
 
 bool Server::getClientConInfo(u16 peer_id, con::rtt_stat_type type, float* retval)
@@ -1433,10 +1729,9 @@ bool Server::getClientInfo(
 
 void Server::handlePeerChanges()
 {
-	while(m_peer_change_queue.size() > 0)
+	while(!m_peer_change_queue.empty())
 	{
-		con::PeerChange c = m_peer_change_queue.front();
-		m_peer_change_queue.pop();
+		con::PeerChange c = m_peer_change_queue.pop_frontNoEx();
 
 		verbosestream<<"Server: Handling peer change: "
 				<<"id="<<c.peer_id<<", timeout="<<c.timeout
@@ -1449,6 +1744,7 @@ void Server::handlePeerChanges()
 			break;
 
 		case con::PEER_REMOVED:
+			m_clients.event(c.peer_id, CSE_Disconnect);
 			DeleteClient(c.peer_id, c.timeout?CDR_TIMEOUT:CDR_LEAVE);
 			break;
 
@@ -1566,8 +1862,56 @@ void Server::SendDeathscreen(u16 peer_id,bool set_camera_point_target,
 	Send(&pkt);
 }
 
-void Server::SendItemDef(u16 peer_id,
-		IItemDefManager *itemdef, u16 protocol_version)
+std::string Server::getCompressedItemDef(u16 protocol_version)
+{
+	MutexAutoLock lock(m_definition_cache_mutex);
+
+	std::map<u16, std::string>::iterator it =
+			m_itemdef_cache.find(protocol_version);
+	if (it != m_itemdef_cache.end())
+		return it->second;
+
+	ScopeProfiler sp(g_profiler, "Server: serialize item definitions");
+	std::ostringstream tmp_os(std::ios::binary);
+	m_itemdef->serialize(tmp_os, protocol_version);
+	std::ostringstream tmp_os2(std::ios::binary);
+	compressZlib(tmp_os.str(), tmp_os2);
+
+	verbosestream << "Server: Serialized item definitions for protocol "
+			<< protocol_version << ": size=" << tmp_os2.str().size()
+			<< std::endl;
+	return m_itemdef_cache[protocol_version] = tmp_os2.str();
+}
+
+std::string Server::getCompressedNodeDef(u16 protocol_version)
+{
+	MutexAutoLock lock(m_definition_cache_mutex);
+
+	std::map<u16, std::string>::iterator it =
+			m_nodedef_cache.find(protocol_version);
+	if (it != m_nodedef_cache.end())
+		return it->second;
+
+	ScopeProfiler sp(g_profiler, "Server: serialize node definitions");
+	std::ostringstream tmp_os(std::ios::binary);
+	m_nodedef->serialize(tmp_os, protocol_version);
+	std::ostringstream tmp_os2(std::ios::binary);
+	compressZlib(tmp_os.str(), tmp_os2);
+
+	verbosestream << "Server: Serialized node definitions for protocol "
+			<< protocol_version << ": size=" << tmp_os2.str().size()
+			<< std::endl;
+	return m_nodedef_cache[protocol_version] = tmp_os2.str();
+}
+
+void Server::invalidateDefinitionCache()
+{
+	MutexAutoLock lock(m_definition_cache_mutex);
+	m_itemdef_cache.clear();
+	m_nodedef_cache.clear();
+}
+
+void Server::SendItemDef(u16 peer_id, u16 protocol_version)
 {
 	DSTACK(FUNCTION_NAME);
 
@@ -1578,11 +1922,7 @@ void Server::SendItemDef(u16 peer_id,
 		u32 length of the next item
 		zlib-compressed serialized ItemDefManager
 	*/
-	std::ostringstream tmp_os(std::ios::binary);
-	itemdef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
-	pkt.putLongString(tmp_os2.str());
+	pkt.putLongString(getCompressedItemDef(protocol_version));
 
 	// Make data buffer
 	verbosestream << "Server: Sending item definitions to id(" << peer_id
@@ -1591,8 +1931,7 @@ void Server::SendItemDef(u16 peer_id,
 	Send(&pkt);
 }
 
-void Server::SendNodeDef(u16 peer_id,
-		INodeDefManager *nodedef, u16 protocol_version)
+void Server::SendNodeDef(u16 peer_id, u16 protocol_version)
 {
 	DSTACK(FUNCTION_NAME);
 
@@ -1603,12 +1942,7 @@ void Server::SendNodeDef(u16 peer_id,
 		u32 length of the next item
 		zlib-compressed serialized NodeDefManager
 	*/
-	std::ostringstream tmp_os(std::ios::binary);
-	nodedef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
-
-	pkt.putLongString(tmp_os2.str());
+	pkt.putLongString(getCompressedNodeDef(protocol_version));
 
 	// Make data buffer
 	verbosestream << "Server: Sending node definitions to id(" << peer_id
@@ -1951,12 +2285,14 @@ u32 Server::SendActiveObjectRemoveAdd(u16 peer_id, const std::string &datas)
 	return pkt.getSize();
 }
 
-void Server::SendActiveObjectMessages(u16 peer_id, const std::string &datas, bool reliable)
+void Server::SendActiveObjectMessages(u16 peer_id,
+		const std::vector<const std::string *> &datas, u32 size, bool reliable)
 {
-	NetworkPacket pkt(TOCLIENT_ACTIVE_OBJECT_MESSAGES,
-			datas.size(), peer_id);
+	NetworkPacket pkt(TOCLIENT_ACTIVE_OBJECT_MESSAGES, size, peer_id);
 
-	pkt.putRawString(datas.c_str(), datas.size());
+	for (std::vector<const std::string *>::const_iterator it = datas.begin();
+			it != datas.end(); ++it)
+		pkt.putRawString((*it)->c_str(), (*it)->size());
 
 	m_clients.send(pkt.getPeerId(),
 			reliable ? clientCommandFactoryTable[pkt.getCommand()].channel : 1,
@@ -2051,6 +2387,64 @@ void Server::stopSound(s32 handle)
 	m_playing_sounds.erase(i);
 }
 
+void Server::sendNodeEdits(const std::map<v3s16, BlockNodeEdits> &block_edits)
+{
+	// Size of the node data of a block, which is about what resending the
+	// whole block costs before compression
+	const u32 block_size = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE *
+			MapNode::serializedLength(SER_FMT_VER_HIGHEST_WRITE);
+
+	m_clients.lock();
+	std::map<u16, RemoteClient*> clients = m_clients.getClientList();
+	for (std::map<v3s16, BlockNodeEdits>::const_iterator
+			i = block_edits.begin();
+			i != block_edits.end(); ++i) {
+		const v3s16 &blockpos = i->first;
+		const BlockNodeEdits &edits = i->second;
+
+		NetworkPacket pkt(TOCLIENT_NODE_EDITS, 6 + 2 + edits.size() * 7);
+		serializeNodeEdits(pkt, blockpos, edits, 0);
+		bool resend = pkt.getSize() > block_size;
+
+		// Peers that made some of the changes themselves
+		std::set<u16> known_by_peers;
+		for (BlockNodeEdits::const_iterator j = edits.begin();
+				j != edits.end(); ++j) {
+			if (j->second.known_by_peer != 0)
+				known_by_peers.insert(j->second.known_by_peer);
+		}
+
+		for (std::map<u16, RemoteClient*>::iterator
+				j = clients.begin();
+				j != clients.end(); ++j) {
+			RemoteClient *client = j->second;
+			if (client->getState() < CS_Active ||
+					client->net_proto_version < 28)
+				continue;
+
+			// A block that is still on the wire would arrive after the
+			// edits; send it again instead
+			client->ResendBlockIfOnWire(blockpos);
+			if (!client->isBlockSent(blockpos))
+				continue;
+
+			if (resend) {
+				client->SetBlockNotSent(blockpos);
+			} else if (known_by_peers.count(client->peer_id)) {
+				// Don't send a client its own changes back
+				NetworkPacket own_pkt(TOCLIENT_NODE_EDITS,
+						6 + 2 + edits.size() * 7, client->peer_id);
+				if (serializeNodeEdits(own_pkt, blockpos, edits,
+						client->peer_id) > 0)
+					m_clients.send(client->peer_id, 0, &own_pkt, true);
+			} else {
+				m_clients.send(client->peer_id, 0, &pkt, true);
+			}
+		}
+	}
+	m_clients.unlock();
+}
+
 void Server::sendRemoveNode(v3s16 p, u16 ignore_id,
 	std::vector<u16> *far_players, float far_d_nodes)
 {
@@ -2063,6 +2457,10 @@ void Server::sendRemoveNode(v3s16 p, u16 ignore_id,
 	std::vector<u16> clients = m_clients.getClientIDs();
 	for(std::vector<u16>::iterator i = clients.begin();
 		i != clients.end(); ++i) {
+		// Newer clients get the change through sendNodeEdits()
+		if (m_clients.getProtocolVersion(*i) >= 28)
+			continue;
+
 		if (far_players) {
 			// Get player
 			if(Player *player = m_env->getPlayer(*i)) {
@@ -2090,6 +2488,9 @@ void Server::sendAddNode(v3s16 p, MapNode n, u16 ignore_id,
 	std::vector<u16> clients = m_clients.getClientIDs();
 	for(std::vector<u16>::iterator i = clients.begin();
 			i != clients.end(); ++i) {
+		// Newer clients get the change through sendNodeEdits()
+		if (m_clients.getProtocolVersion(*i) >= 28)
+			continue;
 
 		if(far_players) {
 			// Get player
@@ -2160,6 +2561,22 @@ void Server::SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto
 	Send(&pkt);
 }
 
+void Server::SendBlockDeltaNoLock(u16 peer_id, MapBlock *block,
+		const std::vector<u16> &indices, bool include_metadata)
+{
+	DSTACK(FUNCTION_NAME);
+
+	std::ostringstream os(std::ios_base::binary);
+	block->serializeDelta(os, indices, include_metadata);
+	std::string s = os.str();
+
+	NetworkPacket pkt(TOCLIENT_BLOCK_DELTA, 6 + s.size(), peer_id);
+
+	pkt << block->getPos();
+	pkt.putRawString(s.c_str(), s.size());
+	Send(&pkt);
+}
+
 void Server::SendBlocks(float dtime)
 {
 	DSTACK(FUNCTION_NAME);
@@ -2222,8 +2639,27 @@ void Server::SendBlocks(float dtime)
 		if(!client)
 			continue;
 
-		SendBlockNoLock(q.peer_id, block, client->serialization_version, client->net_proto_version);
+		/*
+			If the client still has an older version of this block, send
+			only the nodes that changed since.
+		*/
+		u32 incarnation, version;
+		std::vector<u16> changed;
+		bool metadata_changed;
+		if (client->net_proto_version >= 29 &&
+				client->GetBlockVersion(q.pos, incarnation, version) &&
+				incarnation == block->getIncarnation() &&
+				block->getChangesSince(version, changed, metadata_changed) &&
+				changed.size() <= BLOCK_DELTA_MAX_NODES) {
+			SendBlockDeltaNoLock(q.peer_id, block, changed, metadata_changed);
+		} else {
+			SendBlockNoLock(q.peer_id, block, client->serialization_version,
+					client->net_proto_version);
+		}
 
+		block->enableChangeLog();
+		client->SetBlockVersion(q.pos, block->getIncarnation(),
+				block->getVersion());
 		client->SentBlock(q.pos);
 		total_sending++;
 	}
@@ -2326,6 +2762,56 @@ void Server::fillMediaCache()
 	}
 }
 
+void Server::startMediaServer()
+{
+	delete m_media_server;
+	m_media_server = NULL;
+
+	// An external media server takes precedence
+	m_remote_media_url = g_settings->get("remote_media");
+	u16 port = g_settings->getU16("media_server_port");
+	if (port == 0 || !m_remote_media_url.empty())
+		return;
+
+	// Clients need an address to reach the media server at
+	std::string host = g_settings->get("server_address");
+	if (host.empty() && !m_bind_addr.isZero())
+		host = m_bind_addr.serializeString();
+	if (host.empty()) {
+		warningstream << "Server: Not starting the media server, "
+			"server_address or bind_address has to be set" << std::endl;
+		return;
+	}
+	if (host.find(':') != std::string::npos && host[0] != '[')
+		host = "[" + host + "]";
+
+	std::map<std::string, std::string> files;
+	for (std::map<std::string, MediaInfo>::iterator i = m_media.begin();
+			i != m_media.end(); ++i) {
+		files[base64_decode(i->second.sha1_digest)] = i->second.path;
+	}
+
+	Address media_addr = m_bind_addr;
+	media_addr.setPort(port);
+	m_media_server = new MediaHTTPServer(files);
+	try {
+		m_media_server->start(media_addr,
+			g_settings->getU16("media_server_threads"));
+	} catch (SocketException &e) {
+		errorstream << "Server: Failed to start the media server: "
+			<< e.what() << std::endl;
+		delete m_media_server;
+		m_media_server = NULL;
+		return;
+	}
+
+	std::ostringstream os;
+	os << "http://" << host << ":" << port << "/";
+	m_remote_media_url = os.str();
+	actionstream << "Server: Serving media at " << m_remote_media_url
+		<< std::endl;
+}
+
 void Server::sendMediaAnnouncement(u16 peer_id)
 {
 	DSTACK(FUNCTION_NAME);
@@ -2344,7 +2830,7 @@ void Server::sendMediaAnnouncement(u16 peer_id)
 		pkt << i->first << i->second.sha1_digest;
 	}
 
-	pkt << g_settings->get("remote_media");
+	pkt << m_remote_media_url;
 	Send(&pkt);
 }
 
@@ -3330,7 +3816,9 @@ scene::ISceneManager *Server::getSceneManager()
 
 u16 Server::allocateUnknownNodeId(const std::string &name)
 {
-	return m_nodedef->allocateDummy(name);
+	u16 id = m_nodedef->allocateDummy(name);
+	invalidateDefinitionCache();
+	return id;
 }
 
 ISoundManager *Server::getSoundManager()
@@ -3345,11 +3833,15 @@ MtEventManager *Server::getEventManager()
 
 IWritableItemDefManager *Server::getWritableItemDefManager()
 {
+	// The caller may change definitions
+	invalidateDefinitionCache();
 	return m_itemdef;
 }
 
 IWritableNodeDefManager *Server::getWritableNodeDefManager()
 {
+	// The caller may change definitions
+	invalidateDefinitionCache();
 	return m_nodedef;
 }
 
@@ -35,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "chat_interface.h"
 #include "clientiface.h"
 #include "network/networkpacket.h"
+#include "network/serverreceivequeue.h"
 #include <string>
 #include <list>
 #include <map>
@@ -46,6 +47,9 @@ class IWritableItemDefManager;
 class IWritableNodeDefManager;
 class IWritableCraftDefManager;
 class BanManager;
+class AuthDatabase;
+class ModStorageDatabase;
+class ModStorageManager;
 class EventManager;
 class Inventory;
 class Player;
@@ -57,6 +61,8 @@ class GameScripting;
 class ServerEnvironment;
 struct SimpleSoundSpec;
 class ServerThread;
+class ServerReceiveThread;
+class MediaHTTPServer;
 
 enum ClientDeletionReason {
 	CDR_LEAVE,
@@ -154,6 +160,18 @@ struct ServerSoundParams
 	v3f getPos(ServerEnvironment *env, bool *pos_exists) const;
 };
 
+// A node change queued for a TOCLIENT_NODE_EDITS packet
+struct QueuedNodeEdit
+{
+	u8 type;
+	MapNode n;
+	// Peer whose action made the change and that already has it, or 0
+	u16 known_by_peer;
+};
+
+// The node changes of one block, keyed by node index within the block
+typedef std::map<u16, QueuedNodeEdit> BlockNodeEdits;
+
 struct ServerPlayingSound
 {
 	ServerSoundParams params;
@@ -183,7 +201,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void step(float dtime);
 	// This is run by ServerThread and does the actual processing
 	void AsyncRunStep(bool initial_step=false);
+	// Run by ServerThread: applies the commands queued by DecodeReceived()
 	void Receive();
+	// Run by ServerReceiveThread: takes a packet from the connection and
+	// decodes and queues it, without touching the environment
+	void DecodeReceived();
 	PlayerSAO* StageTwoClientInit(u16 peer_id);
 
 	/*
@@ -202,6 +224,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_ClientReady(NetworkPacket* pkt);
 	void handleCommand_GotBlocks(NetworkPacket* pkt);
 	void handleCommand_PlayerPos(NetworkPacket* pkt);
+	void handlePlayerPos(u16 peer_id, const PlayerPosUpdate &pos);
 	void handleCommand_DeletedBlocks(NetworkPacket* pkt);
 	void handleCommand_InventoryAction(NetworkPacket* pkt);
 	void handleCommand_ChatMessage(NetworkPacket* pkt);
@@ -218,7 +241,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_SrpBytesA(NetworkPacket* pkt);
 	void handleCommand_SrpBytesM(NetworkPacket* pkt);
 
-	void ProcessData(NetworkPacket *pkt);
+	// Envlock should be locked when calling this
+	void ProcessData(const ReceivedCommand &cmd);
 
 	void Send(NetworkPacket* pkt);
 
@@ -294,6 +318,16 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// Envlock and conlock should be locked when using scriptapi
 	GameScripting *getScriptIface(){ return m_script; }
 
+	// Authentication data used by the builtin auth handler
+	AuthDatabase *getAuthDatabase() { return m_auth_database; }
+	static AuthDatabase *createAuthDatabase(const std::string &name,
+			const std::string &savedir);
+
+	// Storage objects of minetest.get_mod_storage
+	ModStorageManager *getModStorageManager() { return m_mod_storage; }
+	static ModStorageDatabase *createModStorageDatabase(const std::string &name,
+			const std::string &savedir);
+
 	// actions: time-reversed list
 	// Return value: success/failure
 	bool rollbackRevertActions(const std::list<RollbackAction> &actions,
@@ -396,8 +430,14 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		const std::string &custom_reason, bool reconnect = false);
 	void SendAccessDenied_Legacy(u16 peer_id, const std::wstring &reason);
 	void SendDeathscreen(u16 peer_id,bool set_camera_point_target, v3f camera_point_target);
-	void SendItemDef(u16 peer_id,IItemDefManager *itemdef, u16 protocol_version);
-	void SendNodeDef(u16 peer_id,INodeDefManager *nodedef, u16 protocol_version);
+	void SendItemDef(u16 peer_id, u16 protocol_version);
+	void SendNodeDef(u16 peer_id, u16 protocol_version);
+
+	// Compressed serialized definitions, as sent to clients
+	std::string getCompressedItemDef(u16 protocol_version);
+	std::string getCompressedNodeDef(u16 protocol_version);
+	// Call when definitions may have changed
+	void invalidateDefinitionCache();
 
 	/* mark blocks not sent for all clients */
 	void SetBlocksNotSent(std::map<v3s16, MapBlock *>& block);
@@ -433,14 +473,25 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 			std::vector<u16> *far_players=NULL, float far_d_nodes=100,
 			bool remove_metadata=true);
 	void setBlockNotSent(v3s16 p);
+	/*
+		Send the node edits collected during a step to all clients that
+		have the edited blocks, one TOCLIENT_NODE_EDITS packet per block.
+		If a packet would be larger than the block, the block is resent.
+	*/
+	// Envlock should be locked when calling this
+	void sendNodeEdits(const std::map<v3s16, BlockNodeEdits> &block_edits);
 
 	// Environment and Connection must be locked when called
 	void SendBlockNoLock(u16 peer_id, MapBlock *block, u8 ver, u16 net_proto_version);
+	// Sends the given nodes of a block the client has an older version of
+	void SendBlockDeltaNoLock(u16 peer_id, MapBlock *block,
+			const std::vector<u16> &indices, bool include_metadata);
 
 	// Sends blocks to clients (locks env and con on its own)
 	void SendBlocks(float dtime);
 
 	void fillMediaCache();
+	void startMediaServer();
 	void sendMediaAnnouncement(u16 peer_id);
 	void sendRequestedMedia(u16 peer_id,
 			const std::vector<std::string> &tosend);
@@ -466,7 +517,10 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		bool collisiondetection, bool vertical, std::string texture);
 
 	u32 SendActiveObjectRemoveAdd(u16 peer_id, const std::string &datas);
-	void SendActiveObjectMessages(u16 peer_id, const std::string &datas, bool reliable = true);
+	// Sends the concatenation of datas, which is size bytes long
+	void SendActiveObjectMessages(u16 peer_id,
+		const std::vector<const std::string *> &datas, u32 size,
+		bool reliable = true);
 	/*
 		Something random
 	*/
@@ -540,6 +594,12 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// Ban checking
 	BanManager *m_banmanager;
 
+	// Authentication data, selected by auth_backend in world.mt
+	AuthDatabase *m_auth_database;
+
+	// Mod storage, selected by mod_storage_backend in world.mt
+	ModStorageManager *m_mod_storage;
+
 	// Rollback manager (behind m_env_mutex)
 	IRollbackManager *m_rollback;
 	bool m_enable_rollback_recording; // Updated once in a while
@@ -560,6 +620,13 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// Craft definition manager
 	IWritableCraftDefManager *m_craftdef;
 
+	// Results of getCompressedItemDef() and getCompressedNodeDef() per
+	// protocol version, so that joining clients don't serialize and
+	// compress all definitions again
+	std::map<u16, std::string> m_itemdef_cache;
+	std::map<u16, std::string> m_nodedef_cache;
+	Mutex m_definition_cache_mutex;
+
 	// Event manager
 	EventManager *m_event;
 
@@ -581,6 +648,10 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// The server mainly operates in this thread
 	ServerThread *m_thread;
 
+	// Decodes incoming packets into m_receive_queue for Receive()
+	ServerReceiveThread *m_receive_thread;
+	ServerReceiveQueue m_receive_queue;
+
 	/*
 		Time related stuff
 	*/
@@ -600,7 +671,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 		Queues stuff from peerAdded() and deletingPeer() to
 		handlePeerChanges()
 	*/
-	std::queue<con::PeerChange> m_peer_change_queue;
+	MutexedQueue<con::PeerChange> m_peer_change_queue;
 
 	/*
 		Random stuff
@@ -650,6 +721,11 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// media files known to server
 	std::map<std::string,MediaInfo> m_media;
 
+	// Serves m_media over HTTP if media_server_port is set
+	MediaHTTPServer *m_media_server;
+	// URL announced as remote media, empty to send media over the connection
+	std::string m_remote_media_url;
+
 	/*
 		Sounds
 	*/
@@ -233,6 +233,8 @@ fake_function() {
 	gettext("Maximum proportion of current window to be used for hotbar.\nUseful if there's something to be displayed right or left of hotbar.");
 	gettext("Mesh cache");
 	gettext("Enables caching of facedir rotated meshes.");
+	gettext("Cheap particle collision");
+	gettext("Particles with collision detection only collide with nodes, not with\nobjects. Makes scenes with many particles considerably cheaper.");
 	gettext("Minimap");
 	gettext("Enables minimap.");
 	gettext("Round minimap");
@@ -313,6 +315,10 @@ fake_function() {
 	gettext("Enable to disallow old clients from connecting.\nOlder clients are compatible in the sense that they will not crash when connecting\nto new servers, but they may not support all new features that you are expecting.");
 	gettext("Remote media");
 	gettext("Specifies URL from which client fetches media instead of using UDP.\n$filename should be accessible from $remote_media$filename via cURL\n(obviously, remote_media should end with a slash).\nFiles that are not present will be fetched the usual way.");
+	gettext("Media server port");
+	gettext("Serve media files over HTTP on this TCP port and announce it as remote media.\nClients download the files in parallel instead of over the game connection.\nThe URL uses server_address, or bind_address if that is empty.\nIgnored if remote_media is set. 0 disables the media server.");
+	gettext("Media server threads");
+	gettext("Number of threads of the media server, each serving one client connection at a time.");
 	gettext("IPv6 server");
 	gettext("Enable/disable running an IPv6 server.  An IPv6 server may be restricted\nto IPv6 clients, depending on system configuration.\nIgnored if bind_address is set.");
 	gettext("Advanced");
@@ -323,6 +329,8 @@ fake_function() {
 	gettext("To reduce lag, block transfers are slowed down when a player is building something.\nThis determines how long they are slowed down after placing or removing a node.");
 	gettext("Max. packets per iteration");
 	gettext("Maximum number of packets sent per send step, if you have a slow connection\ntry reducing it, but don't reduce it to a number below double of targeted\nclient number.");
+	gettext("Network compression");
+	gettext("Compress small reliable packets, like object, HUD, chat and inventory updates.\nAll such packets of a connection share one compression context.\nOnly used if the other side supports and enables it as well.");
 	gettext("Game");
 	gettext("Default game");
 	gettext("Default game when creating a new world.\nThis will be overridden when creating a world from the main menu.");
@@ -364,6 +372,14 @@ fake_function() {
 	gettext("Whether to ask clients to reconnect after a (Lua) crash.\nSet this to true if your server is set up to restart automatically.");
 	gettext("Active object send range");
 	gettext("From how far clients know about objects, stated in mapblocks (16 nodes).");
+	gettext("Full rate object update range");
+	gettext("Movement of objects closer to a player than this is sent to it at the full rate, stated in nodes.\nSet to 0 to send movement of all objects at the full rate.");
+	gettext("Far object update range");
+	gettext("Movement of objects farther away from a player than this is sent at the far interval, stated in nodes.");
+	gettext("Medium range object update interval");
+	gettext("Minimum time between movement updates of objects between the near and far range, stated in seconds.");
+	gettext("Far object update interval");
+	gettext("Minimum time between movement updates of objects beyond the far range, stated in seconds.");
 	gettext("Active block range");
 	gettext("How large area of blocks are subject to the active block stuff, stated in mapblocks (16 nodes).\nIn active blocks objects are loaded and ABMs run.");
 	gettext("Max block send distance");
@@ -399,6 +415,10 @@ fake_function() {
 	gettext("Detailed mod profile data. Useful for mod developers.");
 	gettext("Profiling print interval");
 	gettext("Profiler data print interval. 0 = disable. Useful for developers.");
+	gettext("Script profiler");
+	gettext("Measure the time spent in each Lua callback per mod from the start.\nThe profiler can also be started and stopped with /profiler.");
+	gettext("Script profiler sample interval");
+	gettext("Interval in milliseconds in which the script profiler samples the Lua\nstack, for flamegraphs. 0 = disable.");
 	gettext("Max. clearobjects extra blocks");
 	gettext("Number of extra blocks that can be loaded by /clearobjects at once.\nThis is a trade-off between sqlite transaction overhead and\nmemory consumption (4096=100MB, as a rule of thumb).");
 	gettext("Unload unused server data");
@@ -409,6 +429,8 @@ fake_function() {
 	gettext("See http://www.sqlite.org/pragma.html#pragma_synchronous");
 	gettext("Dedicated server step");
 	gettext("Length of a server tick and the interval at which objects are generally updated over network.");
+	gettext("Globalstep time budget");
+	gettext("Time in milliseconds that Lua globalsteps and tasks added with\nminetest.add_task may use per server step. Unfinished tasks continue\nin the next step.");
 	gettext("Active Block Management interval");
 	gettext("Time in between active block management cycles");
 	gettext("ABM modifier interval");
@@ -417,6 +439,12 @@ fake_function() {
 	gettext("Length of time between NodeTimer execution cycles");
 	gettext("Ignore world errors");
 	gettext("If enabled, invalid world data won't cause the server to shut down.\nOnly enable this if you know what you are doing.");
+	gettext("Async threads");
+	gettext("Number of threads running async jobs of mods (core.handle_async).");
+	gettext("Batch entity steps");
+	gettext("Call on_step of all entities at once after moving them, instead of one after another.\nFaster with many entities, and the time spent is accounted per entity name\n(see the profiler and minetest.get_entity_step_stats).\nThis changes the order of entity steps: on_step sees all entities already moved\nin this step, and changes made to other entities (e.g. set_velocity) only affect\ntheir movement in the next step. Some mods may rely on the old order.");
+	gettext("Mod storage flush interval");
+	gettext("Interval in seconds at which changes of mod storage (minetest.get_mod_storage)\nare written to the world, in the background.");
 	gettext("Liquid loop max");
 	gettext("Max liquids processed per step.");
 	gettext("Liquid queue purge time");
@@ -0,0 +1,226 @@
+/*
+Minetest
+Copyright (C) 2010-2014 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "clientiface.h"
+#include "util/basic_macros.h"
+
+class TestClientIface : public TestBase {
+public:
+	TestClientIface() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestClientIface"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBlockPosSet();
+	void testBlockPosSetRegions();
+	void testObjectUpdateTiers();
+	void testObjectUpdateDeferred();
+	void testObjectUpdateForget();
+};
+
+static TestClientIface g_test_instance;
+
+void TestClientIface::runTests(IGameDef *gamedef)
+{
+	TEST(testBlockPosSet);
+	TEST(testBlockPosSetRegions);
+	TEST(testObjectUpdateTiers);
+	TEST(testObjectUpdateDeferred);
+	TEST(testObjectUpdateForget);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static RemoteClient::ObjectUpdateTiers getTestTiers()
+{
+	RemoteClient::ObjectUpdateTiers tiers;
+	tiers.near_range = 10;
+	tiers.far_range = 20;
+	tiers.medium_interval = 0.5;
+	tiers.far_interval = 2;
+	return tiers;
+}
+
+static bool hasPosition(const std::vector<v3s16> &positions, v3s16 p)
+{
+	return std::find(positions.begin(), positions.end(), p) !=
+		positions.end();
+}
+
+void TestClientIface::testBlockPosSet()
+{
+	BlockPosSet set;
+	UASSERTEQ(u32, set.size(), 0);
+	UASSERT(!set.contains(v3s16(0, 0, 0)));
+
+	UASSERT(set.insert(v3s16(0, 0, 0)));
+	UASSERT(!set.insert(v3s16(0, 0, 0)));
+	UASSERT(set.insert(v3s16(1, 2, 3)));
+	UASSERT(set.insert(v3s16(-1, -2, -3)));
+	UASSERTEQ(u32, set.size(), 3);
+
+	UASSERT(set.contains(v3s16(0, 0, 0)));
+	UASSERT(set.contains(v3s16(1, 2, 3)));
+	UASSERT(set.contains(v3s16(-1, -2, -3)));
+	UASSERT(!set.contains(v3s16(3, 2, 1)));
+	UASSERT(!set.contains(v3s16(1, 2, -3)));
+
+	UASSERT(set.erase(v3s16(1, 2, 3)));
+	UASSERT(!set.erase(v3s16(1, 2, 3)));
+	UASSERT(!set.erase(v3s16(5, 5, 5)));
+	UASSERT(!set.contains(v3s16(1, 2, 3)));
+	UASSERTEQ(u32, set.size(), 2);
+
+	set.clear();
+	UASSERTEQ(u32, set.size(), 0);
+	UASSERTEQ(u32, set.getRegionCount(), 0);
+	UASSERT(!set.contains(v3s16(0, 0, 0)));
+}
+
+void TestClientIface::testBlockPosSetRegions()
+{
+	// Positions next to each other in different regions, -1 and 0 as
+	// well as -17 and -16 are on both sides of a region boundary
+	v3s16 positions[] = {
+		v3s16(-1, 0, 0),
+		v3s16(0, 0, 0),
+		v3s16(-16, -1, 15),
+		v3s16(-17, -1, 15),
+		v3s16(16, 0, 0),
+		v3s16(15, 0, 0),
+		v3s16(-32768, -32768, -32768),
+		v3s16(32767, 32767, 32767),
+	};
+
+	BlockPosSet set;
+	for (size_t i = 0; i < ARRLEN(positions); i++)
+		UASSERT(set.insert(positions[i]));
+	UASSERTEQ(u32, set.size(), ARRLEN(positions));
+	UASSERTEQ(u32, set.getRegionCount(), 7);
+
+	for (size_t i = 0; i < ARRLEN(positions); i++)
+		UASSERT(set.contains(positions[i]));
+	UASSERT(!set.contains(v3s16(-2, 0, 0)));
+	UASSERT(!set.contains(v3s16(-1, 0, 1)));
+	UASSERT(!set.contains(v3s16(-16, -1, -1)));
+
+	std::vector<v3s16> listed;
+	set.getPositions(listed);
+	UASSERTEQ(size_t, listed.size(), ARRLEN(positions));
+	for (size_t i = 0; i < ARRLEN(positions); i++)
+		UASSERT(hasPosition(listed, positions[i]));
+
+	// A region is released with its last position
+	UASSERT(set.erase(v3s16(-16, -1, 15)));
+	UASSERTEQ(u32, set.getRegionCount(), 6);
+	UASSERT(set.erase(v3s16(-17, -1, 15)));
+	UASSERTEQ(u32, set.getRegionCount(), 5);
+	UASSERT(set.erase(v3s16(15, 0, 0)));
+	UASSERTEQ(u32, set.getRegionCount(), 5);
+	UASSERT(set.erase(v3s16(0, 0, 0)));
+	UASSERTEQ(u32, set.getRegionCount(), 4);
+	UASSERTEQ(u32, set.size(), ARRLEN(positions) - 4);
+	UASSERT(set.contains(v3s16(-1, 0, 0)));
+	UASSERT(set.contains(v3s16(16, 0, 0)));
+}
+
+void TestClientIface::testObjectUpdateTiers()
+{
+	RemoteClient client;
+	RemoteClient::ObjectUpdateTiers tiers = getTestTiers();
+
+	// Near objects are sent every time
+	for (int i = 0; i < 4; i++)
+		UASSERT(client.filterObjectUpdate(1, 10, i * 0.1, "near", tiers));
+	UASSERT(!client.hasObjectUpdates());
+
+	// Medium ones every medium_interval, far ones every far_interval
+	UASSERT(client.filterObjectUpdate(2, 15, 1.0, "medium", tiers));
+	UASSERT(!client.filterObjectUpdate(2, 15, 1.4, "medium", tiers));
+	UASSERT(client.filterObjectUpdate(2, 15, 1.5, "medium", tiers));
+
+	UASSERT(client.filterObjectUpdate(3, 25, 1.0, "far", tiers));
+	UASSERT(!client.filterObjectUpdate(3, 25, 2.5, "far", tiers));
+	UASSERT(client.filterObjectUpdate(3, 25, 3.0, "far", tiers));
+
+	// Coming close sends right away and drops the kept message
+	UASSERT(!client.filterObjectUpdate(3, 25, 3.1, "far", tiers));
+	UASSERT(client.filterObjectUpdate(3, 5, 3.2, "near", tiers));
+	std::vector<std::string> released;
+	client.releaseObjectUpdates(10, released);
+	UASSERT(released.empty());
+
+	// Without near range everything is sent at full rate
+	tiers.near_range = 0;
+	UASSERT(client.filterObjectUpdate(4, 100, 4.0, "a", tiers));
+	UASSERT(client.filterObjectUpdate(4, 100, 4.1, "b", tiers));
+	UASSERT(client.filterObjectUpdate(2, 15, 4.2, "c", tiers));
+	UASSERT(client.filterObjectUpdate(2, 15, 4.3, "d", tiers));
+	UASSERT(!client.hasObjectUpdates());
+}
+
+void TestClientIface::testObjectUpdateDeferred()
+{
+	RemoteClient client;
+	RemoteClient::ObjectUpdateTiers tiers = getTestTiers();
+	std::vector<std::string> released;
+
+	UASSERT(client.filterObjectUpdate(1, 15, 1.0, "first", tiers));
+	client.releaseObjectUpdates(1.0, released);
+	UASSERT(released.empty());
+
+	// Only the newest of the kept messages is released
+	UASSERT(!client.filterObjectUpdate(1, 15, 1.1, "second", tiers));
+	UASSERT(!client.filterObjectUpdate(1, 15, 1.2, "third", tiers));
+	client.releaseObjectUpdates(1.3, released);
+	UASSERT(released.empty());
+	client.releaseObjectUpdates(1.5, released);
+	UASSERTEQ(size_t, released.size(), 1);
+	UASSERT(released[0] == "third");
+
+	// Released messages count as sent
+	released.clear();
+	client.releaseObjectUpdates(1.6, released);
+	UASSERT(released.empty());
+	UASSERT(!client.filterObjectUpdate(1, 15, 1.7, "fourth", tiers));
+	UASSERT(client.filterObjectUpdate(1, 15, 2.0, "fifth", tiers));
+	client.releaseObjectUpdates(3.0, released);
+	UASSERT(released.empty());
+}
+
+void TestClientIface::testObjectUpdateForget()
+{
+	RemoteClient client;
+	RemoteClient::ObjectUpdateTiers tiers = getTestTiers();
+	std::vector<std::string> released;
+
+	UASSERT(client.filterObjectUpdate(1, 25, 1.0, "a", tiers));
+	UASSERT(!client.filterObjectUpdate(1, 25, 1.5, "b", tiers));
+	UASSERT(client.hasObjectUpdates());
+
+	// An object that is known again starts over
+	client.forgetObjectUpdates(1);
+	UASSERT(!client.hasObjectUpdates());
+	client.releaseObjectUpdates(10, released);
+	UASSERT(released.empty());
+	UASSERT(client.filterObjectUpdate(1, 25, 1.6, "c", tiers));
+}
@@ -38,7 +38,12 @@ class TestConnection : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testHelpers();
+	void testSplitPacket();
+	void testCompression();
+	void testReliableRanges();
+	void testCongestionControl();
 	void testConnectSendReceive();
+	void testLossyLink();
 };
 
 static TestConnection g_test_instance;
@@ -46,7 +51,12 @@ static TestConnection g_test_instance;
 void TestConnection::runTests(IGameDef *gamedef)
 {
 	TEST(testHelpers);
+	TEST(testSplitPacket);
+	TEST(testCompression);
+	TEST(testReliableRanges);
+	TEST(testCongestionControl);
 	TEST(testConnectSendReceive);
+	TEST(testLossyLink);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -124,6 +134,189 @@ void TestConnection::testHelpers()
 	UASSERT(readU8(&p2[3]) == data1[0]);
 }
 
+void TestConnection::testSplitPacket()
+{
+	Address a(127,0,0,1, 10);
+	SharedBuffer<u8> data(1200);
+	for (u32 i = 0; i < data.getSize(); i++)
+		data[i] = i % 251;
+
+	u16 split_seqnum = 7;
+	std::list<con::PacketChunk> chunks =
+			con::makeAutoSplitPacket(data, 500, split_seqnum);
+	UASSERTEQ(u16, split_seqnum, 8);
+	UASSERTEQ(size_t, chunks.size(), 3);
+
+	u32 offset = 0;
+	u16 chunk_num = 0;
+	for (std::list<con::PacketChunk>::iterator i = chunks.begin();
+			i != chunks.end(); ++i) {
+		// The chunks refer to the original data
+		UASSERT(*i->data == *data);
+		UASSERT(i->getSize() <= 500);
+
+		con::PacketChunk reliable = con::makeReliablePacket(*i, 1000 + chunk_num);
+		con::BufferedPacket p = con::makePacket(a, reliable, 0x12345678, 123, 2);
+		u8 *d = &p.data[BASE_HEADER_SIZE];
+		UASSERTEQ(u32, p.data.getSize(), BASE_HEADER_SIZE + 3 + 7 + i->size);
+		UASSERTEQ(u8, readU8(&d[0]), TYPE_RELIABLE);
+		UASSERTEQ(u16, readU16(&d[1]), 1000 + chunk_num);
+		UASSERTEQ(u8, readU8(&d[3]), TYPE_SPLIT);
+		UASSERTEQ(u16, readU16(&d[4]), 7);
+		UASSERTEQ(u16, readU16(&d[6]), 3);
+		UASSERTEQ(u16, readU16(&d[8]), chunk_num);
+		UASSERT(memcmp(&d[10], &data[offset], i->size) == 0);
+
+		offset += i->size;
+		chunk_num++;
+	}
+	UASSERTEQ(u32, offset, data.getSize());
+
+	// Small packets are not split
+	SharedBuffer<u8> small(10);
+	chunks = con::makeAutoSplitPacket(small, 500, split_seqnum);
+	UASSERTEQ(u16, split_seqnum, 8);
+	UASSERTEQ(size_t, chunks.size(), 1);
+	con::BufferedPacket p = con::makePacket(a, chunks.front(), 0x12345678, 123, 2);
+	UASSERTEQ(u32, p.data.getSize(), BASE_HEADER_SIZE + 1 + 10);
+	UASSERTEQ(u8, readU8(&p.data[BASE_HEADER_SIZE]), TYPE_ORIGINAL);
+}
+
+void TestConnection::testCompression()
+{
+	con::ChannelCompression sender;
+	con::ChannelCompression receiver;
+	std::string msg = "Object 1234 moved to (10.5, 22.25, -3.75)";
+
+	// Later packets refer to the data of earlier ones
+	u32 last_size = 0;
+	for (u32 i = 0; i < 3; i++) {
+		SharedBuffer<u8> packet = sender.compress(
+				(const u8 *)msg.c_str(), msg.size());
+		UASSERTEQ(u8, readU8(&packet[0]), TYPE_COMPRESSED);
+		if (i > 0)
+			UASSERT(packet.getSize() < last_size);
+		last_size = packet.getSize();
+
+		SharedBuffer<u8> data = receiver.decompress(*packet, packet.getSize());
+		UASSERT(std::string((char *)*data, data.getSize()) == msg);
+	}
+	UASSERT(last_size < msg.size() / 2);
+
+	// Incompressible data stays within the margin
+	SharedBuffer<u8> noise(400);
+	for (u32 i = 0; i < noise.getSize(); i++)
+		noise[i] = (i * 7919 + (i >> 3) * 104729) % 251;
+	SharedBuffer<u8> packet = sender.compress(*noise, noise.getSize());
+	UASSERT(packet.getSize() <= noise.getSize() + COMPRESSED_HEADER_SIZE +
+			COMPRESSION_MARGIN);
+	SharedBuffer<u8> data = receiver.decompress(*packet, packet.getSize());
+	UASSERTEQ(u32, data.getSize(), noise.getSize());
+	UASSERT(memcmp(*data, *noise, data.getSize()) == 0);
+
+	// A stream that missed a packet is broken
+	con::ChannelCompression late_receiver;
+	packet = sender.compress((const u8 *)msg.c_str(), msg.size());
+	try {
+		data = late_receiver.decompress(*packet, packet.getSize());
+		UASSERT(std::string((char *)*data, data.getSize()) != msg);
+	} catch (con::InvalidIncomingDataException &e) {
+	}
+}
+
+static con::BufferedPacket makeReliableTestPacket(u16 seqnum)
+{
+	Address a(127,0,0,1, 10);
+	SharedBuffer<u8> data(1);
+	data[0] = 1;
+	SharedBuffer<u8> reliable = con::makeReliablePacket(data, seqnum);
+	return con::makePacket(a, reliable, 0x12345678, 123, 0);
+}
+
+void TestConnection::testReliableRanges()
+{
+	con::ReliablePacketBuffer buf;
+	// Received out of order, leaving a gap at 103-104
+	u16 seqnums[] = { 100, 102, 101, 106, 105 };
+	for (u32 i = 0; i < 5; i++) {
+		con::BufferedPacket p = makeReliableTestPacket(seqnums[i]);
+		buf.insert(p, 99);
+	}
+
+	std::vector<std::pair<u16, u16> > ranges;
+	buf.getRanges(ranges, 64);
+	UASSERTEQ(size_t, ranges.size(), 2);
+	UASSERTEQ(u16, ranges[0].first, 100);
+	UASSERTEQ(u16, ranges[0].second, 102);
+	UASSERTEQ(u16, ranges[1].first, 105);
+	UASSERTEQ(u16, ranges[1].second, 106);
+
+	// Ranges over the seqnum wrap around are merged
+	con::ReliablePacketBuffer wrapped;
+	u16 wrapped_seqnums[] = { 65534, 65535, 0, 1 };
+	for (u32 i = 0; i < 4; i++) {
+		con::BufferedPacket p = makeReliableTestPacket(wrapped_seqnums[i]);
+		wrapped.insert(p, 65530);
+	}
+	ranges.clear();
+	wrapped.getRanges(ranges, 64);
+	UASSERTEQ(size_t, ranges.size(), 1);
+	UASSERTEQ(u16, ranges[0].first, 65534);
+	UASSERTEQ(u16, ranges[0].second, 1);
+
+	// Three ACKs of later packets make 100 count as lost
+	u16 first_lost = 0;
+	UASSERTEQ(u32, buf.markLostBefore(102, 0, 3, first_lost), 0);
+	UASSERTEQ(u32, buf.markLostBefore(105, 0, 3, first_lost), 0);
+	UASSERTEQ(u32, buf.markLostBefore(106, 0, 3, first_lost), 2);
+	UASSERTEQ(u16, first_lost, 100);
+	std::list<con::BufferedPacket> lost = buf.getTimedOuts(100, 100);
+	UASSERTEQ(size_t, lost.size(), 2);
+
+	// Acknowledge everything before 102 and the range 105-105
+	std::vector<std::pair<u16, u16> > sack;
+	sack.push_back(std::make_pair(105, 105));
+	std::list<con::BufferedPacket> acked;
+	buf.popAcked(102, sack, acked);
+	UASSERTEQ(size_t, acked.size(), 3);
+	UASSERTEQ(u32, buf.size(), 2);
+	u16 first = 0;
+	UASSERT(buf.getFirstSeqnum(first));
+	UASSERTEQ(u16, first, 102);
+}
+
+void TestConnection::testCongestionControl()
+{
+	con::Channel channel;
+
+	// Legacy channels are neither limited nor paced
+	channel.onPacketLost(SEQNUM_INITIAL, false);
+	UASSERTEQ(u32, channel.getWindowSize(), 0x40);
+	UASSERTEQ(u32, channel.getPacingBudget(1000), 1000);
+
+	channel.enableCongestionControl(400);
+	UASSERTEQ(u32, channel.getWindowSize(), 400);
+
+	// A loss halves the window once per window of packets
+	channel.onPacketLost(SEQNUM_INITIAL - 10, false);
+	UASSERTEQ(u32, channel.getWindowSize(), 200);
+	channel.onPacketLost(SEQNUM_INITIAL - 5, false);
+	UASSERTEQ(u32, channel.getWindowSize(), 200);
+
+	// Recovery ends with the ACK of a packet sent after the loss, the next
+	// loss is a timeout which drops the window to the minimum
+	channel.onPacketAcked(SEQNUM_INITIAL);
+	channel.onPacketLost(SEQNUM_INITIAL + 1, true);
+	UASSERTEQ(u32, channel.getWindowSize(), 0x40);
+
+	// Pacing allows small bursts and refills over a round trip time
+	u32 budget = channel.getPacingBudget(1000);
+	UASSERT(budget > 0 && budget < 1000);
+	channel.consumePacingBudget(budget);
+	UASSERTEQ(u32, channel.getPacingBudget(1000), 0);
+	channel.updatePacing(0.1, 0.1);
+	UASSERT(channel.getPacingBudget(1000) > 0);
+}
 
 void TestConnection::testConnectSendReceive()
 {
@@ -346,3 +539,81 @@ void TestConnection::testConnectSendReceive()
 	UASSERT(hand_server.count == 1);
 	UASSERT(hand_server.last_id == 2);
 }
+
+void TestConnection::testLossyLink()
+{
+	/*
+		Sends reliable packets over a loopback link that loses 10% of all
+		packets in each direction and adds 25ms of latency each way.
+		All packets have to arrive in order; the goodput is logged.
+	*/
+	u32 proto_id = 0xad26846a;
+	const u32 packet_count = 200;
+	const u32 packet_size = 400;
+
+	Handler hand_server("server");
+	Handler hand_client("client");
+
+	con::Connection server(proto_id, 512, 5.0, false, &hand_server);
+	server.Serve(Address(0, 0, 0, 0, 30002));
+
+	con::Connection client(proto_id, 512, 5.0, false, &hand_client);
+	sleep_ms(50);
+	client.Connect(Address(127, 0, 0, 1, 30002));
+
+	u32 timems0 = porting::getTimeMs();
+	while (!client.Connected() || hand_server.count == 0) {
+		UASSERT(porting::getTimeMs() - timems0 < 5000);
+		try {
+			NetworkPacket pkt;
+			client.Receive(&pkt);
+		} catch (con::NoIncomingDataException &e) {
+		}
+		try {
+			NetworkPacket pkt;
+			server.Receive(&pkt);
+		} catch (con::NoIncomingDataException &e) {
+		}
+		sleep_ms(10);
+	}
+	u16 peer_id_client = hand_server.last_id;
+
+	server.setSimulatedLink(0.1, 25);
+	client.setSimulatedLink(0.1, 25);
+
+	timems0 = porting::getTimeMs();
+	for (u32 i = 0; i < packet_count; i++) {
+		NetworkPacket pkt(0, packet_size);
+		pkt << i;
+		for (u32 j = 4; j < packet_size; j++)
+			pkt << (u8) j;
+		server.Send(peer_id_client, 2, &pkt, true);
+	}
+
+	u32 received = 0;
+	while (received < packet_count &&
+			porting::getTimeMs() - timems0 < 20000) {
+		try {
+			NetworkPacket pkt;
+			client.Receive(&pkt);
+			u32 index;
+			pkt >> index;
+			UASSERTEQ(u32, index, received);
+			received++;
+		} catch (con::NoIncomingDataException &e) {
+			sleep_ms(5);
+		}
+	}
+	UASSERTEQ(u32, received, packet_count);
+
+	u32 dtime_ms = MYMAX(porting::getTimeMs() - timems0, 1);
+
+	infostream << "TestConnection: lossy link goodput: "
+		<< (packet_count * packet_size * 1000 / dtime_ms / 1024)
+		<< " KiB/s (" << packet_count << " packets in " << dtime_ms
+		<< "ms)" << std::endl;
+
+	// Let the simulated link drain before the connections shut down
+	server.setSimulatedLink(0, 0);
+	client.setSimulatedLink(0, 0);
+}
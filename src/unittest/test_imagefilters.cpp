@@ -0,0 +1,288 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <math.h>
+#include "imagefilters.h"
+#include "noise.h"
+#include "util/numeric.h"
+
+/*
+	The raw buffer kernels must give exactly the same results as the
+	original per-pixel SColor code. The reference implementations below
+	are that code, working on a plain pixel vector instead of an IImage.
+*/
+
+class TestImageFilters : public TestBase {
+public:
+	TestImageFilters() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestImageFilters"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCleanTransparent();
+	void testScaleNNAA();
+	void testBlitWithAlpha();
+	void testBrighten();
+};
+
+static TestImageFilters g_test_instance;
+
+void TestImageFilters::runTests(IGameDef *gamedef)
+{
+	TEST(testCleanTransparent);
+	TEST(testScaleNNAA);
+	TEST(testBlitWithAlpha);
+	TEST(testBrighten);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::vector<u32> random_image(PseudoRandom &pr, u32 w, u32 h)
+{
+	std::vector<u32> img(w * h);
+	for (u32 i = 0; i < img.size(); i++) {
+		// Favour fully transparent and fully opaque pixels, like real
+		// textures have, so the special cases get exercised too.
+		u32 a;
+		switch (pr.range(0, 3)) {
+		case 0:  a = 0;   break;
+		case 1:  a = 255; break;
+		default: a = pr.range(0, 255);
+		}
+		img[i] = video::SColor(a, pr.range(0, 255), pr.range(0, 255),
+			pr.range(0, 255)).color;
+	}
+	return img;
+}
+
+static void ref_clean_transparent(std::vector<u32> &img, u32 w, u32 h,
+	u32 threshold)
+{
+	for (u32 ctry = 0; ctry < h; ctry++)
+	for (u32 ctrx = 0; ctrx < w; ctrx++) {
+		video::SColor c(img[ctry * w + ctrx]);
+		if (c.getAlpha() > threshold)
+			continue;
+
+		u32 ss = 0, sr = 0, sg = 0, sb = 0;
+		for (u32 sy = (ctry < 1) ? 0 : (ctry - 1);
+				sy <= (ctry + 1) && sy < h; sy++)
+		for (u32 sx = (ctrx < 1) ? 0 : (ctrx - 1);
+				sx <= (ctrx + 1) && sx < w; sx++) {
+			video::SColor d(img[sy * w + sx]);
+			if (d.getAlpha() <= threshold)
+				continue;
+			u32 a = d.getAlpha();
+			ss += a;
+			sr += a * d.getRed();
+			sg += a * d.getGreen();
+			sb += a * d.getBlue();
+		}
+
+		if (ss > 0) {
+			c.setRed(sr / ss);
+			c.setGreen(sg / ss);
+			c.setBlue(sb / ss);
+			img[ctry * w + ctrx] = c.color;
+		}
+	}
+}
+
+static void ref_scale_nnaa(const std::vector<u32> &src, u32 src_w, u32 src_h,
+	const core::rect<s32> &srcrect, std::vector<u32> &dest, u32 dest_w,
+	u32 dest_h)
+{
+	double sx, sy, minsx, maxsx, minsy, maxsy, area, ra, ga, ba, aa, pw, ph, pa;
+	video::SColor pxl;
+
+	double sox = srcrect.UpperLeftCorner.X * 1.0;
+	double soy = srcrect.UpperLeftCorner.Y * 1.0;
+	double sw = srcrect.getWidth() * 1.0;
+	double sh = srcrect.getHeight() * 1.0;
+
+	for (u32 dy = 0; dy < dest_h; dy++)
+	for (u32 dx = 0; dx < dest_w; dx++) {
+		minsx = sox + (dx * sw / dest_w);
+		minsx = rangelim(minsx, 0, sw);
+		maxsx = minsx + sw / dest_w;
+		maxsx = rangelim(maxsx, 0, sw);
+		if (minsx > maxsx)
+			SWAP(double, minsx, maxsx);
+		minsy = soy + (dy * sh / dest_h);
+		minsy = rangelim(minsy, 0, sh);
+		maxsy = minsy + sh / dest_h;
+		maxsy = rangelim(maxsy, 0, sh);
+		if (minsy > maxsy)
+			SWAP(double, minsy, maxsy);
+
+		area = ra = ga = ba = aa = 0;
+		for (sy = floor(minsy); sy < maxsy; sy++)
+		for (sx = floor(minsx); sx < maxsx; sx++) {
+			pw = 1;
+			if (minsx > sx)
+				pw += sx - minsx;
+			if (maxsx < (sx + 1))
+				pw += maxsx - sx - 1;
+			ph = 1;
+			if (minsy > sy)
+				ph += sy - minsy;
+			if (maxsy < (sy + 1))
+				ph += maxsy - sy - 1;
+			pa = pw * ph;
+
+			pxl = ((u32)sx < src_w && (u32)sy < src_h) ?
+				video::SColor(src[(u32)sy * src_w + (u32)sx]) :
+				video::SColor(0);
+			area += pa;
+			ra += pa * pxl.getRed();
+			ga += pa * pxl.getGreen();
+			ba += pa * pxl.getBlue();
+			aa += pa * pxl.getAlpha();
+		}
+
+		if (area > 0) {
+			pxl.setRed(ra / area + 0.5);
+			pxl.setGreen(ga / area + 0.5);
+			pxl.setBlue(ba / area + 0.5);
+			pxl.setAlpha(aa / area + 0.5);
+		} else {
+			pxl = video::SColor(0);
+		}
+		dest[dy * dest_w + dx] = pxl.color;
+	}
+}
+
+static void ref_blit_with_alpha(const std::vector<u32> &src,
+	std::vector<u32> &dst, u32 w, u32 h, bool overlay)
+{
+	for (u32 i = 0; i < w * h; i++) {
+		video::SColor src_c(src[i]);
+		video::SColor dst_c(dst[i]);
+		if (overlay && (dst_c.getAlpha() != 255 || src_c.getAlpha() == 0))
+			continue;
+		dst_c = src_c.getInterpolated(dst_c, (float)src_c.getAlpha()/255.0f);
+		dst[i] = dst_c.color;
+	}
+}
+
+void TestImageFilters::testCleanTransparent()
+{
+	PseudoRandom pr(1337);
+	const u32 w = 37, h = 23;
+	u32 thresholds[] = {0, 127};
+
+	for (size_t t = 0; t < ARRLEN(thresholds); t++) {
+		std::vector<u32> expected = random_image(pr, w, h);
+		std::vector<u32> actual = expected;
+
+		ref_clean_transparent(expected, w, h, thresholds[t]);
+		imageCleanTransparentRaw(&actual[0], w,
+			core::dimension2d<u32>(w, h), thresholds[t]);
+
+		UASSERT(actual == expected);
+	}
+}
+
+void TestImageFilters::testScaleNNAA()
+{
+	PseudoRandom pr(4242);
+	const u32 src_w = 19, src_h = 13;
+	std::vector<u32> src = random_image(pr, src_w, src_h);
+
+	// Upscaling, downscaling, non-integer ratios and a sub-rectangle
+	const s32 cases[][6] = {
+		{0, 0, 19, 13, 64, 48},
+		{0, 0, 19, 13, 7, 5},
+		{0, 0, 19, 13, 25, 11},
+		{3, 2, 15, 12, 9, 17},
+	};
+
+	for (size_t i = 0; i < ARRLEN(cases); i++) {
+		const s32 *c = cases[i];
+		core::rect<s32> srcrect(c[0], c[1], c[2], c[3]);
+		u32 dest_w = c[4], dest_h = c[5];
+
+		std::vector<u32> expected(dest_w * dest_h);
+		std::vector<u32> actual(dest_w * dest_h);
+		ref_scale_nnaa(src, src_w, src_h, srcrect, expected, dest_w, dest_h);
+		imageScaleNNAARaw(&src[0], src_w, core::dimension2d<u32>(src_w, src_h),
+			srcrect, &actual[0], dest_w,
+			core::dimension2d<u32>(dest_w, dest_h));
+
+		UASSERT(actual == expected);
+	}
+}
+
+void TestImageFilters::testBlitWithAlpha()
+{
+	PseudoRandom pr(31337);
+	const u32 w = 33, h = 17;
+
+	for (int overlay = 0; overlay < 2; overlay++) {
+		std::vector<u32> src = random_image(pr, w, h);
+		std::vector<u32> expected = random_image(pr, w, h);
+		std::vector<u32> actual = expected;
+
+		ref_blit_with_alpha(src, expected, w, h, overlay);
+		imageBlitWithAlphaRaw(&src[0], w, &actual[0], w, v2u32(w, h),
+			overlay);
+
+		UASSERT(actual == expected);
+	}
+
+	// Blitting a sub-area honours the pitches
+	std::vector<u32> src = random_image(pr, w, h);
+	std::vector<u32> dst(w * h, 0xff102030);
+	imageBlitWithAlphaRaw(&src[w + 1], w, &dst[2 * w + 3], w, v2u32(4, 3),
+		false);
+	for (u32 y = 0; y < h; y++)
+	for (u32 x = 0; x < w; x++) {
+		if (x < 3 || x >= 7 || y < 2 || y >= 5) {
+			UASSERT(dst[y * w + x] == 0xff102030);
+			continue;
+		}
+		u32 s = src[(y - 1) * w + (x - 2)];
+		if ((s >> 24) == 255)
+			UASSERT(dst[y * w + x] == s);
+		else if ((s >> 24) == 0)
+			UASSERT(dst[y * w + x] == 0xff102030);
+	}
+}
+
+void TestImageFilters::testBrighten()
+{
+	PseudoRandom pr(9001);
+	const u32 w = 41, h = 7;
+	std::vector<u32> img = random_image(pr, w, h);
+	std::vector<u32> expected = img;
+
+	for (u32 i = 0; i < expected.size(); i++) {
+		video::SColor c(expected[i]);
+		c.setRed(0.5 * 255 + 0.5 * (float)c.getRed());
+		c.setGreen(0.5 * 255 + 0.5 * (float)c.getGreen());
+		c.setBlue(0.5 * 255 + 0.5 * (float)c.getBlue());
+		expected[i] = c.color;
+	}
+
+	imageBrightenRaw(&img[0], w, core::dimension2d<u32>(w, h));
+
+	UASSERT(img == expected);
+}
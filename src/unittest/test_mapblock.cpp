@@ -0,0 +1,179 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <sstream>
+#include "gamedef.h"
+#include "mapblock.h"
+#include "serialization.h"
+#include "voxel.h"
+
+class TestMapBlock : public TestBase {
+public:
+	TestMapBlock() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapBlock"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testChangeLog(IGameDef *gamedef);
+	void testChangeLogOverflow(IGameDef *gamedef);
+	void testChangeLogVoxelManipulator(IGameDef *gamedef);
+	void testDelta(IGameDef *gamedef);
+};
+
+static TestMapBlock g_test_instance;
+
+void TestMapBlock::runTests(IGameDef *gamedef)
+{
+	TEST(testChangeLog, gamedef);
+	TEST(testChangeLogOverflow, gamedef);
+	TEST(testChangeLogVoxelManipulator, gamedef);
+	TEST(testDelta, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestMapBlock::testChangeLog(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	std::vector<u16> indices;
+	bool metadata_changed;
+	MapNode stone(t_CONTENT_STONE);
+	MapNode brick(t_CONTENT_BRICK);
+
+	// Nothing is logged before the log is enabled
+	block.setNode(v3s16(1, 2, 3), stone);
+	UASSERTEQ(u32, block.getVersion(), 0);
+	UASSERT(!block.getChangesSince(0, indices, metadata_changed));
+
+	block.enableChangeLog();
+	u32 version = block.getVersion();
+	UASSERT(block.getChangesSince(version, indices, metadata_changed));
+	UASSERT(indices.empty());
+	UASSERT(!metadata_changed);
+
+	// Setting a node to what it already is is not a change
+	block.setNode(v3s16(1, 2, 3), stone);
+	UASSERTEQ(u32, block.getVersion(), version);
+
+	block.setNode(v3s16(4, 5, 6), stone);
+	block.setNodeNoCheck(v3s16(0, 0, 1), brick);
+	block.setNode(v3s16(4, 5, 6), brick);
+	block.logMetadataChange();
+	UASSERTEQ(u32, block.getVersion(), version + 4);
+
+	UASSERT(block.getChangesSince(version, indices, metadata_changed));
+	UASSERTEQ(size_t, indices.size(), 2);
+	UASSERTEQ(u16, indices[0], 1 * MapBlock::zstride);
+	UASSERTEQ(u16, indices[1], 6 * MapBlock::zstride + 5 * MapBlock::ystride + 4);
+	UASSERT(metadata_changed);
+
+	UASSERT(block.getChangesSince(version + 3, indices, metadata_changed));
+	UASSERT(indices.empty());
+	UASSERT(metadata_changed);
+
+	// Versions from the future are not known
+	UASSERT(!block.getChangesSince(version + 5, indices, metadata_changed));
+}
+
+void TestMapBlock::testChangeLogOverflow(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	std::vector<u16> indices;
+	bool metadata_changed;
+	u32 incarnation = block.getIncarnation();
+
+	block.enableChangeLog();
+	for (u32 i = 0; i < MapBlock::CHANGE_LOG_MAX_LENGTH + 10; i++) {
+		MapNode n(t_CONTENT_STONE, 0, (i / 16) % 2);
+		block.setNodeNoCheck(v3s16(i % 16, 0, 0), n);
+	}
+
+	// The oldest changes have been dropped
+	UASSERT(!block.getChangesSince(0, indices, metadata_changed));
+	UASSERT(block.getChangesSince(block.getVersion() - 10,
+			indices, metadata_changed));
+	UASSERTEQ(size_t, indices.size(), 10);
+
+	// Loading the block again makes a different block of it
+	std::ostringstream os(std::ios_base::binary);
+	block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, false);
+	std::istringstream is(os.str(), std::ios_base::binary);
+	block.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, false);
+	UASSERT(block.getIncarnation() != incarnation);
+	UASSERTEQ(u32, block.getVersion(), 0);
+}
+
+void TestMapBlock::testChangeLogVoxelManipulator(IGameDef *gamedef)
+{
+	MapBlock block(NULL, v3s16(0, 0, 0), gamedef);
+	std::vector<u16> indices;
+	bool metadata_changed;
+
+	VoxelManipulator v;
+	v.addArea(VoxelArea(v3s16(0, 0, 0), v3s16(15, 15, 15)));
+	block.copyTo(v);
+	block.enableChangeLog();
+	u32 version = block.getVersion();
+
+	v.setNode(v3s16(3, 3, 3), MapNode(t_CONTENT_WATER));
+	v.setNode(v3s16(15, 15, 15), MapNode(t_CONTENT_LAVA));
+	block.copyFrom(v);
+
+	UASSERT(block.getChangesSince(version, indices, metadata_changed));
+	UASSERTEQ(size_t, indices.size(), 2);
+	UASSERTEQ(u16, indices[0], 3 * MapBlock::zstride + 3 * MapBlock::ystride + 3);
+	UASSERTEQ(u16, indices[1], MapBlock::nodecount - 1);
+}
+
+void TestMapBlock::testDelta(IGameDef *gamedef)
+{
+	MapBlock server_block(NULL, v3s16(0, 0, 0), gamedef);
+	MapBlock client_block(NULL, v3s16(0, 0, 0), gamedef);
+	std::vector<u16> indices;
+	bool metadata_changed;
+	MapNode torch(t_CONTENT_TORCH, 0, 3);
+	MapNode grass(t_CONTENT_GRASS);
+
+	// Initial full send
+	std::ostringstream os(std::ios_base::binary);
+	server_block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, false);
+	std::istringstream is(os.str(), std::ios_base::binary);
+	client_block.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, false);
+	server_block.enableChangeLog();
+	u32 version = server_block.getVersion();
+
+	server_block.setNode(v3s16(7, 8, 9), torch);
+	server_block.setNode(v3s16(0, 15, 0), grass);
+	UASSERT(server_block.getChangesSince(version, indices, metadata_changed));
+
+	std::ostringstream delta(std::ios_base::binary);
+	server_block.serializeDelta(delta, indices, metadata_changed);
+	std::istringstream delta_is(delta.str(), std::ios_base::binary);
+	client_block.deSerializeDelta(delta_is);
+
+	const MapNode *server_data = server_block.getDataNoCheck();
+	const MapNode *client_data = client_block.getDataNoCheck();
+	for (u32 i = 0; i < MapBlock::nodecount; i++) {
+		UASSERT(server_data[i].param0 == client_data[i].param0 &&
+				server_data[i].param1 == client_data[i].param1 &&
+				server_data[i].param2 == client_data[i].param2);
+	}
+}
@@ -0,0 +1,280 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include "network/mediaserver.h"
+#include "util/hex.h"
+#include "util/serialize.h"
+
+#ifndef _WIN32
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <unistd.h>
+#endif
+
+class TestMediaServer : public TestBase {
+public:
+	TestMediaServer() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMediaServer"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testParseRequestHeader();
+	void testAnswerHashSet();
+	void testParseMediaPath();
+	void testServe();
+	void testIdleConnection();
+
+	static const int port = 30004;
+};
+
+static TestMediaServer g_test_instance;
+
+void TestMediaServer::runTests(IGameDef *gamedef)
+{
+	TEST(testParseRequestHeader);
+	TEST(testAnswerHashSet);
+	TEST(testParseMediaPath);
+#ifndef _WIN32
+	TEST(testServe);
+	TEST(testIdleConnection);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::string makeHashSet(const std::vector<std::string> &hashes)
+{
+	std::ostringstream os(std::ios_base::binary);
+	writeU32(os, 0x4d544853);
+	writeU16(os, 1);
+	for (size_t i = 0; i < hashes.size(); i++)
+		os << hashes[i];
+	return os.str();
+}
+
+#ifndef _WIN32
+static int connectToServer(u16 port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	// Fail instead of hanging if the server doesn't answer
+	struct timeval timeout;
+	timeout.tv_sec = 5;
+	timeout.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	struct sockaddr_in address = Address(127, 0, 0, 1, port).getAddress();
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Receives until the server closes the connection
+static std::string receiveAll(int fd)
+{
+	std::string response;
+	char buf[1024];
+	ssize_t received;
+	while ((received = recv(fd, buf, sizeof(buf), 0)) > 0)
+		response.append(buf, received);
+	return response;
+}
+#endif
+
+void TestMediaServer::testParseRequestHeader()
+{
+	HTTPRequest req;
+	UASSERT(MediaHTTPServer::parseRequestHeader(
+		"POST /media/index.mth?x=1 HTTP/1.1\r\n"
+		"Host: example.com\r\n"
+		"Content-Length: 46\r\n"
+		"Expect: 100-continue\r\n", req));
+	UASSERT(req.method == "POST");
+	UASSERT(req.path == "media/index.mth");
+	UASSERTEQ(u32, req.content_length, 46);
+	UASSERT(req.keep_alive);
+	UASSERT(req.expect_continue);
+
+	UASSERT(MediaHTTPServer::parseRequestHeader(
+		"GET /abc HTTP/1.1\r\nconnection: Close\r\n", req));
+	UASSERT(req.method == "GET");
+	UASSERT(req.path == "abc");
+	UASSERTEQ(u32, req.content_length, 0);
+	UASSERT(!req.keep_alive);
+	UASSERT(!req.expect_continue);
+
+	// HTTP/1.0 closes connections unless asked not to
+	UASSERT(MediaHTTPServer::parseRequestHeader("GET / HTTP/1.0\r\n", req));
+	UASSERT(!req.keep_alive);
+
+	UASSERT(!MediaHTTPServer::parseRequestHeader("GET /\r\n", req));
+	UASSERT(!MediaHTTPServer::parseRequestHeader("GET abc HTTP/1.1\r\n", req));
+	UASSERT(!MediaHTTPServer::parseRequestHeader(
+		"POST / HTTP/1.1\r\nContent-Length: -1\r\n", req));
+	UASSERT(!MediaHTTPServer::parseRequestHeader(
+		"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n", req));
+	UASSERT(!MediaHTTPServer::parseRequestHeader(
+		"GET / HTTP/1.1\r\nno colon\r\n", req));
+}
+
+void TestMediaServer::testAnswerHashSet()
+{
+	std::string a(20, 'a'), b(20, 'b'), c(20, 'c');
+	std::map<std::string, std::string> files;
+	files[a] = "a.png";
+	files[c] = "c.ogg";
+
+	std::vector<std::string> requested;
+	requested.push_back(a);
+	requested.push_back(b);
+	requested.push_back(c);
+
+	std::vector<std::string> available;
+	available.push_back(a);
+	available.push_back(c);
+
+	std::string answer;
+	UASSERT(MediaHTTPServer::answerHashSet(makeHashSet(requested), files, answer));
+	UASSERT(answer == makeHashSet(available));
+
+	UASSERT(MediaHTTPServer::answerHashSet(makeHashSet(std::vector<std::string>()),
+		files, answer));
+	UASSERTEQ(size_t, answer.size(), 6);
+
+	UASSERT(!MediaHTTPServer::answerHashSet("", files, answer));
+	UASSERT(!MediaHTTPServer::answerHashSet(makeHashSet(requested) + "x",
+		files, answer));
+	UASSERT(!MediaHTTPServer::answerHashSet(std::string(26, 'M'), files, answer));
+}
+
+void TestMediaServer::testParseMediaPath()
+{
+	std::string sha1;
+	UASSERT(MediaHTTPServer::parseMediaPath(
+		"00ff10A0000000000000000000000000000000e1", sha1));
+	UASSERTEQ(size_t, sha1.size(), 20);
+	UASSERTEQ(u8, (u8)sha1[0], 0x00);
+	UASSERTEQ(u8, (u8)sha1[1], 0xff);
+	UASSERTEQ(u8, (u8)sha1[2], 0x10);
+	UASSERTEQ(u8, (u8)sha1[3], 0xa0);
+	UASSERTEQ(u8, (u8)sha1[19], 0xe1);
+
+	UASSERT(!MediaHTTPServer::parseMediaPath("index.mth", sha1));
+	UASSERT(!MediaHTTPServer::parseMediaPath(
+		"00ff10a0000000000000000000000000000000g1", sha1));
+}
+
+void TestMediaServer::testServe()
+{
+	std::string path = getTestTempFile();
+	std::string content = "media file contents";
+	{
+		std::ofstream os(path.c_str(), std::ios_base::binary);
+		os << content;
+	}
+
+	std::string sha1(20, '\x12');
+	std::map<std::string, std::string> files;
+	files[sha1] = path;
+
+	MediaHTTPServer server(files);
+	server.start(Address(127, 0, 0, 1, port), 2);
+
+	int fd = connectToServer(port);
+	UASSERT(fd >= 0);
+
+	// Pipelined requests on one connection, the last one closes it
+	std::vector<std::string> requested;
+	requested.push_back(sha1);
+	requested.push_back(std::string(20, 'x'));
+	std::string hashset = makeHashSet(requested);
+	std::ostringstream request;
+	request << "POST /index.mth HTTP/1.1\r\n"
+		<< "Content-Length: " << hashset.size() << "\r\n\r\n" << hashset
+		<< "GET /" << std::string(40, '1') << " HTTP/1.1\r\n\r\n"
+		<< "GET /unknown HTTP/1.1\r\n\r\n"
+		<< "GET /" << hex_encode(sha1) << " HTTP/1.1\r\n"
+		<< "Connection: close\r\n\r\n";
+	std::string data = request.str();
+	UASSERT(send(fd, data.c_str(), data.size(), 0) == (ssize_t)data.size());
+
+	std::string response = receiveAll(fd);
+	close(fd);
+	server.stop();
+
+	std::vector<std::string> available;
+	available.push_back(sha1);
+	std::string answer = makeHashSet(available);
+
+	size_t pos = response.find("HTTP/1.1 200 OK\r\n");
+	UASSERT(pos == 0);
+	pos = response.find("\r\n\r\n", pos) + 4;
+	UASSERT(response.compare(pos, answer.size(), answer) == 0);
+	pos = response.find("HTTP/1.1 404 Not Found\r\n", pos);
+	UASSERT(pos != std::string::npos);
+	pos = response.find("HTTP/1.1 404 Not Found\r\n", pos + 1);
+	UASSERT(pos != std::string::npos);
+	pos = response.find("HTTP/1.1 200 OK\r\n", pos);
+	UASSERT(pos != std::string::npos);
+	UASSERT(response.find("Content-Length: 19\r\n", pos) != std::string::npos);
+	pos = response.find("\r\n\r\n", pos) + 4;
+	UASSERT(response.substr(pos) == content);
+}
+
+void TestMediaServer::testIdleConnection()
+{
+	std::map<std::string, std::string> files;
+	MediaHTTPServer server(files);
+	server.start(Address(127, 0, 0, 1, port), 1);
+
+	// An idle keep-alive connection must not hold the only worker
+	int idle_fd = connectToServer(port);
+	UASSERT(idle_fd >= 0);
+	const char *request = "GET /unknown HTTP/1.1\r\n\r\n";
+	UASSERT(send(idle_fd, request, strlen(request), 0) == (ssize_t)strlen(request));
+	char buf[1024];
+	UASSERT(recv(idle_fd, buf, sizeof(buf), 0) > 0);
+
+	int fd = connectToServer(port);
+	UASSERT(fd >= 0);
+	request = "GET /unknown HTTP/1.1\r\nConnection: close\r\n\r\n";
+	UASSERT(send(fd, request, strlen(request), 0) == (ssize_t)strlen(request));
+	std::string response = receiveAll(fd);
+	close(fd);
+	UASSERT(response.find("HTTP/1.1 404 Not Found\r\n") == 0);
+
+	// The idle connection can still be used
+	UASSERT(send(idle_fd, request, strlen(request), 0) == (ssize_t)strlen(request));
+	response = receiveAll(idle_fd);
+	close(idle_fd);
+	UASSERT(response.find("HTTP/1.1 404 Not Found\r\n") == 0);
+
+	server.stop();
+}
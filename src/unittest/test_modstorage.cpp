@@ -0,0 +1,170 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "filesys.h"
+#include "mod_storage.h"
+#include "database-dummy.h"
+#include "database-sqlite3.h"
+
+class TestModStorage : public TestBase {
+public:
+	TestModStorage() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestModStorage"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSetGet();
+	void testWriteBehind();
+	void testSQLite3Persistence();
+	void testSQLite3FailedSave();
+};
+
+static TestModStorage g_test_instance;
+
+void TestModStorage::runTests(IGameDef *gamedef)
+{
+	TEST(testSetGet);
+	TEST(testWriteBehind);
+	TEST(testSQLite3Persistence);
+	TEST(testSQLite3FailedSave);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestModStorage::testSetGet()
+{
+	ModStorageManager manager(new ModStorageDatabaseDummy(), 5);
+	ModStorage *storage = manager.getModStorage("testmod");
+	UASSERT(manager.getModStorage("testmod") == storage);
+	UASSERT(storage->getModName() == "testmod");
+
+	UASSERT(!storage->contains("key"));
+	UASSERT(storage->getString("key") == "");
+	UASSERT(storage->setString("key", "value"));
+	UASSERT(!storage->setString("key", "value"));
+	UASSERT(storage->contains("key"));
+	UASSERT(storage->getString("key") == "value");
+
+	UASSERT(storage->setString("key", ""));
+	UASSERT(!storage->contains("key"));
+	UASSERT(!storage->setString("key", ""));
+	UASSERT(storage->getEntries().empty());
+}
+
+void TestModStorage::testWriteBehind()
+{
+	ModStorageDatabaseDummy *db = new ModStorageDatabaseDummy();
+	ModStorageManager manager(db, 5);
+	ModStorage *storage = manager.getModStorage("testmod");
+
+	storage->setString("a", "1");
+	storage->setString("b", "2");
+	storage->setString("b", "3");
+
+	// Nothing is written before the flush
+	std::map<std::string, std::string> entries;
+	db->getModEntries("testmod", entries);
+	UASSERT(entries.empty());
+
+	manager.flush();
+	db->getModEntries("testmod", entries);
+	UASSERT(entries.size() == 2);
+	UASSERT(entries["b"] == "3");
+
+	storage->setString("a", "");
+	manager.flush();
+	entries.clear();
+	db->getModEntries("testmod", entries);
+	UASSERT(entries.size() == 1 && entries.count("b") == 1);
+}
+
+void TestModStorage::testSQLite3Persistence()
+{
+	std::string dir = getTestTempDirectory();
+	{
+		ModStorageManager manager(new ModStorageDatabaseSQLite3(dir), 0.1);
+		manager.start();
+		ModStorage *storage = manager.getModStorage("testmod");
+		storage->setString("key", "value");
+		storage->setString(std::string("bin\0ary", 7), std::string("\0\1", 2));
+		manager.getModStorage("othermod")->setString("key", "other");
+		// Destruction writes the rest
+	}
+	{
+		ModStorageManager manager(new ModStorageDatabaseSQLite3(dir), 0.1);
+		ModStorage *storage = manager.getModStorage("testmod");
+		UASSERT(storage->getEntries().size() == 2);
+		UASSERT(storage->getString("key") == "value");
+		UASSERT(storage->getString(std::string("bin\0ary", 7)) ==
+			std::string("\0\1", 2));
+		UASSERT(manager.getModStorage("othermod")->getString("key") == "other");
+	}
+	fs::DeleteSingleFileOrEmptyDirectory(dir + DIR_DELIM "mod_storage.sqlite");
+}
+
+// Fails in the middle of the next transaction
+class FailingModStorageDatabase : public ModStorageDatabaseSQLite3
+{
+public:
+	FailingModStorageDatabase(const std::string &savedir):
+		ModStorageDatabaseSQLite3(savedir),
+		fail(false)
+	{}
+
+	bool setModEntry(const std::string &modname,
+			const std::string &key, const std::string &value)
+	{
+		ModStorageDatabaseSQLite3::setModEntry(modname, key, value);
+		if (fail) {
+			fail = false;
+			throw FileNotGoodException("Test failure");
+		}
+		return true;
+	}
+
+	bool fail;
+};
+
+void TestModStorage::testSQLite3FailedSave()
+{
+	std::string dir = getTestTempDirectory();
+	FailingModStorageDatabase *db = new FailingModStorageDatabase(dir);
+	{
+		ModStorageManager manager(db, 5);
+		ModStorage *storage = manager.getModStorage("testmod");
+		storage->setString("a", "1");
+		storage->setString("b", "2");
+
+		// Nothing of the failed transaction is kept
+		db->fail = true;
+		manager.flush();
+		std::map<std::string, std::string> entries;
+		db->getModEntries("testmod", entries);
+		UASSERT(entries.empty());
+
+		// The next flush writes the changes again
+		manager.flush();
+		db->getModEntries("testmod", entries);
+		UASSERT(entries.size() == 2);
+		UASSERT(entries["a"] == "1");
+	}
+	fs::DeleteSingleFileOrEmptyDirectory(dir + DIR_DELIM "mod_storage.sqlite");
+}
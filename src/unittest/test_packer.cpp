@@ -0,0 +1,211 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "exceptions.h"
+#include "cpp_api/s_base.h"
+#include "cpp_api/s_internal.h"
+#include "common/c_packer.h"
+#include "lua_api/l_sharedbuffer.h"
+#include "lua_api/l_util.h"
+#include "util/basic_macros.h"
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+class TestPacker : public TestBase {
+public:
+	TestPacker() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPacker"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testRoundTrip();
+	void testRejected();
+	void testSharedBuffer();
+};
+
+static TestPacker g_test_instance;
+
+static const char *test_script =
+	"function equals(a, b)\n"
+	"	if type(a) ~= \"table\" or type(b) ~= \"table\" then\n"
+	"		return a == b\n"
+	"	end\n"
+	"	for k, v in pairs(a) do\n"
+	"		if not equals(v, b[k]) then return false end\n"
+	"	end\n"
+	"	for k in pairs(b) do\n"
+	"		if a[k] == nil then return false end\n"
+	"	end\n"
+	"	return true\n"
+	"end\n";
+
+// A Lua state like the one of the game or of an async worker
+class PackerScript : public ScriptApiBase
+{
+public:
+	PackerScript()
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		LuaSharedBuffer::Register(L);
+		lua_getglobal(L, "core");
+		ModApiUtil::Initialize(L, lua_gettop(L));
+		lua_pop(L, 1);
+		run(test_script);
+	}
+
+	void run(const std::string &code)
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		if (luaL_dostring(L, code.c_str()) != 0)
+			throw LuaError(lua_tostring(L, -1));
+	}
+
+	bool check(const std::string &expr)
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		if (luaL_dostring(L, ("return " + expr).c_str()) != 0)
+			throw LuaError(lua_tostring(L, -1));
+		return lua_toboolean(L, -1);
+	}
+
+	void pack(const char *name, PackedValue &packed)
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		lua_getglobal(L, name);
+		script_pack(L, -1, packed);
+	}
+
+	void unpack(const char *name, const PackedValue &packed)
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		script_unpack(L, packed);
+		lua_setglobal(L, name);
+	}
+
+	SharedBufferData *getBufferData(const char *name)
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		lua_getglobal(L, name);
+		return LuaSharedBuffer::checkobject(L, -1)->getData();
+	}
+};
+
+void TestPacker::runTests(IGameDef *gamedef)
+{
+	TEST(testRoundTrip);
+	TEST(testRejected);
+	TEST(testSharedBuffer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestPacker::testRoundTrip()
+{
+	const char *values[] = {
+		"nil",
+		"true",
+		"false",
+		"-1.5",
+		"2^53",
+		"\"a\\0b\"",
+		"{}",
+		"{1, 2, nil, 4}",
+		"{1, x = {y = {z = \"deep\"}}, [1.5] = false, [-1] = true}",
+		"{{}, {{}, {\"a\"}}, [true] = 0}",
+	};
+
+	PackerScript sender, receiver;
+	for (size_t i = 0; i < ARRLEN(values); i++) {
+		std::string value = values[i];
+		sender.run("value = " + value);
+		receiver.run("expected = " + value);
+
+		PackedValue packed;
+		sender.pack("value", packed);
+		UASSERT(packed.buffers.empty());
+		receiver.unpack("received", packed);
+		UASSERT(receiver.check("equals(expected, received)"));
+	}
+
+	// A table referenced twice is no recursion and is packed twice
+	sender.run("local sub = {1} value = {sub, sub}");
+	PackedValue packed;
+	sender.pack("value", packed);
+	receiver.unpack("received", packed);
+	UASSERT(receiver.check("equals(received, {{1}, {1}})"));
+	UASSERT(receiver.check("received[1] ~= received[2]"));
+}
+
+void TestPacker::testRejected()
+{
+	PackerScript script;
+	PackedValue packed;
+
+	script.run("value = {} value.a = {value}");
+	EXCEPTION_CHECK(LuaError, script.pack("value", packed));
+
+	script.run("value = function() end");
+	EXCEPTION_CHECK(LuaError, script.pack("value", packed));
+	script.run("value = {f = coroutine.create(function() end)}");
+	EXCEPTION_CHECK(LuaError, script.pack("value", packed));
+
+	const char *nest =
+		"value = {} local t = value\n"
+		"for i = 2, depth do t[1] = {} t = t[1] end\n";
+	script.run(std::string("depth = 150\n") + nest);
+	script.pack("value", packed);
+	script.run(std::string("depth = 300\n") + nest);
+	EXCEPTION_CHECK(LuaError, script.pack("value", packed));
+
+	// The state is still usable
+	script.run("value = {1}");
+	script.pack("value", packed);
+}
+
+void TestPacker::testSharedBuffer()
+{
+	PackedValue packed;
+	SharedBufferData *data;
+	PackerScript receiver;
+	{
+		PackerScript sender;
+		sender.run("buf = core.create_shared_buffer(\"bytes\")\n"
+			"value = {buf, buf, n = buf}");
+		data = sender.getBufferData("buf");
+
+		sender.pack("value", packed);
+		UASSERTEQ(size_t, packed.buffers.size(), 3);
+		for (size_t i = 0; i < packed.buffers.size(); i++)
+			UASSERT(packed.buffers[i] == data);
+		// The contents are referenced, not copied
+		UASSERT(packed.data.find("bytes") == std::string::npos);
+	}
+
+	// The buffer outlives the state that created it
+	receiver.unpack("received", packed);
+	packed.clear();
+	receiver.run("buf = received.n");
+	UASSERT(receiver.getBufferData("buf") == data);
+	UASSERT(receiver.check("received[1]:to_string() == \"bytes\""));
+	UASSERT(receiver.check("received[2]:size() == 5"));
+}
@@ -0,0 +1,265 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "exceptions.h"
+#include "filesys.h"
+#include "player.h"
+#include "util/basic_macros.h"
+#include "database-dummy.h"
+#include "database-files.h"
+#include "database-sqlite3.h"
+
+class TestPlayerDB : public TestBase {
+public:
+	TestPlayerDB() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPlayerDB"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBinaryFormat();
+	void testDummy();
+	void testSQLite3();
+	void testFiles();
+
+	void testAuthLine();
+	void testAuthCache();
+	void testAuthSQLite3();
+	void testAuthFiles();
+
+	void testBackend(PlayerDatabase *db);
+	void testAuthBackend(AuthDatabase *db);
+};
+
+static TestPlayerDB g_test_instance;
+
+static const char *player_text =
+	"breath = 11\n"
+	"hp = 20\n"
+	"name = singleplayer\n"
+	"pitch = 0\n"
+	"position = (0,100,0)\n"
+	"version = 1\n"
+	"yaw = 0\n"
+	"PlayerArgsEnd\n"
+	"List main 1\n"
+	"Width 0\n"
+	"Item default:dirt 99\n"
+	"EndInventoryList\n"
+	"EndInventory\n";
+
+void TestPlayerDB::runTests(IGameDef *gamedef)
+{
+	TEST(testBinaryFormat);
+	TEST(testDummy);
+	TEST(testSQLite3);
+	TEST(testFiles);
+	TEST(testAuthLine);
+	TEST(testAuthCache);
+	TEST(testAuthSQLite3);
+	TEST(testAuthFiles);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestPlayerDB::testBinaryFormat()
+{
+	std::string data = Player::textToBinary(player_text);
+	UASSERT(data.size() > 1);
+	UASSERT((u8)data[0] == PLAYER_BINARY_VERSION);
+	UASSERT(Player::binaryToText(data) == player_text);
+
+	data[0] = PLAYER_BINARY_VERSION + 1;
+	EXCEPTION_CHECK(SerializationError, Player::binaryToText(data));
+}
+
+void TestPlayerDB::testBackend(PlayerDatabase *db)
+{
+	std::string data = Player::textToBinary(player_text);
+
+	UASSERT(db->loadPlayer("singleplayer").empty());
+
+	db->beginSave();
+	UASSERT(db->savePlayer("singleplayer", data));
+	db->endSave();
+
+	UASSERT(Player::binaryToText(db->loadPlayer("singleplayer")) ==
+		player_text);
+
+	std::vector<std::string> names;
+	db->listPlayers(names);
+	UASSERT(std::find(names.begin(), names.end(), "singleplayer") !=
+		names.end());
+
+	UASSERT(db->deletePlayer("singleplayer"));
+	UASSERT(db->loadPlayer("singleplayer").empty());
+	UASSERT(!db->deletePlayer("singleplayer"));
+}
+
+void TestPlayerDB::testDummy()
+{
+	PlayerDatabaseDummy db;
+	testBackend(&db);
+}
+
+void TestPlayerDB::testSQLite3()
+{
+	std::string dir = getTestTempDirectory();
+	{
+		PlayerDatabaseSQLite3 db(dir);
+		testBackend(&db);
+	}
+	fs::DeleteSingleFileOrEmptyDirectory(dir + DIR_DELIM "players.sqlite");
+}
+
+void TestPlayerDB::testFiles()
+{
+	std::string dir = getTestTempDirectory();
+	PlayerDatabaseFiles db(dir);
+	testBackend(&db);
+	fs::RecursiveDelete(dir + DIR_DELIM "players");
+}
+
+void TestPlayerDB::testAuthLine()
+{
+	AuthEntry entry;
+	UASSERT(entry.fromLine("celeron55::interact,shout"));
+	UASSERT(entry.name == "celeron55");
+	UASSERT(entry.password == "");
+	UASSERT(entry.privileges.size() == 2);
+	UASSERT(entry.privileges[1] == "shout");
+	UASSERT(entry.last_login == -1);
+	UASSERT(entry.toLine() == "celeron55::interact,shout:");
+
+	UASSERT(entry.fromLine("foo:iEPX+SQWIR3p67lj/0zigSWTKHg::1456000000"));
+	UASSERT(entry.privileges.empty());
+	UASSERT(entry.last_login == 1456000000);
+	UASSERT(entry.toLine() == "foo:iEPX+SQWIR3p67lj/0zigSWTKHg::1456000000");
+
+	UASSERT(!entry.fromLine("foo"));
+	UASSERT(!entry.fromLine(":pw:shout"));
+}
+
+void TestPlayerDB::testAuthBackend(AuthDatabase *db)
+{
+	AuthEntry entry;
+	UASSERT(!db->getAuth("singleplayer", entry));
+
+	entry.name = "singleplayer";
+	entry.password = "#1#salt#verifier";
+	entry.privileges.push_back("interact");
+	entry.privileges.push_back("shout");
+	entry.last_login = 1456000000;
+	UASSERT(db->saveAuth(entry));
+
+	AuthEntry res;
+	UASSERT(db->getAuth("singleplayer", res));
+	UASSERT(res.toLine() == entry.toLine());
+
+	entry.privileges.clear();
+	UASSERT(db->saveAuth(entry));
+	UASSERT(db->getAuth("singleplayer", res));
+	UASSERT(res.privileges.empty());
+
+	std::vector<std::string> names;
+	db->listNames(names);
+	UASSERT(names.size() == 1 && names[0] == "singleplayer");
+
+	UASSERT(db->deleteAuth("singleplayer"));
+	UASSERT(!db->getAuth("singleplayer", res));
+
+	db->beginSave();
+	entry.name = "a";
+	UASSERT(db->saveAuth(entry));
+	entry.name = "b";
+	UASSERT(db->saveAuth(entry));
+	UASSERT(db->deleteAuth("a"));
+	UASSERT(db->endSave());
+	UASSERT(!db->getAuth("a", res));
+	UASSERT(db->getAuth("b", res));
+	UASSERT(db->deleteAuth("b"));
+}
+
+void TestPlayerDB::testAuthCache()
+{
+	AuthDatabaseDummy *backend = new AuthDatabaseDummy();
+	AuthDatabaseCache db(backend, 2);
+	testAuthBackend(&db);
+
+	const char *names[] = {"a", "b", "c"};
+	for (size_t i = 0; i < ARRLEN(names); i++) {
+		AuthEntry entry;
+		entry.name = names[i];
+		db.saveAuth(entry);
+	}
+
+	// "a" was evicted, changes to the backend show through
+	AuthEntry entry;
+	entry.name = "a";
+	entry.password = "new";
+	backend->saveAuth(entry);
+	entry.name = "c";
+	backend->saveAuth(entry);
+
+	AuthEntry res;
+	UASSERT(db.getAuth("a", res) && res.password == "new");
+	UASSERT(db.getAuth("c", res) && res.password == "");
+	db.reload();
+	UASSERT(db.getAuth("c", res) && res.password == "new");
+}
+
+void TestPlayerDB::testAuthSQLite3()
+{
+	std::string dir = getTestTempDirectory();
+	{
+		AuthDatabaseSQLite3 db(dir);
+		testAuthBackend(&db);
+	}
+	fs::DeleteSingleFileOrEmptyDirectory(dir + DIR_DELIM "auth.sqlite");
+}
+
+void TestPlayerDB::testAuthFiles()
+{
+	std::string dir = getTestTempDirectory();
+	{
+		AuthDatabaseFiles db(dir);
+		testAuthBackend(&db);
+
+		AuthEntry entry;
+		entry.fromLine("celeron55::interact,shout:");
+		db.saveAuth(entry);
+	}
+	AuthDatabaseFiles db(dir);
+	AuthEntry res;
+	UASSERT(db.getAuth("celeron55", res));
+	UASSERT(res.toLine() == "celeron55::interact,shout:");
+
+	// Batched saves are written by endSave
+	AuthDatabaseFiles other(dir);
+	db.beginSave();
+	UASSERT(db.deleteAuth("celeron55"));
+	other.reload();
+	UASSERT(other.getAuth("celeron55", res));
+	UASSERT(db.endSave());
+	other.reload();
+	UASSERT(!other.getAuth("celeron55", res));
+	fs::DeleteSingleFileOrEmptyDirectory(dir + DIR_DELIM "auth.txt");
+}
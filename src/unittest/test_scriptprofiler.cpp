@@ -0,0 +1,190 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "exceptions.h"
+#include "cpp_api/s_base.h"
+#include "cpp_api/s_internal.h"
+#include <sstream>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+class TestScriptProfiler : public TestBase {
+public:
+	TestScriptProfiler() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestScriptProfiler"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCallbackTimes();
+	void testPcallProfiled();
+	void testSampling();
+};
+
+static TestScriptProfiler g_test_instance;
+
+static const char *test_script =
+	"core.callback_origins = {}\n"
+	"function core.run_callbacks(callbacks, mode, ...)\n"
+	"	local ret = false\n"
+	"	for _, cb in ipairs(callbacks) do\n"
+	"		ret = cb(...) or ret\n"
+	"	end\n"
+	"	return ret\n"
+	"end\n"
+	"function busy()\n"
+	"	local x = 0\n"
+	"	for i = 1, 200000 do x = x + i end\n"
+	"	return x\n"
+	"end\n"
+	"local function a(n) return n > 1 end\n"
+	"local function b(n) busy() return false end\n"
+	"callbacks = {a, b}\n"
+	"core.callback_origins[a] = {mod = \"moda\"}\n"
+	"core.callback_origins[b] = {mod = \"modb\"}\n";
+
+class ProfiledScript : public ScriptApiBase
+{
+public:
+	ProfiledScript()
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		if (luaL_dostring(L, test_script) != 0)
+			throw LuaError(lua_tostring(L, -1));
+	}
+
+	bool runTestCallbacks(int n)
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		lua_getglobal(L, "callbacks");
+		lua_pushnumber(L, n);
+		runCallbacks(1, RUN_CALLBACKS_MODE_OR);
+		return lua_toboolean(L, -1);
+	}
+
+	void callBusy()
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		int error_handler = PUSH_ERROR_HANDLER(L);
+		lua_getglobal(L, "busy");
+		setOriginDirect("directmod");
+		PCALL_RES(pcallProfiled(0, 0, error_handler));
+		lua_pop(L, 1); // Pop error handler
+	}
+};
+
+void TestScriptProfiler::runTests(IGameDef *gamedef)
+{
+	TEST(testCallbackTimes);
+	TEST(testPcallProfiled);
+	TEST(testSampling);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const ScriptProfiler::Stats *find_stats(const ScriptProfiler &profiler,
+		const std::string &mod, const std::string &type)
+{
+	const ScriptProfiler::StatsMap &stats = profiler.getStats();
+	for (ScriptProfiler::StatsMap::const_iterator it = stats.begin();
+			it != stats.end(); ++it)
+		if (it->first.mod == mod && it->first.type == type)
+			return &it->second;
+	return NULL;
+}
+
+void TestScriptProfiler::testCallbackTimes()
+{
+	ProfiledScript script;
+	ScriptProfiler &profiler = script.getProfiler();
+
+	UASSERT(script.runTestCallbacks(2));
+	UASSERT(profiler.getStats().empty());
+
+	script.setProfiling(true);
+	UASSERT(script.runTestCallbacks(2));
+	UASSERT(!script.runTestCallbacks(0));
+	UASSERTEQ(size_t, profiler.getStats().size(), 2);
+
+	const ScriptProfiler::Stats *stats_a =
+		find_stats(profiler, "moda", "runTestCallbacks");
+	const ScriptProfiler::Stats *stats_b =
+		find_stats(profiler, "modb", "runTestCallbacks");
+	UASSERT(stats_a && stats_b);
+	UASSERTEQ(u32, stats_a->count, 2);
+	UASSERTEQ(u32, stats_b->count, 2);
+	UASSERT(stats_b->wall_us >= stats_b->max_wall_us);
+	UASSERT(profiler.getStats().begin()->first.function.find(":") !=
+		std::string::npos);
+
+	// The last callback's mod is the origin afterwards
+	UASSERT(script.getOrigin() == "modb");
+
+	script.setProfiling(false);
+	script.runTestCallbacks(2);
+	stats_a = find_stats(profiler, "moda", "runTestCallbacks");
+	UASSERTEQ(u32, stats_a->count, 2);
+
+	profiler.clear();
+	UASSERT(profiler.getStats().empty());
+}
+
+void TestScriptProfiler::testPcallProfiled()
+{
+	ProfiledScript script;
+	ScriptProfiler &profiler = script.getProfiler();
+
+	script.callBusy();
+	UASSERT(profiler.getStats().empty());
+
+	script.setProfiling(true);
+	script.callBusy();
+	const ScriptProfiler::Stats *stats =
+		find_stats(profiler, "directmod", "callBusy");
+	UASSERT(stats);
+	UASSERTEQ(u32, stats->count, 1);
+	UASSERTEQ(u32, profiler.getSampleCount(), 0);
+}
+
+void TestScriptProfiler::testSampling()
+{
+	ProfiledScript script;
+	ScriptProfiler &profiler = script.getProfiler();
+
+	// Sample as often as possible
+	script.setProfiling(true, 1);
+	UASSERT(profiler.isSampling());
+	script.callBusy();
+	UASSERT(profiler.getSampleCount() > 0);
+
+	std::ostringstream os;
+	profiler.writeFolded(os);
+	std::string folded = os.str();
+	// busy() is called from C, so it has no name
+	UASSERT(folded.find("directmod;[string ") == 0);
+
+	script.setProfiling(false);
+	UASSERT(!profiler.isSampling());
+	u32 samples = profiler.getSampleCount();
+	script.callBusy();
+	UASSERTEQ(u32, profiler.getSampleCount(), samples);
+}
@@ -0,0 +1,129 @@
+/*
+Minetest
+Copyright (C) 2013 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "exceptions.h"
+#include "settings.h"
+#include "cpp_api/s_env.h"
+#include "cpp_api/s_internal.h"
+#include "lua_api/l_env.h"
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+class TestScriptTasks : public TestBase {
+public:
+	TestScriptTasks() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestScriptTasks"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testBudgetExhausted();
+	void testBudgetLeft();
+};
+
+static TestScriptTasks g_test_instance;
+
+static const char *test_script =
+	"log = {}\n"
+	"core.callback_origins = {}\n"
+	"core.registered_globalsteps = {}\n"
+	"function core.run_callbacks(callbacks, mode, ...)\n"
+	"	for _, cb in ipairs(callbacks) do cb(...) end\n"
+	"end\n"
+	"core.add_task(function()\n"
+	"	for i = 1, 3 do\n"
+	"		log[#log + 1] = \"a\" .. i\n"
+	"		coroutine.yield()\n"
+	"	end\n"
+	"end)\n"
+	"core.add_task(function()\n"
+	"	log[#log + 1] = \"d\"\n"
+	"end, {deferrable = true})\n";
+
+class TaskScript : public ScriptApiEnv
+{
+public:
+	TaskScript()
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		lua_getglobal(L, "core");
+		ModApiEnvMod::Initialize(L, lua_gettop(L));
+		lua_pop(L, 1);
+		if (luaL_dostring(L, test_script) != 0)
+			throw LuaError(lua_tostring(L, -1));
+	}
+
+	std::string getLog()
+	{
+		SCRIPTAPI_PRECHECKHEADER
+		std::string log;
+		lua_getglobal(L, "log");
+		for (int i = 1; ; i++) {
+			lua_rawgeti(L, -1, i);
+			if (lua_isnil(L, -1))
+				break;
+			log += lua_tostring(L, -1);
+			lua_pop(L, 1);
+		}
+		return log;
+	}
+};
+
+void TestScriptTasks::runTests(IGameDef *gamedef)
+{
+	std::string budget = g_settings->get("globalstep_time_budget");
+
+	TEST(testBudgetExhausted);
+	TEST(testBudgetLeft);
+
+	g_settings->set("globalstep_time_budget", budget);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestScriptTasks::testBudgetExhausted()
+{
+	// Without budget each task that isn't deferrable runs once per step
+	g_settings->setFloat("globalstep_time_budget", 0);
+	TaskScript script;
+	UASSERTEQ(size_t, script.getTaskCount(), 2);
+
+	script.environment_Step(0.1);
+	UASSERTEQ(std::string, script.getLog(), "a1");
+	script.environment_Step(0.1);
+	script.environment_Step(0.1);
+	UASSERTEQ(std::string, script.getLog(), "a1a2a3");
+	script.environment_Step(0.1);
+	UASSERTEQ(size_t, script.getTaskCount(), 1);
+	UASSERTEQ(std::string, script.getLog(), "a1a2a3");
+}
+
+void TestScriptTasks::testBudgetLeft()
+{
+	g_settings->setFloat("globalstep_time_budget", 1000);
+	TaskScript script;
+
+	// Both tasks run in turns until they are done
+	script.environment_Step(0.1);
+	UASSERTEQ(std::string, script.getLog(), "a1da2a3");
+	UASSERTEQ(size_t, script.getTaskCount(), 0);
+}
@@ -0,0 +1,156 @@
+/*
+Minetest
+Copyright (C) 2016 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "network/networkpacket.h"
+#include "network/networkprotocol.h"
+#include "network/serverreceivequeue.h"
+
+class TestServerReceiveQueue : public TestBase {
+public:
+	TestServerReceiveQueue() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestServerReceiveQueue"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testPlayerPosDecode();
+	void testCoalescing();
+	void testOrder();
+};
+
+static TestServerReceiveQueue g_test_instance;
+
+void TestServerReceiveQueue::runTests(IGameDef *gamedef)
+{
+	TEST(testPlayerPosDecode);
+	TEST(testCoalescing);
+	TEST(testOrder);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static ReceivedCommand make_playerpos(u16 peer_id, s32 x)
+{
+	ReceivedCommand cmd;
+	cmd.peer_id = peer_id;
+	cmd.command = TOSERVER_PLAYERPOS;
+	cmd.playerpos.position = v3f(x, 0, 0);
+	return cmd;
+}
+
+static ReceivedCommand make_packet(u16 peer_id, u16 command)
+{
+	ReceivedCommand cmd;
+	cmd.peer_id = peer_id;
+	cmd.command = command;
+	cmd.pkt = new NetworkPacket(command, 0, peer_id);
+	return cmd;
+}
+
+void TestServerReceiveQueue::testPlayerPosDecode()
+{
+	PlayerPosUpdate pos;
+
+	// As received from the connection
+	NetworkPacket sent(TOSERVER_PLAYERPOS, 0);
+	sent << v3s32(150, -200, 1000) << v3s32(0, 0, 0)
+		<< (s32)4500 << (s32)45000 << (u32)0x41;
+	SharedBuffer<u8> data = sent.oldForgePacket();
+
+	NetworkPacket short_pkt;
+	short_pkt.putRawPacket(*data, 2 + 12, 1);
+	UASSERT(!pos.deSerialize(&short_pkt));
+
+	NetworkPacket pkt;
+	pkt.putRawPacket(*data, data.getSize(), 1);
+	UASSERT(pos.deSerialize(&pkt));
+	UASSERT(pos.position == v3f(1.5, -2, 10));
+	UASSERT(pos.pitch == 45);
+	UASSERT(pos.yaw == 90);
+	UASSERTEQ(u32, pos.keys_pressed, 0x41);
+}
+
+void TestServerReceiveQueue::testCoalescing()
+{
+	ServerReceiveQueue queue;
+	std::vector<ReceivedCommand> commands;
+
+	queue.push(make_playerpos(1, 1));
+	queue.push(make_playerpos(2, 1));
+	queue.push(make_playerpos(1, 2));
+	queue.push(make_playerpos(2, 2));
+	queue.push(make_playerpos(1, 3));
+	UASSERTEQ(u32, queue.size(), 2);
+
+	UASSERT(queue.popAll(commands, 0));
+	UASSERTEQ(size_t, commands.size(), 2);
+	UASSERTEQ(u16, commands[0].peer_id, 1);
+	UASSERT(commands[0].playerpos.position.X == 3);
+	UASSERTEQ(u16, commands[1].peer_id, 2);
+	UASSERT(commands[1].playerpos.position.X == 2);
+
+	// Nothing is left
+	commands.clear();
+	UASSERT(!queue.popAll(commands, 0));
+	UASSERT(commands.empty());
+
+	// Positions with other keys pressed are kept, so that a key pressed
+	// and released within one batch is seen
+	ReceivedCommand pressed = make_playerpos(1, 2);
+	pressed.playerpos.keys_pressed = 0x20;
+	queue.push(make_playerpos(1, 1));
+	queue.push(pressed);
+	pressed.playerpos.position.X = 3;
+	queue.push(pressed);
+	queue.push(make_playerpos(1, 4));
+	queue.push(make_playerpos(1, 5));
+	UASSERTEQ(u32, queue.size(), 3);
+
+	UASSERT(queue.popAll(commands, 0));
+	UASSERTEQ(size_t, commands.size(), 3);
+	UASSERT(commands[0].playerpos.position.X == 1);
+	UASSERT(commands[1].playerpos.position.X == 3);
+	UASSERTEQ(u32, commands[1].playerpos.keys_pressed, 0x20);
+	UASSERT(commands[2].playerpos.position.X == 5);
+	UASSERTEQ(u32, commands[2].playerpos.keys_pressed, 0);
+}
+
+void TestServerReceiveQueue::testOrder()
+{
+	ServerReceiveQueue queue;
+	std::vector<ReceivedCommand> commands;
+
+	// A position that came before another command of the same peer
+	// stays before it
+	queue.push(make_playerpos(1, 1));
+	queue.push(make_packet(1, TOSERVER_INTERACT));
+	queue.push(make_playerpos(1, 2));
+	queue.push(make_playerpos(1, 3));
+	UASSERTEQ(u32, queue.size(), 3);
+
+	UASSERT(queue.popAll(commands, 0));
+	UASSERTEQ(size_t, commands.size(), 3);
+	UASSERT(commands[0].playerpos.position.X == 1);
+	UASSERTEQ(u16, commands[1].command, TOSERVER_INTERACT);
+	UASSERT(commands[2].playerpos.position.X == 3);
+
+	for (size_t i = 0; i < commands.size(); i++)
+		delete commands[i].pkt;
+}
@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "../irrlichttypes.h"
 #include "../debug.h" // For assert()
+#include "../threading/atomic.h"
 #include <cstring>
 
 template <typename T>
@@ -178,14 +179,11 @@ class Buffer
 	unsigned int m_size;
 };
 
-/************************************************
- *           !!!  W A R N I N G  !!!            *
- *           !!!  A C H T U N G  !!!            *
- *                                              *
- * This smart pointer class is NOT thread safe. *
- * ONLY use in a single-threaded context!       *
- *                                              *
- ************************************************/
+/*
+	The reference count is atomic, so copies of a SharedBuffer can be
+	handed to other threads (e.g. through the connection's queues).
+	The data itself is not protected.
+*/
 template <typename T>
 class SharedBuffer
 {
@@ -194,8 +192,7 @@ class SharedBuffer
 	{
 		m_size = 0;
 		data = NULL;
-		refcount = new unsigned int;
-		(*refcount) = 1;
+		refcount = new Atomic<unsigned int>(1);
 	}
 	SharedBuffer(unsigned int size)
 	{
@@ -204,9 +201,8 @@ class SharedBuffer
 			data = new T[m_size];
 		else
 			data = NULL;
-		refcount = new unsigned int;
+		refcount = new Atomic<unsigned int>(1);
 		memset(data,0,sizeof(T)*m_size);
-		(*refcount) = 1;
 	}
 	SharedBuffer(const SharedBuffer &buffer)
 	{
@@ -241,8 +237,7 @@ class SharedBuffer
 		}
 		else
 			data = NULL;
-		refcount = new unsigned int;
-		(*refcount) = 1;
+		refcount = new Atomic<unsigned int>(1);
 	}
 	/*
 		Copies whole buffer
@@ -257,8 +252,7 @@ class SharedBuffer
 		}
 		else
 			data = NULL;
-		refcount = new unsigned int;
-		(*refcount) = 1;
+		refcount = new Atomic<unsigned int>(1);
 	}
 	~SharedBuffer()
 	{
@@ -284,9 +278,7 @@ class SharedBuffer
 private:
 	void drop()
 	{
-		assert((*refcount) > 0);
-		(*refcount)--;
-		if(*refcount == 0)
+		if (--(*refcount) == 0)
 		{
 			if(data)
 				delete[] data;
@@ -295,7 +287,7 @@ class SharedBuffer
 	}
 	T *data;
 	unsigned int m_size;
-	unsigned int *refcount;
+	Atomic<unsigned int> *refcount;
 };
 
 inline SharedBuffer<u8> SharedBufferFromString(const char *string)